@@ -7,6 +7,8 @@
 #include <sstream>
 #include <initializer_list>
 #include "ics_exceptions.hpp"
+#include "template_function.hpp"
+#include "iteration_policy.hpp"
 #include "pair.hpp"
 #include "array_queue.hpp"   //For traversal
 
@@ -25,7 +27,11 @@ bool undefinedlt (const T& a, const T& b) {return false;}
 //If both tlt and clt are supplied, then they must be the same (by ==) function.
 //If neither is supplied, or both are supplied but different, TemplateFunctionError is raised.
 //The (unique) non-undefinedlt value supplied by tlt/clt is stored in the instance variable gt.
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b) = undefinedlt<KEY>> class BSTMap {
+//A tlt is called directly (see template_function.hpp), so it can be inlined; tlt can also be
+//  functor<F> for a stateless functor class F (e.g., BSTMap<int,int,functor<std::less<int>>>).
+//Iteration (CheckedIteration or UncheckedIteration, see iteration_policy.hpp) decides whether
+//  Iterators and for_each check for concurrent modification.
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b) = undefinedlt<KEY>, class Iteration = CheckedIteration> class BSTMap {
   public:
     typedef pair<KEY,T> Entry;
     typedef bool (*ltfunc) (const KEY& a, const KEY& b);
@@ -34,7 +40,7 @@ template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b) = undefinedl
     ~BSTMap();
 
     BSTMap          (bool (*clt)(const KEY& a, const KEY& b) = undefinedlt<KEY>);
-    BSTMap          (const BSTMap<KEY,T,tlt>& to_copy, bool (*clt)(const KEY& a, const KEY& b) = undefinedlt<KEY>);
+    BSTMap          (const BSTMap<KEY,T,tlt,Iteration>& to_copy, bool (*clt)(const KEY& a, const KEY& b) = undefinedlt<KEY>);
     explicit BSTMap (const std::initializer_list<Entry>& il, bool (*clt)(const KEY& a, const KEY& b) = undefinedlt<KEY>);
 
     //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
@@ -64,12 +70,12 @@ template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b) = undefinedl
 
     T&       operator [] (const KEY&);
     const T& operator [] (const KEY&) const;
-    BSTMap<KEY,T,tlt>& operator = (const BSTMap<KEY,T,tlt>& rhs);
-    bool operator == (const BSTMap<KEY,T,tlt>& rhs) const;
-    bool operator != (const BSTMap<KEY,T,tlt>& rhs) const;
+    BSTMap<KEY,T,tlt,Iteration>& operator = (const BSTMap<KEY,T,tlt,Iteration>& rhs);
+    bool operator == (const BSTMap<KEY,T,tlt,Iteration>& rhs) const;
+    bool operator != (const BSTMap<KEY,T,tlt,Iteration>& rhs) const;
 
-    template<class KEY2,class T2, bool (*lt2)(const KEY2& a, const KEY2& b)>
-    friend std::ostream& operator << (std::ostream& outs, const BSTMap<KEY2,T2,lt2>& m);
+    template<class KEY2,class T2, bool (*lt2)(const KEY2& a, const KEY2& b), class Iteration2>
+    friend std::ostream& operator << (std::ostream& outs, const BSTMap<KEY2,T2,lt2,Iteration2>& m);
 
 
 
@@ -79,34 +85,42 @@ template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b) = undefinedl
         ~Iterator();
         Entry       erase();
         std::string str  () const;
-        BSTMap<KEY,T,tlt>::Iterator& operator ++ ();
-        BSTMap<KEY,T,tlt>::Iterator  operator ++ (int);
-        bool operator == (const BSTMap<KEY,T,tlt>::Iterator& rhs) const;
-        bool operator != (const BSTMap<KEY,T,tlt>::Iterator& rhs) const;
+        BSTMap<KEY,T,tlt,Iteration>::Iterator& operator ++ ();
+        BSTMap<KEY,T,tlt,Iteration>::Iterator  operator ++ (int);
+        bool operator == (const BSTMap<KEY,T,tlt,Iteration>::Iterator& rhs) const;
+        bool operator != (const BSTMap<KEY,T,tlt,Iteration>::Iterator& rhs) const;
         Entry& operator *  () const;
         Entry* operator -> () const;
-        friend std::ostream& operator << (std::ostream& outs, const BSTMap<KEY,T,tlt>::Iterator& i) {
+        friend std::ostream& operator << (std::ostream& outs, const BSTMap<KEY,T,tlt,Iteration>::Iterator& i) {
           outs << i.str(); //Use the same meaning as the debugging .str() method
           return outs;
         }
-        friend Iterator BSTMap<KEY,T,tlt>::begin () const;
-        friend Iterator BSTMap<KEY,T,tlt>::end   () const;
+        friend Iterator BSTMap<KEY,T,tlt,Iteration>::begin () const;
+        friend Iterator BSTMap<KEY,T,tlt,Iteration>::end   () const;
 
       private:
         //If can_erase is false, the value has been removed from "it" (++ does nothing)
         ArrayQueue<Entry> it;                 //Queue for all associations (from begin); use it as iterator via dequeue
-        BSTMap<KEY,T,tlt>* ref_map;
+        BSTMap<KEY,T,tlt,Iteration>* ref_map;
         int               expected_mod_count;
         bool              can_erase = true;
 
         //Called in friends begin/end
-        Iterator(BSTMap<KEY,T,tlt>* iterate_over, bool from_begin);
+        Iterator(BSTMap<KEY,T,tlt,Iteration>* iterate_over, bool from_begin);
     };
 
 
     Iterator begin () const;
     Iterator end   () const;
 
+    //Internal iteration: visit(entry) for each entry (as a const Entry&) in key order, walking the
+    //  tree without copying it into a queue as an Iterator does; visit must not change the map. With
+    //  CheckedIteration, mod_count is compared after each visit, so ConcurrentModificationError is thrown
+    //  after the visit that changed the map has run; with UncheckedIteration the comparison compiles to
+    //  nothing and such a change is undefined.
+    template<class Visitor>
+    void for_each (Visitor visit) const;
+
 
   private:
     class TN {
@@ -121,7 +135,7 @@ template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b) = undefinedl
         TN*   right;
     };
 
-  bool (*lt) (const KEY& a, const KEY& b); // The lt used for searching BST (from template or constructor)
+  TemplateFunction<ltfunc,tlt,undefinedlt<KEY>> lt; // The lt used for searching BST (from template or constructor)
   TN* map       = nullptr;
   int used      = 0;                       //Cache for number of key->value pairs in the BST
   int mod_count = 0;                       //For sensing concurrent modification
@@ -131,7 +145,9 @@ template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b) = undefinedl
   bool  has_value           (TN*  root, const T& value)                 const; //Returns whether value is is root's tree
   TN*   copy                (TN*  root)                                 const; //Copy the keys/values in root's tree (identical structure)
   void  copy_to_queue       (TN* root, ArrayQueue<Entry>& q)            const; //Fill queue with root's tree value
-  bool  equals              (TN*  root, const BSTMap<KEY,T,tlt>& other) const; //Returns whether root's keys/value are all in other
+  template<class Visitor>
+  void  for_each            (TN* root, Visitor& visit, int expected)    const; //visit root's tree's values in order
+  bool  equals              (TN*  root, const BSTMap<KEY,T,tlt,Iteration>& other) const; //Returns whether root's keys/value are all in other
   std::string string_rotated(TN* root, std::string indent)              const; //Returns string representing root's tree
 
   T     insert              (TN*& root, const KEY& key, const T& value);       //Put key->value, returning key's old value (or new one's, if key absent)
@@ -151,14 +167,14 @@ template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b) = undefinedl
 
 //Destructor/Constructors
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-BSTMap<KEY,T,tlt>::~BSTMap() {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+BSTMap<KEY,T,tlt,Iteration>::~BSTMap() {
     delete_BST(map);
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-BSTMap<KEY,T,tlt>::BSTMap(bool (*clt)(const KEY& a, const KEY& b))
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+BSTMap<KEY,T,tlt,Iteration>::BSTMap(bool (*clt)(const KEY& a, const KEY& b))
 : lt(tlt != (ltfunc)undefinedlt<KEY> ? tlt : clt) {
     if (lt == (ltfunc)undefinedlt<KEY>)
         throw TemplateFunctionError("BSTMap::default constructor: neither specified");
@@ -167,8 +183,8 @@ BSTMap<KEY,T,tlt>::BSTMap(bool (*clt)(const KEY& a, const KEY& b))
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-BSTMap<KEY,T,tlt>::BSTMap(const BSTMap<KEY,T,tlt>& to_copy, bool (*clt)(const KEY& a, const KEY& b))
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+BSTMap<KEY,T,tlt,Iteration>::BSTMap(const BSTMap<KEY,T,tlt,Iteration>& to_copy, bool (*clt)(const KEY& a, const KEY& b))
 : lt(tlt != (ltfunc)undefinedlt<KEY> ? tlt : clt) {
     if (lt == (ltfunc)undefinedlt<KEY>)
         lt = to_copy.lt;
@@ -187,8 +203,8 @@ BSTMap<KEY,T,tlt>::BSTMap(const BSTMap<KEY,T,tlt>& to_copy, bool (*clt)(const KE
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-BSTMap<KEY,T,tlt>::BSTMap(const std::initializer_list<Entry>& il, bool (*clt)(const KEY& a, const KEY& b))
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+BSTMap<KEY,T,tlt,Iteration>::BSTMap(const std::initializer_list<Entry>& il, bool (*clt)(const KEY& a, const KEY& b))
 : lt(tlt != (ltfunc)undefinedlt<KEY> ? tlt : clt) {
     if (lt == (ltfunc)undefinedlt<KEY>)
         throw TemplateFunctionError("BSTMap::initializer_list constructor: neither specified");
@@ -201,9 +217,9 @@ BSTMap<KEY,T,tlt>::BSTMap(const std::initializer_list<Entry>& il, bool (*clt)(co
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
 template <class Iterable>
-BSTMap<KEY,T,tlt>::BSTMap(const Iterable& i, bool (*clt)(const KEY& a, const KEY& b))
+BSTMap<KEY,T,tlt,Iteration>::BSTMap(const Iterable& i, bool (*clt)(const KEY& a, const KEY& b))
 : lt(tlt != (ltfunc)undefinedlt<KEY> ? tlt : clt) {
     if (lt == (ltfunc)undefinedlt<KEY>)
         throw TemplateFunctionError("BSTMap::Iterable constructor: neither specified");
@@ -220,32 +236,32 @@ BSTMap<KEY,T,tlt>::BSTMap(const Iterable& i, bool (*clt)(const KEY& a, const KEY
 //
 //Queries
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-bool BSTMap<KEY,T,tlt>::empty() const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+bool BSTMap<KEY,T,tlt,Iteration>::empty() const {
     return used == 0;
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-int BSTMap<KEY,T,tlt>::size() const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+int BSTMap<KEY,T,tlt,Iteration>::size() const {
     return used;
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-bool BSTMap<KEY,T,tlt>::has_key (const KEY& key) const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+bool BSTMap<KEY,T,tlt,Iteration>::has_key (const KEY& key) const {
     return (find_key(map, key) != nullptr);
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-bool BSTMap<KEY,T,tlt>::has_value (const T& value) const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+bool BSTMap<KEY,T,tlt,Iteration>::has_value (const T& value) const {
     return has_value(map, value);
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-std::string BSTMap<KEY,T,tlt>::str() const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+std::string BSTMap<KEY,T,tlt,Iteration>::str() const {
     std::ostringstream outs;
     outs << "bst_map[";
     outs<< string_rotated(map,"\n") << "\n](used = " << used << ", mod_count = " << mod_count << ")";
@@ -257,15 +273,15 @@ std::string BSTMap<KEY,T,tlt>::str() const {
 //
 //Commands
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-T BSTMap<KEY,T,tlt>::put(const KEY& key, const T& value) {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+T BSTMap<KEY,T,tlt,Iteration>::put(const KEY& key, const T& value) {
     mod_count++;
     return insert(map, key, value);
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-T BSTMap<KEY,T,tlt>::erase(const KEY& key) {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+T BSTMap<KEY,T,tlt,Iteration>::erase(const KEY& key) {
     auto to_return = remove(map, key);
     --used;
     mod_count++;
@@ -273,17 +289,17 @@ T BSTMap<KEY,T,tlt>::erase(const KEY& key) {
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-void BSTMap<KEY,T,tlt>::clear() {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+void BSTMap<KEY,T,tlt,Iteration>::clear() {
     used = 0;
     mod_count++;
     delete_BST(map);
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
 template<class Iterable>
-int BSTMap<KEY,T,tlt>::put_all(const Iterable& i) {
+int BSTMap<KEY,T,tlt,Iteration>::put_all(const Iterable& i) {
     int count = 0;
     for (auto m_entry : i) {
         ++count;
@@ -298,14 +314,14 @@ int BSTMap<KEY,T,tlt>::put_all(const Iterable& i) {
 //
 //Operators
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-T& BSTMap<KEY,T,tlt>::operator [] (const KEY& key) {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+T& BSTMap<KEY,T,tlt,Iteration>::operator [] (const KEY& key) {
     return find_addempty(map, key);
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-const T& BSTMap<KEY,T,tlt>::operator [] (const KEY& key) const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+const T& BSTMap<KEY,T,tlt,Iteration>::operator [] (const KEY& key) const {
     if (has_key(key)) {
         auto i = find_key(map, key);
         return i->value.second;
@@ -317,8 +333,8 @@ const T& BSTMap<KEY,T,tlt>::operator [] (const KEY& key) const {
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-BSTMap<KEY,T,tlt>& BSTMap<KEY,T,tlt>::operator = (const BSTMap<KEY,T,tlt>& rhs) {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+BSTMap<KEY,T,tlt,Iteration>& BSTMap<KEY,T,tlt,Iteration>::operator = (const BSTMap<KEY,T,tlt,Iteration>& rhs) {
     if (this == &rhs)
         return *this;
 
@@ -331,20 +347,20 @@ BSTMap<KEY,T,tlt>& BSTMap<KEY,T,tlt>::operator = (const BSTMap<KEY,T,tlt>& rhs)
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-bool BSTMap<KEY,T,tlt>::operator == (const BSTMap<KEY,T,tlt>& rhs) const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+bool BSTMap<KEY,T,tlt,Iteration>::operator == (const BSTMap<KEY,T,tlt,Iteration>& rhs) const {
     return (equals(map, rhs));
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-bool BSTMap<KEY,T,tlt>::operator != (const BSTMap<KEY,T,tlt>& rhs) const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+bool BSTMap<KEY,T,tlt,Iteration>::operator != (const BSTMap<KEY,T,tlt,Iteration>& rhs) const {
     return !(*this == rhs);
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-std::ostream& operator << (std::ostream& outs, const BSTMap<KEY,T,tlt>& m) {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+std::ostream& operator << (std::ostream& outs, const BSTMap<KEY,T,tlt,Iteration>& m) {
     outs << "map[";
     int i = 0;
     for(auto kv : m)
@@ -364,22 +380,29 @@ std::ostream& operator << (std::ostream& outs, const BSTMap<KEY,T,tlt>& m) {
 //
 //Iterator constructors
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-auto BSTMap<KEY,T,tlt>::begin () const -> BSTMap<KEY,T,tlt>::Iterator {
-    return Iterator(const_cast<BSTMap<KEY,T,tlt>*>(this), true);
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+auto BSTMap<KEY,T,tlt,Iteration>::begin () const -> BSTMap<KEY,T,tlt,Iteration>::Iterator {
+    return Iterator(const_cast<BSTMap<KEY,T,tlt,Iteration>*>(this), true);
 }
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-auto BSTMap<KEY,T,tlt>::end () const -> BSTMap<KEY,T,tlt>::Iterator {
-    return Iterator(const_cast<BSTMap<KEY,T,tlt>*>(this),false);
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+auto BSTMap<KEY,T,tlt,Iteration>::end () const -> BSTMap<KEY,T,tlt,Iteration>::Iterator {
+    return Iterator(const_cast<BSTMap<KEY,T,tlt,Iteration>*>(this),false);
+}
+
+
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+template<class Visitor>
+void BSTMap<KEY,T,tlt,Iteration>::for_each (Visitor visit) const {
+    for_each(map, visit, mod_count);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 //
 //Private helper methods
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-typename BSTMap<KEY,T,tlt>::TN* BSTMap<KEY,T,tlt>::find_key (TN* root, const KEY& key) const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+typename BSTMap<KEY,T,tlt,Iteration>::TN* BSTMap<KEY,T,tlt,Iteration>::find_key (TN* root, const KEY& key) const {
     if(root == nullptr)
         return nullptr;
     else if(root->value.first == key)
@@ -392,8 +415,8 @@ typename BSTMap<KEY,T,tlt>::TN* BSTMap<KEY,T,tlt>::find_key (TN* root, const KEY
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-bool BSTMap<KEY,T,tlt>::has_value (TN* root, const T& value) const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+bool BSTMap<KEY,T,tlt,Iteration>::has_value (TN* root, const T& value) const {
     if(root == nullptr)
         return false;
     else if(root->value.second == value)
@@ -404,8 +427,8 @@ bool BSTMap<KEY,T,tlt>::has_value (TN* root, const T& value) const {
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-typename BSTMap<KEY,T,tlt>::TN* BSTMap<KEY,T,tlt>::copy (TN* root) const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+typename BSTMap<KEY,T,tlt,Iteration>::TN* BSTMap<KEY,T,tlt,Iteration>::copy (TN* root) const {
     if (!root)
         return root;
 
@@ -416,8 +439,8 @@ typename BSTMap<KEY,T,tlt>::TN* BSTMap<KEY,T,tlt>::copy (TN* root) const {
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-void BSTMap<KEY,T,tlt>::copy_to_queue (TN* root, ArrayQueue<Entry>& q) const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+void BSTMap<KEY,T,tlt,Iteration>::copy_to_queue (TN* root, ArrayQueue<Entry>& q) const {
     if (!root) {
         return;
     }
@@ -429,8 +452,21 @@ void BSTMap<KEY,T,tlt>::copy_to_queue (TN* root, ArrayQueue<Entry>& q) const {
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-bool BSTMap<KEY,T,tlt>::equals (TN* root, const BSTMap<KEY,T,tlt>& other) const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+template<class Visitor>
+void BSTMap<KEY,T,tlt,Iteration>::for_each (TN* root, Visitor& visit, int expected) const {
+    if (!root)
+        return;
+    for_each(root->left, visit, expected);
+    visit(const_cast<const Entry&>(root->value));
+    if (Iteration::modified(expected, mod_count))
+        throw ConcurrentModificationError("BSTMap::for_each");
+    for_each(root->right, visit, expected);
+}
+
+
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+bool BSTMap<KEY,T,tlt,Iteration>::equals (TN* root, const BSTMap<KEY,T,tlt,Iteration>& other) const {
     if (this == &other)
         return true;
 
@@ -448,8 +484,8 @@ bool BSTMap<KEY,T,tlt>::equals (TN* root, const BSTMap<KEY,T,tlt>& other) const
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-std::string BSTMap<KEY,T,tlt>::string_rotated(TN* root, std::string indent) const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+std::string BSTMap<KEY,T,tlt,Iteration>::string_rotated(TN* root, std::string indent) const {
     std::ostringstream rotated;
     if (root == nullptr)
         return "";
@@ -460,8 +496,8 @@ std::string BSTMap<KEY,T,tlt>::string_rotated(TN* root, std::string indent) cons
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-T BSTMap<KEY,T,tlt>::insert (TN*& root, const KEY& key, const T& value) {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+T BSTMap<KEY,T,tlt,Iteration>::insert (TN*& root, const KEY& key, const T& value) {
     if(root == nullptr)
     {
         root = new TN();
@@ -483,8 +519,8 @@ T BSTMap<KEY,T,tlt>::insert (TN*& root, const KEY& key, const T& value) {
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-T& BSTMap<KEY,T,tlt>::find_addempty (TN*& root, const KEY& key) {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+T& BSTMap<KEY,T,tlt,Iteration>::find_addempty (TN*& root, const KEY& key) {
     if(root == nullptr) {
         root = new TN();
         root->value.first = key;
@@ -504,8 +540,8 @@ T& BSTMap<KEY,T,tlt>::find_addempty (TN*& root, const KEY& key) {
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-pair<KEY,T> BSTMap<KEY,T,tlt>::remove_closest(TN*& root) {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+pair<KEY,T> BSTMap<KEY,T,tlt,Iteration>::remove_closest(TN*& root) {
   if (root->right != nullptr)
     return remove_closest(root->right);
   else{
@@ -518,8 +554,8 @@ pair<KEY,T> BSTMap<KEY,T,tlt>::remove_closest(TN*& root) {
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-T BSTMap<KEY,T,tlt>::remove (TN*& root, const KEY& key) {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+T BSTMap<KEY,T,tlt,Iteration>::remove (TN*& root, const KEY& key) {
   if (root == nullptr) {
     std::ostringstream answer;
     answer << "BSTMap::erase: key(" << key << ") not in Map";
@@ -543,8 +579,8 @@ T BSTMap<KEY,T,tlt>::remove (TN*& root, const KEY& key) {
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-void BSTMap<KEY,T,tlt>::delete_BST (TN*& root) {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+void BSTMap<KEY,T,tlt,Iteration>::delete_BST (TN*& root) {
     if (root == nullptr)
         return;
     delete_BST(root->left);
@@ -562,8 +598,8 @@ void BSTMap<KEY,T,tlt>::delete_BST (TN*& root) {
 //
 //Iterator class definitions
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-BSTMap<KEY,T,tlt>::Iterator::Iterator(BSTMap<KEY,T,tlt>* iterate_over, bool from_begin)
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+BSTMap<KEY,T,tlt,Iteration>::Iterator::Iterator(BSTMap<KEY,T,tlt,Iteration>* iterate_over, bool from_begin)
 : ref_map(iterate_over), expected_mod_count(ref_map->mod_count) {
     if (from_begin) {
         ref_map->copy_to_queue(ref_map->map, it);
@@ -571,14 +607,14 @@ BSTMap<KEY,T,tlt>::Iterator::Iterator(BSTMap<KEY,T,tlt>* iterate_over, bool from
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-BSTMap<KEY,T,tlt>::Iterator::~Iterator()
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+BSTMap<KEY,T,tlt,Iteration>::Iterator::~Iterator()
 {}
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-auto BSTMap<KEY,T,tlt>::Iterator::erase() -> Entry {
-    if (expected_mod_count != ref_map->mod_count)
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+auto BSTMap<KEY,T,tlt,Iteration>::Iterator::erase() -> Entry {
+    if (Iteration::modified(expected_mod_count,ref_map->mod_count))
         throw ConcurrentModificationError("BSTMap::Iterator::erase");
     if (!can_erase)
         throw CannotEraseError("BSTMap::Iterator::erase Iterator cursor already erased");
@@ -594,17 +630,17 @@ auto BSTMap<KEY,T,tlt>::Iterator::erase() -> Entry {
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-std::string BSTMap<KEY,T,tlt>::Iterator::str() const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+std::string BSTMap<KEY,T,tlt,Iteration>::Iterator::str() const {
     std::ostringstream answer;
     answer << it.str() << ",expected_mod_count=" << expected_mod_count << ",can_erase=" << can_erase << ")";
     return answer.str();
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-auto  BSTMap<KEY,T,tlt>::Iterator::operator ++ () -> BSTMap<KEY,T,tlt>::Iterator& {
-    if (expected_mod_count != ref_map->mod_count)
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+auto  BSTMap<KEY,T,tlt,Iteration>::Iterator::operator ++ () -> BSTMap<KEY,T,tlt,Iteration>::Iterator& {
+    if (Iteration::modified(expected_mod_count,ref_map->mod_count))
         throw ConcurrentModificationError("BSTMap::Iterator::operator ++");
 
     if (it.size() == 0)
@@ -620,9 +656,9 @@ auto  BSTMap<KEY,T,tlt>::Iterator::operator ++ () -> BSTMap<KEY,T,tlt>::Iterator
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-auto BSTMap<KEY,T,tlt>::Iterator::operator ++ (int) -> BSTMap<KEY,T,tlt>::Iterator {
-    if (expected_mod_count != ref_map->mod_count)
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+auto BSTMap<KEY,T,tlt,Iteration>::Iterator::operator ++ (int) -> BSTMap<KEY,T,tlt,Iteration>::Iterator {
+    if (Iteration::modified(expected_mod_count,ref_map->mod_count))
         throw ConcurrentModificationError("BSTMap::Iterator::operator ++(int)");
 
     if (it.size() == 0)
@@ -638,12 +674,12 @@ auto BSTMap<KEY,T,tlt>::Iterator::operator ++ (int) -> BSTMap<KEY,T,tlt>::Iterat
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-bool BSTMap<KEY,T,tlt>::Iterator::operator == (const BSTMap<KEY,T,tlt>::Iterator& rhs) const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+bool BSTMap<KEY,T,tlt,Iteration>::Iterator::operator == (const BSTMap<KEY,T,tlt,Iteration>::Iterator& rhs) const {
     const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
     if (rhsASI == 0)
         throw IteratorTypeError("BSTMap::Iterator::operator ==");
-    if (expected_mod_count != ref_map->mod_count)
+    if (Iteration::modified(expected_mod_count,ref_map->mod_count))
         throw ConcurrentModificationError("BSTMap::Iterator::operator ==");
     if (ref_map != rhsASI->ref_map)
         throw ComparingDifferentIteratorsError("BSTMap::Iterator::operator ==");
@@ -652,12 +688,12 @@ bool BSTMap<KEY,T,tlt>::Iterator::operator == (const BSTMap<KEY,T,tlt>::Iterator
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-bool BSTMap<KEY,T,tlt>::Iterator::operator != (const BSTMap<KEY,T,tlt>::Iterator& rhs) const {
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+bool BSTMap<KEY,T,tlt,Iteration>::Iterator::operator != (const BSTMap<KEY,T,tlt,Iteration>::Iterator& rhs) const {
     const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
     if (rhsASI == 0)
         throw IteratorTypeError("BSTMap::Iterator::operator !=");
-    if (expected_mod_count != ref_map->mod_count)
+    if (Iteration::modified(expected_mod_count,ref_map->mod_count))
         throw ConcurrentModificationError("BSTMap::Iterator::operator !=");
     if (ref_map != rhsASI->ref_map)
         throw ComparingDifferentIteratorsError("BSTMap::Iterator::operator !=");
@@ -666,9 +702,9 @@ bool BSTMap<KEY,T,tlt>::Iterator::operator != (const BSTMap<KEY,T,tlt>::Iterator
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-pair<KEY,T>& BSTMap<KEY,T,tlt>::Iterator::operator *() const {
-    if (expected_mod_count != ref_map->mod_count)
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+pair<KEY,T>& BSTMap<KEY,T,tlt,Iteration>::Iterator::operator *() const {
+    if (Iteration::modified(expected_mod_count,ref_map->mod_count))
         throw ConcurrentModificationError("BSTMap::Iterator::operator *");
     if (!can_erase || it.size() == 0) {
         std::ostringstream where;
@@ -680,9 +716,9 @@ pair<KEY,T>& BSTMap<KEY,T,tlt>::Iterator::operator *() const {
 }
 
 
-template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b)>
-pair<KEY,T>* BSTMap<KEY,T,tlt>::Iterator::operator ->() const {
-    if (expected_mod_count != ref_map->mod_count)
+template<class KEY,class T, bool (*tlt)(const KEY& a, const KEY& b), class Iteration>
+pair<KEY,T>* BSTMap<KEY,T,tlt,Iteration>::Iterator::operator ->() const {
+    if (Iteration::modified(expected_mod_count,ref_map->mod_count))
         throw ConcurrentModificationError("BSTMap::Iterator::operator ->");
     if (!can_erase || it.size() == 0) {
         std::ostringstream where;
@@ -5,8 +5,15 @@
 #include <iostream>
 #include <sstream>
 #include <initializer_list>
+#include <cstdint>
 #include "ics_exceptions.hpp"
-#include <utility>              //For std::swap function
+#include "template_function.hpp"
+#include "iteration_policy.hpp"
+#include <utility>              //For std::swap, std::move and std::forward functions
+#include <vector>               //Iterator's frontier
+#include <memory>               //std::uninitialized_copy_n, std::destroy_n
+#include <new>                  //std::align_val_t, placement new
+#include <algorithm>            //std::min
 #include "array_stack.hpp"      //See operator <<
 
 
@@ -24,16 +31,33 @@ bool undefinedgt (const T& a, const T& b) {return false;}
 //If both tgt and cgt are supplied, then they must be the same (by ==) function.
 //If neither is supplied, or both are supplied but different, TemplateFunctionError is raised.
 //The (unique) non-undefinedgt value supplied by tgt/cgt is stored in the instance variable gt.
-template<class T, bool (*tgt)(const T& a, const T& b) = undefinedgt<T>> class HeapPriorityQueue {
+//A tgt is called directly (see template_function.hpp), so it can be inlined; tgt can also be
+//  functor<F> for a stateless functor class F (e.g., HeapPriorityQueue<int,functor<std::greater<int>>>).
+//Sizes and array indexes are std::int64_t, so a heap can hold more than 2^31-1 values.
+//Iteration (CheckedIteration or UncheckedIteration, see iteration_policy.hpp) decides whether
+//  Iterators and for_each check for concurrent modification.
+//Arity is the number of children of each node (a d-ary heap): the children of i are at indexes
+//  Arity*i+1 .. Arity*i+Arity. A larger arity makes the heap shallower (log_Arity N levels), so
+//  dequeue's percolate_down takes fewer dependent cache misses, but compares more children per level.
+//  The array is allocated on a cache line boundary and offset so that pq[1] starts a cache line: when
+//  Arity*sizeof(T) divides the line size (e.g., Arity 8 for 8-byte T), each node's children are all
+//  in one cache line.
+//The array is raw storage: only pq[0..used) are constructed Ts (so T needs no default constructor),
+//  and growing the array moves each value once. percolate_up/percolate_down move the value being
+//  placed out of the array, shift the values it passes into the hole (one move per level, not a swap's
+//  three), and move it into the hole where it stops.
+template<class T, bool (*tgt)(const T& a, const T& b) = undefinedgt<T>, class Iteration = CheckedIteration, int Arity = 2> class HeapPriorityQueue {
+  static_assert(Arity >= 2, "HeapPriorityQueue: Arity must be at least 2");
   public:
     typedef bool (*gtfunc) (const T& a, const T& b);
-        
+
     //Destructor/Constructors
     ~HeapPriorityQueue();
 
     HeapPriorityQueue(bool (*cgt)(const T& a, const T& b) = undefinedgt<T>);
     explicit HeapPriorityQueue(int initial_length, bool (*cgt)(const T& a, const T& b) = undefinedgt<T>);
-    HeapPriorityQueue(const HeapPriorityQueue<T,tgt>& to_copy, bool (*cgt)(const T& a, const T& b) = undefinedgt<T>);
+    HeapPriorityQueue(const HeapPriorityQueue<T,tgt,Iteration,Arity>& to_copy, bool (*cgt)(const T& a, const T& b) = undefinedgt<T>);
+    HeapPriorityQueue(HeapPriorityQueue<T,tgt,Iteration,Arity>&& to_move) noexcept;  //to_move is left empty (with length 0)
     explicit HeapPriorityQueue(const std::initializer_list<T>& il, bool (*cgt)(const T& a, const T& b) = undefinedgt<T>);
 
     //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
@@ -42,88 +66,165 @@ template<class T, bool (*tgt)(const T& a, const T& b) = undefinedgt<T>> class He
 
 
     //Queries
-    bool empty      () const;
-    int  size       () const;
-    T&   peek       () const;
-    std::string str () const; //supplies useful debugging information; contrast to operator <<
+    bool         empty () const;
+    std::int64_t size  () const;
+    T&           peek  () const;
+    std::string  str   () const; //supplies useful debugging information; contrast to operator <<
 
 
     //Commands
     int  enqueue (const T& element);
+    int  enqueue (T&& element);
     T    dequeue ();
+
+    //Enqueue T(args...), moved into the heap's array
+    template<class... Args>
+    int emplace (Args&&... args);
     void clear   ();
 
     //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
+    //Appends all the values, then restores the heap in bulk (see restore_heap); q.enqueue_all(q) doubles q
     template <class Iterable>
-    int enqueue_all (const Iterable& i);
+    std::int64_t enqueue_all (const Iterable& i);
+
+    //Moves all of other's values into this heap, leaving other empty (with length 0). The array of the
+    //  larger heap is kept (stolen from other, if other's is larger): only the smaller heap's values are
+    //  moved into it (growing it first if it lacks room), then restore_heap. Returns the number of values
+    //  merged from other.
+    std::int64_t merge (HeapPriorityQueue<T,tgt,Iteration,Arity>&& other);
 
 
     //Operators
-    HeapPriorityQueue<T,tgt>& operator = (const HeapPriorityQueue<T,tgt>& rhs);
-    bool operator == (const HeapPriorityQueue<T,tgt>& rhs) const;
-    bool operator != (const HeapPriorityQueue<T,tgt>& rhs) const;
+    HeapPriorityQueue<T,tgt,Iteration,Arity>& operator = (const HeapPriorityQueue<T,tgt,Iteration,Arity>& rhs);
+    HeapPriorityQueue<T,tgt,Iteration,Arity>& operator = (HeapPriorityQueue<T,tgt,Iteration,Arity>&& rhs) noexcept;
+    bool operator == (const HeapPriorityQueue<T,tgt,Iteration,Arity>& rhs) const;
+    bool operator != (const HeapPriorityQueue<T,tgt,Iteration,Arity>& rhs) const;
 
-    template<class T2, bool (*gt2)(const T2& a, const T2& b)>
-    friend std::ostream& operator << (std::ostream& outs, const HeapPriorityQueue<T2,gt2>& pq);
+    template<class T2, bool (*gt2)(const T2& a, const T2& b), class Iteration2, int Arity2>
+    friend std::ostream& operator << (std::ostream& outs, const HeapPriorityQueue<T2,gt2,Iteration2,Arity2>& pq);
 
 
 
+    //Iterator visits the values in priority order (as dequeue would remove them) without copying or
+    //  changing the heap: it keeps a frontier, a small heap of the indexes of the roots of the
+    //  not-yet-visited subheaps (initially just the root). ++ replaces the cursor's index by its
+    //  children's indexes, so begin() is O(1) and visiting the first k values is O(k log k).
+    //Iterator::erase removes the cursor's value from the heap by its index (not by ==) and repairs the
+    //  frontier: the value moved into the cursor's slot is pushed again if it is still to be visited, or
+    //  skipped (its children pushed) if it was visited already. The first erase records where each
+    //  index is in the frontier (O(N), once); each erase is then O(log N).
     class Iterator {
       public:
-        //Private constructor called in begin/end, which are friends of HeapPriorityQueue<T,tgt>
+        //Private constructor called in begin/end, which are friends of HeapPriorityQueue<T,tgt,Iteration,Arity>
         ~Iterator();
         T           erase();
         std::string str  () const;
-        HeapPriorityQueue<T,tgt>::Iterator& operator ++ ();
-        HeapPriorityQueue<T,tgt>::Iterator  operator ++ (int);
-        bool operator == (const HeapPriorityQueue<T,tgt>::Iterator& rhs) const;
-        bool operator != (const HeapPriorityQueue<T,tgt>::Iterator& rhs) const;
+        HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator& operator ++ ();
+        HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator  operator ++ (int);
+        bool operator == (const HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator& rhs) const;
+        bool operator != (const HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator& rhs) const;
         T& operator *  () const;
         T* operator -> () const;
-        friend std::ostream& operator << (std::ostream& outs, const HeapPriorityQueue<T,tgt>::Iterator& i) {
+        friend std::ostream& operator << (std::ostream& outs, const HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator& i) {
           outs << i.str(); //Use the same meaning as the debugging .str() method
           return outs;
         }
 
-        friend Iterator HeapPriorityQueue<T,tgt>::begin () const;
-        friend Iterator HeapPriorityQueue<T,tgt>::end   () const;
+        friend Iterator HeapPriorityQueue<T,tgt,Iteration,Arity>::begin () const;
+        friend Iterator HeapPriorityQueue<T,tgt,Iteration,Arity>::end   () const;
 
       private:
-        //If can_erase is false, the value has been removed from "it" (++ does nothing)
-        HeapPriorityQueue<T,tgt>  it;                 //copy of HPQ (from begin), to use as iterator via dequeue
-        HeapPriorityQueue<T,tgt>* ref_pq;
-        int                       expected_mod_count;
-        bool                      can_erase = true;
+        //If can_erase is false, the cursor's value has been erased (++ just moves past it)
+        HeapPriorityQueue<T,tgt,Iteration,Arity>* ref_pq;
+        std::vector<std::int64_t>           frontier;      //A heap (by gt of their values) of indexes; frontier[0] is the cursor
+        std::vector<std::int64_t>           frontier_at;   //After an erase: frontier_at[i] is i's position in frontier (or -1)
+        std::int64_t                        remaining = 0; //Values not yet visited (including the cursor's)
+        int                                 expected_mod_count;
+        bool                                can_erase = true;
 
         //Called in friends begin/end
-        //These constructors have different initializers (see it(...) in first one)
-        Iterator(HeapPriorityQueue<T,tgt>* iterate_over, bool from_begin);    // Called by begin
-        Iterator(HeapPriorityQueue<T,tgt>* iterate_over);                     // Called by end
+        Iterator(HeapPriorityQueue<T,tgt,Iteration,Arity>* iterate_over, bool from_begin);
+
+        //Helper methods
+        bool         unvisited       (std::int64_t i) const;     //i, or one of its ancestors, is in frontier
+        bool         higher          (std::int64_t a, std::int64_t b) const;  //gt of the values at indexes a and b
+        void         place_frontier  (std::int64_t p, std::int64_t i);       //frontier[p] = i (and frontier_at[i] = p)
+        void         sift_frontier   (std::int64_t p);           //Restore frontier's heap order for frontier[p]
+        void         push_frontier   (std::int64_t i);
+        void         push_children   (std::int64_t i);
+        void         remove_frontier (std::int64_t p);           //Remove frontier[p]; p == 0 is the cursor
+        void         advance         ();                         //Pop the cursor; push its children
+    };
+
+
+    //UnorderedIterator visits the values in the heap's array order (not priority order): begin is O(1)
+    //  and each ++ is O(1), for callers who need every value but not their order. It has no erase.
+    class UnorderedIterator {
+      public:
+        //Private constructor called in unordered_begin/unordered_end
+        std::string str () const;
+        HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator& operator ++ ();
+        HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator  operator ++ (int);
+        bool operator == (const HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator& rhs) const;
+        bool operator != (const HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator& rhs) const;
+        const T& operator *  () const;
+        const T* operator -> () const;
+        friend std::ostream& operator << (std::ostream& outs, const HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator& i) {
+          outs << i.str(); //Use the same meaning as the debugging .str() method
+          return outs;
+        }
+
+        friend UnorderedIterator HeapPriorityQueue<T,tgt,Iteration,Arity>::unordered_begin () const;
+        friend UnorderedIterator HeapPriorityQueue<T,tgt,Iteration,Arity>::unordered_end   () const;
+
+      private:
+        const HeapPriorityQueue<T,tgt,Iteration,Arity>* ref_pq;
+        std::int64_t                              index;
+        int                                       expected_mod_count;
+
+        UnorderedIterator(const HeapPriorityQueue<T,tgt,Iteration,Arity>* iterate_over, std::int64_t index);
     };
 
 
     Iterator begin () const;
     Iterator end   () const;
+    UnorderedIterator unordered_begin () const;
+    UnorderedIterator unordered_end   () const;
+
+    //Internal iteration: visit(value) for each value (as a const T&) in the heap's array order, not
+    //  priority order: O(N), with no iterator object; visit must not change the priority queue. With
+    //  CheckedIteration, mod_count is compared after each visit, so ConcurrentModificationError is thrown
+    //  after the visit that changed the queue has run; with UncheckedIteration the comparison compiles
+    //  to nothing and such a change is undefined.
+    template<class Visitor>
+    void for_each (Visitor visit) const;
 
 
   private:
-    bool (*gt) (const T& a, const T& b); //The gt used by enqueue (from template or constructor)
-    T*  pq;                              //Array represents a heap, so it uses the heap ordering property
-    int length    = 0;                   //Physical length of array: must be >= .size()
-    int used      = 0;                   //Amount of array used:  invariant: 0 <= used <= length
-    int mod_count = 0;                   //For sensing concurrent modification
+    TemplateFunction<gtfunc,tgt,undefinedgt<T>> gt; // The gt used by enqueue (from template or constructor)
+    T*  pq;                              // Array represents a heap, so it uses heap ordering property; only pq[0..used) are constructed
+    std::int64_t length = 0;             //Physical length of array: must be >= .size()
+    std::int64_t used   = 0;             //Amount of array used:  invariant: 0 <= used <= length
+    int mod_count       = 0;             //For sensing concurrent modification
+
+    static constexpr std::size_t  cache_line = 64;
+    static constexpr std::int64_t offset     =          //Unused slots before pq[0], so pq[1] starts a cache line
+      sizeof(T) < cache_line && cache_line % sizeof(T) == 0 ? cache_line/sizeof(T) - 1 : 0;
 
 
     //Helper methods
-    void ensure_length  (int new_length);
-    int  left_child     (int i) const;         //Useful abstractions for heaps as arrays
-    int  right_child    (int i) const;
-    int  parent         (int i) const;
-    bool is_root        (int i) const;
-    bool in_heap        (int i) const;
-    void percolate_up   (int i);
-    void percolate_down (int i);
+    static T*    allocate       (std::int64_t length);               //Raw (unconstructed) storage for length Ts, cache line aligned
+    static void  deallocate     (T* pq, std::int64_t used);          //Destroy pq[0..used) and free storage from allocate
+    void         ensure_length  (std::int64_t new_length);
+    std::int64_t first_child    (std::int64_t i) const;  //Useful abstractions for heaps as arrays
+    std::int64_t end_child      (std::int64_t i) const;  //One past i's last child in the heap (at most used)
+    std::int64_t parent         (std::int64_t i) const;
+    bool         is_root        (std::int64_t i) const;
+    bool         in_heap        (std::int64_t i) const;
+    void         percolate_up   (std::int64_t i);
+    void         percolate_down (std::int64_t i);
     void heapify        ();                   // Percolate down all value is array (from indexes used-1 to 0): O(N)
+    void restore_heap   (std::int64_t first_new);  // Restore heap order after appending pq[first_new..used)
   };
 
 
@@ -136,99 +237,92 @@ template<class T, bool (*tgt)(const T& a, const T& b) = undefinedgt<T>> class He
 
 //Destructor/Constructors
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-HeapPriorityQueue<T,tgt>::~HeapPriorityQueue() {
-    delete[] pq;
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+HeapPriorityQueue<T,tgt,Iteration,Arity>::~HeapPriorityQueue() {
+  deallocate(pq,used);
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-HeapPriorityQueue<T,tgt>::HeapPriorityQueue(bool (*cgt)(const T& a, const T& b))
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+HeapPriorityQueue<T,tgt,Iteration,Arity>::HeapPriorityQueue(bool (*cgt)(const T& a, const T& b))
 : gt(tgt != (gtfunc)undefinedgt<T> ? tgt : cgt) {
-    if (gt == (gtfunc)undefinedgt<T>)
-        throw TemplateFunctionError("HeapPriorityQueue::default constructor: neither specified");
-    if (tgt != (gtfunc)undefinedgt<T> && cgt != (gtfunc)undefinedgt<T> && tgt != cgt)
-        throw TemplateFunctionError("HeapPriorityQueue::default constructor: both specified and different");
+  if (gt == (gtfunc)undefinedgt<T>)
+    throw TemplateFunctionError("HeapPriorityQueue::default constructor: neither specified");
+  if (tgt != (gtfunc)undefinedgt<T> && cgt != (gtfunc)undefinedgt<T> && tgt != cgt)
+    throw TemplateFunctionError("HeapPriorityQueue::default constructor: both specified and different");
 
-    pq = new T[length];
+  pq = allocate(length);
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-HeapPriorityQueue<T,tgt>::HeapPriorityQueue(int initial_length, bool (*cgt)(const T& a, const T& b))
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+HeapPriorityQueue<T,tgt,Iteration,Arity>::HeapPriorityQueue(int initial_length, bool (*cgt)(const T& a, const T& b))
 : gt(tgt != (gtfunc)undefinedgt<T> ? tgt : cgt), length(initial_length) {
-    if (gt == (gtfunc)undefinedgt<T>)
-        throw TemplateFunctionError("HeapPriorityQueue::length constructor: neither specified");
-    if (tgt != (gtfunc)undefinedgt<T> && cgt != (gtfunc)undefinedgt<T> && tgt != cgt)
-        throw TemplateFunctionError("HeapPriorityQueue::length constructor: both specified and different");
-
-    if (length < 0)
-        length = 0;
-    pq = new T[length];
+  if (gt == (gtfunc)undefinedgt<T>)
+    throw TemplateFunctionError("HeapPriorityQueue::length constructor: neither specified");
+  if (tgt != (gtfunc)undefinedgt<T> && cgt != (gtfunc)undefinedgt<T> && tgt != cgt)
+    throw TemplateFunctionError("HeapPriorityQueue::length constructor: both specified and different");
+
+  if (length < 0)
+    length = 0;
+  pq = allocate(length);
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-HeapPriorityQueue<T,tgt>::HeapPriorityQueue(const HeapPriorityQueue<T,tgt>& to_copy, bool (*cgt)(const T& a, const T& b))
-: gt(tgt != (gtfunc)undefinedgt<T> ? tgt : cgt), length(to_copy.length) {
-    if (gt == (gtfunc)undefinedgt<T>)
-        gt = to_copy.gt;
-    if (tgt != (gtfunc)undefinedgt<T> && cgt != (gtfunc)undefinedgt<T> && tgt != cgt)
-        throw TemplateFunctionError("HeapPriorityQueue::copy constructor: both specified and different");
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+HeapPriorityQueue<T,tgt,Iteration,Arity>::HeapPriorityQueue(const HeapPriorityQueue<T,tgt,Iteration,Arity>& to_copy, bool (*cgt)(const T& a, const T& b))
+: gt(tgt != (gtfunc)undefinedgt<T> ? tgt : cgt), length(to_copy.length), used(to_copy.used) {
+  if (gt == (gtfunc)undefinedgt<T>)
+    gt = to_copy.gt;//throw TemplateFunctionError("HeapPriorityQueue::copy constructor: neither specified");
+  if (tgt != (gtfunc)undefinedgt<T> && cgt != (gtfunc)undefinedgt<T> && tgt != cgt)
+    throw TemplateFunctionError("HeapPriorityQueue::copy constructor: both specified and different");
 
-    pq = new T[length];
+  pq = allocate(length);
+  std::uninitialized_copy_n(to_copy.pq,to_copy.used,pq);
+
+  if (gt != to_copy.gt)
+    heapify();
+}
 
-    if (gt == to_copy.gt) {
-        used = to_copy.used;
-        for (int i = 0; i < to_copy.used; ++i)
-            pq[i] = to_copy.pq[i];
-    } else {
-        used = to_copy.used;
-        for (int i = 0; i < to_copy.used; ++i) {
-            pq[i] = to_copy.pq[i];
-        } heapify();
-    }
 
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+HeapPriorityQueue<T,tgt,Iteration,Arity>::HeapPriorityQueue(HeapPriorityQueue<T,tgt,Iteration,Arity>&& to_move) noexcept
+: gt(to_move.gt), pq(to_move.pq), length(to_move.length), used(to_move.used) {
+  to_move.pq     = nullptr;
+  to_move.length = 0;
+  to_move.used   = 0;
+  ++to_move.mod_count;
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-HeapPriorityQueue<T,tgt>::HeapPriorityQueue(const std::initializer_list<T>& il, bool (*cgt)(const T& a, const T& b))
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+HeapPriorityQueue<T,tgt,Iteration,Arity>::HeapPriorityQueue(const std::initializer_list<T>& il, bool (*cgt)(const T& a, const T& b))
 : gt(tgt != (gtfunc)undefinedgt<T> ? tgt : cgt), length(il.size()) {
-    if (gt == (gtfunc)undefinedgt<T>)
-        throw TemplateFunctionError("HeapPriorityQueue::initializer_list constructor: neither specified");
-    if (tgt != (gtfunc)undefinedgt<T> && cgt != (gtfunc)undefinedgt<T> && tgt != cgt)
-        throw TemplateFunctionError("HeapPriorityQueue::initializer_list constructor: both specified and different");
-
-    pq = new T[length];
-    int i = 0;
-    for (const T& pq_elem : il) {
-        pq[i] = pq_elem;
-        i++;
-    }
-
-    used = i;
-    heapify();
+  if (gt == (gtfunc)undefinedgt<T>)
+    throw TemplateFunctionError("HeapPriorityQueue::initializer_list constructor: neither specified");
+  if (tgt != (gtfunc)undefinedgt<T> && cgt != (gtfunc)undefinedgt<T> && tgt != cgt)
+    throw TemplateFunctionError("HeapPriorityQueue::initializer_list constructor: both specified and different");
+
+  pq = allocate(length);
+  std::uninitialized_copy(il.begin(),il.end(),pq);
+  used = length;
+  heapify();
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
 template<class Iterable>
-HeapPriorityQueue<T,tgt>::HeapPriorityQueue(const Iterable& i, bool (*cgt)(const T& a, const T& b))
+HeapPriorityQueue<T,tgt,Iteration,Arity>::HeapPriorityQueue(const Iterable& i, bool (*cgt)(const T& a, const T& b))
 : gt(tgt != (gtfunc)undefinedgt<T> ? tgt : cgt), length(i.size()) {
-    if (gt == (gtfunc)undefinedgt<T>)
-        throw TemplateFunctionError("HeapPriorityQueue::Iterable constructor: neither specified");
-    if (tgt != (gtfunc)undefinedgt<T> && cgt != (gtfunc)undefinedgt<T> && tgt != cgt)
-        throw TemplateFunctionError("HeapPriorityQueue::Iterable constructor: both specified and different");
-
-    pq = new T[length];
-    auto j = 0;
-    for (const T& pq_elem : i) {
-        pq[j] = pq_elem;
-        j++;
-    }
-    used = j;
-    heapify();
+  if (gt == (gtfunc)undefinedgt<T>)
+    throw TemplateFunctionError("HeapPriorityQueue::Iterable constructor: neither specified");
+  if (tgt != (gtfunc)undefinedgt<T> && cgt != (gtfunc)undefinedgt<T> && tgt != cgt)
+    throw TemplateFunctionError("HeapPriorityQueue::Iterable constructor: both specified and different");
+
+  pq = allocate(length);
+  for (const T& pq_elem : i)
+    new (pq+used++) T(pq_elem);
+  heapify();
 }
 
 
@@ -236,40 +330,40 @@ HeapPriorityQueue<T,tgt>::HeapPriorityQueue(const Iterable& i, bool (*cgt)(const
 //
 //Queries
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-bool HeapPriorityQueue<T,tgt>::empty() const {
-    return used == 0;
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+bool HeapPriorityQueue<T,tgt,Iteration,Arity>::empty() const {
+  return used == 0;
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-int HeapPriorityQueue<T,tgt>::size() const {
-    return used;
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+std::int64_t HeapPriorityQueue<T,tgt,Iteration,Arity>::size() const {
+  return used;
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-T& HeapPriorityQueue<T,tgt>::peek () const {
-    if (empty())
-        throw EmptyError("HeapPriorityQueue::peek");
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+T& HeapPriorityQueue<T,tgt,Iteration,Arity>::peek () const {
+  if (empty())
+    throw EmptyError("HeapPriorityQueue::peek");
 
-    return pq[0];
+  return pq[0];
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-std::string HeapPriorityQueue<T,tgt>::str() const {
-    std::ostringstream answer;
-    answer << "HeapPriorityQueue[";
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+std::string HeapPriorityQueue<T,tgt,Iteration,Arity>::str() const {
+  std::ostringstream answer;
+  answer << "HeapPriorityQueue[";
 
-    if (length != 0) {
-        answer << "0:" << pq[0];
-        for (int i=1; i<length; ++i)
-            answer << "," << i << ":" << pq[i];
-    }
+  if (used != 0) {           //Only pq[0..used) hold values: the rest of the array is raw storage
+    answer << "0:" << pq[0];
+    for (std::int64_t i = 1; i < used; ++i)
+      answer << "," << i << ":" << pq[i];
+  }
 
-    answer << "](length=" << length << ",used=" << used << ",mod_count=" << mod_count << ")";
-    return answer.str();
+  answer << "](length=" << length << ",used=" << used << ",mod_count=" << mod_count << ")";
+  return answer.str();
 }
 
 
@@ -277,45 +371,110 @@ std::string HeapPriorityQueue<T,tgt>::str() const {
 //
 //Commands
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-int HeapPriorityQueue<T,tgt>::enqueue(const T& element) {
-    this->ensure_length(used+1);
-    pq[used++] = element;
-    percolate_up(used-1);
-    mod_count++;
-    return 1;
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+int HeapPriorityQueue<T,tgt,Iteration,Arity>::enqueue(const T& element) {
+  this->ensure_length(used+1);
+  new (pq+used++) T(element);
+
+  this->percolate_up(used-1);
+  ++mod_count;
+  return 1;
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+int HeapPriorityQueue<T,tgt,Iteration,Arity>::enqueue(T&& element) {
+  this->ensure_length(used+1);
+  new (pq+used++) T(std::move(element));
+
+  this->percolate_up(used-1);
+  ++mod_count;
+  return 1;
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+template<class... Args>
+int HeapPriorityQueue<T,tgt,Iteration,Arity>::emplace(Args&&... args) {
+  return enqueue(T(std::forward<Args>(args)...));
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-T HeapPriorityQueue<T,tgt>::dequeue() {
-    if (this->empty())
-        throw EmptyError("HeapPriorityQueue::dequeue");
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+T HeapPriorityQueue<T,tgt,Iteration,Arity>::dequeue() {
+  if (this->empty())
+    throw EmptyError("HeapPriorityQueue::dequeue");
 
-    auto to_return = pq[0];
-    pq[0] = pq[--used];
-    this->ensure_length(used-1);
-    percolate_down(0);
-    mod_count++;
-    return to_return;
+  T to_return = std::move(pq[0]);
+  if (--used != 0)
+    pq[0] = std::move(pq[used]);
+  pq[used].~T();
+
+  percolate_down(0);
+
+  ++mod_count;
+  return to_return;
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-void HeapPriorityQueue<T,tgt>::clear() {
-    used = 0;
-    ++mod_count;
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::clear() {
+  std::destroy_n(pq,used);
+  used = 0;
+  ++mod_count;
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
 template <class Iterable>
-int HeapPriorityQueue<T,tgt>::enqueue_all (const Iterable& i) {
-    int count = 0;
-    for (const T& v : i) {
-        count += enqueue(v);
-    }
-    return count;
+std::int64_t HeapPriorityQueue<T,tgt,Iteration,Arity>::enqueue_all (const Iterable& i) {
+  std::int64_t first_new = used;
+  this->ensure_length(used+std::int64_t(i.size()));
+  if (static_cast<const void*>(&i) == this)   //Self: copy the values it had (iterating would see the copies)
+    for (std::int64_t j=0; j<first_new; ++j)
+      new (pq+used++) T(pq[j]);
+  else
+    for (const T& v : i)
+      new (pq+used++) T(v);
+
+  std::int64_t count = used-first_new;
+  if (count == 0)
+    return 0;
+  restore_heap(first_new);
+  ++mod_count;
+  return count;
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+std::int64_t HeapPriorityQueue<T,tgt,Iteration,Arity>::merge (HeapPriorityQueue<T,tgt,Iteration,Arity>&& other) {
+  if (this == &other || other.used == 0)
+    return 0;
+
+  std::int64_t count = other.used;
+  bool same_gt = gt == other.gt;
+  if (other.used > used) {             //Keep the larger array: other's values stay where they are
+    std::swap(pq,other.pq);
+    std::swap(length,other.length);
+    std::swap(used,other.used);
+  }
+
+  std::int64_t first_new = used;
+  this->ensure_length(used+other.used);
+  for (std::int64_t i=0; i<other.used; ++i)
+    new (pq+used++) T(std::move(other.pq[i]));
+  deallocate(other.pq,other.used);
+  other.pq     = nullptr;
+  other.length = 0;
+  other.used   = 0;
+
+  if (same_gt)
+    restore_heap(first_new);
+  else
+    heapify();                         //other's values are not ordered by this heap's gt
+  ++other.mod_count;
+  ++mod_count;
+  return count;
 }
 
 
@@ -323,64 +482,79 @@ int HeapPriorityQueue<T,tgt>::enqueue_all (const Iterable& i) {
 //
 //Operators
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-HeapPriorityQueue<T,tgt>& HeapPriorityQueue<T,tgt>::operator = (const HeapPriorityQueue<T,tgt>& rhs) {
-    if (this == &rhs)
-        return *this;
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+HeapPriorityQueue<T,tgt,Iteration,Arity>& HeapPriorityQueue<T,tgt,Iteration,Arity>::operator = (const HeapPriorityQueue<T,tgt,Iteration,Arity>& rhs) {
+  if (this == &rhs)
+    return *this;
 
-    gt = rhs.gt;
-    this->ensure_length(rhs.used);
-    used = rhs.used;
-    for (int i=0; i<used; ++i)
-        pq[i] = rhs.pq[i];
+  gt = rhs.gt;   // if tgt != nullptr, gts are already equal (or compiler error)
+  std::destroy_n(pq,used);
+  used = 0;
+  this->ensure_length(rhs.used);
+  std::uninitialized_copy_n(rhs.pq,rhs.used,pq);
+  used = rhs.used;
 
-    ++mod_count;
-    return *this;
+  ++mod_count;
+  return *this;
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-bool HeapPriorityQueue<T,tgt>::operator == (const HeapPriorityQueue<T,tgt>& rhs) const {
-    if (this == &rhs)
-        return true;
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+HeapPriorityQueue<T,tgt,Iteration,Arity>& HeapPriorityQueue<T,tgt,Iteration,Arity>::operator = (HeapPriorityQueue<T,tgt,Iteration,Arity>&& rhs) noexcept {
+  if (this == &rhs)
+    return *this;
 
-    if (gt != rhs.gt)
-        return false;
+  deallocate(pq,used);
+  gt     = rhs.gt;
+  pq     = rhs.pq;
+  length = rhs.length;
+  used   = rhs.used;
+
+  rhs.pq     = nullptr;
+  rhs.length = 0;
+  rhs.used   = 0;
+  ++rhs.mod_count;
+  ++mod_count;
+  return *this;
+}
 
-    if (used != rhs.size())
-        return false;
 
-    for (int i = used; i < used; i++) {
-        if (pq[i] != rhs.pq[i]) {
-            return false;
-        }
-    } return true;
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+bool HeapPriorityQueue<T,tgt,Iteration,Arity>::operator == (const HeapPriorityQueue<T,tgt,Iteration,Arity>& rhs) const {
+  if (this == &rhs)
+    return true;
+  if (gt != rhs.gt) //For PriorityQueues to be equal, they need the same gt function, and values
+    return false;
+  if (used != rhs.size())
+    return false;
+  HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator l = this->begin(), r = rhs.begin();
+  for (std::int64_t i=0; i<used; ++i, ++l, ++r)
+    if (*l != *r)
+      return false;
+
+  return true;
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-bool HeapPriorityQueue<T,tgt>::operator != (const HeapPriorityQueue<T,tgt>& rhs) const {
-    return !(*this == rhs);
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+bool HeapPriorityQueue<T,tgt,Iteration,Arity>::operator != (const HeapPriorityQueue<T,tgt,Iteration,Arity>& rhs) const {
+  return !(*this == rhs);
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-std::ostream& operator << (std::ostream& outs, const HeapPriorityQueue<T,tgt>& p) {
-    outs << "priority_queue[";
-    ArrayStack<T> stack;
-    auto s = p;
-    if (!p.empty()) {
-        for (int i = 0; i < p.used; ++i) {
-            stack.push(s.dequeue());
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+std::ostream& operator << (std::ostream& outs, const HeapPriorityQueue<T,tgt,Iteration,Arity>& p) {
+  outs << "priority_queue[";
 
-        } outs << stack.pop();
-        for (int i = 1; i < p.used; ++i) {
-            outs << "," << stack.pop();
-        }
-    }
-    outs << "]:highest";
-    return outs;
+  if (!p.empty()) {
+    ArrayStack<T> temp(p);
+    outs << temp.pop();
+    for (std::int64_t i = 1; i < p.used; ++i)
+      outs << "," << temp.pop();
+  }
 
+  outs << "]:highest";
+  return outs;
 }
 
 
@@ -388,15 +562,39 @@ std::ostream& operator << (std::ostream& outs, const HeapPriorityQueue<T,tgt>& p
 //
 //Iterator constructors
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-auto HeapPriorityQueue<T,tgt>::begin () const -> HeapPriorityQueue<T,tgt>::Iterator {
-    return Iterator(const_cast<HeapPriorityQueue<T,tgt>*>(this), true);
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+auto HeapPriorityQueue<T,tgt,Iteration,Arity>::begin () const -> HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator {
+    return Iterator(const_cast<HeapPriorityQueue<T,tgt,Iteration,Arity>*>(this),true);
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+auto HeapPriorityQueue<T,tgt,Iteration,Arity>::end () const -> HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator {
+  return Iterator(const_cast<HeapPriorityQueue<T,tgt,Iteration,Arity>*>(this),false);  //Empty frontier (remaining == 0)
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+auto HeapPriorityQueue<T,tgt,Iteration,Arity>::unordered_begin () const -> HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator {
+  return UnorderedIterator(this,0);
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+auto HeapPriorityQueue<T,tgt,Iteration,Arity>::unordered_end () const -> HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator {
+  return UnorderedIterator(this,used);
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-auto HeapPriorityQueue<T,tgt>::end () const -> HeapPriorityQueue<T,tgt>::Iterator {
-    return Iterator(const_cast<HeapPriorityQueue<T,tgt>*>(this));
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+template<class Visitor>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::for_each (Visitor visit) const {
+  int expected_mod_count = mod_count;
+  for (std::int64_t i=0; i<used; ++i) {
+    visit(const_cast<const T&>(pq[i]));
+    if (Iteration::modified(expected_mod_count,mod_count))
+      throw ConcurrentModificationError("HeapPriorityQueue::for_each");
+  }
 }
 
 
@@ -404,242 +602,431 @@ auto HeapPriorityQueue<T,tgt>::end () const -> HeapPriorityQueue<T,tgt>::Iterato
 //
 //Private helper methods
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-void HeapPriorityQueue<T,tgt>::ensure_length(int new_length) {
-    if (length >= new_length)
-        return;
-    T* old_pq = pq;
-    length = std::max(new_length,2*length);
-    pq = new T[length];
-    for (int i=0; i<used; ++i)
-        pq[i] = old_pq[i];
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+T* HeapPriorityQueue<T,tgt,Iteration,Arity>::allocate(std::int64_t length) {
+  void* block = ::operator new((offset+length)*sizeof(T),std::align_val_t(cache_line));
+  return static_cast<T*>(block) + offset;
+}
+
 
-    delete [] old_pq;
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::deallocate(T* pq, std::int64_t used) {
+  if (pq == nullptr)
+    return;
+  std::destroy_n(pq,used);
+  ::operator delete(pq-offset,std::align_val_t(cache_line));
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-int HeapPriorityQueue<T,tgt>::left_child(int i) const {
-    return (2*i + 1);
+//Each value is moved (or, if T's move constructor may throw, copied) into the new array once
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::ensure_length(std::int64_t new_length) {
+  if (length >= new_length)
+    return;
+  T* new_pq = allocate(std::max(new_length,2*length));
+  for (std::int64_t i=0; i<used; ++i)
+    new (new_pq+i) T(std::move_if_noexcept(pq[i]));
+
+  deallocate(pq,used);
+  pq     = new_pq;
+  length = std::max(new_length,2*length);
 }
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-int HeapPriorityQueue<T,tgt>::right_child(int i) const {
-    return (2*i + 2);
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+std::int64_t HeapPriorityQueue<T,tgt,Iteration,Arity>::first_child(std::int64_t i) const
+{return Arity*i+1;}
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+std::int64_t HeapPriorityQueue<T,tgt,Iteration,Arity>::end_child(std::int64_t i) const
+{return std::min(Arity*i+Arity+1,used);}
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+std::int64_t HeapPriorityQueue<T,tgt,Iteration,Arity>::parent(std::int64_t i) const
+{return (i-1)/Arity;}
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+bool HeapPriorityQueue<T,tgt,Iteration,Arity>::is_root(std::int64_t i) const
+{return i == 0;}
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+bool HeapPriorityQueue<T,tgt,Iteration,Arity>::in_heap(std::int64_t i) const
+{return i < used;}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::percolate_up(std::int64_t i) {
+  if (is_root(i) || !gt(pq[i],pq[parent(i)]))
+    return;
+  T moving = std::move(pq[i]);                 //Leaves a hole at i; lower-priority ancestors move down into it
+  for (/*parameter*/; !is_root(i) && gt(moving,pq[parent(i)]); i = parent(i))
+    pq[i] = std::move(pq[parent(i)]);
+  pq[i] = std::move(moving);
 }
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-int HeapPriorityQueue<T,tgt>::parent(int i) const {
-    return ((i-1)/2);
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::percolate_down(std::int64_t i) {
+  if (!in_heap(first_child(i)))
+    return;
+  T moving = std::move(pq[i]);                 //Leaves a hole at i; higher-priority children move up into it
+  for (std::int64_t c = first_child(i); in_heap(c); c = first_child(i)) {
+    std::int64_t max_child = c;
+    for (std::int64_t s = c+1, end = end_child(i); s < end; ++s)   //Siblings share a cache line (see offset)
+      if (gt(pq[s],pq[max_child]))
+        max_child = s;
+    if ( gt(moving,pq[max_child]) )
+       break;
+    pq[i] = std::move(pq[max_child]);
+    i = max_child;
+  }
+  pq[i] = std::move(moving);
 }
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-bool HeapPriorityQueue<T,tgt>::is_root(int i) const {
-    return i == 0;
+
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::heapify() {
+for (std::int64_t i = (used <= 1 ? -1 : parent(used-1)); i >= 0; --i)  //Leaves are already heaps
+  percolate_down(i);
 }
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-bool HeapPriorityQueue<T,tgt>::in_heap(int i) const {
-    return (i < used);
 
+//Percolating each of k appended values up costs up to k*log(N) moves (for an ascending batch); heapify
+//  costs O(N) however the batch is ordered, so it is used when the batch is at least as large as the
+//  heap it joins
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::restore_heap(std::int64_t first_new) {
+  if (used-first_new >= first_new)
+    heapify();
+  else
+    for (std::int64_t i = first_new; i < used; ++i)
+      percolate_up(i);
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-void HeapPriorityQueue<T,tgt>::percolate_up(int i) {
-    auto parentIndex = parent(i);
-    while (gt(pq[i], pq[parentIndex])) {
-        std::swap(pq[i], pq[parentIndex]);
-        i = parentIndex;
-        parentIndex = parent(i);
-    }
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator class definitions
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::Iterator(HeapPriorityQueue<T,tgt,Iteration,Arity>* iterate_over, bool from_begin)
+: ref_pq(iterate_over), expected_mod_count(iterate_over->mod_count) {
+  if (from_begin && !iterate_over->empty()) {  //Otherwise an empty frontier: the end
+    frontier.push_back(0);
+    remaining = iterate_over->used;
+  }
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-void HeapPriorityQueue<T,tgt>::percolate_down(int i) {
-    int highest;
-    while (in_heap(left_child(i))) {
-        if (in_heap(right_child(i))) {
-            auto left = left_child(i);
-            auto right = right_child(i);
-            if (gt(pq[left], pq[right])) {
-                highest = left;
-            } else {
-                highest = right;
-            }
-            if (gt(pq[i], pq[highest])) {
-                break;
-            }
-            else {
-                std::swap(pq[i], pq[highest]);
-                i = highest;
-            }
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::~Iterator()
+{}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+T HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::erase() {
+  if (Iteration::modified(expected_mod_count,ref_pq->mod_count))
+    throw ConcurrentModificationError("HeapPriorityQueue::Iterator::erase");
+  if (!can_erase)
+    throw CannotEraseError("HeapPriorityQueue::Iterator::erase Iterator cursor already erased");
+  if (remaining == 0)
+    throw CannotEraseError("HeapPriorityQueue::Iterator::erase Iterator cursor beyond data structure");
+
+  if (frontier_at.empty()) {
+    frontier_at.assign(ref_pq->used,-1);
+    for (std::size_t p=0; p<frontier.size(); ++p)
+      frontier_at[frontier[p]] = p;
+  }
+
+  //Fill the cursor's slot with the last value, as dequeue does with the root. Visited indexes are
+  //  closed under parent (the ancestors of the frontier), so the last value is visited iff no index on
+  //  its path to the root is in the frontier. Every visited value has priority >= every unvisited one,
+  //  so a visited last value need only percolate up, through the cursor's (visited) ancestors, and an
+  //  unvisited one need only percolate down, through the cursor's (unvisited) subheap.
+  std::int64_t cursor = frontier[0], last = ref_pq->used-1;
+  bool last_unvisited = unvisited(last);
+  can_erase = false;
+  T to_return = std::move(ref_pq->pq[cursor]);
+  remove_frontier(0);
+  --remaining;
+
+  if (cursor != last && frontier_at[last] != -1)
+    remove_frontier(frontier_at[last]);
+  if (cursor != last)
+    ref_pq->pq[cursor] = std::move(ref_pq->pq[last]);
+  ref_pq->pq[last].~T();
+  ref_pq->used = last;
+  if (cursor != last && last_unvisited) {
+    ref_pq->percolate_down(cursor);
+    push_frontier(cursor);             //Its slot holds the highest value of the (unvisited) subheap
+  } else if (cursor != last) {
+    ref_pq->percolate_up(cursor);      //Not percolate_down: it would move a visited value below an equal child
+    push_children(cursor);             //Its slot holds a visited value: skip it
+  }
+
+  ++ref_pq->mod_count;
+  expected_mod_count = ref_pq->mod_count;
+  return to_return;
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+std::string HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::str() const {
+  std::ostringstream answer;
+  answer << "frontier[";
+  for (std::size_t i=0; i<frontier.size(); ++i)
+    answer << (i == 0 ? "" : ",") << frontier[i];
+  answer << "](remaining=" << remaining << ")"
+         << "/expected_mod_count=" << expected_mod_count << "/can_erase=" << can_erase;
+  return answer.str();
+}
 
-        } else {
-            if (gt(pq[i], pq[left_child(i)])) {
-                break;
-            }
-            std::swap(pq[i], pq[left_child(i)]);
-            i = left_child(i);
-        }
 
 
-    }
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+auto HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::operator ++ () -> HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator& {
+  if (Iteration::modified(expected_mod_count,ref_pq->mod_count))
+    throw ConcurrentModificationError("HeapPriorityQueue::Iterator::operator ++");
+
+  if (remaining == 0)
+    return *this;
 
+  if (can_erase)
+    advance();
+  else
+    can_erase = true;
 
+  return *this;
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-void HeapPriorityQueue<T,tgt>::heapify() {
-for (int i = used-1; i >= 0; --i)
-  percolate_down(i);
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+auto HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::operator ++ (int) -> HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator {
+  if (Iteration::modified(expected_mod_count,ref_pq->mod_count))
+    throw ConcurrentModificationError("HeapPriorityQueue::Iterator::operator ++(int)");
+
+  if (remaining == 0)
+    return *this;
+
+  Iterator to_return(*this);
+  if (can_erase)
+    advance();
+  else
+    can_erase = true;
+
+  return to_return;
 }
 
 
-////////////////////////////////////////////////////////////////////////////////
-//
-//Iterator class definitions
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+bool HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::operator == (const HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator& rhs) const {
+  const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
+  if (rhsASI == 0)
+    throw IteratorTypeError("HeapPriorityQueue::Iterator::operator ==");
+  if (Iteration::modified(expected_mod_count,ref_pq->mod_count))
+    throw ConcurrentModificationError("HeapPriorityQueue::Iterator::operator ==");
+  if (ref_pq != rhsASI->ref_pq)
+    throw ComparingDifferentIteratorsError("HeapPriorityQueue::Iterator::operator ==");
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-HeapPriorityQueue<T,tgt>::Iterator::Iterator(HeapPriorityQueue<T,tgt>* iterate_over, bool tgt_nullptr)
-: it(*iterate_over,iterate_over->gt), ref_pq(iterate_over), expected_mod_count(iterate_over->mod_count) {
+  //Two iterators on the same heap are equal if they have the same number of values left to visit
+  return this->remaining == rhsASI->remaining;
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-HeapPriorityQueue<T,tgt>::Iterator::Iterator(HeapPriorityQueue<T,tgt>* iterate_over)
-: it(iterate_over->gt), ref_pq(iterate_over), expected_mod_count(iterate_over->mod_count) {
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+bool HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::operator != (const HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator& rhs) const {
+  const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
+  if (rhsASI == 0)
+    throw IteratorTypeError("HeapPriorityQueue::Iterator::operator !=");
+  if (Iteration::modified(expected_mod_count,ref_pq->mod_count))
+    throw ConcurrentModificationError("HeapPriorityQueue::Iterator::operator !=");
+  if (ref_pq != rhsASI->ref_pq)
+    throw ComparingDifferentIteratorsError("HeapPriorityQueue::Iterator::operator !=");
+
+  return this->remaining != rhsASI->remaining;
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-HeapPriorityQueue<T,tgt>::Iterator::~Iterator()
-{}
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+T& HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::operator *() const {
+  if (Iteration::modified(expected_mod_count,ref_pq->mod_count))
+    throw ConcurrentModificationError("HeapPriorityQueue::Iterator::operator *");
+  if (!can_erase || remaining == 0)
+    throw IteratorPositionIllegal("HeapPriorityQueue::Iterator::operator * Iterator illegal");
 
+  return ref_pq->pq[frontier[0]];
+}
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-T HeapPriorityQueue<T,tgt>::Iterator::erase() {
-    if (expected_mod_count != ref_pq->mod_count)
-        throw ConcurrentModificationError("HeapPriorityQueue::Iterator::erase");
-    if (!can_erase)
-        throw CannotEraseError("HeapPriorityQueue::Iterator::erase Iterator cursor already erased");
-    if (it.used ==0)
-        throw CannotEraseError("HeapPriorityQueue::Iterator::erase Iterator cursor beyond data structure");
-
-    can_erase = false;
-    T to_return = it.dequeue();
-    for (auto i = 0; i < ref_pq->used; i++) {
-        if (ref_pq->pq[i] == to_return) {
-            ref_pq->pq[i] = ref_pq->pq[ref_pq->used-1];
-            ref_pq->percolate_down(i);
-            ref_pq->percolate_up(i);
-            break;
-        }
-    }
-    --ref_pq->used;
-    expected_mod_count = ref_pq->mod_count;
-    return to_return;
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+T* HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::operator ->() const {
+  if (Iteration::modified(expected_mod_count,ref_pq->mod_count))
+    throw ConcurrentModificationError("HeapPriorityQueue::Iterator::operator *");
+  if (!can_erase || remaining == 0)
+    throw IteratorPositionIllegal("HeapPriorityQueue::Iterator::operator -> Iterator illegal");
+
+  return &ref_pq->pq[frontier[0]];
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-std::string HeapPriorityQueue<T,tgt>::Iterator::str() const {
-    std::ostringstream answer;
-    answer << it.str() << "/current=" << it << "/expected_mod_count=" << expected_mod_count << "/can_erase=" << can_erase;
-    return answer.str();
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+bool HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::unvisited (std::int64_t i) const {
+  for (/*parameter*/; frontier_at[i] == -1; i = ref_pq->parent(i))
+    if (ref_pq->is_root(i))
+      return false;
+  return true;
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-auto HeapPriorityQueue<T,tgt>::Iterator::operator ++ () -> HeapPriorityQueue<T,tgt>::Iterator& {
-    if (expected_mod_count != ref_pq->mod_count)
-        throw ConcurrentModificationError("HeapPriorityQueue::Iterator::operator ++");
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+bool HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::higher (std::int64_t a, std::int64_t b) const {
+  return ref_pq->gt(ref_pq->pq[a],ref_pq->pq[b]);
+}
+
 
-    if (it.used == 0)
-        return *this;
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::place_frontier (std::int64_t p, std::int64_t i) {
+  frontier[p] = i;
+  if (!frontier_at.empty())
+    frontier_at[i] = p;
+}
 
-    if (can_erase)
-        it.dequeue();
-    else
-        can_erase = true;
 
-    return *this;
+//The frontier is a binary heap, ordered by the values its indexes refer to (highest priority at
+//  frontier[0]); it is hole-based, like percolate_up/percolate_down, and keeps frontier_at current
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::sift_frontier (std::int64_t p) {
+  std::int64_t i = frontier[p], size = frontier.size();
+  for (/*parameter*/; p != 0 && higher(i,frontier[(p-1)/2]); p = (p-1)/2)
+    place_frontier(p,frontier[(p-1)/2]);
+  for (std::int64_t c = 2*p+1; c < size; c = 2*p+1) {
+    if (c+1 < size && higher(frontier[c+1],frontier[c]))
+      ++c;
+    if (!higher(frontier[c],i))
+      break;
+    place_frontier(p,frontier[c]);
+    p = c;
+  }
+  place_frontier(p,i);
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-auto HeapPriorityQueue<T,tgt>::Iterator::operator ++ (int) -> HeapPriorityQueue<T,tgt>::Iterator {
-    if (expected_mod_count != ref_pq->mod_count)
-        throw ConcurrentModificationError("HeapPriorityQueue::Iterator::operator ++(int)");
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::push_frontier (std::int64_t i) {
+  frontier.push_back(i);
+  sift_frontier(frontier.size()-1);
+}
 
-    if (it.used == 0)
-        return *this;
 
-    Iterator to_return(*this);
-    if (can_erase)
-        it.dequeue();
-    else
-        can_erase = true;
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::push_children (std::int64_t i) {
+  for (std::int64_t c = ref_pq->first_child(i), end = ref_pq->end_child(i); c < end; ++c)
+    push_frontier(c);
+}
+
 
-    return to_return;
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::remove_frontier (std::int64_t p) {
+  if (!frontier_at.empty())
+    frontier_at[frontier[p]] = -1;
+  std::int64_t moved = frontier.back();
+  frontier.pop_back();
+  if (p != std::int64_t(frontier.size())) {
+    frontier[p] = moved;
+    sift_frontier(p);
+  }
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-bool HeapPriorityQueue<T,tgt>::Iterator::operator == (const HeapPriorityQueue<T,tgt>::Iterator& rhs) const {
-    const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
-    if (rhsASI == 0)
-        throw IteratorTypeError("HeapPriorityQueue::Iterator::operator ==");
-    if (expected_mod_count != ref_pq->mod_count)
-        throw ConcurrentModificationError("HeapPriorityQueue::Iterator::operator ==");
-    if (ref_pq != rhsASI->ref_pq)
-        throw ComparingDifferentIteratorsError("HeapPriorityQueue::Iterator::operator ==");
+//The cursor's children are the only new candidates for the next value: every other unvisited value
+//  is in a subheap whose root is already in the frontier
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+void HeapPriorityQueue<T,tgt,Iteration,Arity>::Iterator::advance () {
+  std::int64_t cursor = frontier[0];
+  remove_frontier(0);
+  --remaining;
+  push_children(cursor);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//UnorderedIterator class definitions
 
-    return it.size() == rhsASI->it.size();
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator::UnorderedIterator(const HeapPriorityQueue<T,tgt,Iteration,Arity>* iterate_over, std::int64_t index)
+: ref_pq(iterate_over), index(index), expected_mod_count(iterate_over->mod_count)
+{}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+std::string HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator::str() const {
+  std::ostringstream answer;
+  answer << "index=" << index << "/expected_mod_count=" << expected_mod_count;
+  return answer.str();
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+auto HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator::operator ++ () -> HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator& {
+  if (Iteration::modified(expected_mod_count,ref_pq->mod_count))
+    throw ConcurrentModificationError("HeapPriorityQueue::UnorderedIterator::operator ++");
+
+  if (index < ref_pq->used)
+    ++index;
+  return *this;
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-bool HeapPriorityQueue<T,tgt>::Iterator::operator != (const HeapPriorityQueue<T,tgt>::Iterator& rhs) const {
-    const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
-    if (rhsASI == 0)
-        throw IteratorTypeError("HeapPriorityQueue::Iterator::operator !=");
-    if (expected_mod_count != ref_pq->mod_count)
-        throw ConcurrentModificationError("HeapPriorityQueue::Iterator::operator !=");
-    if (ref_pq != rhsASI->ref_pq)
-        throw ComparingDifferentIteratorsError("HeapPriorityQueue::Iterator::operator !=");
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+auto HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator::operator ++ (int) -> HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator {
+  if (Iteration::modified(expected_mod_count,ref_pq->mod_count))
+    throw ConcurrentModificationError("HeapPriorityQueue::UnorderedIterator::operator ++(int)");
+
+  UnorderedIterator to_return(*this);
+  if (index < ref_pq->used)
+    ++index;
+  return to_return;
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+bool HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator::operator == (const HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator& rhs) const {
+  if (Iteration::modified(expected_mod_count,ref_pq->mod_count))
+    throw ConcurrentModificationError("HeapPriorityQueue::UnorderedIterator::operator ==");
+  if (ref_pq != rhs.ref_pq)
+    throw ComparingDifferentIteratorsError("HeapPriorityQueue::UnorderedIterator::operator ==");
+
+  return index == rhs.index;
+}
+
 
-    return it.size() != rhsASI->it.size();
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+bool HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator::operator != (const HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator& rhs) const {
+  return !(*this == rhs);
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-T& HeapPriorityQueue<T,tgt>::Iterator::operator *() const {
-    if (expected_mod_count != ref_pq->mod_count)
-        throw ConcurrentModificationError("HeapPriorityQueue::Iterator::operator *");
-    if (!can_erase || it.used == 0) {
-        std::ostringstream where;
-        where << it << " when size = " << ref_pq->size();
-        throw IteratorPositionIllegal("HeapPriorityQueue::Iterator::operator * Iterator illegal: "+where.str());
-    }
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+const T& HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator::operator *() const {
+  if (Iteration::modified(expected_mod_count,ref_pq->mod_count))
+    throw ConcurrentModificationError("HeapPriorityQueue::UnorderedIterator::operator *");
+  if (index >= ref_pq->used)
+    throw IteratorPositionIllegal("HeapPriorityQueue::UnorderedIterator::operator * Iterator illegal");
 
-    return it.peek();
+  return ref_pq->pq[index];
 }
 
 
-template<class T, bool (*tgt)(const T& a, const T& b)>
-T* HeapPriorityQueue<T,tgt>::Iterator::operator ->() const {
-    if (expected_mod_count !=  ref_pq->mod_count)
-        throw ConcurrentModificationError("HeapPriorityQueue::Iterator::operator ->");
-    if (!can_erase || it.used == 0) {
-        std::ostringstream where;
-        where << it << " when size = " << ref_pq->size();
-        throw IteratorPositionIllegal("HeapPriorityQueue::Iterator::operator -> Iterator illegal: "+where.str());
-    }
+template<class T, bool (*tgt)(const T& a, const T& b), class Iteration, int Arity>
+const T* HeapPriorityQueue<T,tgt,Iteration,Arity>::UnorderedIterator::operator ->() const {
+  if (Iteration::modified(expected_mod_count,ref_pq->mod_count))
+    throw ConcurrentModificationError("HeapPriorityQueue::UnorderedIterator::operator ->");
+  if (index >= ref_pq->used)
+    throw IteratorPositionIllegal("HeapPriorityQueue::UnorderedIterator::operator -> Iterator illegal");
 
-    return &it.peek();
+  return &ref_pq->pq[index];
 }
 
 }
@@ -0,0 +1,59 @@
+#ifndef TEMPLATE_FUNCTION_HPP_
+#define TEMPLATE_FUNCTION_HPP_
+
+#include <utility>              //std::forward
+#include <type_traits>          //std::decay
+
+
+namespace ics {
+
+
+//The hash/gt/lt instance variable of a container taking the function as a template argument tf
+//  (which is undefined when none was supplied) or a constructor argument f.
+//When tf is supplied, calls are to tf itself, a constant: the compiler can inline them, instead of
+//  calling through a pointer loaded from the container on every probe/percolate. Otherwise calls
+//  are through f. It converts to (and compares as) a function pointer: tf if supplied, else f.
+template<class F, F tf, F undefined>
+class TemplateFunction {
+  public:
+    TemplateFunction (F f = undefined) : f(f) {}
+
+    operator F () const {
+      if constexpr (tf != undefined)
+        return tf;
+      else
+        return f;
+    }
+
+    template<class... Args>
+    auto operator () (Args&&... args) const {
+      if constexpr (tf != undefined)
+        return tf(std::forward<Args>(args)...);
+      else
+        return f(std::forward<Args>(args)...);
+    }
+
+  private:
+    F f;
+};
+
+
+//Supply a stateless (default constructible) functor class F as a container's function template
+//  argument, e.g., HashMap<int,int,functor<IntHash>> or HeapPriorityQueue<int,functor<std::greater<int>>>.
+//functor<F> is a function whose parameters/result are those of F's (non-template) operator (),
+//  taken by const&: IntHash's result may be int or 64-bit; F's operator () is inlined.
+template<class Member> class FunctorCall;
+
+template<class F, class R, class... A>
+class FunctorCall<R (F::*)(A...) const> {
+  public:
+    static R call (const typename std::decay<A>::type&... a) {return F()(a...);}
+};
+
+template<class F>
+constexpr auto functor = &FunctorCall<decltype(&F::operator ())>::call;
+
+
+}
+
+#endif /* TEMPLATE_FUNCTION_HPP_ */
@@ -0,0 +1,610 @@
+#ifndef CONCURRENT_HASH_MAP_HPP_
+#define CONCURRENT_HASH_MAP_HPP_
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <initializer_list>
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include "ics_exceptions.hpp"
+#include "pair.hpp"
+#include "hash_code.hpp"
+#include "template_function.hpp"
+
+
+namespace ics {
+
+
+#ifndef undefinedhashdefined
+#define undefinedhashdefined
+template<class T, class R = int>
+R undefinedhash (const T& a) {return 0;}
+#endif /* undefinedhashdefined */
+
+//ConcurrentHashMap is HashMap's design (bins of linked lists, each ending in a trailer node)
+//  made safe to share among threads. It is not a drop-in replacement: it has no [] (another
+//  thread could change or erase the value while a reference to it is in use), no copying
+//  (copy by put_all), and its Iterator is weakly consistent (see below).
+//Lock striping: as in HashMap, there are 2^bits bins and a key's bin is bin_index(code,bits) (see
+//  hash_code.hpp), with bits >= stripe_bits. Its top stripe_bits bits, bin_index(code,stripe_bits),
+//  pick the key's stripe (% stripes), whatever the number of bins: doubling bins moves the keys in
+//  bin b to bins 2b and 2b+1, which have the same top bits.
+//  An operation on a key locks only its stripe, so threads using different stripes run in parallel.
+//Coordinated resize: a thread whose put pushes the load factor over load_threshold locks every
+//  stripe (in order, so resizes cannot deadlock) and doubles bins; threads that saw the same
+//  overload find that bins has already changed when they get the locks, and do nothing.
+//  Nodes store their hash codes, so a resize does not call hash while holding every lock.
+//size is an atomic counter, read without locking.
+//compute_if_absent and update call their function argument while the key's stripe is locked;
+//  it must not use this map.
+//The Iterator copies the entries of one stripe at a time (while holding its lock). It never throws
+//  ConcurrentModificationError: it produces exactly once every key that is in the map for the
+//  whole iteration, and might or might not produce keys put or erased while it runs.
+//
+//Instantiate the templated class supplying thash(a): produces a hash value for a.
+//If thash is defaulted to undefinedhash in the template, then a constructor must supply chash.
+//If both thash and chash are supplied, then they must be the same (by ==) function.
+//If neither is supplied, or both are supplied but different, TemplateFunctionError is raised.
+//The (unique) non-undefinedhash value supplied by thash/chash is stored in the instance variable hash.
+//As in HashMap, thash is called directly (see template_function.hpp) and may return an int or a 64-bit
+//  value (e.g., the hashers in hashers.hpp); sizes and bins are 64-bit.
+template<class KEY,class T, auto thash = undefinedhash<KEY>, int stripes = 16> class ConcurrentHashMap {
+  static_assert(stripes >= 1, "ConcurrentHashMap: stripes must be >= 1");
+
+  public:
+    typedef ics::pair<KEY,T>   Entry;
+    typedef decltype(thash) hashfunc;  //int or 64-bit hash values: see hash_code.hpp
+
+    //Destructor/Constructors
+    ~ConcurrentHashMap ();
+
+    ConcurrentHashMap          (double the_load_threshold = 1.0, hashfunc chash = undefinedhash<KEY>);
+    ConcurrentHashMap          (const ConcurrentHashMap<KEY,T,thash,stripes>& to_copy) = delete;
+    explicit ConcurrentHashMap (const std::initializer_list<Entry>& il, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<KEY>);
+
+
+    //Queries: each is atomic (sees the map between other threads' commands)
+    bool empty      () const;
+    std::int64_t size () const;              //Lock-free: may be out of date by the time it is used
+    bool has_key    (const KEY& key) const;
+    T    get        (const KEY& key) const;  //A copy of key's value; KeyError if absent
+    std::string str () const; //supplies useful debugging information; contrast to operator <<
+
+
+    //Commands: each is atomic
+    T    put   (const KEY& key, const T& value);
+    T    erase (const KEY& key);
+    void clear ();
+
+    //If key is absent, put(key,make(key)); returns whether it did (make is not called if not)
+    template<class Make>
+    bool compute_if_absent (const KEY& key, Make make);
+
+    //Call f(value) on key's value (a T&), first putting key with value T() if it is absent;
+    //  returns whether key was already present
+    template<class Update>
+    bool update (const KEY& key, Update f);
+
+    //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
+    template <class Iterable>
+    std::int64_t put_all(const Iterable& i);
+
+
+    //Operators
+
+    ConcurrentHashMap<KEY,T,thash,stripes>& operator = (const ConcurrentHashMap<KEY,T,thash,stripes>& rhs) = delete;
+
+    template<class KEY2,class T2, auto hash2, int stripes2>
+    friend std::ostream& operator << (std::ostream& outs, const ConcurrentHashMap<KEY2,T2,hash2,stripes2>& m);
+
+
+
+    class Iterator {
+      public:
+        //Private constructor called in begin/end, which are friends of ConcurrentHashMap<T>
+        ~Iterator();
+        std::string str  () const;
+        ConcurrentHashMap<KEY,T,thash,stripes>::Iterator& operator ++ ();
+        ConcurrentHashMap<KEY,T,thash,stripes>::Iterator  operator ++ (int);
+        bool operator == (const ConcurrentHashMap<KEY,T,thash,stripes>::Iterator& rhs) const;
+        bool operator != (const ConcurrentHashMap<KEY,T,thash,stripes>::Iterator& rhs) const;
+        const Entry& operator *  () const;
+        const Entry* operator -> () const;
+        friend std::ostream& operator << (std::ostream& outs, const ConcurrentHashMap<KEY,T,thash,stripes>::Iterator& i) {
+          outs << i.str(); //Use the same meaning as the debugging .str() method
+          return outs;
+        }
+        friend Iterator ConcurrentHashMap<KEY,T,thash,stripes>::begin () const;
+        friend Iterator ConcurrentHashMap<KEY,T,thash,stripes>::end   () const;
+
+      private:
+        std::vector<Entry> copied;   //Entries of stripe, copied while it was locked
+        int                current;  //Index in copied
+        int                stripe;   //Stripe copied; stop: stripe == stripes
+        const ConcurrentHashMap<KEY,T,thash,stripes>* ref_map;
+
+        //Helper methods
+        void advance_cursors();      //Copy the next stripe with any entries
+
+        //Called in friends begin/end
+        Iterator(const ConcurrentHashMap<KEY,T,thash,stripes>* iterate_over, bool from_begin);
+    };
+
+
+    Iterator begin () const;
+    Iterator end   () const;
+
+
+  private:
+    class LN {
+      public:
+        LN ()                              : next(nullptr){}
+        LN (const Entry& v, HashCode c, LN* n) : value(v), code(c), next(n){}
+
+        Entry    value;
+        HashCode code = 0;   //to_hash_code(hash(value.first))
+        LN*      next;
+    };
+
+    //Each lock on its own cache line: threads locking different stripes do not slow each other down
+    struct alignas(64) Stripe {
+      std::mutex lock;
+    };
+
+  static constexpr int stripe_bits = bin_bits(stripes);   //The fewest top bits of a bin index that can pick among stripes
+
+  TemplateFunction<hashfunc,thash,undefinedhash<KEY>> hash;  //Hashing function used (from template or constructor)
+  LN** map      = nullptr;    //Pointer to array of pointers: each bin stores a list with a trailer node
+  double load_threshold;      //used/bins <= load_threshold
+  int bits      = stripe_bits;//bins == 2^bits; changed only with every stripe locked
+  std::int64_t bins = std::int64_t(1) << stripe_bits;  //# bins in array
+  std::atomic<std::int64_t> used{0};  //Cache for number of key->value pairs in the hash table
+  mutable Stripe locks[stripes]; //locks[s] guards every bin whose top stripe_bits bits are s (% stripes)
+
+
+  //Helper methods (call those that access bins with the key's stripe, or all stripes, locked)
+  HashCode hash_code         (const KEY& key)          const;  //hash function as a HashCode: the code nodes store
+  std::mutex& lock_of        (HashCode code)           const;  //Lock of the stripe holding code's bins
+  LN*   find_key             (const KEY& key, HashCode code) const; //Returns reference to key's node or nullptr
+  LN*   add_node             (const Entry& e, HashCode code, std::int64_t& grow_from);  //Add e (key not in map); grow_from = bins if now overloaded, else 0
+  void  grow                 (std::int64_t from_bins);         //Lock all; double bins unless another thread already has
+  void  lock_all             ()                        const;  //In stripe order
+  void  unlock_all           ()                        const;
+  void  delete_nodes         ();                               //Deallocate every node but the trailers
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//ConcurrentHashMap class and related definitions
+
+//Destructor/Constructors
+
+template<class KEY,class T, auto thash, int stripes>
+ConcurrentHashMap<KEY,T,thash,stripes>::~ConcurrentHashMap() {
+  delete_nodes();
+  for (std::int64_t b=0; b<bins; ++b)
+    delete map[b];
+  delete[] map;
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+ConcurrentHashMap<KEY,T,thash,stripes>::ConcurrentHashMap(double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("ConcurrentHashMap::default constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("ConcurrentHashMap::default constructor: both specified and different");
+
+  map = new LN*[bins];
+  for (std::int64_t b=0; b<bins; ++b)
+    map[b] = new LN();
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+ConcurrentHashMap<KEY,T,thash,stripes>::ConcurrentHashMap(const std::initializer_list<Entry>& il, double the_load_threshold, hashfunc chash)
+: ConcurrentHashMap(the_load_threshold,chash) {
+  for (const Entry& m_entry : il)
+    put(m_entry.first,m_entry.second);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Queries
+
+template<class KEY,class T, auto thash, int stripes>
+bool ConcurrentHashMap<KEY,T,thash,stripes>::empty() const {
+  return used == 0;
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+std::int64_t ConcurrentHashMap<KEY,T,thash,stripes>::size() const {
+  return used;
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+bool ConcurrentHashMap<KEY,T,thash,stripes>::has_key (const KEY& key) const {
+  HashCode code = hash_code(key);
+  std::lock_guard<std::mutex> guard(lock_of(code));
+  return find_key(key,code) != nullptr;
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+T ConcurrentHashMap<KEY,T,thash,stripes>::get (const KEY& key) const {
+  HashCode code = hash_code(key);
+  {
+    std::lock_guard<std::mutex> guard(lock_of(code));
+    LN* c = find_key(key,code);
+    if (c != nullptr)
+      return c->value.second;
+  }
+
+  std::ostringstream answer;
+  answer << "ConcurrentHashMap::get: key(" << key << ") not in Map";
+  throw KeyError(answer.str());
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+std::string ConcurrentHashMap<KEY,T,thash,stripes>::str() const {
+  std::ostringstream answer;
+  lock_all();
+  answer << "ConcurrentHashMap[";
+  for (std::int64_t b=0; b<bins; ++b) {
+    answer << std::endl << "  bin[" << b << "] (stripe " << (b >> (bits-stripe_bits))%stripes << "): ";
+    for (LN* c = map[b]; c->next!=nullptr; c=c->next)
+      answer << c->value.first << "->" << c->value.second << " -> ";
+    answer << "TRAILER";
+  }
+  answer << std::endl << "](load_threshold=" << load_threshold << ",bins=" << bins << ",used=" << used << ",stripes=" << stripes << ")";
+  unlock_all();
+  return answer.str();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Commands
+
+template<class KEY,class T, auto thash, int stripes>
+T ConcurrentHashMap<KEY,T,thash,stripes>::put(const KEY& key, const T& value) {
+  HashCode code = hash_code(key);
+  std::int64_t grow_from;
+  {
+    std::lock_guard<std::mutex> guard(lock_of(code));
+    LN* c = find_key(key,code);
+    if (c != nullptr) {
+      T to_return = c->value.second;
+      c->value.second = value;
+      return to_return;
+    }
+    add_node(Entry(key,value),code,grow_from);
+  }
+
+  if (grow_from != 0)                           //after unlocking: grow locks every stripe
+    grow(grow_from);
+  return value;
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+T ConcurrentHashMap<KEY,T,thash,stripes>::erase(const KEY& key) {
+  HashCode code = hash_code(key);
+  {
+    std::lock_guard<std::mutex> guard(lock_of(code));
+    LN* c = find_key(key,code);
+    if (c != nullptr) {
+      T to_return = std::move(c->value.second);
+      LN* to_delete = c->next;
+      c->value = std::move(to_delete->value);
+      c->code  = to_delete->code;
+      c->next  = to_delete->next;
+      delete to_delete;
+      --used;
+      return to_return;
+    }
+  }
+
+  std::ostringstream answer;
+  answer << "ConcurrentHashMap::erase: key(" << key << ") not in Map";
+  throw KeyError(answer.str());
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+void ConcurrentHashMap<KEY,T,thash,stripes>::clear() {
+  lock_all();
+  delete_nodes();
+  used = 0;
+  unlock_all();
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+template<class Make>
+bool ConcurrentHashMap<KEY,T,thash,stripes>::compute_if_absent(const KEY& key, Make make) {
+  HashCode code = hash_code(key);
+  std::int64_t grow_from;
+  {
+    std::lock_guard<std::mutex> guard(lock_of(code));
+    if (find_key(key,code) != nullptr)
+      return false;
+    add_node(Entry(key,make(key)),code,grow_from);
+  }
+
+  if (grow_from != 0)
+    grow(grow_from);
+  return true;
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+template<class Update>
+bool ConcurrentHashMap<KEY,T,thash,stripes>::update(const KEY& key, Update f) {
+  HashCode code = hash_code(key);
+  std::int64_t grow_from = 0;
+  bool present;
+  {
+    std::lock_guard<std::mutex> guard(lock_of(code));
+    LN* c = find_key(key,code);
+    present = c != nullptr;
+    if (!present)
+      c = add_node(Entry(key,T()),code,grow_from);
+    f(c->value.second);
+  }
+
+  if (grow_from != 0)
+    grow(grow_from);
+  return present;
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+template<class Iterable>
+std::int64_t ConcurrentHashMap<KEY,T,thash,stripes>::put_all(const Iterable& i) {
+  std::int64_t count = 0;
+  for (const Entry& m_entry : i) {
+    ++count;
+    put(m_entry.first, m_entry.second);
+  }
+
+  return count;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Operators
+
+template<class KEY,class T, auto thash, int stripes>
+std::ostream& operator << (std::ostream& outs, const ConcurrentHashMap<KEY,T,thash,stripes>& m) {
+  outs << "map[";
+
+  int printed = 0;
+  for (const typename ConcurrentHashMap<KEY,T,thash,stripes>::Entry& e : m)
+    outs << (printed++ == 0? "" : ",") << e.first << "->" << e.second;
+
+  outs << "]";
+  return outs;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator constructors
+
+template<class KEY,class T, auto thash, int stripes>
+auto ConcurrentHashMap<KEY,T,thash,stripes>::begin () const -> ConcurrentHashMap<KEY,T,thash,stripes>::Iterator {
+  return Iterator(this,true);
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+auto ConcurrentHashMap<KEY,T,thash,stripes>::end () const -> ConcurrentHashMap<KEY,T,thash,stripes>::Iterator {
+  return Iterator(this,false);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Private helper methods
+
+template<class KEY,class T, auto thash, int stripes>
+HashCode ConcurrentHashMap<KEY,T,thash,stripes>::hash_code (const KEY& key) const {
+  return to_hash_code(hash(key));
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+std::mutex& ConcurrentHashMap<KEY,T,thash,stripes>::lock_of (HashCode code) const {
+  return locks[bin_index(code,stripe_bits)%stripes].lock;
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+typename ConcurrentHashMap<KEY,T,thash,stripes>::LN* ConcurrentHashMap<KEY,T,thash,stripes>::find_key (const KEY& key, HashCode code) const {
+  for (LN* c = map[bin_index(code,bits)]; c->next!=nullptr; c=c->next)
+    if (c->code == code && key == c->value.first)
+      return c;
+
+  return nullptr;
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+typename ConcurrentHashMap<KEY,T,thash,stripes>::LN* ConcurrentHashMap<KEY,T,thash,stripes>::add_node (const Entry& e, HashCode code, std::int64_t& grow_from) {
+  LN*& bin = map[bin_index(code,bits)];
+  bin = new LN(e,code,bin);
+  grow_from = double(++used)/bins > load_threshold ? bins : 0;
+  return bin;
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+void ConcurrentHashMap<KEY,T,thash,stripes>::grow (std::int64_t from_bins) {
+  lock_all();
+  if (bins == from_bins) {                      //else another thread grew the map first
+    std::int64_t new_bins = 2*bins;
+    LN** new_map  = new LN*[new_bins];
+    for (std::int64_t b=0; b<new_bins; ++b)
+      new_map[b] = new LN();
+
+    //Relink (not copy) nodes; bin b's keys go to bins 2b and 2b+1, both in b's stripe
+    for (std::int64_t b=0; b<bins; ++b) {
+      LN* c = map[b];
+      for (LN* next; c->next != nullptr; c = next) {
+        next = c->next;
+        LN*& to = new_map[bin_index(c->code,bits+1)];
+        c->next = to;
+        to = c;
+      }
+      delete c;                                 //trailer
+    }
+
+    delete[] map;
+    map  = new_map;
+    bins = new_bins;
+    ++bits;
+  }
+  unlock_all();
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+void ConcurrentHashMap<KEY,T,thash,stripes>::lock_all () const {
+  for (int s=0; s<stripes; ++s)
+    locks[s].lock.lock();
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+void ConcurrentHashMap<KEY,T,thash,stripes>::unlock_all () const {
+  for (int s=stripes-1; s>=0; --s)
+    locks[s].lock.unlock();
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+void ConcurrentHashMap<KEY,T,thash,stripes>::delete_nodes () {
+  for (std::int64_t b=0; b<bins; ++b)
+    while (map[b]->next != nullptr) {
+      LN* to_delete = map[b];
+      map[b] = map[b]->next;
+      delete to_delete;
+    }
+}
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator class definitions
+
+template<class KEY,class T, auto thash, int stripes>
+void ConcurrentHashMap<KEY,T,thash,stripes>::Iterator::advance_cursors() {
+  copied.clear();
+  current = 0;
+  while (++stripe < stripes) {
+    std::lock_guard<std::mutex> guard(ref_map->locks[stripe].lock);
+    std::int64_t per_top = ref_map->bins >> stripe_bits;   //Bins sharing each value of the top stripe_bits bits
+    for (std::int64_t top = stripe; top < (std::int64_t(1) << stripe_bits); top += stripes)
+      for (std::int64_t b = top*per_top; b < (top+1)*per_top; ++b)
+        for (LN* c = ref_map->map[b]; c->next!=nullptr; c=c->next)
+          copied.push_back(c->value);
+    if (!copied.empty())
+      return;
+  }
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+ConcurrentHashMap<KEY,T,thash,stripes>::Iterator::Iterator(const ConcurrentHashMap<KEY,T,thash,stripes>* iterate_over, bool from_begin)
+: current(0), stripe(from_begin ? -1 : stripes), ref_map(iterate_over) {
+  if (from_begin)
+    advance_cursors();
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+ConcurrentHashMap<KEY,T,thash,stripes>::Iterator::~Iterator()
+{}
+
+
+template<class KEY,class T, auto thash, int stripes>
+std::string ConcurrentHashMap<KEY,T,thash,stripes>::Iterator::str () const {
+  std::ostringstream answer;
+  answer << "ConcurrentHashMap::Iterator(stripe=" << stripe << ",current=" << current << "/" << copied.size() << ")";
+  return answer.str();
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+auto ConcurrentHashMap<KEY,T,thash,stripes>::Iterator::operator ++ () -> ConcurrentHashMap<KEY,T,thash,stripes>::Iterator& {
+  if (stripe == stripes)
+    return *this;
+
+  if (++current == int(copied.size()))
+    advance_cursors();
+  return *this;
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+auto ConcurrentHashMap<KEY,T,thash,stripes>::Iterator::operator ++ (int) -> ConcurrentHashMap<KEY,T,thash,stripes>::Iterator {
+  Iterator to_return(*this);
+  ++(*this);
+  return to_return;
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+bool ConcurrentHashMap<KEY,T,thash,stripes>::Iterator::operator == (const ConcurrentHashMap<KEY,T,thash,stripes>::Iterator& rhs) const {
+  if (ref_map != rhs.ref_map)
+    throw ComparingDifferentIteratorsError("ConcurrentHashMap::Iterator::operator ==");
+
+  return stripe == rhs.stripe && current == rhs.current;
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+bool ConcurrentHashMap<KEY,T,thash,stripes>::Iterator::operator != (const ConcurrentHashMap<KEY,T,thash,stripes>::Iterator& rhs) const {
+  return !(*this == rhs);
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+auto ConcurrentHashMap<KEY,T,thash,stripes>::Iterator::operator *() const -> const Entry& {
+  if (stripe == stripes)
+    throw IteratorPositionIllegal("ConcurrentHashMap::Iterator::operator * Iterator illegal: exhausted");
+
+  return copied[current];
+}
+
+
+template<class KEY,class T, auto thash, int stripes>
+auto ConcurrentHashMap<KEY,T,thash,stripes>::Iterator::operator ->() const -> const Entry* {
+  if (stripe == stripes)
+    throw IteratorPositionIllegal("ConcurrentHashMap::Iterator::operator -> Iterator illegal: exhausted");
+
+  return &copied[current];
+}
+
+
+}
+
+#endif /* CONCURRENT_HASH_MAP_HPP_ */
@@ -0,0 +1,866 @@
+#ifndef CUCKOO_HASH_MAP_HPP_
+#define CUCKOO_HASH_MAP_HPP_
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <initializer_list>
+#include <vector>
+#include <cstdint>
+#include <utility>              //std::move, std::swap
+#include "ics_exceptions.hpp"
+#include "pair.hpp"
+#include "hash_code.hpp"
+#include "template_function.hpp"
+
+
+namespace ics {
+
+
+#ifndef undefinedhashdefined
+#define undefinedhashdefined
+template<class T, class R = int>
+R undefinedhash (const T& a) {return 0;}
+#endif /* undefinedhashdefined */
+
+#ifndef ICS_PREFETCH
+#if defined(__GNUC__) || defined(__clang__)
+#define ICS_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define ICS_PREFETCH(address)
+#endif
+#endif /* ICS_PREFETCH */
+
+//CuckooHashMap has the same constructors, queries, commands, operators and Iterator (including
+//  mod_count checking) as HashMap, but every lookup is worst-case O(1): a key can only be in one of
+//  two buckets (or the small stash), so a lookup never searches a list or a probe sequence.
+//Each bucket holds slots (4) entries and a 1-byte tag per slot; a lookup compares a key only with
+//  the entries whose tags match its own. A bucket is aligned to a cache line: for small entries
+//  (e.g., ics::pair<int,int>) a bucket is one cache line, so a lookup touches at most two lines
+//  (and the second is prefetched while the first is searched).
+//The two buckets of a key (its two hash functions) both come from the one hash code of thash/chash:
+//  the first is the code's Fibonacci bin (see hash_code.hpp); the second and the tag are from the
+//  code multiplied by a different odd constant.
+//put stores a new key in an empty slot of either of its buckets; if both are full it evicts an entry
+//  from one (chosen at random), which moves to its other bucket, and so on (cuckoo hashing). After
+//  max_kicks evictions the entry left over goes to the stash. When the stash holds more than
+//  stash_slots entries the map doubles its buckets and re-places everything.
+//Keys that share one hash code share both buckets: if more than 2*slots+stash_slots keys share a
+//  code, the extra ones stay in the stash (lookups are still correct, but no longer O(1)).
+//Unlike HashMap, a reference returned by [] is invalidated by a later put/[] of a new key (entries
+//  move between buckets), so do not hold onto it across mutations.
+//
+//Instantiate the templated class supplying thash(a): produces a hash value for a.
+//If thash is defaulted to undefinedhash in the template, then a constructor must supply chash.
+//If both thash and chash are supplied, then they must be the same (by ==) function.
+//If neither is supplied, or both are supplied but different, TemplateFunctionError is raised.
+//The (unique) non-undefinedhash value supplied by thash/chash is stored in the instance variable hash.
+//The load_threshold (used/(bins*slots)) must be <= .95 (cuckoo inserts slow down sharply above
+//  that); larger values are clamped.
+template<class KEY,class T, auto thash = undefinedhash<KEY>> class CuckooHashMap {
+  public:
+    typedef ics::pair<KEY,T>   Entry;
+    typedef decltype(thash) hashfunc;  //int or 64-bit hash values: see hash_code.hpp
+
+    static const int slots       = 4;    //Entries per bucket
+    static const int stash_slots = 8;    //Stash entries allowed before the buckets double
+    static const int max_kicks   = 500;  //Evictions tried by one put before using the stash
+
+    //Destructor/Constructors
+    ~CuckooHashMap ();
+
+    CuckooHashMap          (double the_load_threshold = 0.9, hashfunc chash = undefinedhash<KEY>);
+    explicit CuckooHashMap (int initial_bins, double the_load_threshold = 0.9, hashfunc chash = undefinedhash<KEY>);
+    CuckooHashMap          (const CuckooHashMap<KEY,T,thash>& to_copy, double the_load_threshold = 0.9, hashfunc chash = undefinedhash<KEY>);
+    CuckooHashMap          (CuckooHashMap<KEY,T,thash>&& to_move) noexcept;  //to_move is left with no buckets (allocated when next needed)
+    explicit CuckooHashMap (const std::initializer_list<Entry>& il, double the_load_threshold = 0.9, hashfunc chash = undefinedhash<KEY>);
+
+    //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
+    template <class Iterable>
+    explicit CuckooHashMap (const Iterable& i, double the_load_threshold = 0.9, hashfunc chash = undefinedhash<KEY>);
+
+
+    //Queries
+    bool empty      () const;
+    std::int64_t size () const;
+    bool has_key    (const KEY& key) const;
+    bool has_value  (const T& value) const;
+    std::string str () const; //supplies useful debugging information; contrast to operator <<
+    std::int64_t stash_size () const; //# entries in the stash (normally 0)
+
+
+    //Commands
+    T    put   (const KEY& key, const T& value);
+    T    erase (const KEY& key);
+    void clear ();
+
+    //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
+    template <class Iterable>
+    int put_all(const Iterable& i);
+
+
+    //Operators
+
+    T&       operator [] (const KEY&);
+    const T& operator [] (const KEY&) const;
+    CuckooHashMap<KEY,T,thash>& operator = (const CuckooHashMap<KEY,T,thash>& rhs);
+    bool operator == (const CuckooHashMap<KEY,T,thash>& rhs) const;
+    bool operator != (const CuckooHashMap<KEY,T,thash>& rhs) const;
+
+    template<class KEY2,class T2, auto hash2>
+    friend std::ostream& operator << (std::ostream& outs, const CuckooHashMap<KEY2,T2,hash2>& m);
+
+
+
+  public:
+    class Iterator {
+      public:
+        //Private constructor called in begin/end, which are friends of CuckooHashMap<T>
+        ~Iterator();
+        Entry       erase();
+        std::string str  () const;
+        CuckooHashMap<KEY,T,thash>::Iterator& operator ++ ();
+        CuckooHashMap<KEY,T,thash>::Iterator  operator ++ (int);
+        bool operator == (const CuckooHashMap<KEY,T,thash>::Iterator& rhs) const;
+        bool operator != (const CuckooHashMap<KEY,T,thash>::Iterator& rhs) const;
+        Entry& operator *  () const;
+        Entry* operator -> () const;
+        friend std::ostream& operator << (std::ostream& outs, const CuckooHashMap<KEY,T,thash>::Iterator& i) {
+          outs << i.str(); //Use the same meaning as the debugging .str() method
+          return outs;
+        }
+        friend Iterator CuckooHashMap<KEY,T,thash>::begin () const;
+        friend Iterator CuckooHashMap<KEY,T,thash>::end   () const;
+
+      private:
+        //If can_erase is false, current indexes the "next" value (must ++ to reach it)
+        //Positions 0..bins*slots-1 are bucket slots (bucket = position/slots), then the stash;
+        //  erasing never moves an entry, except the last stash entry into the erased stash
+        //  position (an unvisited entry moving into current)
+        std::int64_t                current;   //Position; stop: current == -1
+        CuckooHashMap<KEY,T,thash>* ref_map;
+        int                         expected_mod_count;
+        bool                        can_erase = true;
+
+        //Helper methods
+        void advance_cursors();
+
+        //Called in friends begin/end
+        Iterator(CuckooHashMap<KEY,T,thash>* iterate_over, bool from_begin);
+    };
+
+
+    Iterator begin () const;
+    Iterator end   () const;
+
+
+  private:
+    class alignas(64) Bucket {
+      public:
+        std::uint8_t tag[slots] = {};  //0 for an empty slot; else the tag of its entry's key
+        Entry        entry[slots];
+    };
+
+  TemplateFunction<hashfunc,thash,undefinedhash<KEY>> hash;  //Hashing function used (from template or constructor)
+  Bucket* map          = nullptr;  //Array of buckets: entries are stored in the buckets themselves
+  std::vector<Entry> stash;        //Entries that found no slot (normally empty)
+  double load_threshold;           //used/(bins*slots) <= load_threshold
+  std::int64_t bins    = 0;        //# buckets in array (always 2^bits)
+  int bits             = 0;
+  std::int64_t used    = 0;        //Cache for number of key->value pairs in the hash table
+  int mod_count        = 0;        //For sensing concurrent modification
+  std::uint64_t kick_state = 0x9e3779b97f4a7c15ull;  //xorshift state choosing the entries put evicts
+
+
+  //Helper methods
+  HashCode      hash_code            (const KEY& key)          const {return to_hash_code(hash(key));}
+  std::int64_t  first_bucket         (HashCode code)           const {return bin_index(code,bits);}
+  std::int64_t  second_bucket        (HashCode code)           const;
+  static std::uint8_t tag_of         (HashCode code);                  //1..128
+  Entry*        find_key             (const KEY& key)          const;  //Returns pointer to key's entry or nullptr
+  bool          place_entry          (Entry& e, HashCode code, bool allow_stash);  //Cuckoo insert; e becomes any entry left over
+  void          remove_entry         (std::int64_t position);          //Erase the entry at an Iterator position
+  Entry&        at_position          (std::int64_t position)   const;
+  bool          occupied             (std::int64_t position)   const;
+  std::uint64_t next_random          ();
+
+  void  allocate_bins        (std::int64_t at_least);          //2^bits >= at_least empty buckets
+  void  ensure_load_threshold(std::int64_t new_used);          //Reallocate if load_factor > load_threshold
+  void  rebuild              (std::int64_t at_least_bins);     //Re-place every entry into new buckets
+  void  add_new              (const Entry& e);                 //Add an entry whose key is not in the map
+  static double clamp_threshold    (double lt);                //Keep load_threshold in (0,0.95]
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//CuckooHashMap class and related definitions
+
+//Destructor/Constructors
+
+template<class KEY,class T, auto thash>
+CuckooHashMap<KEY,T,thash>::~CuckooHashMap() {
+  delete[] map;
+}
+
+
+template<class KEY,class T, auto thash>
+CuckooHashMap<KEY,T,thash>::CuckooHashMap(double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("CuckooHashMap::default constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("CuckooHashMap::default constructor: both specified and different");
+
+  allocate_bins(1);
+}
+
+
+template<class KEY,class T, auto thash>
+CuckooHashMap<KEY,T,thash>::CuckooHashMap(int initial_bins, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("CuckooHashMap::length constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("CuckooHashMap::length constructor: both specified and different");
+
+  allocate_bins(initial_bins);
+}
+
+
+template<class KEY,class T, auto thash>
+CuckooHashMap<KEY,T,thash>::CuckooHashMap(const CuckooHashMap<KEY,T,thash>& to_copy, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    hash = to_copy.hash;//throw TemplateFunctionError("CuckooHashMap::copy constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("CuckooHashMap::copy constructor: both specified and different");
+
+  if (hash == to_copy.hash && (double)to_copy.used/(to_copy.bins*slots) <= load_threshold) {
+    allocate_bins(to_copy.bins);
+    for (std::int64_t b=0; b<bins; ++b)
+      map[b] = to_copy.map[b];     //Same hash and bins: every entry keeps its slot
+    stash = to_copy.stash;
+    used  = to_copy.used;
+  }else {
+    allocate_bins(std::int64_t(to_copy.used/(load_threshold*slots))+1);
+    for (const Entry& m_entry : to_copy)
+      add_new(m_entry);
+  }
+}
+
+
+template<class KEY,class T, auto thash>
+CuckooHashMap<KEY,T,thash>::CuckooHashMap(CuckooHashMap<KEY,T,thash>&& to_move) noexcept
+: hash(to_move.hash), map(to_move.map), stash(std::move(to_move.stash)), load_threshold(to_move.load_threshold),
+  bins(to_move.bins), bits(to_move.bits), used(to_move.used), kick_state(to_move.kick_state) {
+  to_move.map  = nullptr;
+  to_move.stash.clear();
+  to_move.bins = 0;
+  to_move.bits = 0;
+  to_move.used = 0;
+  to_move.mod_count++;
+}
+
+
+template<class KEY,class T, auto thash>
+CuckooHashMap<KEY,T,thash>::CuckooHashMap(const std::initializer_list<Entry>& il, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("CuckooHashMap::initializer_list constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("CuckooHashMap::initializer_list constructor: both specified and different");
+
+  allocate_bins(std::int64_t(il.size()/(load_threshold*slots))+1);
+  for (const Entry& m_entry : il)
+    put(m_entry.first,m_entry.second);
+}
+
+
+template<class KEY,class T, auto thash>
+template <class Iterable>
+CuckooHashMap<KEY,T,thash>::CuckooHashMap(const Iterable& i, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("CuckooHashMap::Iterable constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("CuckooHashMap::Iterable constructor: both specified and different");
+
+  allocate_bins(std::int64_t(i.size()/(load_threshold*slots))+1);
+  for (const Entry& m_entry : i)
+    put(m_entry.first,m_entry.second);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Queries
+
+template<class KEY,class T, auto thash>
+bool CuckooHashMap<KEY,T,thash>::empty() const {
+  return used == 0;
+}
+
+
+template<class KEY,class T, auto thash>
+std::int64_t CuckooHashMap<KEY,T,thash>::size() const {
+  return used;
+}
+
+
+template<class KEY,class T, auto thash>
+bool CuckooHashMap<KEY,T,thash>::has_key (const KEY& key) const {
+  return find_key(key) != nullptr;
+}
+
+
+template<class KEY,class T, auto thash>
+bool CuckooHashMap<KEY,T,thash>::has_value (const T& value) const {
+  for (std::int64_t b=0; b<bins; ++b)
+    for (int s=0; s<slots; ++s)
+      if (map[b].tag[s] != 0 && value == map[b].entry[s].second)
+        return true;
+  for (const Entry& e : stash)
+    if (value == e.second)
+      return true;
+
+  return false;
+}
+
+
+template<class KEY,class T, auto thash>
+std::string CuckooHashMap<KEY,T,thash>::str() const {
+  std::ostringstream answer;
+  answer << "CuckooHashMap[";
+  if (bins != 0) {
+    answer << std::endl;
+    for (std::int64_t b=0; b<bins; ++b) {
+      answer << "  bucket[" << b << "] = ";
+      for (int s=0; s<slots; ++s) {
+        answer << (s == 0 ? "" : ", ");
+        if (map[b].tag[s] == 0)
+          answer << "EMPTY";
+        else
+          answer << map[b].entry[s].first << "->" << map[b].entry[s].second << " (tag=" << int(map[b].tag[s]) << ")";
+      }
+      answer << std::endl;
+    }
+    answer << "  stash = ";
+    for (std::size_t i=0; i<stash.size(); ++i)
+      answer << (i == 0 ? "" : ", ") << stash[i].first << "->" << stash[i].second;
+    answer << std::endl;
+  }
+  answer  << "](load_threshold=" << load_threshold << ",bins=" << bins << ",used=" <<used <<",mod_count=" << mod_count << ")";
+  return answer.str();
+}
+
+
+template<class KEY,class T, auto thash>
+std::int64_t CuckooHashMap<KEY,T,thash>::stash_size() const {
+  return stash.size();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Commands
+
+template<class KEY,class T, auto thash>
+T CuckooHashMap<KEY,T,thash>::put(const KEY& key, const T& value) {
+  T to_return;
+  Entry* c = find_key(key);
+  if (c != nullptr) {
+    to_return = c->second;
+    c->second = value;
+  }else{
+    to_return = value;
+    add_new(Entry(key,value));
+  }
+
+  ++mod_count;
+  return to_return;
+}
+
+
+template<class KEY,class T, auto thash>
+T CuckooHashMap<KEY,T,thash>::erase(const KEY& key) {
+  Entry* c = find_key(key);
+  if (c == nullptr) {
+    std::ostringstream answer;
+    answer << "CuckooHashMap::erase: key(" << key << ") not in Map";
+    throw KeyError(answer.str());
+  }
+  T to_return = c->second;
+  std::int64_t position = -1;
+  HashCode code = hash_code(key);
+  for (std::int64_t b : {first_bucket(code), second_bucket(code)})
+    for (int s=0; s<slots; ++s)
+      if (c == &map[b].entry[s])                //== (unlike - or <) may compare pointers into different arrays
+        position = b*slots + s;
+  if (position == -1)                           //c is in the stash
+    position = bins*slots + (c-stash.data());
+  remove_entry(position);
+
+  ++mod_count;
+  return to_return;
+}
+
+
+template<class KEY,class T, auto thash>
+void CuckooHashMap<KEY,T,thash>::clear() {
+  for (std::int64_t b=0; b<bins; ++b)
+    for (int s=0; s<slots; ++s)
+      if (map[b].tag[s] != 0) {
+        map[b].entry[s] = Entry();   //Release the key/value now, not at the next resize
+        map[b].tag[s]   = 0;
+      }
+  stash.clear();
+
+  used = 0;
+  ++mod_count;
+}
+
+
+template<class KEY,class T, auto thash>
+template<class Iterable>
+int CuckooHashMap<KEY,T,thash>::put_all(const Iterable& i) {
+  int count = 0;
+  for (const Entry& m_entry : i) {
+    ++count;
+    put(m_entry.first, m_entry.second);
+  }
+
+  return count;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Operators
+
+template<class KEY,class T, auto thash>
+T& CuckooHashMap<KEY,T,thash>::operator [] (const KEY& key) {
+  Entry* c = find_key(key);
+  if (c != nullptr)
+    return c->second;
+
+  ++mod_count;
+  add_new(Entry(key,T()));
+  return find_key(key)->second;               //put may have moved it (or rebuilt the buckets)
+}
+
+
+template<class KEY,class T, auto thash>
+const T& CuckooHashMap<KEY,T,thash>::operator [] (const KEY& key) const {
+  Entry* c = find_key(key);
+  if (c != nullptr)
+    return c->second;
+
+  std::ostringstream answer;
+  answer << "CuckooHashMap::operator []: key(" << key << ") not in Map";
+  throw KeyError(answer.str());
+}
+
+
+template<class KEY,class T, auto thash>
+CuckooHashMap<KEY,T,thash>& CuckooHashMap<KEY,T,thash>::operator = (const CuckooHashMap<KEY,T,thash>& rhs) {
+  if (this == &rhs)
+    return *this;
+
+  if (hash == rhs.hash && (double)rhs.used/(rhs.bins*slots) <= load_threshold) {
+    delete[] map;
+    allocate_bins(rhs.bins);
+    for (std::int64_t b=0; b<bins; ++b)
+      map[b] = rhs.map[b];
+    stash = rhs.stash;
+    used  = rhs.used;
+  }else{
+    clear();
+    for (const Entry& m_entry : rhs)
+      put(m_entry.first,m_entry.second);
+  }
+  ++mod_count;
+  return *this;
+}
+
+
+template<class KEY,class T, auto thash>
+bool CuckooHashMap<KEY,T,thash>::operator == (const CuckooHashMap<KEY,T,thash>& rhs) const {
+  if (this == &rhs)
+    return true;
+  if (used != rhs.size())
+    return false;
+
+  for (const Entry& m_entry : *this) {
+    // Uses ! and ==, so != on T need not be defined
+    Entry* rhs_entry = rhs.find_key(m_entry.first);
+    if (rhs_entry == nullptr || !(m_entry.second == rhs_entry->second))
+      return false;
+  }
+
+  return true;
+}
+
+
+template<class KEY,class T, auto thash>
+bool CuckooHashMap<KEY,T,thash>::operator != (const CuckooHashMap<KEY,T,thash>& rhs) const {
+  return !(*this == rhs);
+}
+
+
+template<class KEY,class T, auto thash>
+std::ostream& operator << (std::ostream& outs, const CuckooHashMap<KEY,T,thash>& m) {
+  outs << "map[";
+
+  int printed = 0;
+  for (const auto& m_entry : m)
+    outs << (printed++ == 0? "" : ",") << m_entry.first << "->" << m_entry.second;
+
+  outs << "]";
+  return outs;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator constructors
+
+template<class KEY,class T, auto thash>
+auto CuckooHashMap<KEY,T,thash>::begin () const -> CuckooHashMap<KEY,T,thash>::Iterator {
+  return Iterator(const_cast<CuckooHashMap<KEY,T,thash>*>(this),true);
+}
+
+
+template<class KEY,class T, auto thash>
+auto CuckooHashMap<KEY,T,thash>::end () const -> CuckooHashMap<KEY,T,thash>::Iterator {
+  return Iterator(const_cast<CuckooHashMap<KEY,T,thash>*>(this),false);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Private helper methods
+
+template<class KEY,class T, auto thash>
+std::int64_t CuckooHashMap<KEY,T,thash>::second_bucket (HashCode code) const {
+  return std::int64_t(((code*0xd6e8feb86659fd93ull) >> 1) >> (63-bits));
+}
+
+
+template<class KEY,class T, auto thash>
+std::uint8_t CuckooHashMap<KEY,T,thash>::tag_of (HashCode code) {
+  return std::uint8_t(1 + (((code*0xd6e8feb86659fd93ull) >> 24) & 0x7f));
+}
+
+
+template<class KEY,class T, auto thash>
+auto CuckooHashMap<KEY,T,thash>::find_key (const KEY& key) const -> Entry* {
+  if (bins == 0)
+    return nullptr;
+  HashCode     code = hash_code(key);
+  std::uint8_t tag  = tag_of(code);
+  Bucket&      b2   = map[second_bucket(code)];
+  ICS_PREFETCH(&b2);                              //Its miss overlaps the search of the first bucket
+  Bucket&      b1   = map[first_bucket(code)];
+  for (int s=0; s<slots; ++s)
+    if (b1.tag[s] == tag && key == b1.entry[s].first)
+      return &b1.entry[s];
+  for (int s=0; s<slots; ++s)
+    if (b2.tag[s] == tag && key == b2.entry[s].first)
+      return &b2.entry[s];
+  for (const Entry& e : stash)
+    if (key == e.first)
+      return const_cast<Entry*>(&e);
+
+  return nullptr;
+}
+
+
+template<class KEY,class T, auto thash>
+bool CuckooHashMap<KEY,T,thash>::place_entry (Entry& e, HashCode code, bool allow_stash) {
+  for (int kick=0; kick<=max_kicks; ++kick) {
+    std::int64_t candidate[2] = {first_bucket(code), second_bucket(code)};
+    for (std::int64_t b : candidate)
+      for (int s=0; s<slots; ++s)
+        if (map[b].tag[s] == 0) {
+          map[b].entry[s] = std::move(e);
+          map[b].tag[s]   = tag_of(code);
+          return true;
+        }
+    if (kick == max_kicks)
+      break;
+
+    //Both buckets are full: e takes a random slot in one, and its entry goes on to its other bucket
+    std::uint64_t r = next_random();
+    Bucket& b = map[candidate[r & 1]];
+    int     s = int((r >> 1) % slots);
+    std::swap(b.entry[s],e);
+    b.tag[s] = tag_of(code);
+    code     = hash_code(e.first);
+  }
+
+  if (!allow_stash && stash.size() >= std::size_t(stash_slots))
+    return false;
+  stash.push_back(std::move(e));
+  return true;
+}
+
+
+template<class KEY,class T, auto thash>
+void CuckooHashMap<KEY,T,thash>::remove_entry (std::int64_t position) {
+  if (position < bins*slots) {
+    Bucket& b = map[position/slots];
+    b.entry[position%slots] = Entry();
+    b.tag[position%slots]   = 0;
+  }else{
+    std::size_t i = position - bins*slots;
+    if (i != stash.size()-1)
+      stash[i] = std::move(stash.back());
+    stash.pop_back();
+  }
+  --used;
+}
+
+
+template<class KEY,class T, auto thash>
+auto CuckooHashMap<KEY,T,thash>::at_position (std::int64_t position) const -> Entry& {
+  if (position < bins*slots)
+    return map[position/slots].entry[position%slots];
+  return const_cast<Entry&>(stash[position - bins*slots]);
+}
+
+
+template<class KEY,class T, auto thash>
+bool CuckooHashMap<KEY,T,thash>::occupied (std::int64_t position) const {
+  if (position < bins*slots)
+    return map[position/slots].tag[position%slots] != 0;
+  return position - bins*slots < std::int64_t(stash.size());
+}
+
+
+template<class KEY,class T, auto thash>
+std::uint64_t CuckooHashMap<KEY,T,thash>::next_random () {
+  kick_state ^= kick_state << 13;
+  kick_state ^= kick_state >> 7;
+  kick_state ^= kick_state << 17;
+  return kick_state;
+}
+
+
+template<class KEY,class T, auto thash>
+void CuckooHashMap<KEY,T,thash>::allocate_bins (std::int64_t at_least) {
+  bits = bin_bits(at_least);
+  bins = std::int64_t(1) << bits;
+  map  = new Bucket[bins];
+}
+
+
+template<class KEY,class T, auto thash>
+void CuckooHashMap<KEY,T,thash>::ensure_load_threshold(std::int64_t new_used) {
+  if (bins == 0)
+    allocate_bins(1);
+  if (double(new_used)/double(bins*slots) > load_threshold)
+    rebuild(2*bins);
+}
+
+
+template<class KEY,class T, auto thash>
+void CuckooHashMap<KEY,T,thash>::rebuild (std::int64_t at_least_bins) {
+  Bucket*            old_map  = map;
+  std::int64_t       old_bins = bins;
+  std::vector<Entry> old_stash;
+  old_stash.swap(stash);
+
+  //Copies, not moves: if some entry cannot be placed (the stash fills), start over with more buckets
+  for (int new_bits = bin_bits(at_least_bins); /*See body*/; ++new_bits) {
+    allocate_bins(std::int64_t(1) << new_bits);
+    bool placed = true;
+    bool allow_stash = new_bits > bin_bits(at_least_bins)+2;   //Keys sharing codes: stop growing
+    for (std::int64_t b=0; placed && b<old_bins; ++b)
+      for (int s=0; placed && s<slots; ++s)
+        if (old_map[b].tag[s] != 0) {
+          Entry e(old_map[b].entry[s]);
+          placed = place_entry(e,hash_code(e.first),allow_stash);
+        }
+    for (std::size_t i=0; placed && i<old_stash.size(); ++i) {
+      Entry e(old_stash[i]);
+      placed = place_entry(e,hash_code(e.first),allow_stash);
+    }
+    if (placed)
+      break;
+    delete[] map;
+    stash.clear();
+  }
+
+  delete[] old_map;
+}
+
+
+template<class KEY,class T, auto thash>
+void CuckooHashMap<KEY,T,thash>::add_new (const Entry& e) {
+  ensure_load_threshold(used+1);
+  ++used;
+  Entry to_place(e);
+  place_entry(to_place,hash_code(to_place.first),true);
+
+  //An overfull stash at a low load means keys sharing codes, which more buckets would not separate
+  if (stash.size() > std::size_t(stash_slots) && used > bins*slots/4)
+    rebuild(2*bins);
+}
+
+
+template<class KEY,class T, auto thash>
+double CuckooHashMap<KEY,T,thash>::clamp_threshold (double lt) {
+  return lt <= 0. || lt > .95 ? .95 : lt;
+}
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator class definitions
+
+template<class KEY,class T, auto thash>
+void CuckooHashMap<KEY,T,thash>::Iterator::advance_cursors(){
+  std::int64_t positions = ref_map->bins*slots + ref_map->stash.size();
+  for (++current; current < positions; ++current)
+    if (ref_map->occupied(current))
+      return;
+
+  //Not found
+  current = -1;
+}
+
+
+template<class KEY,class T, auto thash>
+CuckooHashMap<KEY,T,thash>::Iterator::Iterator(CuckooHashMap<KEY,T,thash>* iterate_over, bool from_begin)
+: current(-1), ref_map(iterate_over), expected_mod_count(ref_map->mod_count) {
+  if (from_begin)
+    advance_cursors();
+}
+
+
+template<class KEY,class T, auto thash>
+CuckooHashMap<KEY,T,thash>::Iterator::~Iterator()
+{}
+
+
+template<class KEY,class T, auto thash>
+auto CuckooHashMap<KEY,T,thash>::Iterator::erase() -> Entry {
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("CuckooHashMap::Iterator::erase");
+  if (!can_erase)
+    throw CannotEraseError("CuckooHashMap::Iterator::erase Iterator cursor already erased");
+  if (current == -1)
+    throw CannotEraseError("CuckooHashMap::Iterator::erase Iterator cursor beyond data structure");
+
+  can_erase = false;
+  Entry to_return = ref_map->at_position(current);
+  ref_map->remove_entry(current);   //May move the last (unvisited) stash entry into current
+
+  ++ref_map->mod_count;
+  expected_mod_count = ref_map->mod_count;
+
+  return to_return;
+}
+
+
+template<class KEY,class T, auto thash>
+std::string CuckooHashMap<KEY,T,thash>::Iterator::str() const {
+  std::ostringstream answer;
+  answer << ref_map->str() << "(current=" << current << ",expected_mod_count=" << expected_mod_count << ",can_erase=" << can_erase << ")";
+  return answer.str();
+}
+
+template<class KEY,class T, auto thash>
+auto  CuckooHashMap<KEY,T,thash>::Iterator::operator ++ () -> CuckooHashMap<KEY,T,thash>::Iterator& {
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("CuckooHashMap::Iterator::operator ++");
+
+  if (current == -1)
+    return *this;
+
+  if (can_erase || !ref_map->occupied(current))
+    advance_cursors();
+
+  can_erase = true;
+  return *this;
+}
+
+
+template<class KEY,class T, auto thash>
+auto  CuckooHashMap<KEY,T,thash>::Iterator::operator ++ (int) -> CuckooHashMap<KEY,T,thash>::Iterator {
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("CuckooHashMap::Iterator::operator ++(int)");
+
+  if (current == -1)
+    return *this;
+
+  Iterator to_return(*this);
+  if (can_erase || !ref_map->occupied(current))
+    advance_cursors();
+  can_erase = true;
+
+  return to_return;
+}
+
+
+template<class KEY,class T, auto thash>
+bool CuckooHashMap<KEY,T,thash>::Iterator::operator == (const CuckooHashMap<KEY,T,thash>::Iterator& rhs) const {
+  const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
+  if (rhsASI == 0)
+    throw IteratorTypeError("CuckooHashMap::Iterator::operator ==");
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("CuckooHashMap::Iterator::operator ==");
+  if (ref_map != rhsASI->ref_map)
+    throw ComparingDifferentIteratorsError("CuckooHashMap::Iterator::operator ==");
+
+  return this->current == rhsASI->current;
+}
+
+
+template<class KEY,class T, auto thash>
+bool CuckooHashMap<KEY,T,thash>::Iterator::operator != (const CuckooHashMap<KEY,T,thash>::Iterator& rhs) const {
+  const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
+  if (rhsASI == 0)
+    throw IteratorTypeError("CuckooHashMap::Iterator::operator !=");
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("CuckooHashMap::Iterator::operator !=");
+  if (ref_map != rhsASI->ref_map)
+    throw ComparingDifferentIteratorsError("CuckooHashMap::Iterator::operator !=");
+
+  return this->current != rhsASI->current;
+}
+
+
+template<class KEY,class T, auto thash>
+pair<KEY,T>& CuckooHashMap<KEY,T,thash>::Iterator::operator *() const {
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("CuckooHashMap::Iterator::operator *");
+  if (!can_erase || current == -1)
+    throw IteratorPositionIllegal("CuckooHashMap::Iterator::operator * Iterator illegal");
+
+  return ref_map->at_position(current);
+}
+
+
+template<class KEY,class T, auto thash>
+pair<KEY,T>* CuckooHashMap<KEY,T,thash>::Iterator::operator ->() const {
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("CuckooHashMap::Iterator::operator ->");
+  if (!can_erase || current == -1)
+    throw IteratorPositionIllegal("CuckooHashMap::Iterator::operator -> Iterator illegal");
+
+  return &(ref_map->at_position(current));
+}
+
+
+}
+
+#endif /* CUCKOO_HASH_MAP_HPP_ */
@@ -0,0 +1,744 @@
+#ifndef FLAT_HASH_MAP_HPP_
+#define FLAT_HASH_MAP_HPP_
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <initializer_list>
+#include <utility>              //For std::swap function
+#include <cstdint>
+#include "ics_exceptions.hpp"
+#include "pair.hpp"
+#include "hash_code.hpp"
+#include "template_function.hpp"
+
+
+namespace ics {
+
+
+#ifndef undefinedhashdefined
+#define undefinedhashdefined
+template<class T, class R = int>
+R undefinedhash (const T& a) {return 0;}
+#endif /* undefinedhashdefined */
+
+//FlatHashMap is a drop-in replacement for HashMap: same constructors, queries,
+//  commands, operators and Iterator (including mod_count checking), but all
+//  entries live directly in one array of slots (open addressing) instead of
+//  in linked lists hanging off each bin.
+//Collisions are resolved by Robin Hood linear probing: an entry being placed
+//  takes the slot of any entry that is closer to its own home bin, so probe
+//  lengths stay short and a lookup can stop as soon as it sees a "richer" slot.
+//Erasing uses backward-shift deletion (no tombstones): the entries after the
+//  erased one move back one slot until an empty slot or a home slot is found.
+//bins is always 2^bits. As in HashMap, hash_compress is bin_index (see hash_code.hpp): Fibonacci
+//  hashing, in which every bit of the hash code picks the home slot (integer keys that differ only in
+//  their high bits do not cluster in one run of slots); probing wraps around with a mask.
+//Unlike HashMap, a reference returned by [] is invalidated by a later put/[]/erase
+//  (entries move around in the array), so do not hold onto it across mutations.
+//
+//Instantiate the templated class supplying thash(a): produces a hash value for a.
+//If thash is defaulted to undefinedhash in the template, then a constructor must supply chash.
+//If both thash and chash are supplied, then they must be the same (by ==) function.
+//If neither is supplied, or both are supplied but different, TemplateFunctionError is raised.
+//The (unique) non-undefinedhash value supplied by thash/chash is stored in the instance variable hash.
+//As in HashMap, thash is called directly (see template_function.hpp) and may return an int or a 64-bit
+//  value (e.g., the hashers in hashers.hpp); sizes and slot indexes are 64-bit.
+//The load_threshold must be < 1 (some slot must always be empty); larger values are clamped.
+template<class KEY,class T, auto thash = undefinedhash<KEY>> class FlatHashMap {
+  public:
+    typedef ics::pair<KEY,T>   Entry;
+    typedef decltype(thash) hashfunc;  //int or 64-bit hash values: see hash_code.hpp
+
+    //Destructor/Constructors
+    ~FlatHashMap ();
+
+    FlatHashMap          (double the_load_threshold = 0.875, hashfunc chash = undefinedhash<KEY>);
+    explicit FlatHashMap (int initial_bins, double the_load_threshold = 0.875, hashfunc chash = undefinedhash<KEY>);
+    FlatHashMap          (const FlatHashMap<KEY,T,thash>& to_copy, double the_load_threshold = 0.875, hashfunc chash = undefinedhash<KEY>);
+    explicit FlatHashMap (const std::initializer_list<Entry>& il, double the_load_threshold = 0.875, hashfunc chash = undefinedhash<KEY>);
+
+    //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
+    template <class Iterable>
+    explicit FlatHashMap (const Iterable& i, double the_load_threshold = 0.875, hashfunc chash = undefinedhash<KEY>);
+
+
+    //Queries
+    bool empty      () const;
+    std::int64_t size () const;
+    bool has_key    (const KEY& key) const;
+    bool has_value  (const T& value) const;
+    std::string str () const; //supplies useful debugging information; contrast to operator <<
+
+
+    //Commands
+    T    put   (const KEY& key, const T& value);
+    T    erase (const KEY& key);
+    void clear ();
+
+    //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
+    template <class Iterable>
+    std::int64_t put_all(const Iterable& i);
+
+
+    //Operators
+
+    T&       operator [] (const KEY&);
+    const T& operator [] (const KEY&) const;
+    FlatHashMap<KEY,T,thash>& operator = (const FlatHashMap<KEY,T,thash>& rhs);
+    bool operator == (const FlatHashMap<KEY,T,thash>& rhs) const;
+    bool operator != (const FlatHashMap<KEY,T,thash>& rhs) const;
+
+    template<class KEY2,class T2, auto hash2>
+    friend std::ostream& operator << (std::ostream& outs, const FlatHashMap<KEY2,T2,hash2>& m);
+
+
+
+  private:
+    class Slot;
+
+  public:
+    class Iterator {
+      public:
+        //Private constructor called in begin/end, which are friends of FlatHashMap<T>
+        ~Iterator();
+        Entry       erase();
+        std::string str  () const;
+        FlatHashMap<KEY,T,thash>::Iterator& operator ++ ();
+        FlatHashMap<KEY,T,thash>::Iterator  operator ++ (int);
+        bool operator == (const FlatHashMap<KEY,T,thash>::Iterator& rhs) const;
+        bool operator != (const FlatHashMap<KEY,T,thash>::Iterator& rhs) const;
+        Entry& operator *  () const;
+        Entry* operator -> () const;
+        friend std::ostream& operator << (std::ostream& outs, const FlatHashMap<KEY,T,thash>::Iterator& i) {
+          outs << i.str(); //Use the same meaning as the debugging .str() method
+          return outs;
+        }
+        friend Iterator FlatHashMap<KEY,T,thash>::begin () const;
+        friend Iterator FlatHashMap<KEY,T,thash>::end   () const;
+
+      private:
+        //If can_erase is false, current indexes the "next" value (must ++ to reach it)
+        //Iteration starts just after an empty slot and wraps around the array, so
+        //  backward-shift deletion can only move unvisited entries into current
+        std::int64_t              current;   //Slot index; stop: current == -1
+        std::int64_t              remaining; //Slots still to examine after current
+        FlatHashMap<KEY,T,thash>* ref_map;
+        int                       expected_mod_count;
+        bool                      can_erase = true;
+
+        //Helper methods
+        void advance_cursors();
+
+        //Called in friends begin/end
+        Iterator(FlatHashMap<KEY,T,thash>* iterate_over, bool from_begin);
+    };
+
+
+    Iterator begin () const;
+    Iterator end   () const;
+
+
+  private:
+    class Slot {
+      public:
+        Entry value;
+        int   probe = 0;   //0 for an empty slot; else 1 + distance from the key's home bin
+    };
+
+  TemplateFunction<hashfunc,thash,undefinedhash<KEY>> hash;  //Hashing function used (from template or constructor)
+  Slot* map     = nullptr;    //Array of slots: entries are stored in the array itself
+  double load_threshold;      //used/bins <= load_threshold < 1
+  std::int64_t bins = 1;      //# slots in array (always a power of 2)
+  int bits      = 0;          //bins == 2^bits
+  std::int64_t used = 0;      //Cache for number of key->value pairs in the hash table
+  int mod_count = 0;          //For sensing concurrent modification
+
+
+  //Helper methods
+  std::int64_t hash_compress (const KEY& key)          const;  //hash function ranged to [0,bins-1] (key's home slot)
+  Slot* find_key             (const KEY& key)          const;  //Returns reference to key's slot or nullptr
+  std::int64_t place_entry   (const Entry& e);                 //Robin Hood insert of a new key; returns its slot
+  void  remove_slot          (std::int64_t s);                 //Backward-shift delete of the entry in slot s
+  std::int64_t first_empty_slot ()                     const;  //Start of iteration (there is always one)
+
+  void  ensure_load_threshold(std::int64_t new_used);          //Reallocate if load_factor > load_threshold
+  static std::int64_t round_up_bins (std::int64_t n);          //Smallest power of 2 >= n (and >= 1)
+  static double clamp_threshold    (double lt);                //Keep load_threshold in (0,0.95]
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//FlatHashMap class and related definitions
+
+//Destructor/Constructors
+
+template<class KEY,class T, auto thash>
+FlatHashMap<KEY,T,thash>::~FlatHashMap() {
+  delete[] map;
+}
+
+
+template<class KEY,class T, auto thash>
+FlatHashMap<KEY,T,thash>::FlatHashMap(double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("FlatHashMap::default constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("FlatHashMap::default constructor: both specified and different");
+
+  map = new Slot[bins];
+}
+
+
+template<class KEY,class T, auto thash>
+FlatHashMap<KEY,T,thash>::FlatHashMap(int initial_bins, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)), bins(round_up_bins(initial_bins)), bits(bin_bits(bins)) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("FlatHashMap::length constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("FlatHashMap::length constructor: both specified and different");
+
+  map = new Slot[bins];
+}
+
+
+template<class KEY,class T, auto thash>
+FlatHashMap<KEY,T,thash>::FlatHashMap(const FlatHashMap<KEY,T,thash>& to_copy, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)), bins(to_copy.bins), bits(to_copy.bits) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    hash = to_copy.hash;//throw TemplateFunctionError("FlatHashMap::copy constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("FlatHashMap::copy constructor: both specified and different");
+
+  if (hash == to_copy.hash && (double)to_copy.size()/to_copy.bins <= load_threshold) {
+    used = to_copy.used;
+    map  = new Slot[bins];
+    for (std::int64_t s=0; s<bins; ++s)
+      map[s] = to_copy.map[s];     //Same hash and bins: every slot keeps its position
+  }else {
+    bins = round_up_bins(std::int64_t(to_copy.size()/load_threshold)+1);
+    bits = bin_bits(bins);
+    map  = new Slot[bins];
+    for (std::int64_t s=0; s<to_copy.bins; ++s)
+      if (to_copy.map[s].probe != 0)
+        put(to_copy.map[s].value.first,to_copy.map[s].value.second);
+  }
+}
+
+
+template<class KEY,class T, auto thash>
+FlatHashMap<KEY,T,thash>::FlatHashMap(const std::initializer_list<Entry>& il, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("FlatHashMap::initializer_list constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("FlatHashMap::initializer_list constructor: both specified and different");
+
+  bins = round_up_bins(std::int64_t(il.size()/load_threshold)+1);
+  bits = bin_bits(bins);
+  map  = new Slot[bins];
+  for (const Entry& m_entry : il)
+    put(m_entry.first,m_entry.second);
+}
+
+
+template<class KEY,class T, auto thash>
+template <class Iterable>
+FlatHashMap<KEY,T,thash>::FlatHashMap(const Iterable& i, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("FlatHashMap::Iterable constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("FlatHashMap::Iterable constructor: both specified and different");
+
+  bins = round_up_bins(std::int64_t(i.size()/load_threshold)+1);
+  bits = bin_bits(bins);
+  map  = new Slot[bins];
+  for (const Entry& m_entry : i)
+    put(m_entry.first,m_entry.second);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Queries
+
+template<class KEY,class T, auto thash>
+bool FlatHashMap<KEY,T,thash>::empty() const {
+  return used == 0;
+}
+
+
+template<class KEY,class T, auto thash>
+std::int64_t FlatHashMap<KEY,T,thash>::size() const {
+  return used;
+}
+
+
+template<class KEY,class T, auto thash>
+bool FlatHashMap<KEY,T,thash>::has_key (const KEY& key) const {
+  return find_key(key) != nullptr;
+}
+
+
+template<class KEY,class T, auto thash>
+bool FlatHashMap<KEY,T,thash>::has_value (const T& value) const {
+  for (std::int64_t s=0; s<bins; ++s)
+    if (map[s].probe != 0 && value == map[s].value.second)
+      return true;
+
+  return false;
+}
+
+
+template<class KEY,class T, auto thash>
+std::string FlatHashMap<KEY,T,thash>::str() const {
+  std::ostringstream answer;
+  answer << "FlatHashMap[";
+  if (bins != 0) {
+    answer << std::endl;
+    for (std::int64_t s=0; s<bins; ++s) {
+      answer << "  slot[" << s << "] = ";
+      if (map[s].probe == 0)
+        answer << "EMPTY" << std::endl;
+      else
+        answer << map[s].value.first << "->" << map[s].value.second << " (probe=" << map[s].probe << ")" << std::endl;
+    }
+  }
+  answer  << "](load_threshold=" << load_threshold << ",bins=" << bins << ",used=" <<used <<",mod_count=" << mod_count << ")";
+  return answer.str();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Commands
+
+template<class KEY,class T, auto thash>
+T FlatHashMap<KEY,T,thash>::put(const KEY& key, const T& value) {
+  T to_return;
+  Slot* c = find_key(key);
+  if (c != nullptr) {
+    to_return = c->value.second;
+    c->value.second = value;
+  }else{
+    to_return = value;
+    ensure_load_threshold(used+1);
+    ++used;
+    place_entry(Entry(key,value));                //bins may have changed in ensure_load_threshold!
+  }
+
+  ++mod_count;
+  return to_return;
+}
+
+
+template<class KEY,class T, auto thash>
+T FlatHashMap<KEY,T,thash>::erase(const KEY& key) {
+  Slot* c = find_key(key);
+  if (c == nullptr) {
+    std::ostringstream answer;
+    answer << "FlatHashMap::erase: key(" << key << ") not in Map";
+    throw KeyError(answer.str());
+  }
+  T to_return = c->value.second;
+  remove_slot(c-map);
+
+  --used;
+  ++mod_count;
+  return to_return;
+}
+
+
+template<class KEY,class T, auto thash>
+void FlatHashMap<KEY,T,thash>::clear() {
+  for (std::int64_t s=0; s<bins; ++s)
+    if (map[s].probe != 0) {
+      map[s].value = Entry();   //Release the key/value now, not at the next resize
+      map[s].probe = 0;
+    }
+
+  used = 0;
+  ++mod_count;
+}
+
+
+template<class KEY,class T, auto thash>
+template<class Iterable>
+std::int64_t FlatHashMap<KEY,T,thash>::put_all(const Iterable& i) {
+  std::int64_t count = 0;
+  for (const Entry& m_entry : i) {
+    ++count;
+    put(m_entry.first, m_entry.second);
+  }
+
+  return count;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Operators
+
+template<class KEY,class T, auto thash>
+T& FlatHashMap<KEY,T,thash>::operator [] (const KEY& key) {
+  Slot* c = find_key(key);
+  if (c != nullptr)
+    return c->value.second;
+
+  ensure_load_threshold(used+1);
+  ++used;
+  ++mod_count;
+  std::int64_t s = place_entry(Entry(key,T()));         //bins may have changed in ensure_load_threshold!
+  return map[s].value.second;
+}
+
+
+template<class KEY,class T, auto thash>
+const T& FlatHashMap<KEY,T,thash>::operator [] (const KEY& key) const {
+  Slot* c = find_key(key);
+  if (c != nullptr)
+    return c->value.second;
+
+  std::ostringstream answer;
+  answer << "FlatHashMap::operator []: key(" << key << ") not in Map";
+  throw KeyError(answer.str());
+}
+
+
+template<class KEY,class T, auto thash>
+FlatHashMap<KEY,T,thash>& FlatHashMap<KEY,T,thash>::operator = (const FlatHashMap<KEY,T,thash>& rhs) {
+  if (this == &rhs)
+    return *this;
+
+  if (hash == rhs.hash && (double)rhs.size()/rhs.bins <= load_threshold) {
+    delete[] map;
+    bins = rhs.bins;
+    bits = rhs.bits;
+    used = rhs.used;
+    map  = new Slot[bins];
+    for (std::int64_t s=0; s<bins; ++s)
+      map[s] = rhs.map[s];
+  }else{
+    clear();
+    for (std::int64_t s=0; s<rhs.bins; ++s)
+      if (rhs.map[s].probe != 0)
+        put(rhs.map[s].value.first,rhs.map[s].value.second);
+  }
+  ++mod_count;
+  return *this;
+}
+
+
+template<class KEY,class T, auto thash>
+bool FlatHashMap<KEY,T,thash>::operator == (const FlatHashMap<KEY,T,thash>& rhs) const {
+  if (this == &rhs)
+    return true;
+  if (used != rhs.size())
+    return false;
+
+  for (std::int64_t s=0; s<bins; ++s)
+    if (map[s].probe != 0) {
+      // Uses ! and ==, so != on T need not be defined
+      Slot* rhs_slot = rhs.find_key(map[s].value.first);
+      if (rhs_slot == nullptr || !(map[s].value.second == rhs_slot->value.second))
+        return false;
+    }
+
+  return true;
+}
+
+
+template<class KEY,class T, auto thash>
+bool FlatHashMap<KEY,T,thash>::operator != (const FlatHashMap<KEY,T,thash>& rhs) const {
+  return !(*this == rhs);
+}
+
+
+template<class KEY,class T, auto thash>
+std::ostream& operator << (std::ostream& outs, const FlatHashMap<KEY,T,thash>& m) {
+  outs << "map[";
+
+  int printed = 0;
+  for (std::int64_t s=0; s<m.bins; ++s)
+    if (m.map[s].probe != 0)
+      outs << (printed++ == 0? "" : ",") << m.map[s].value.first << "->" << m.map[s].value.second;
+
+  outs << "]";
+  return outs;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator constructors
+
+template<class KEY,class T, auto thash>
+auto FlatHashMap<KEY,T,thash>::begin () const -> FlatHashMap<KEY,T,thash>::Iterator {
+  return Iterator(const_cast<FlatHashMap<KEY,T,thash>*>(this),true);
+}
+
+
+template<class KEY,class T, auto thash>
+auto FlatHashMap<KEY,T,thash>::end () const -> FlatHashMap<KEY,T,thash>::Iterator {
+  return Iterator(const_cast<FlatHashMap<KEY,T,thash>*>(this),false);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Private helper methods
+
+template<class KEY,class T, auto thash>
+std::int64_t FlatHashMap<KEY,T,thash>::hash_compress (const KEY& key) const {
+  return bin_index(to_hash_code(hash(key)),bits);
+}
+
+
+template<class KEY,class T, auto thash>
+typename FlatHashMap<KEY,T,thash>::Slot* FlatHashMap<KEY,T,thash>::find_key (const KEY& key) const {
+  //Robin Hood invariant: once a slot's probe is smaller than ours, key cannot be further on
+  std::int64_t s = hash_compress(key);
+  for (int probe = 1; map[s].probe >= probe; ++probe, s = (s+1) & (bins-1))
+    if (map[s].probe == probe && key == map[s].value.first)
+      return &map[s];
+
+  return nullptr;
+}
+
+
+template<class KEY,class T, auto thash>
+std::int64_t FlatHashMap<KEY,T,thash>::place_entry (const Entry& e) {
+  Entry to_place = e;
+  int   probe    = 1;
+  std::int64_t answer = -1;  //Slot where e itself ends up (it may be displaced by nobody after that)
+  for (std::int64_t s = hash_compress(e.first); /*See body*/; s = (s+1) & (bins-1), ++probe) {
+    if (map[s].probe == 0) {
+      map[s].value = to_place;
+      map[s].probe = probe;
+      return answer == -1 ? s : answer;
+    }
+    if (map[s].probe < probe) {   //Take from the rich: the resident is closer to home than we are
+      std::swap(map[s].value,to_place);
+      std::swap(map[s].probe,probe);
+      if (answer == -1)
+        answer = s;
+    }
+  }
+}
+
+
+template<class KEY,class T, auto thash>
+void FlatHashMap<KEY,T,thash>::remove_slot (std::int64_t s) {
+  for (std::int64_t n = (s+1) & (bins-1); map[n].probe > 1; s = n, n = (n+1) & (bins-1)) {
+    map[s].value = map[n].value;
+    map[s].probe = map[n].probe-1;
+  }
+  map[s].value = Entry();
+  map[s].probe = 0;
+}
+
+
+template<class KEY,class T, auto thash>
+std::int64_t FlatHashMap<KEY,T,thash>::first_empty_slot () const {
+  for (std::int64_t s=0; s<bins; ++s)
+    if (map[s].probe == 0)
+      return s;
+  return 0;  //Not reachable while load_threshold < 1
+}
+
+
+template<class KEY,class T, auto thash>
+void FlatHashMap<KEY,T,thash>::ensure_load_threshold(std::int64_t new_used) {
+  if (double(new_used)/double(bins) <= load_threshold)
+    return;
+
+  Slot* old_map  = map;
+  std::int64_t old_bins = bins;
+
+  bins = 2*old_bins;
+  ++bits;
+  map  = new Slot[bins];
+
+  for (std::int64_t s=0; s<old_bins; ++s)
+    if (old_map[s].probe != 0)
+      place_entry(old_map[s].value);
+
+  delete [] old_map;
+}
+
+
+template<class KEY,class T, auto thash>
+std::int64_t FlatHashMap<KEY,T,thash>::round_up_bins (std::int64_t n) {
+  std::int64_t answer = 1;
+  while (answer < n)
+    answer *= 2;
+  return answer;
+}
+
+
+template<class KEY,class T, auto thash>
+double FlatHashMap<KEY,T,thash>::clamp_threshold (double lt) {
+  return lt <= 0. || lt > .95 ? .95 : lt;
+}
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator class definitions
+
+template<class KEY,class T, auto thash>
+void FlatHashMap<KEY,T,thash>::Iterator::advance_cursors(){
+  for (; remaining > 0; --remaining) {
+    current = (current+1) & (ref_map->bins-1);
+    if (ref_map->map[current].probe != 0) {
+      --remaining;
+      return;
+    }
+  }
+
+  //Not found
+  current   = -1;
+  remaining = 0;
+}
+
+
+template<class KEY,class T, auto thash>
+FlatHashMap<KEY,T,thash>::Iterator::Iterator(FlatHashMap<KEY,T,thash>* iterate_over, bool from_begin)
+: current(-1), remaining(0), ref_map(iterate_over), expected_mod_count(ref_map->mod_count) {
+  if (from_begin) {
+    current   = ref_map->first_empty_slot();
+    remaining = ref_map->bins-1;
+    advance_cursors();
+  }
+}
+
+
+template<class KEY,class T, auto thash>
+FlatHashMap<KEY,T,thash>::Iterator::~Iterator()
+{}
+
+
+template<class KEY,class T, auto thash>
+auto FlatHashMap<KEY,T,thash>::Iterator::erase() -> Entry {
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("FlatHashMap::Iterator::erase");
+  if (!can_erase)
+    throw CannotEraseError("FlatHashMap::Iterator::erase Iterator cursor already erased");
+  if (current == -1)
+    throw CannotEraseError("FlatHashMap::Iterator::erase Iterator cursor beyond data structure");
+
+  can_erase = false;
+  Entry to_return = ref_map->map[current].value;
+  ref_map->remove_slot(current);   //May shift the next (unvisited) entry into current
+
+  --ref_map->used;
+  ++ref_map->mod_count;
+  expected_mod_count = ref_map->mod_count;
+
+  return to_return;
+}
+
+
+template<class KEY,class T, auto thash>
+std::string FlatHashMap<KEY,T,thash>::Iterator::str() const {
+  std::ostringstream answer;
+  answer << ref_map->str() << "(current=" << current << ",remaining=" << remaining << ",expected_mod_count=" << expected_mod_count << ",can_erase=" << can_erase << ")";
+  return answer.str();
+}
+
+template<class KEY,class T, auto thash>
+auto  FlatHashMap<KEY,T,thash>::Iterator::operator ++ () -> FlatHashMap<KEY,T,thash>::Iterator& {
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("FlatHashMap::Iterator::operator ++");
+
+  if (current == -1)
+    return *this;
+
+  if (can_erase || ref_map->map[current].probe == 0)
+    advance_cursors();
+
+  can_erase = true;
+  return *this;
+}
+
+
+template<class KEY,class T, auto thash>
+auto  FlatHashMap<KEY,T,thash>::Iterator::operator ++ (int) -> FlatHashMap<KEY,T,thash>::Iterator {
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("FlatHashMap::Iterator::operator ++(int)");
+
+  if (current == -1)
+    return *this;
+
+  Iterator to_return(*this);
+  if (can_erase || ref_map->map[current].probe == 0)
+    advance_cursors();
+  can_erase = true;
+
+  return to_return;
+}
+
+
+template<class KEY,class T, auto thash>
+bool FlatHashMap<KEY,T,thash>::Iterator::operator == (const FlatHashMap<KEY,T,thash>::Iterator& rhs) const {
+  const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
+  if (rhsASI == 0)
+    throw IteratorTypeError("FlatHashMap::Iterator::operator ==");
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("FlatHashMap::Iterator::operator ==");
+  if (ref_map != rhsASI->ref_map)
+    throw ComparingDifferentIteratorsError("FlatHashMap::Iterator::operator ==");
+
+  return this->current == rhsASI->current;
+}
+
+
+template<class KEY,class T, auto thash>
+bool FlatHashMap<KEY,T,thash>::Iterator::operator != (const FlatHashMap<KEY,T,thash>::Iterator& rhs) const {
+  const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
+  if (rhsASI == 0)
+    throw IteratorTypeError("FlatHashMap::Iterator::operator !=");
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("FlatHashMap::Iterator::operator !=");
+  if (ref_map != rhsASI->ref_map)
+    throw ComparingDifferentIteratorsError("FlatHashMap::Iterator::operator !=");
+
+  return this->current != rhsASI->current;
+}
+
+
+template<class KEY,class T, auto thash>
+pair<KEY,T>& FlatHashMap<KEY,T,thash>::Iterator::operator *() const {
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("FlatHashMap::Iterator::operator *");
+  if (!can_erase || current == -1)
+    throw IteratorPositionIllegal("FlatHashMap::Iterator::operator * Iterator illegal");
+
+  return ref_map->map[current].value;
+}
+
+
+template<class KEY,class T, auto thash>
+pair<KEY,T>* FlatHashMap<KEY,T,thash>::Iterator::operator ->() const {
+  if (expected_mod_count != ref_map->mod_count)
+    throw ConcurrentModificationError("FlatHashMap::Iterator::operator ->");
+  if (!can_erase || current == -1)
+    throw IteratorPositionIllegal("FlatHashMap::Iterator::operator -> Iterator illegal");
+
+  return &(ref_map->map[current].value);
+}
+
+
+}
+
+#endif /* FLAT_HASH_MAP_HPP_ */
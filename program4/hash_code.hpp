@@ -0,0 +1,45 @@
+#ifndef HASH_CODE_HPP_
+#define HASH_CODE_HPP_
+
+#include <cstdint>
+#include <type_traits>          //std::make_unsigned
+
+
+namespace ics {
+
+
+//Hash codes and bins for HashMap/HashSet (and the images they write: see hash_image.hpp).
+//A hash function may return an int (as all our old ones do) or a 64-bit value (e.g., std::hash's
+//  std::size_t). Either is converted, without sign extension, to an unsigned 64-bit HashCode:
+//  no bits are thrown away and no code is negative (abs(INT_MIN) is).
+//A table has 2^bits bins; a code's bin is the top bits of code*2^64/phi (Fibonacci hashing): a
+//  multiply and a shift instead of a %, in which every bit of the code affects the bin (so codes
+//  that differ only in their high bits still spread over the bins).
+//Doubling the bins (bits+1) moves the codes in bin b to bins 2b and 2b+1.
+typedef std::uint64_t HashCode;
+
+
+template<class Value>
+inline HashCode to_hash_code (Value hash_value) {
+  return HashCode(typename std::make_unsigned<Value>::type(hash_value));
+}
+
+
+//The least bits with 2^bits >= bins: a table that must have at least bins bins has 2^bits
+constexpr int bin_bits (std::int64_t bins) {
+  int bits = 0;
+  while (bits < 62 && (std::int64_t(1) << bits) < bins)
+    ++bits;
+  return bits;
+}
+
+
+//The bin (0..2^bits-1) of code; shifting by 1 first means bits == 0 (1 bin) shifts by 63, not 64
+inline std::int64_t bin_index (HashCode code, int bits) {
+  return std::int64_t(((code*11400714819323198485ull) >> 1) >> (63-bits));
+}
+
+
+}
+
+#endif /* HASH_CODE_HPP_ */
@@ -6,8 +6,15 @@
 #include <iostream>
 #include <sstream>
 #include <initializer_list>
+#include <utility>              //std::move, std::forward, std::swap
 #include "ics_exceptions.hpp"
 #include "pair.hpp"
+#include "node_allocator.hpp"
+#include "hash_image.hpp"
+#include "hash_statistics.hpp"
+#include "hash_code.hpp"
+#include "template_function.hpp"
+#include "iteration_policy.hpp"
 
 
 namespace ics {
@@ -15,61 +22,158 @@ namespace ics {
 
 #ifndef undefinedhashdefined
 #define undefinedhashdefined
-template<class T>
-int undefinedhash (const T& a) {return 0;}
+template<class T, class R = int>
+R undefinedhash (const T& a) {return 0;}
 #endif /* undefinedhashdefined */
 
+#ifndef ICS_PREFETCH
+#if defined(__GNUC__) || defined(__clang__)
+#define ICS_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define ICS_PREFETCH(address)
+#endif
+#endif /* ICS_PREFETCH */
+
+//Hash code policies for HashMap: each list node derives from one.
+//RecomputeHash stores nothing (a node is no bigger): a key's hash code is recomputed, calling
+//  hash(key), whenever it is needed, including for every key moved in a resize.
+//CacheHash stores each key's hash code in its node when it is added: resizes never call hash,
+//  and lookups compare hash codes before calling KEY's operator ==.
+class RecomputeHash {
+  public:
+    template<class KEY, class Hash>
+    HashCode code      (const KEY& key, const Hash& hash) const {return to_hash_code(hash(key));}
+    void     set_code  (HashCode c)                             {}
+    bool     may_match (HashCode c)                       const {return true;}
+};
+
+class CacheHash {
+  public:
+    template<class KEY, class Hash>
+    HashCode code      (const KEY& key, const Hash& hash) const {return hash_code;}
+    void     set_code  (HashCode c)                             {hash_code = c;}
+    bool     may_match (HashCode c)                       const {return hash_code == c;}
+
+  private:
+    HashCode hash_code = 0;
+};
+
 //Instantiate the templated class supplying thash(a): produces a hash value for a.
 //If thash is defaulted to undefinedhash in the template, then a constructor must supply chash.
 //If both thash and chash are supplied, then they must be the same (by ==) function.
 //If neither is supplied, or both are supplied but different, TemplateFunctionError is raised.
 //The (unique) non-undefinedhash value supplied by thash/chash is stored in the instance variable hash.
-template<class KEY,class T, int (*thash)(const KEY& a) = undefinedhash<KEY>> class HashMap {
+//A thash is called directly (see template_function.hpp), so it can be inlined; thash can also be
+//  functor<F> for a stateless functor class F (e.g., HashMap<int,int,functor<IntHash>>).
+//thash may return an int or a 64-bit value; sizes and bins are 64-bit, so a map can hold more
+//  than 2^31 entries. There are always 2^bits bins (see hash_code.hpp).
+//NodeAllocator (see node_allocator.hpp) allocates the list nodes: PoolNodeAllocator<> recycles erased
+//  nodes from slabs instead of calling new/delete for each one.
+//HashCache (RecomputeHash or CacheHash, above) decides whether nodes store their keys' hash codes.
+//Counters (NoHashCounters or HashCounters, see hash_statistics.hpp) decides whether statistics()
+//  reports lookup probes and resizes too; with NoHashCounters the counting compiles to nothing.
+//Iteration (CheckedIteration or UncheckedIteration, see iteration_policy.hpp) decides whether
+//  Iterators and for_each check for concurrent modification.
+template<class KEY,class T, auto thash = undefinedhash<KEY>, class NodeAllocator = HeapNodeAllocator, class HashCache = RecomputeHash, class Counters = NoHashCounters, class Iteration = CheckedIteration> class HashMap {
   public:
     typedef ics::pair<KEY,T>   Entry;
-    typedef int (*hashfunc) (const KEY& a);
+    typedef decltype(thash) hashfunc;  //int or 64-bit hash values: see hash_code.hpp
 
     //Destructor/Constructors
     ~HashMap ();
 
-    HashMap          (double the_load_threshold = 1.0, int (*chash)(const KEY& a) = undefinedhash<KEY>);
-    explicit HashMap (int initial_bins, double the_load_threshold = 1.0, int (*chash)(const KEY& k) = undefinedhash<KEY>);
-    HashMap          (const HashMap<KEY,T,thash>& to_copy, double the_load_threshold = 1.0, int (*chash)(const KEY& a) = undefinedhash<KEY>);
-    explicit HashMap (const std::initializer_list<Entry>& il, double the_load_threshold = 1.0, int (*chash)(const KEY& a) = undefinedhash<KEY>);
+    HashMap          (double the_load_threshold = 1.0, hashfunc chash = undefinedhash<KEY>);
+    explicit HashMap (int initial_bins, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<KEY>);
+    HashMap          (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& to_copy, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<KEY>);
+    HashMap          (HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>&& to_move) noexcept;  //to_move is left with no bins (allocated when next needed)
+    explicit HashMap (const std::initializer_list<Entry>& il, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<KEY>);
 
     //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
     template <class Iterable>
-    explicit HashMap (const Iterable& i, double the_load_threshold = 1.0, int (*chash)(const KEY& a) = undefinedhash<KEY>);
+    explicit HashMap (const Iterable& i, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<KEY>);
 
 
     //Queries
     bool empty      () const;
-    int  size       () const;
+    std::int64_t size () const;
     bool has_key    (const KEY& key) const;
     bool has_value  (const T& value) const;
     std::string str () const; //supplies useful debugging information; contrast to operator <<
+    HashStatistics statistics () const; //chain lengths, collisions, (with HashCounters) probes/resizes
+
+    //Heterogeneous lookup: probe is any type comparable (key == probe) to KEY, with phash(probe) ==
+    //  hash(key) when they are equal (e.g., std::string_view probing std::string keys: nothing is built)
+    template<class Probe, class Code> bool     has_key (const Probe& probe, Code (*phash)(const Probe& p)) const;
+    template<class Probe, class Code> const T& get     (const Probe& probe, Code (*phash)(const Probe& p)) const; //KeyError if absent
+
+    //Batched lookup of keys[0..n-1]: hashes a batch of keys and prefetches their bins before
+    //  searching any list, so the cache misses of independent probes overlap; both return # found
+    std::int64_t contains_many (const KEY* keys, std::int64_t n, bool* found)      const;  //found[i]  = has_key(keys[i])
+    std::int64_t get_many      (const KEY* keys, std::int64_t n, const T** values) const;  //values[i] = &(*this)[keys[i]] or nullptr
+
+    //Write an image of the map (see hash_image.hpp) that MappedHashMap (mapped_hash_map.hpp) can
+    //  search in place; KEY and T must each be std::string or trivially copyable
+    void write_image (std::ostream& out) const;
 
 
     //Commands
     T    put   (const KEY& key, const T& value);
+    T    put   (KEY&& key, T&& value);    //moves key/value in; copies value only when returning it for a new key
     T    erase (const KEY& key);
     void clear ();
 
+    //If key is not in the map, add it with the value T(args...) constructed in its node and return 1;
+    //  otherwise return 0 (leaving args untouched). Unlike put, no T is copied or returned.
+    template<class... Args>
+    int try_emplace (const KEY& key, Args&&... args);
+    template<class... Args>
+    int try_emplace (KEY&& key, Args&&... args);
+
+    //Construct Entry(args...) in a node and add it, returning 1, unless its key is already in the map: return 0
+    template<class... Args>
+    int emplace (Args&&... args);
+
+    //0 (the default): a resize rehashes every bin at once. Otherwise a resize allocates the new bins
+    //  and each later put/erase/operator[] insertion moves bins_per_op old bins into them, so no single
+    //  call pays for the whole O(N) rehash. bins_per_op >= 1/load_threshold ensures each resize
+    //  completes before the next starts (else the next one finishes it at once).
+    void set_rehash_step (int bins_per_op);
+
+    //Sizing: bins are always a power of 2. reserve(n) grows the bins (never shrinks them) so n keys are
+    //  within load_threshold: put_all of n keys after reserve(n) never resizes. rehash(at_least_bins)
+    //  resizes, up or down, to at least at_least_bins bins and at least enough bins for size() keys;
+    //  shrink_to_fit() is rehash(0). Each relinks every node at once (finishing any incremental rehash).
+    void reserve       (std::int64_t n);
+    void rehash        (std::int64_t at_least_bins);
+    void shrink_to_fit ();
+
+    //0 (the default): the bins never shrink on their own. Otherwise erase(key) calls shrink_to_fit once
+    //  size()/bins falls below low_water, and clear() shrinks to 1 bin, so iteration and clear stop
+    //  walking the empty bins left by mass erases. low_water is clamped to at most load_threshold/4, so
+    //  a map that just shrank (or grew) is not resized again by the next few put/erase calls.
+    //Iterator::erase never shrinks (it would move the nodes being iterated over): call shrink_to_fit after.
+    void set_shrink_threshold (double low_water);
+
+    //Restart the counts that statistics() reports (with HashCounters)
+    void reset_statistics ();
+
     //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
     template <class Iterable>
-    int put_all(const Iterable& i);
+    std::int64_t put_all(const Iterable& i);
 
 
     //Operators
 
     T&       operator [] (const KEY&);
+    T&       operator [] (KEY&&);
     const T& operator [] (const KEY&) const;
-    HashMap<KEY,T,thash>& operator = (const HashMap<KEY,T,thash>& rhs);
-    bool operator == (const HashMap<KEY,T,thash>& rhs) const;
-    bool operator != (const HashMap<KEY,T,thash>& rhs) const;
+    HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& operator = (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& rhs);
+    HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& operator = (HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>&& rhs) noexcept;  //Takes rhs's hash/load_threshold too
+    bool operator == (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& rhs) const;
+    bool operator != (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& rhs) const;
 
-    template<class KEY2,class T2, int (*hash2)(const KEY2& a)>
-    friend std::ostream& operator << (std::ostream& outs, const HashMap<KEY2,T2,hash2>& m);
+    template<class KEY2,class T2, auto hash2, class NodeAllocator2, class HashCache2, class Counters2, class Iteration2>
+    friend std::ostream& operator << (std::ostream& outs, const HashMap<KEY2,T2,hash2,NodeAllocator2,HashCache2,Counters2,Iteration2>& m);
 
 
 
@@ -79,29 +183,29 @@ template<class KEY,class T, int (*thash)(const KEY& a) = undefinedhash<KEY>> cla
   public:
     class Iterator {
       public:
-         typedef pair<int,LN*> Cursor;
+         typedef pair<std::int64_t,LN*> Cursor;
 
         //Private constructor called in begin/end, which are friends of HashMap<T>
         ~Iterator();
         Entry       erase();
         std::string str  () const;
-        HashMap<KEY,T,thash>::Iterator& operator ++ ();
-        HashMap<KEY,T,thash>::Iterator  operator ++ (int);
-        bool operator == (const HashMap<KEY,T,thash>::Iterator& rhs) const;
-        bool operator != (const HashMap<KEY,T,thash>::Iterator& rhs) const;
+        HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& operator ++ ();
+        HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator  operator ++ (int);
+        bool operator == (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& rhs) const;
+        bool operator != (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& rhs) const;
         Entry& operator *  () const;
         Entry* operator -> () const;
-        friend std::ostream& operator << (std::ostream& outs, const HashMap<KEY,T,thash>::Iterator& i) {
+        friend std::ostream& operator << (std::ostream& outs, const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& i) {
           outs << i.str(); //Use the same meaning as the debugging .str() method
           return outs;
         }
-        friend Iterator HashMap<KEY,T,thash>::begin () const;
-        friend Iterator HashMap<KEY,T,thash>::end   () const;
+        friend Iterator HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::begin () const;
+        friend Iterator HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::end   () const;
 
       private:
         //If can_erase is false, current indexes the "next" value (must ++ to reach it)
         Cursor                current; //Bin Index and Cursor; stops if LN* == nullptr
-        HashMap<KEY,T,thash>* ref_map;
+        HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>* ref_map;
         int                   expected_mod_count;
         bool                  can_erase = true;
 
@@ -109,41 +213,81 @@ template<class KEY,class T, int (*thash)(const KEY& a) = undefinedhash<KEY>> cla
         void advance_cursors();
 
         //Called in friends begin/end
-        Iterator(HashMap<KEY,T,thash>* iterate_over, bool from_begin);
+        Iterator(HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>* iterate_over, bool from_begin);
     };
 
 
     Iterator begin () const;
     Iterator end   () const;
 
+    //Internal iteration: visit(entry) for each entry (as a const Entry&), walking the bins without an Iterator;
+    //  visit must not change the map. With CheckedIteration, mod_count is compared after each visit (before
+    //  moving on), so ConcurrentModificationError is thrown after the visit that changed the map has run;
+    //  with UncheckedIteration the comparison compiles to nothing and such a change is undefined.
+    template<class Visitor>
+    void for_each (Visitor visit) const;
+
 
   private:
-    class LN {
+    class LN : public HashCache {
     public:
-      LN ()                         : next(nullptr){}
-      LN (const LN& ln)             : value(ln.value), next(ln.next){}
-      LN (Entry v, LN* n = nullptr) : value(v), next(n){}
+      LN ()                                : next(nullptr){}
+      LN (const LN& ln)                    : HashCache(ln), value(ln.value), next(ln.next){}
+      LN (const LN& ln, LN* n)             : HashCache(ln), value(ln.value), next(n){}
+      LN (const Entry& v, LN* n = nullptr) : value(v), next(n){}
+      LN (Entry&& v, LN* n = nullptr)      : value(std::move(v)), next(n){}
+      LN (KEY&& k, T&& v, LN* n)           : next(n) {value.first = std::move(k); value.second = std::move(v);} //pair has no moving 2-argument constructor
+
+      //Erasing this node's entry: take n's entry/code/next instead (then n can be deallocated)
+      void take (LN* n) {HashCache::operator = (*n); value = std::move(n->value); next = n->next;}
 
       Entry value;
       LN*   next;
   };
 
-  int (*hash)(const KEY& k);  //Hashing function used (from template or constructor)
+  TemplateFunction<hashfunc,thash,undefinedhash<KEY>> hash;  //Hashing function used (from template or constructor)
   LN** map      = nullptr;    //Pointer to array of pointers: each bin stores a list with a trailer node
   double load_threshold;      //used/bins <= load_threshold
-  int bins      = 1;          //# bins in array (should start >= 1 so hash_compress doesn't % 0)
-  int used      = 0;          //Cache for number of key->value pairs in the hash table
+  std::int64_t bins = 1;      //# bins in array: 2^bits (0 only once moved from)
+  int bits      = 0;
+  std::int64_t used = 0;      //Cache for number of key->value pairs in the hash table
   int mod_count = 0;          //For sensing concurrent modification
+  typename NodeAllocator::template Pool<LN> nodes; //Allocates every LN (trailers too); see node_allocator.hpp
+  Counters counters;          //Not copied or moved: counts the operations on this map
 
+  //Incremental rehashing: while old_map != nullptr, old bin b < migrated has been moved into
+  //  map[2b] and map[2b+1] (bins == 2*old_bins); old bins >= migrated still hold their
+  //  keys (and receive new keys that hash to them) and the map bins they feed are not yet allocated
+  LN** old_map     = nullptr; //Bins being emptied into map during an incremental rehash
+  std::int64_t old_bins = 0;  //# bins in old_map (2^(bits-1))
+  std::int64_t migrated = 0;  //old_map[0..migrated-1] are moved into map
+  int  rehash_step = 0;       //old bins moved per mutating operation; 0 means all at once
+  double shrink_threshold = 0;//erase shrinks the bins when used/bins < shrink_threshold; 0 means never
+  static constexpr std::int64_t scan_ahead = 8;//bins prefetched ahead while scanning past empty bins
 
-  //Helper methods
-  int   hash_compress        (const KEY& key)          const;  //hash function ranged to [0,bins-1]
-  LN*   find_key             (const KEY& key) const;           //Returns reference to key's node or nullptr
-  LN*   copy_list            (LN*   l)                 const;  //Copy the keys/values in a bin (order irrelevant)
-  LN**  copy_hash_table      (LN** ht, int bins)       const;  //Copy the bins/keys/values in ht tree (order in bins irrelevant)
 
-  void  ensure_load_threshold(int new_used);                   //Reallocate if load_factor > load_threshold
-  void  delete_hash_table    (LN**& ht, int bins);             //Deallocate all LN in ht (and the ht itself; ht == nullptr)
+  //Helper methods
+  HashCode     hash_code            (const KEY& key)          const;  //hash function as a HashCode: the code nodes store
+  LN*&         bin_of               (HashCode code)           const;  //The list a key with hash_code code belongs in: in map or (while rehashing) old_map
+  std::int64_t all_bins             ()                        const;  //# bins in map plus, while rehashing, old_map
+  LN*          bin_list             (std::int64_t b)          const;  //b-th list over map then old_map; nullptr if not in use
+  LN*          find_key             (const KEY& key) const;           //Returns reference to key's node or nullptr
+  template<class Probe>
+  LN*          find_key             (const Probe& key, HashCode code) const; //Same, given key's hash_code (or a Probe and its code)
+  LN*          add_node             (KEY&& key, T&& value, HashCode code); //Add key (not in the map; hash_code code) with value; returns its node
+  LN*          copy_list            (LN*   l);                        //Copy the keys/values in a bin (order irrelevant)
+  LN**         copy_hash_table      (LN** ht, std::int64_t bins);     //Copy the bins/keys/values in ht tree (order in bins irrelevant)
+  void         allocate_bins        (std::int64_t at_least);          //map = 2^bits >= at_least bins, each with a trailer
+
+  void         ensure_load_threshold(std::int64_t new_used);          //Reallocate if load_factor > load_threshold
+  void         migrate_bins         (std::int64_t count);             //Move up to count old_map bins into map
+  void         finish_rehash        ();                               //Move all remaining old_map bins into map
+  void         delete_hash_table    (LN**& ht, std::int64_t bins);    //Deallocate all LN in ht (and the ht itself; ht == nullptr)
+  void         delete_all_bins      ();                               //Deallocate map and old_map (mid-rehash too), allocating nothing
+  std::int64_t bins_for             (std::int64_t n)          const;  //# bins holding n keys within load_threshold
+  void         resize_bins          (std::int64_t at_least);          //Relink every node into 2^bits >= at_least bins at once
+  template<class Resolve>
+  std::int64_t probe_many           (const KEY* keys, std::int64_t n, Resolve resolve) const; //For contains/get_many: resolve(i,find_key(keys[i]))
 };
 
 
@@ -156,63 +300,56 @@ template<class KEY,class T, int (*thash)(const KEY& a) = undefinedhash<KEY>> cla
 
 //Destructor/Constructors
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::~HashMap() {
-    delete_hash_table(map, bins);
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::~HashMap() {
+    delete_all_bins();
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::HashMap(double the_load_threshold, int (*chash)(const KEY& k))
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::HashMap(double the_load_threshold, hashfunc chash)
 : hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold) {
   if (hash == (hashfunc)undefinedhash<KEY>)
     throw TemplateFunctionError("HashMap::default constructor: neither specified");
   if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
     throw TemplateFunctionError("HashMap::default constructor: both specified and different");
 
-    map = new LN* [bins];
-    for (auto i = 0; i < bins; i++) {
-        map[i] = new LN();
-    }
+  allocate_bins(1);
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::HashMap(int initial_bins, double the_load_threshold, int (*chash)(const KEY& k))
-        : hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash) {
-    if (hash == (hashfunc)undefinedhash<KEY>)
-        throw TemplateFunctionError("HashMap::default constructor: neither specified");
-    if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
-        throw TemplateFunctionError("HashMap::default constructor: both specified and different");
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::HashMap(int initial_bins, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("HashMap::length constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("HashMap::length constructor: both specified and different");
 
-    bins = initial_bins;
-    map = new LN*[bins];
-    for (auto i = 0; i < bins; i++) {
-        map[i] = new LN();
-    }
+  allocate_bins(initial_bins);
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::HashMap(const HashMap<KEY,T,thash>& to_copy, double the_load_threshold, int (*chash)(const KEY& a))
-: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::HashMap(const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& to_copy, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold) {
     if (hash == (hashfunc)undefinedhash<KEY>)
         hash = to_copy.hash;
     if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
         throw TemplateFunctionError("HashMap::copy constructor: both specified and different");
 
-    if (hash == to_copy.hash) {
+    rehash_step = to_copy.rehash_step;
+    shrink_threshold = to_copy.shrink_threshold;
+    if (hash == to_copy.hash && to_copy.old_map == nullptr) {
         bins = to_copy.bins;
+        bits = to_copy.bits;
         used = to_copy.used;
         map = copy_hash_table(to_copy.map, to_copy.bins);
     } else {
-        bins = to_copy.bins;
-        map = new LN* [bins];
-        for (int i = 0; i < bins; i++)
-            map[i] = new LN();
-        for (int i = 0; i < to_copy.bins; i++) {
-            LN* head = to_copy.map[i];
-            while (head->next) {
+        allocate_bins(to_copy.bins);
+        for (std::int64_t i = 0; i < to_copy.all_bins(); i++) {
+            LN* head = to_copy.bin_list(i);
+            while (head && head->next) {
                 put(head->value.first, head->value.second);
                 head = head->next;
             }
@@ -222,18 +359,31 @@ HashMap<KEY,T,thash>::HashMap(const HashMap<KEY,T,thash>& to_copy, double the_lo
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::HashMap(const std::initializer_list<Entry>& il, double the_load_threshold, int (*chash)(const KEY& k))
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::HashMap(HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>&& to_move) noexcept
+: hash(to_move.hash), map(to_move.map), load_threshold(to_move.load_threshold), bins(to_move.bins), bits(to_move.bits), used(to_move.used),
+  nodes(std::move(to_move.nodes)), old_map(to_move.old_map), old_bins(to_move.old_bins), migrated(to_move.migrated), rehash_step(to_move.rehash_step),
+  shrink_threshold(to_move.shrink_threshold) {
+    to_move.map = nullptr;
+    to_move.bins = 0;
+    to_move.bits = 0;
+    to_move.used = 0;
+    to_move.old_map = nullptr;
+    to_move.old_bins = 0;
+    to_move.migrated = 0;
+    to_move.mod_count++;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::HashMap(const std::initializer_list<Entry>& il, double the_load_threshold, hashfunc chash)
 : hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold) {
     if (hash == (hashfunc)undefinedhash<KEY>)
         throw TemplateFunctionError("HashMap::initializer_list constructor: neither specified");
     if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
         throw TemplateFunctionError("HashMap::initializer_list constructor: both specified and different");
 
-    bins = 1;
-    map = new LN* [bins];
-    for (int i = 0; i < bins; i++)
-        map[i] = new LN();
+    allocate_bins(1);
 
     for (auto i : il) {
         put(i.first, i.second);
@@ -242,19 +392,16 @@ HashMap<KEY,T,thash>::HashMap(const std::initializer_list<Entry>& il, double the
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
 template <class Iterable>
-HashMap<KEY,T,thash>::HashMap(const Iterable& i, double the_load_threshold, int (*chash)(const KEY& k))
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::HashMap(const Iterable& i, double the_load_threshold, hashfunc chash)
 : hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold) {
     if (hash == (hashfunc)undefinedhash<KEY>)
         throw TemplateFunctionError("HashMap::Iterable constructor: neither specified");
     if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
         throw TemplateFunctionError("HashMap::Iterable constructor: both specified and different");
 
-    bins = 1;
-    map = new LN* [bins];
-    for (int i = 0; i < bins; i++)
-        map[i] = new LN();
+    allocate_bins(1);
 
     for (auto j : i) {
         put(j.first, j.second);
@@ -266,29 +413,75 @@ HashMap<KEY,T,thash>::HashMap(const Iterable& i, double the_load_threshold, int
 //
 //Queries
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::empty() const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::empty() const {
     return (used == 0);
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-int HashMap<KEY,T,thash>::size() const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::size() const {
     return used;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::has_key (const KEY& key) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::has_key (const KEY& key) const {
     return find_key(key) != nullptr;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::has_value (const T& value) const {
-    for (int i = 0; i < bins; i++) {
-        auto head = map[i];
-        while (head->next != nullptr) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class Probe, class Code>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::has_key (const Probe& probe, Code (*phash)(const Probe& p)) const {
+    return find_key(probe, to_hash_code(phash(probe))) != nullptr;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class Probe, class Code>
+const T& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::get (const Probe& probe, Code (*phash)(const Probe& p)) const {
+    LN* p = find_key(probe, to_hash_code(phash(probe)));
+    if (p != nullptr)
+        return p->value.second;
+
+    std::ostringstream answer;
+    answer << "HashMap::get: key(" << probe << ") not in Map";
+    throw KeyError(answer.str());
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::contains_many (const KEY* keys, std::int64_t n, bool* found) const {
+    return probe_many(keys, n, [found] (std::int64_t i, LN* p) {found[i] = p != nullptr;});
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::get_many (const KEY* keys, std::int64_t n, const T** values) const {
+    return probe_many(keys, n, [values] (std::int64_t i, LN* p) {values[i] = p ? &p->value.second : nullptr;});
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::write_image (std::ostream& out) const {
+    HashImageWriter<KEY,T> image(true);
+    for (std::int64_t i = 0; i < all_bins(); i++) {
+        auto p = bin_list(i);
+        while (p != nullptr && p->next != nullptr) {
+            image.add(p->code(p->value.first, hash), p->value.first, &p->value.second);
+            p = p->next;
+        }
+    }
+    image.write(out, bins);
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::has_value (const T& value) const {
+    for (std::int64_t i = 0; i < all_bins(); i++) {
+        auto head = bin_list(i);
+        while (head != nullptr && head->next != nullptr) {
             if (head->value.second == value) {
                 return true;
             } else {
@@ -299,59 +492,105 @@ bool HashMap<KEY,T,thash>::has_value (const T& value) const {
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-std::string HashMap<KEY,T,thash>::str() const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::string HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::str() const {
     std::ostringstream answer;
     answer << "HashMap\n";
 
     if(used) {
-        for (int i = 0; i < bins; i++) {
-            answer<<"Bin:["<<i<<"] ";
-            auto p = map[i];
+        for (std::int64_t i = 0; i < all_bins(); i++) {
+            if (i < bins)
+                answer<<"Bin:["<<i<<"] ";
+            else
+                answer<<"Old Bin:["<<i-bins<<"] ";
+            auto p = bin_list(i);
+            if (!p) {
+                answer<<"(not in use)\n";
+                continue;
+            }
             while(p->next) {
                 answer<<p->value<<"->";
                 p=p->next;
             }
-            if(i != bins -1)
+            if(i != all_bins() -1)
                 answer<<"TRAILER\n";
         }
     }
-    answer << "TRAILER](used=" << used << ",bins= "<<bins<<",mod_count=" << mod_count << ")";
+    answer << "TRAILER](used=" << used << ",bins= "<<bins<<",mod_count=" << mod_count;
+    if (old_map)
+        answer << ",old_bins=" << old_bins << ",migrated=" << migrated;
+    answer << ")";
     return answer.str();
 }
 
 
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashStatistics HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::statistics () const {
+    HashStatistics answer;
+    std::vector<HashCode> codes;
+    codes.reserve(used);
+    for (std::int64_t i = 0; i < all_bins(); i++) {
+        auto p = bin_list(i);
+        if (p == nullptr)
+            continue;
+        std::int64_t length = 0;
+        while (p->next != nullptr) {
+            codes.push_back(p->code(p->value.first, hash));
+            length++;
+            p = p->next;
+        }
+        answer.count_chain(length);
+    }
+    answer.count_codes(codes);
+    counters.report(answer);
+    return answer;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 //Commands
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-T HashMap<KEY,T,thash>::put(const KEY& key, const T& value) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+T HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::put(const KEY& key, const T& value) {
     mod_count++;
-    auto p = find_key(key);
+    HashCode code = hash_code(key);
+    auto p = find_key(key, code);
     if (p != nullptr) {
         auto v = p->value.second;
         p->value.second = value;
+        migrate_bins(rehash_step);
         return v;
     } else {
         used++;
         ensure_load_threshold(used+1);
-        int index = hash_compress(key);
-        LN* head = map[index];
-        while (head->next != nullptr) {
-            head = head->next;
-        }
-        head->next = new LN();
-        head->value.first = key;
-        head->value.second = value;
+        LN*& head = bin_of(code);         //bins may have changed in ensure_load_threshold
+        head = nodes.create(Entry(key,value), head);
+        head->set_code(code);
+        migrate_bins(rehash_step);
         return value;
     }
 
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-T HashMap<KEY,T,thash>::erase(const KEY& key) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+T HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::put(KEY&& key, T&& value) {
+    HashCode code = hash_code(key);
+    auto p = find_key(key, code);
+    if (p != nullptr) {
+        mod_count++;
+        std::swap(p->value.second, value);      //value now holds the old value, to return
+        migrate_bins(rehash_step);
+    } else {
+        add_node(std::move(key), T(value), code);
+    }
+    return std::move(value);
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+T HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::erase(const KEY& key) {
     LN *p = find_key(key);
     if (p == nullptr) {
         std::ostringstream answer;
@@ -359,46 +598,41 @@ T HashMap<KEY,T,thash>::erase(const KEY& key) {
         throw KeyError(answer.str());
     }
 
-    int index = hash_compress(key);
-    LN* head = map[index];
-
-    while (head->next != nullptr) {
-        if (head->value.first == key) {
-            used--;
-            mod_count++;
-            auto value = head->value.second;
-            head->value.first = head->next->value.first;
-            head->value.second = head->next->value.second;
-            auto del = head->next;
-            head->next = head->next->next;
-            delete del;
-            return value;
-        } else {
-            head = head->next;
-        }
-    }
+    used--;
+    mod_count++;
+    auto value = std::move(p->value.second);
+    auto del = p->next;
+    p->take(del);
+    nodes.destroy(del);
+    migrate_bins(rehash_step);      //after p is unlinked: migration relinks nodes
+    if (used < shrink_threshold*bins)
+        shrink_to_fit();
+    return value;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-void HashMap<KEY,T,thash>::clear() {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::clear() {
+    finish_rehash();
     used = 0;
     mod_count++;
-    for (int i = 0; i < bins; i++) {
+    for (std::int64_t i = 0; i < bins; i++) {
         auto head = map[i];
         while (head->next) {
             auto del = head;
             head = head->next;
-            delete del;
+            nodes.destroy(del);
         } map[i] = head;
     }
+    if (shrink_threshold > 0)
+        shrink_to_fit();
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
 template<class Iterable>
-int HashMap<KEY,T,thash>::put_all(const Iterable& i) {
-    int count = 0;
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::put_all(const Iterable& i) {
+    std::int64_t count = 0;
     for (auto j : i) {
         put(j.first, j.second);
         count++;
@@ -406,33 +640,129 @@ int HashMap<KEY,T,thash>::put_all(const Iterable& i) {
 }
 
 
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class... Args>
+int HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::try_emplace(const KEY& key, Args&&... args) {
+    HashCode code = hash_code(key);
+    if (find_key(key, code) != nullptr) {
+        return 0;
+    }
+    add_node(KEY(key), T(std::forward<Args>(args)...), code);
+    return 1;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class... Args>
+int HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::try_emplace(KEY&& key, Args&&... args) {
+    HashCode code = hash_code(key);
+    if (find_key(key, code) != nullptr) {
+        return 0;
+    }
+    add_node(std::move(key), T(std::forward<Args>(args)...), code);
+    return 1;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class... Args>
+int HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::emplace(Args&&... args) {
+    LN* p = nodes.create(Entry(std::forward<Args>(args)...));
+    HashCode code = hash_code(p->value.first);
+    if (find_key(p->value.first, code) != nullptr) {
+        nodes.destroy(p);
+        return 0;
+    }
+    p->set_code(code);
+    ensure_load_threshold(used+1);
+    used++;
+    mod_count++;
+    LN*& head = bin_of(code);               //bins may have changed in ensure_load_threshold
+    p->next = head;
+    head = p;
+    migrate_bins(rehash_step);
+    return 1;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::reset_statistics () {
+    counters.reset();
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::set_rehash_step(int bins_per_op) {
+    rehash_step = bins_per_op < 0 ? 0 : bins_per_op;
+    if (rehash_step == 0 && old_map) {
+        finish_rehash();
+        mod_count++;    //nodes moved between bins
+    }
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::reserve(std::int64_t n) {
+    if (bins_for(n) > bins)
+        resize_bins(bins_for(n));
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::rehash(std::int64_t at_least_bins) {
+    resize_bins(at_least_bins > bins_for(used) ? at_least_bins : bins_for(used));
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::shrink_to_fit() {
+    rehash(0);
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::set_shrink_threshold(double low_water) {
+    shrink_threshold = low_water < 0 ? 0 : low_water > load_threshold/4 ? load_threshold/4 : low_water;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 //Operators
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-T& HashMap<KEY,T,thash>::operator [] (const KEY& key) {
-    auto p = find_key(key);
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+T& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator [] (const KEY& key) {
+    HashCode code = hash_code(key);
+    auto p = find_key(key, code);
     if (p != nullptr) {
         return p->value.second;
     } else {
         ensure_load_threshold(used+1);
+        migrate_bins(rehash_step);    //not on a hit (above): a hit does not change mod_count
         used++;
         mod_count++;
-        int index = hash_compress(key);
-        LN* head = map[index];
-        while (head->next != nullptr) {
-            head = head->next;
-        }
-        head->next = new LN();
-        head->value = Entry(key, T());
+        LN*& head = bin_of(code);
+        head = nodes.create(Entry(key, T()), head);
+        head->set_code(code);
         return head->value.second;
     }
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-const T& HashMap<KEY,T,thash>::operator [] (const KEY& key) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+T& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator [] (KEY&& key) {
+    HashCode code = hash_code(key);
+    auto p = find_key(key, code);
+    if (p != nullptr) {
+        return p->value.second;
+    } else {
+        return add_node(std::move(key), T(), code)->value.second;
+    }
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+const T& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator [] (const KEY& key) const {
     LN* p = find_key(key);
     if (p != nullptr)
         return p->value.second;
@@ -443,16 +773,16 @@ const T& HashMap<KEY,T,thash>::operator [] (const KEY& key) const {
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>& HashMap<KEY,T,thash>::operator = (const HashMap<KEY,T,thash>& rhs) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator = (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& rhs) {
     if (this == &rhs) {
         return *this;
     }
 
     clear();
-    for (auto i = 0; i < rhs.bins; i++) {
-        auto head = rhs.map[i];
-        while (head->next != nullptr) {
+    for (std::int64_t i = 0; i < rhs.all_bins(); i++) {
+        auto head = rhs.bin_list(i);
+        while (head != nullptr && head->next != nullptr) {
             put(head->value.first, head->value.second);
             head = head->next;
         }
@@ -462,16 +792,49 @@ HashMap<KEY,T,thash>& HashMap<KEY,T,thash>::operator = (const HashMap<KEY,T,thas
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::operator == (const HashMap<KEY,T,thash>& rhs) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator = (HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>&& rhs) noexcept {
+    if (this == &rhs) {
+        return *this;
+    }
+
+    delete_all_bins();
+    nodes = std::move(rhs.nodes);   //every node of this was just destroyed
+    hash = rhs.hash;
+    map = rhs.map;
+    load_threshold = rhs.load_threshold;
+    bins = rhs.bins;
+    bits = rhs.bits;
+    used = rhs.used;
+    old_map = rhs.old_map;
+    old_bins = rhs.old_bins;
+    migrated = rhs.migrated;
+    rehash_step = rhs.rehash_step;
+    shrink_threshold = rhs.shrink_threshold;
+
+    rhs.map = nullptr;
+    rhs.bins = 0;
+    rhs.bits = 0;
+    rhs.used = 0;
+    rhs.old_map = nullptr;
+    rhs.old_bins = 0;
+    rhs.migrated = 0;
+    rhs.mod_count++;
+    mod_count++;
+    return *this;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator == (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& rhs) const {
     if (this == &rhs) {
         return true;
     } else if (used != rhs.used) {
         return false;
     }
-    for (int i = 0; i < bins; i++) {
-        LN* head = this->map[i];
-        while (head->next != nullptr) {
+    for (std::int64_t i = 0; i < all_bins(); i++) {
+        LN* head = bin_list(i);
+        while (head != nullptr && head->next != nullptr) {
             if (!rhs.has_key(head->value.first) || !rhs.has_value(head->value.second)) {
                 return false;
             }else {
@@ -482,18 +845,18 @@ bool HashMap<KEY,T,thash>::operator == (const HashMap<KEY,T,thash>& rhs) const {
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::operator != (const HashMap<KEY,T,thash>& rhs) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator != (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& rhs) const {
     return !(*this == rhs);
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-std::ostream& operator << (std::ostream& outs, const HashMap<KEY,T,thash>& m) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::ostream& operator << (std::ostream& outs, const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& m) {
     outs << "map[";
-    for (auto i = 0; i < m.bins; i++) {
-        auto head = m.map[i];
-        while (head->next != nullptr) {
+    for (std::int64_t i = 0; i < m.all_bins(); i++) {
+        auto head = m.bin_list(i);
+        while (head != nullptr && head->next != nullptr) {
             outs << head->value.first << "->" << head->value.second;
             head = head->next;
         }
@@ -506,15 +869,32 @@ std::ostream& operator << (std::ostream& outs, const HashMap<KEY,T,thash>& m) {
 //
 //Iterator constructors
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-auto HashMap<KEY,T,thash>::begin () const -> HashMap<KEY,T,thash>::Iterator {
-    return Iterator(const_cast<HashMap<KEY, T, thash>*>(this),true);
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+auto HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::begin () const -> HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator {
+    return Iterator(const_cast<HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>*>(this),true);
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-auto HashMap<KEY,T,thash>::end () const -> HashMap<KEY,T,thash>::Iterator {
-    return Iterator(const_cast<HashMap<KEY, T, thash>*>(this),false);
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+auto HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::end () const -> HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator {
+    return Iterator(const_cast<HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>*>(this),false);
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class Visitor>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::for_each (Visitor visit) const {
+    int expected_mod_count = mod_count;
+    std::int64_t all = all_bins();
+    for (std::int64_t b = 0; b < all; b++) {
+        if (!old_map && b + scan_ahead < all)
+            ICS_PREFETCH(map[b + scan_ahead]);
+        for (LN* p = bin_list(b); p && p->next; p = p->next) {
+            visit(const_cast<const Entry&>(p->value));
+            if (Iteration::modified(expected_mod_count,mod_count))
+                throw ConcurrentModificationError("HashMap::for_each");
+        }
+    }
 }
 
 
@@ -522,35 +902,88 @@ auto HashMap<KEY,T,thash>::end () const -> HashMap<KEY,T,thash>::Iterator {
 //
 //Private helper methods
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-int HashMap<KEY,T,thash>::hash_compress (const KEY& key) const {
-    int index = hash(key);
-    return (abs(index) % bins);
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashCode HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::hash_code (const KEY& key) const {
+    return to_hash_code(hash(key));
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN*& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::bin_of (HashCode code) const {
+    if (old_map) {
+        auto b = bin_index(code, bits-1);
+        if (b >= migrated)
+            return old_map[b];
+    }
+    return map[bin_index(code, bits)];
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::all_bins () const {
+    return old_map ? bins + old_bins : bins;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN* HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::bin_list (std::int64_t i) const {
+    if (!old_map)
+        return map[i];
+    if (i < bins)
+        return i/2 < migrated ? map[i] : nullptr;
+    return i - bins >= migrated ? old_map[i - bins] : nullptr;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN* HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::find_key (const KEY& key) const {
+    return find_key(key, hash_code(key));
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-typename HashMap<KEY,T,thash>::LN* HashMap<KEY,T,thash>::find_key (const KEY& key) const {
-    int index = hash_compress(key);
-    LN *head = map[index];
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class Probe>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN* HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::find_key (const Probe& key, HashCode code) const {
+    if (bins == 0) {
+        return nullptr;
+    }
+    LN *head = bin_of(code);
+    int probes = 0;
     while (head->next != nullptr) {
-        if (head->value.first == key) {
+        probes++;
+        if (head->may_match(code) && head->value.first == key) {   //CacheHash: codes first
+            counters.lookup(true, probes);
             return head;
         } else {
             head = head->next;
         }
     }
+    counters.lookup(false, probes);
     return nullptr;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-typename HashMap<KEY,T,thash>::LN* HashMap<KEY,T,thash>::copy_list (LN* l) const {
-    LN* head = new LN(l->value);
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN* HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::add_node (KEY&& key, T&& value, HashCode code) {
+    ensure_load_threshold(used+1);
+    used++;
+    mod_count++;
+    LN*& head = bin_of(code);               //bins may have changed in ensure_load_threshold
+    LN* p = nodes.create(std::move(key), std::move(value), head);
+    p->set_code(code);
+    head = p;
+    migrate_bins(rehash_step);              //relinks p (and may deallocate the array head is in)
+    return p;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN* HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::copy_list (LN* l) {
+    LN* head = nodes.create(*l, nullptr);
     LN* runner = head;
     l = l->next;
     while (l) {
-        runner->next = new LN(l->value);
+        runner->next = nodes.create(*l, nullptr);
         runner = runner->next;
         l = l->next;
     }
@@ -559,55 +992,189 @@ typename HashMap<KEY,T,thash>::LN* HashMap<KEY,T,thash>::copy_list (LN* l) const
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-typename HashMap<KEY,T,thash>::LN** HashMap<KEY,T,thash>::copy_hash_table (LN** ht, int bins) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN** HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::copy_hash_table (LN** ht, std::int64_t bins) {
     LN** hashMap = new LN* [bins];
-    for (int i = 0; i < bins; i++) {
+    for (std::int64_t i = 0; i < bins; i++) {
         hashMap[i] = copy_list(ht[i]);
     } return hashMap;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-void HashMap<KEY,T,thash>::ensure_load_threshold(int new_used) {
-    if(new_used/bins > load_threshold) {
-        int b = bins;
-        bins*=2;
-        LN** new_map = map;
-        map = new LN*[bins];
-        for(int i = 0; i < bins; i ++) {
-            map[i] = new LN();
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::allocate_bins(std::int64_t at_least) {
+    bits = bin_bits(at_least);
+    bins = std::int64_t(1) << bits;
+    map = new LN*[bins];
+    nodes.reserve(bins);
+    for (std::int64_t i = 0; i < bins; i++)
+        map[i] = nodes.create();
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::ensure_load_threshold(std::int64_t new_used) {
+    if (bins == 0) {        //moved from (or copied from a moved-from map): start again with one bin
+        delete[] map;
+        allocate_bins(1);
+    }
+    if (double(new_used)/double(bins) <= load_threshold)
+        return;
+
+    counters.resized();
+    typename Counters::Timer timing(counters);
+    finish_rehash();    //the previous resize is still moving bins
+    old_map = map;
+    old_bins = bins;
+    migrated = 0;
+    bins*=2;
+    bits++;
+    map = new LN*[bins];    //trailers allocated as each old bin is moved into map
+
+    if (rehash_step == 0) {
+        nodes.reserve(bins);
+        finish_rehash();
+    }
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::migrate_bins(std::int64_t count) {
+    if (!old_map || count <= 0)
+        return;
+
+    typename Counters::Timer timing(counters);
+    while (old_map && count-- > 0) {
+        //Keys in old bin i go to map[2i] or map[2i+1]
+        auto i = migrated++;
+        map[2*i] = nodes.create();
+        map[2*i+1] = nodes.create();
+        //Relink each old node at the front of its new bin: no copying, no walk to the trailer
+        auto p = old_map[i];
+        while (p->next) {
+            auto index = bin_index(p->code(p->value.first, hash), bits);    //CacheHash: hash is not called
+            auto to_move = p;
+            p = p->next;
+            to_move->next = map[index];
+            map[index] = to_move;
         }
-        for(int i = 0 ; i < b;i++) {
-            auto p = new_map[i];
-            while (p->next) {
-                int index = hash_compress(p->value.first);
-                auto head = map[index];
-                while (head->next) {
-                    head = head->next;
-                }
-                head->value.first = p->value.first;
-                head->value.second = p->value.second;
-                head->next = new LN();
-                p = p->next;
-            }
+        nodes.destroy(p);   //old trailer
+
+        if (migrated == old_bins) {
+            delete[] old_map;
+            old_map = nullptr;
+            old_bins = 0;
+            migrated = 0;
         }
-        delete new_map;
     }
-    else return;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-void HashMap<KEY,T,thash>::delete_hash_table (LN**& ht, int bins) {
-    for (int i = 0; i < bins; i++) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::finish_rehash() {
+    if (old_map)
+        migrate_bins(old_bins - migrated);
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::bins_for(std::int64_t n) const {
+    auto b = std::int64_t(n/load_threshold);
+    return b*load_threshold < n ? b+1 : b;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::resize_bins(std::int64_t at_least) {
+    if (bins == 0) {        //moved from: nothing to relink
+        delete[] map;
+        allocate_bins(at_least);
+        return;
+    }
+    if (old_map) {
+        finish_rehash();
+        mod_count++;    //nodes moved between bins, even if no resize follows
+    }
+    if (bins == std::int64_t(1) << bin_bits(at_least))
+        return;
+
+    counters.resized();
+    typename Counters::Timer timing(counters);
+    auto b = bins;
+    LN** old = map;
+    allocate_bins(at_least);
+    //Relink each old node at the front of its new bin, as migrate_bins does
+    for (std::int64_t i = 0; i < b; i++) {
+        auto p = old[i];
+        while (p->next) {
+            auto index = bin_index(p->code(p->value.first, hash), bits);    //CacheHash: hash is not called
+            auto to_move = p;
+            p = p->next;
+            to_move->next = map[index];
+            map[index] = to_move;
+        }
+        nodes.destroy(p);   //old trailer
+    }
+    delete[] old;
+    mod_count++;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::delete_hash_table (LN**& ht, std::int64_t bins) {
+    for (std::int64_t i = 0; i < bins; i++) {
         LN* head = ht[i];
-        while (head->next) {
+        while (head) {
             auto del = head;
             head = head->next;
-            delete head;
+            nodes.destroy(del);
         }
-    } delete ht;
+    } delete[] ht;
+    ht = nullptr;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::delete_all_bins () {
+    for (std::int64_t i = 0; i < all_bins(); i++) {
+        LN* head = bin_list(i);
+        while (head) {
+            auto del = head;
+            head = head->next;
+            nodes.destroy(del);
+        }
+    }
+    delete[] map;
+    delete[] old_map;
+    map = nullptr;
+    old_map = nullptr;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class Resolve>
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::probe_many (const KEY* keys, std::int64_t n, Resolve resolve) const {
+    const int batch = 16;                   //probes in flight at once
+    HashCode codes[batch];
+    std::int64_t found = 0;
+    for (std::int64_t first = 0; first < n; first += batch) {
+        int count = n - first < batch ? int(n - first) : batch;
+        for (int i = 0; i < count; i++)
+            codes[i] = hash_code(keys[first+i]);
+        if (bins != 0) {
+            for (int i = 0; i < count; i++)     //the bins' pointers...
+                ICS_PREFETCH(&bin_of(codes[i]));
+            for (int i = 0; i < count; i++)     //...then the lists' first nodes
+                ICS_PREFETCH(bin_of(codes[i]));
+        }
+        for (int i = 0; i < count; i++) {
+            LN* p = find_key(keys[first+i], codes[i]);
+            if (p)
+                found++;
+            resolve(first+i, p);
+        }
+    }
+    return found;
 }
 
 
@@ -618,31 +1185,30 @@ void HashMap<KEY,T,thash>::delete_hash_table (LN**& ht, int bins) {
 //
 //Iterator class definitions
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-void HashMap<KEY,T,thash>::Iterator::advance_cursors(){
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::advance_cursors(){
     if (current.second && current.second->next && current.second->next->next) {
         current.second = current.second->next;
     } else {
-        int i = current.first+1;
-        bool found = false;
-        while (i < ref_map->bins) {
-            if (ref_map->map[i]->next) {
-                found = true;
+        std::int64_t all = ref_map->all_bins();
+        for (std::int64_t i = current.first+1; i < all; i++) {
+            if (!ref_map->old_map && i + scan_ahead < all)
+                ICS_PREFETCH(ref_map->map[i + scan_ahead]);   //the trailer of a bin ahead: empty bins cost a miss each
+            LN* head = ref_map->bin_list(i);
+            if (head && head->next) {
                 current.first = i;
-                current.second = ref_map->map[i];
+                current.second = head;
                 return;
-            } i++;
-        }
-        if (!found) {
-            current.first = -1;
-            current.second = nullptr;
+            }
         }
+        current.first = -1;
+        current.second = nullptr;
     }
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::Iterator::Iterator(HashMap<KEY,T,thash>* iterate_over, bool from_begin)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::Iterator(HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>* iterate_over, bool from_begin)
 : ref_map(iterate_over), expected_mod_count(ref_map->mod_count) {
     current.first = -1;
     current.second = nullptr;
@@ -652,14 +1218,14 @@ HashMap<KEY,T,thash>::Iterator::Iterator(HashMap<KEY,T,thash>* iterate_over, boo
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::Iterator::~Iterator()
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::~Iterator()
 {}
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-auto HashMap<KEY,T,thash>::Iterator::erase() -> Entry {
-    if (expected_mod_count != ref_map->mod_count)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+auto HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::erase() -> Entry {
+    if (Iteration::modified(expected_mod_count,ref_map->mod_count))
         throw ConcurrentModificationError("HashMap::Iterator::erase");
     if (!can_erase)
         throw CannotEraseError("HashMap::Iterator::erase Iterator cursor already erased");
@@ -667,12 +1233,10 @@ auto HashMap<KEY,T,thash>::Iterator::erase() -> Entry {
         throw CannotEraseError("HashMap::Iterator::erase Iterator cursor beyond data structure");
 
     can_erase = false;
-    auto to_return = current.second->value;
+    auto to_return = std::move(current.second->value);
     LN* del = current.second->next;
-    current.second->value.first = current.second->next->value.first;
-    current.second->value.second = current.second->next->value.second;
-    current.second->next = current.second->next->next;
-    delete del;
+    current.second->take(del);
+    ref_map->nodes.destroy(del);
 
     ref_map->mod_count++;
     ref_map->used--;
@@ -682,16 +1246,16 @@ auto HashMap<KEY,T,thash>::Iterator::erase() -> Entry {
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-std::string HashMap<KEY,T,thash>::Iterator::str() const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::string HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::str() const {
   std::ostringstream answer;
   answer << current.second << "/expected_mod_count=" << expected_mod_count << "/can_erase=" << can_erase;
   return answer.str();
 }
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-auto  HashMap<KEY,T,thash>::Iterator::operator ++ () -> HashMap<KEY,T,thash>::Iterator& {
-    if (expected_mod_count != ref_map->mod_count)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+auto  HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::operator ++ () -> HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& {
+    if (Iteration::modified(expected_mod_count,ref_map->mod_count))
         throw ConcurrentModificationError("HashMap::Iterator::operator ++");
 
     if (!current.second)
@@ -706,9 +1270,9 @@ auto  HashMap<KEY,T,thash>::Iterator::operator ++ () -> HashMap<KEY,T,thash>::It
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-auto  HashMap<KEY,T,thash>::Iterator::operator ++ (int) -> HashMap<KEY,T,thash>::Iterator {
-    if (expected_mod_count != ref_map->mod_count)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+auto  HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::operator ++ (int) -> HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator {
+    if (Iteration::modified(expected_mod_count,ref_map->mod_count))
         throw ConcurrentModificationError("HashMap::Iterator::operator ++(int)");
 
     if (!current.second)
@@ -724,12 +1288,12 @@ auto  HashMap<KEY,T,thash>::Iterator::operator ++ (int) -> HashMap<KEY,T,thash>:
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::Iterator::operator == (const HashMap<KEY,T,thash>::Iterator& rhs) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::operator == (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& rhs) const {
     const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
     if (rhsASI == 0)
         throw IteratorTypeError("HashMap::Iterator::operator ==");
-    if (expected_mod_count != ref_map->mod_count)
+    if (Iteration::modified(expected_mod_count,ref_map->mod_count))
         throw ConcurrentModificationError("HashMap::Iterator::operator ==");
     if (ref_map != rhsASI->ref_map)
         throw ComparingDifferentIteratorsError("HashMap::Iterator::operator ==");
@@ -738,12 +1302,12 @@ bool HashMap<KEY,T,thash>::Iterator::operator == (const HashMap<KEY,T,thash>::It
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::Iterator::operator != (const HashMap<KEY,T,thash>::Iterator& rhs) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::operator != (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& rhs) const {
   const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
   if (rhsASI == 0)
     throw IteratorTypeError("HashMap::Iterator::operator !=");
-  if (expected_mod_count != ref_map->mod_count)
+  if (Iteration::modified(expected_mod_count,ref_map->mod_count))
     throw ConcurrentModificationError("HashMap::Iterator::operator !=");
   if (ref_map != rhsASI->ref_map)
     throw ComparingDifferentIteratorsError("HashMap::Iterator::operator !=");
@@ -752,9 +1316,9 @@ bool HashMap<KEY,T,thash>::Iterator::operator != (const HashMap<KEY,T,thash>::It
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-pair<KEY,T>& HashMap<KEY,T,thash>::Iterator::operator *() const {
-    if (expected_mod_count != ref_map->mod_count)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+pair<KEY,T>& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::operator *() const {
+    if (Iteration::modified(expected_mod_count,ref_map->mod_count))
         throw ConcurrentModificationError("HashMap::Iterator::operator *");
     if (!can_erase || !current.second)
         throw IteratorPositionIllegal("HashMap::Iterator::operator * Iterator illegal");
@@ -763,9 +1327,9 @@ pair<KEY,T>& HashMap<KEY,T,thash>::Iterator::operator *() const {
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-pair<KEY,T>* HashMap<KEY,T,thash>::Iterator::operator ->() const {
-  if (expected_mod_count != ref_map->mod_count)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+pair<KEY,T>* HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::operator ->() const {
+  if (Iteration::modified(expected_mod_count,ref_map->mod_count))
     throw ConcurrentModificationError("HashMap::Iterator::operator ->");
   if (!can_erase || !current.second)
     throw IteratorPositionIllegal("HashMap::Iterator::operator -> Iterator illegal");
@@ -7,8 +7,15 @@
 #include <iostream>
 #include <sstream>
 #include <initializer_list>
+#include <utility>              //std::move, std::forward
 #include "ics_exceptions.hpp"
 #include "pair.hpp"
+#include "node_allocator.hpp"
+#include "hash_image.hpp"
+#include "hash_statistics.hpp"
+#include "hash_code.hpp"
+#include "template_function.hpp"
+#include "iteration_policy.hpp"
 
 
 namespace ics {
@@ -16,37 +23,69 @@ namespace ics {
 
 #ifndef undefinedhashdefined
 #define undefinedhashdefined
-template<class T>
-int undefinedhash (const T& a) {return 0;}
+template<class T, class R = int>
+R undefinedhash (const T& a) {return 0;}
 #endif /* undefinedhashdefined */
 
+#ifndef ICS_PREFETCH
+#if defined(__GNUC__) || defined(__clang__)
+#define ICS_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define ICS_PREFETCH(address)
+#endif
+#endif /* ICS_PREFETCH */
+
 //Instantiate the templated class supplying thash(a): produces a hash value for a.
 //If thash is defaulted to undefinedhash in the template, then a constructor must supply chash.
 //If both thash and chash are supplied, then they must be the same (by ==) function.
 //If neither is supplied, or both are supplied but different, TemplateFunctionError is raised.
 //The (unique) non-undefinedhash value supplied by thash/chash is stored in the instance variable hash.
-template<class T, int (*thash)(const T& a) = undefinedhash<T>> class HashSet {
+//A thash is called directly (see template_function.hpp), so it can be inlined; thash can also be
+//  functor<F> for a stateless functor class F (e.g., HashSet<int,functor<IntHash>>).
+//thash may return an int or a 64-bit value; sizes and bins are 64-bit, so a set can hold more
+//  than 2^31 elements. There are always 2^bits bins (see hash_code.hpp).
+//NodeAllocator (see node_allocator.hpp) allocates the list nodes: PoolNodeAllocator<> recycles erased
+//  nodes from slabs instead of calling new/delete for each one.
+//Counters (NoHashCounters or HashCounters, see hash_statistics.hpp) decides whether statistics()
+//  reports lookup probes and resizes too; with NoHashCounters the counting compiles to nothing.
+//Iteration (CheckedIteration or UncheckedIteration, see iteration_policy.hpp) decides whether
+//  Iterators and for_each check for concurrent modification.
+template<class T, auto thash = undefinedhash<T>, class NodeAllocator = HeapNodeAllocator, class Counters = NoHashCounters, class Iteration = CheckedIteration> class HashSet {
   public:
-    typedef int (*hashfunc) (const T& a);
+    typedef decltype(thash) hashfunc;  //int or 64-bit hash values: see hash_code.hpp
 
     //Destructor/Constructors
     ~HashSet ();
 
-    HashSet (double the_load_threshold = 1.0, int (*chash)(const T& a) = undefinedhash<T>);
-    explicit HashSet (int initial_bins, double the_load_threshold = 1.0, int (*chash)(const T& k) = undefinedhash<T>);
-    HashSet (const HashSet<T,thash>& to_copy, double the_load_threshold = 1.0, int (*chash)(const T& a) = undefinedhash<T>);
-    explicit HashSet (const std::initializer_list<T>& il, double the_load_threshold = 1.0, int (*chash)(const T& a) = undefinedhash<T>);
+    HashSet (double the_load_threshold = 1.0, hashfunc chash = undefinedhash<T>);
+    explicit HashSet (int initial_bins, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<T>);
+    HashSet (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& to_copy, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<T>);
+    HashSet (HashSet<T,thash,NodeAllocator,Counters,Iteration>&& to_move) noexcept;  //to_move is left with no bins (allocated when next needed)
+    explicit HashSet (const std::initializer_list<T>& il, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<T>);
 
     //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
     template <class Iterable>
-    explicit HashSet (const Iterable& i, double the_load_threshold = 1.0, int (*chash)(const T& a) = undefinedhash<T>);
+    explicit HashSet (const Iterable& i, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<T>);
 
 
     //Queries
     bool empty      () const;
-    int  size       () const;
+    std::int64_t size () const;
     bool contains   (const T& element) const;
     std::string str () const; //supplies useful debugging information; contrast to operator <<
+    HashStatistics statistics () const; //chain lengths, collisions, (with HashCounters) probes/resizes
+
+    //Heterogeneous lookup: probe is any type comparable (element == probe) to T, with phash(probe) ==
+    //  hash(element) when they are equal (e.g., std::string_view probing std::string elements)
+    template<class Probe, class Code> bool contains (const Probe& probe, Code (*phash)(const Probe& p)) const;
+
+    //Batched contains of elements[0..n-1] (found[i] = contains(elements[i])): hashes a batch of
+    //  elements and prefetches their bins before searching any list; returns # found
+    std::int64_t contains_many (const T* elements, std::int64_t n, bool* found) const;
+
+    //Write an image of the set (see hash_image.hpp) that MappedHashSet (mapped_hash_map.hpp) can
+    //  search in place; T must be std::string or trivially copyable
+    void write_image (std::ostream& out) const;
 
     //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
     template <class Iterable>
@@ -55,32 +94,55 @@ template<class T, int (*thash)(const T& a) = undefinedhash<T>> class HashSet {
 
     //Commands
     int  insert (const T& element);
+    int  insert (T&& element);
     int  erase  (const T& element);
     void clear  ();
 
+    //Restart the counts that statistics() reports (with HashCounters)
+    void reset_statistics ();
+
+    //Sizing: bins are always a power of 2. reserve(n) grows the bins (never shrinks them) so n elements
+    //  are within load_threshold: insert_all of n elements after reserve(n) never resizes.
+    //  rehash(at_least_bins) resizes, up or down, to at least at_least_bins bins and at least enough
+    //  bins for size() elements; shrink_to_fit() is rehash(0).
+    void reserve       (std::int64_t n);
+    void rehash        (std::int64_t at_least_bins);
+    void shrink_to_fit ();
+
+    //0 (the default): the bins never shrink on their own. Otherwise erase(element) calls shrink_to_fit
+    //  once size()/bins falls below low_water, and clear() shrinks to 1 bin. low_water is clamped to at
+    //  most load_threshold/4, so a set that just shrank (or grew) is not resized again right away.
+    //Iterator::erase never shrinks (it would move the nodes being iterated over): call shrink_to_fit after.
+    void set_shrink_threshold (double low_water);
+
+    //Construct T(args...) in a node and add it, returning 1, unless it is already in the set: return 0
+    template<class... Args>
+    int emplace (Args&&... args);
+
     //Iterable class must support "for" loop: .begin()/.end() and prefix ++ on returned result
 
     template <class Iterable>
-    int insert_all(const Iterable& i);
+    std::int64_t insert_all(const Iterable& i);
 
     template <class Iterable>
-    int erase_all(const Iterable& i);
+    std::int64_t erase_all(const Iterable& i);
 
     template<class Iterable>
-    int retain_all(const Iterable& i);
+    std::int64_t retain_all(const Iterable& i);
 
 
     //Operators
-    HashSet<T,thash>& operator = (const HashSet<T,thash>& rhs);
-    bool operator == (const HashSet<T,thash>& rhs) const;
-    bool operator != (const HashSet<T,thash>& rhs) const;
-    bool operator <= (const HashSet<T,thash>& rhs) const;
-    bool operator <  (const HashSet<T,thash>& rhs) const;
-    bool operator >= (const HashSet<T,thash>& rhs) const;
-    bool operator >  (const HashSet<T,thash>& rhs) const;
+    HashSet<T,thash,NodeAllocator,Counters,Iteration>& operator = (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs);
+    HashSet<T,thash,NodeAllocator,Counters,Iteration>& operator = (HashSet<T,thash,NodeAllocator,Counters,Iteration>&& rhs) noexcept;  //Takes rhs's hash/load_threshold too
+    bool operator == (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const;
+    bool operator != (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const;
+    bool operator <= (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const;
+    bool operator <  (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const;
+    bool operator >= (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const;
+    bool operator >  (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const;
 
-    template<class T2, int (*hash2)(const T2& a)>
-    friend std::ostream& operator << (std::ostream& outs, const HashSet<T2,hash2>& s);
+    template<class T2, auto hash2, class NodeAllocator2, class Counters2, class Iteration2>
+    friend std::ostream& operator << (std::ostream& outs, const HashSet<T2,hash2,NodeAllocator2,Counters2,Iteration2>& s);
 
 
 
@@ -90,29 +152,29 @@ template<class T, int (*thash)(const T& a) = undefinedhash<T>> class HashSet {
   public:
     class Iterator {
       public:
-        typedef pair<int,LN*> Cursor;
+        typedef pair<std::int64_t,LN*> Cursor;
 
-        //Private constructor called in begin/end, which are friends of HashSet<T,thash>
+        //Private constructor called in begin/end, which are friends of HashSet<T,thash,NodeAllocator,Counters,Iteration>
         ~Iterator();
         T           erase();
         std::string str  () const;
-        HashSet<T,thash>::Iterator& operator ++ ();
-        HashSet<T,thash>::Iterator  operator ++ (int);
-        bool operator == (const HashSet<T,thash>::Iterator& rhs) const;
-        bool operator != (const HashSet<T,thash>::Iterator& rhs) const;
+        HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& operator ++ ();
+        HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator  operator ++ (int);
+        bool operator == (const HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& rhs) const;
+        bool operator != (const HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& rhs) const;
         T& operator *  () const;
         T* operator -> () const;
-        friend std::ostream& operator << (std::ostream& outs, const HashSet<T,thash>::Iterator& i) {
+        friend std::ostream& operator << (std::ostream& outs, const HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& i) {
           outs << i.str(); //Use the same meaning as the debugging .str() method
           return outs;
         }
-        friend Iterator HashSet<T,thash>::begin () const;
-        friend Iterator HashSet<T,thash>::end   () const;
+        friend Iterator HashSet<T,thash,NodeAllocator,Counters,Iteration>::begin () const;
+        friend Iterator HashSet<T,thash,NodeAllocator,Counters,Iteration>::end   () const;
 
       private:
         //If can_erase is false, current indexes the "next" value (must ++ to reach it)
         Cursor              current; //Bin Index and Cursor; stops if LN* == nullptr
-        HashSet<T,thash>*   ref_set;
+        HashSet<T,thash,NodeAllocator,Counters,Iteration>*   ref_set;
         int                 expected_mod_count;
         bool                can_erase = true;
 
@@ -120,43 +182,61 @@ template<class T, int (*thash)(const T& a) = undefinedhash<T>> class HashSet {
         void advance_cursors();
 
         //Called in friends begin/end
-        Iterator(HashSet<T,thash>* iterate_over, bool from_begin);
+        Iterator(HashSet<T,thash,NodeAllocator,Counters,Iteration>* iterate_over, bool from_begin);
     };
 
 
     Iterator begin () const;
     Iterator end   () const;
 
+    //Internal iteration: visit(element) for each element (as a const T&), walking the bins without an Iterator;
+    //  visit must not change the set. With CheckedIteration, mod_count is compared after each visit (before
+    //  moving on), so ConcurrentModificationError is thrown after the visit that changed the set has run;
+    //  with UncheckedIteration the comparison compiles to nothing and such a change is undefined.
+    template<class Visitor>
+    void for_each (Visitor visit) const;
+
 
   private:
     class LN {
       public:
         LN ()                      {}
         LN (const LN& ln)          : value(ln.value), next(ln.next){}
-        LN (T v,  LN* n = nullptr) : value(v), next(n){}
+        LN (const T& v, LN* n = nullptr) : value(v), next(n){}
+        LN (T&& v, LN* n = nullptr)      : value(std::move(v)), next(n){}
 
         T   value;
         LN* next   = nullptr;
     };
 
 public:
-  int (*hash)(const T& k);   //Hashing function used (from template or constructor)
+  TemplateFunction<hashfunc,thash,undefinedhash<T>> hash;  //Hashing function used (from template or constructor)
 private:
   LN** set      = nullptr;   //Pointer to array of pointers: each bin stores a list with a trailer node
   double load_threshold;     //used/bins <= load_threshold
-  int bins      = 1;         //# bins in array (should start >= 1 so hash_compress doesn't % 0)
-  int used      = 0;         //Cache for number of key->value pairs in the hash table
+  std::int64_t bins = 1;     //# bins in array: 2^bits (0 only once moved from)
+  int bits      = 0;
+  std::int64_t used = 0;     //Cache for number of key->value pairs in the hash table
   int mod_count = 0;         //For sensing concurrent modification
+  typename NodeAllocator::template Pool<LN> nodes; //Allocates every LN (trailers too); see node_allocator.hpp
+  Counters counters;         //Not copied or moved: counts the operations on this set
+  double shrink_threshold = 0; //erase shrinks the bins when used/bins < shrink_threshold; 0 means never
+  static constexpr std::int64_t scan_ahead = 8;//bins prefetched ahead while scanning past empty bins
 
 
   //Helper methods
-  int   hash_compress        (const T& key)              const;  //hash function ranged to [0,bins-1]
-  LN*   find_element         (const T& element)          const;  //Returns reference to element's node or nullptr
-  LN*   copy_list            (LN*   l)                   const;  //Copy the elements in a bin (order irrelevant)
-  LN**  copy_hash_table      (LN** ht, int bins)         const;  //Copy the bins/keys/values in ht tree (order in bins irrelevant)
-
-  void  ensure_load_threshold(int new_used);                     //Reallocate if load_threshold > load_threshold
-  void  delete_hash_table    (LN**& ht, int bins);               //Deallocate all LN in ht (and the ht itself; ht == nullptr)
+  std::int64_t hash_compress        (const T& key)              const;  //hash function ranged to [0,bins-1]
+  LN*          find_element         (const T& element)          const;  //Returns reference to element's node or nullptr
+  template<class Probe>
+  LN*          find_element         (const Probe& element, HashCode code) const; //Same, given to_hash_code(hash(element)) (or a Probe and its code)
+  LN*          copy_list            (LN*   l);                          //Copy the elements in a bin (order irrelevant)
+  LN**         copy_hash_table      (LN** ht, std::int64_t bins);       //Copy the bins/keys/values in ht tree (order in bins irrelevant)
+  void         allocate_bins        (std::int64_t at_least);            //set = 2^bits >= at_least bins, each with a trailer
+
+  void         ensure_load_threshold(std::int64_t new_used);            //Reallocate if load_threshold > load_threshold
+  void         delete_hash_table    (LN**& ht, std::int64_t bins);      //Deallocate all LN in ht (and the ht itself; ht == nullptr)
+  std::int64_t bins_for             (std::int64_t n)            const;  //# bins holding n elements within load_threshold
+  void         resize_bins          (std::int64_t at_least);            //Relink every node into 2^bits >= at_least bins
 };
 
 
@@ -169,61 +249,53 @@ private:
 //
 //Destructor/Constructors
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::~HashSet() {
-//    delete_hash_table(set, bins);
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::~HashSet() {
+    delete_hash_table(set, bins);
 }
 
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::HashSet(double the_load_threshold, int (*chash)(const T& element))
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::HashSet(double the_load_threshold, hashfunc chash)
 : hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(the_load_threshold) {
     if (hash == (hashfunc)undefinedhash<T>)
         throw TemplateFunctionError("HashSet::default constructor: neither specified");
     if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
         throw TemplateFunctionError("HashSet::default constructor: both specified and different");
 
-    set = new LN* [bins];
-    for (auto i = 0; i < bins; i++) {
-        set[i] = new LN();
-    }
+    allocate_bins(1);
 }
 
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::HashSet(int initial_bins, double the_load_threshold, int (*chash)(const T& element))
-: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::HashSet(int initial_bins, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(the_load_threshold) {
     if (hash == (hashfunc)undefinedhash<T>)
-        throw TemplateFunctionError("HashSet::default constructor: neither specified");
+        throw TemplateFunctionError("HashSet::length constructor: neither specified");
     if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
-        throw TemplateFunctionError("HashSet::default constructor: both specified and different");
+        throw TemplateFunctionError("HashSet::length constructor: both specified and different");
 
-    bins = initial_bins;
-    set = new LN*[bins];
-    for (auto i = 0; i < bins; i++) {
-        set[i] = new LN();
-    }
+    allocate_bins(initial_bins);
 }
 
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::HashSet(const HashSet<T,thash>& to_copy, double the_load_threshold, int (*chash)(const T& element))
-: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::HashSet(const HashSet<T,thash,NodeAllocator,Counters,Iteration>& to_copy, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(the_load_threshold) {
     if (hash == (hashfunc)undefinedhash<T>)
         hash = to_copy.hash;
     if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
         throw TemplateFunctionError("HashSet::copy constructor: both specified and different");
 
+    shrink_threshold = to_copy.shrink_threshold;
     if (hash == to_copy.hash) {
         bins = to_copy.bins;
+        bits = to_copy.bits;
         used = to_copy.used;
         set = copy_hash_table(to_copy.set, to_copy.bins);
     } else {
-        bins = to_copy.bins;
-        set = new LN* [bins];
-        for (int i = 0; i < bins; i++)
-            set[i] = new LN();
-        for (int i = 0; i < to_copy.bins; i++) {
+        allocate_bins(to_copy.bins);
+        for (std::int64_t i = 0; i < to_copy.bins; i++) {
             LN* head = to_copy.set[i];
             while (head->next) {
                 insert(head->value);
@@ -234,18 +306,27 @@ HashSet<T,thash>::HashSet(const HashSet<T,thash>& to_copy, double the_load_thres
 }
 
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::HashSet(const std::initializer_list<T>& il, double the_load_threshold, int (*chash)(const T& element))
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::HashSet(HashSet<T,thash,NodeAllocator,Counters,Iteration>&& to_move) noexcept
+: hash(to_move.hash), set(to_move.set), load_threshold(to_move.load_threshold), bins(to_move.bins), bits(to_move.bits), used(to_move.used),
+  nodes(std::move(to_move.nodes)), shrink_threshold(to_move.shrink_threshold) {
+    to_move.set = nullptr;
+    to_move.bins = 0;
+    to_move.bits = 0;
+    to_move.used = 0;
+    to_move.mod_count++;
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::HashSet(const std::initializer_list<T>& il, double the_load_threshold, hashfunc chash)
 : hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(the_load_threshold) {
     if (hash == (hashfunc)undefinedhash<T>)
         throw TemplateFunctionError("HashSet::initializer_list constructor: neither specified");
     if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
         throw TemplateFunctionError("HashSet::initializer_list constructor: both specified and different");
 
-    bins = 1;
-    set = new LN* [bins];
-    for (int i = 0; i < bins; i++)
-        set[i] = new LN();
+    allocate_bins(1);
 
     for (auto i : il) {
         insert(i);
@@ -253,19 +334,16 @@ HashSet<T,thash>::HashSet(const std::initializer_list<T>& il, double the_load_th
 }
 
 
-template<class T, int (*thash)(const T& a)>
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
 template<class Iterable>
-HashSet<T,thash>::HashSet(const Iterable& i, double the_load_threshold, int (*chash)(const T& a))
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::HashSet(const Iterable& i, double the_load_threshold, hashfunc chash)
 : hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(the_load_threshold) {
     if (hash == (hashfunc)undefinedhash<T>)
         throw TemplateFunctionError("HashSet::Iterable constructor: neither specified");
     if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
         throw TemplateFunctionError("HashSet::Iterable constructor: both specified and different");
 
-    bins = 1;
-    set = new LN* [bins];
-    for (int i = 0; i < bins; i++)
-        set[i] = new LN();
+    allocate_bins(1);
 
     for (auto j : i) {
         insert(j);
@@ -277,31 +355,77 @@ HashSet<T,thash>::HashSet(const Iterable& i, double the_load_threshold, int (*ch
 //
 //Queries
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::empty() const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::empty() const {
     return (used == 0);
 }
 
 
-template<class T, int (*thash)(const T& a)>
-int HashSet<T,thash>::size() const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::size() const {
     return used;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::contains (const T& element) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::contains (const T& element) const {
     return (find_element(element) != nullptr);
 }
 
 
-template<class T, int (*thash)(const T& a)>
-std::string HashSet<T,thash>::str() const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+template<class Probe, class Code>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::contains (const Probe& probe, Code (*phash)(const Probe& p)) const {
+    return (find_element(probe, to_hash_code(phash(probe))) != nullptr);
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::contains_many (const T* elements, std::int64_t n, bool* found) const {
+    const int batch = 16;                   //probes in flight at once
+    HashCode codes[batch];
+    std::int64_t answer = 0;
+    for (std::int64_t first = 0; first < n; first += batch) {
+        int count = n - first < batch ? int(n - first) : batch;
+        for (int i = 0; i < count; i++)
+            codes[i] = to_hash_code(hash(elements[first+i]));
+        if (bins != 0) {
+            for (int i = 0; i < count; i++)     //the bins' pointers...
+                ICS_PREFETCH(&set[bin_index(codes[i], bits)]);
+            for (int i = 0; i < count; i++)     //...then the lists' first nodes
+                ICS_PREFETCH(set[bin_index(codes[i], bits)]);
+        }
+        for (int i = 0; i < count; i++) {
+            found[first+i] = find_element(elements[first+i], codes[i]) != nullptr;
+            if (found[first+i])
+                answer++;
+        }
+    }
+    return answer;
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::write_image (std::ostream& out) const {
+    HashImageWriter<T,T> image(false);
+    for (std::int64_t i = 0; i < bins; i++) {
+        auto p = set[i];
+        while (p->next) {
+            image.add(to_hash_code(hash(p->value)), p->value, nullptr);
+            p = p->next;
+        }
+    }
+    image.write(out, bins);
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::string HashSet<T,thash,NodeAllocator,Counters,Iteration>::str() const {
     std::ostringstream answer;
     answer << "HashSet\n";
 
     if(used) {
-        for (int i = 0; i < bins; i++) {
+        for (std::int64_t i = 0; i < bins; i++) {
             answer<<"Bin:["<<i<<"] ";
             auto p = set[i];
             while(p->next) {
@@ -317,9 +441,30 @@ std::string HashSet<T,thash>::str() const {
 }
 
 
-template<class T, int (*thash)(const T& a)>
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashStatistics HashSet<T,thash,NodeAllocator,Counters,Iteration>::statistics () const {
+    HashStatistics answer;
+    std::vector<HashCode> codes;
+    codes.reserve(used);
+    for (std::int64_t i = 0; i < bins; i++) {
+        auto p = set[i];
+        std::int64_t length = 0;
+        while (p->next) {
+            codes.push_back(to_hash_code(hash(p->value)));
+            length++;
+            p = p->next;
+        }
+        answer.count_chain(length);
+    }
+    answer.count_codes(codes);
+    counters.report(answer);
+    return answer;
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
 template <class Iterable>
-bool HashSet<T,thash>::contains_all(const Iterable& i) const {
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::contains_all(const Iterable& i) const {
     for (auto j : i) {
         if (!contains(j)) {
             return false;
@@ -332,101 +477,154 @@ bool HashSet<T,thash>::contains_all(const Iterable& i) const {
 //
 //Commands
 
-template<class T, int (*thash)(const T& a)>
-int HashSet<T,thash>::insert(const T& element) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+int HashSet<T,thash,NodeAllocator,Counters,Iteration>::insert(const T& element) {
     if (contains(element)) {
         return 0;
     } else {
         ensure_load_threshold(used+1);
         mod_count++;
         used++;
-        int index = hash_compress(element);
-        LN* head = set[index];
-        while (head->next != nullptr) {
-            head = head->next;
-        }
-        head->next = new LN();
-        head->value = element;
+        auto index = hash_compress(element);   //bins may have changed in ensure_load_threshold
+        set[index] = nodes.create(element, set[index]);
         return 1;
     }
 }
 
 
-template<class T, int (*thash)(const T& a)>
-int HashSet<T,thash>::erase(const T& element) {
-    LN *p = find_element(element);
-    if (p == nullptr) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+int HashSet<T,thash,NodeAllocator,Counters,Iteration>::insert(T&& element) {
+    if (contains(element)) {
         return 0;
+    } else {
+        ensure_load_threshold(used+1);
+        mod_count++;
+        used++;
+        auto index = hash_compress(element);   //bins may have changed in ensure_load_threshold
+        set[index] = nodes.create(std::move(element), set[index]);
+        return 1;
     }
+}
 
-    int index = hash_compress(element);
-    LN* head = set[index];
 
-    while (head->next != nullptr) {
-        if (head->value == element) {
-            used--;
-            mod_count++;
-            auto value = head->value;
-            head->value = head->next->value;
-            auto del = head->next;
-            head->next = head->next->next;
-            delete del;
-            return 1;
-        } else {
-            head = head->next;
-        }
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+template<class... Args>
+int HashSet<T,thash,NodeAllocator,Counters,Iteration>::emplace(Args&&... args) {
+    LN* p = nodes.create(T(std::forward<Args>(args)...));
+    if (contains(p->value)) {
+        nodes.destroy(p);
+        return 0;
     }
+    ensure_load_threshold(used+1);
+    mod_count++;
+    used++;
+    auto index = hash_compress(p->value);     //bins may have changed in ensure_load_threshold
+    p->next = set[index];
+    set[index] = p;
+    return 1;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-void HashSet<T,thash>::clear() {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+int HashSet<T,thash,NodeAllocator,Counters,Iteration>::erase(const T& element) {
+    LN *p = find_element(element);
+    if (p == nullptr) {
+        return 0;
+    }
+
+    used--;
+    mod_count++;
+    auto del = p->next;
+    p->value = std::move(del->value);
+    p->next = del->next;
+    nodes.destroy(del);
+    if (used < shrink_threshold*bins)
+        shrink_to_fit();
+    return 1;
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::clear() {
     used = 0;
     mod_count++;
-    for (int i = 0; i < bins; i++) {
+    for (std::int64_t i = 0; i < bins; i++) {
         auto head = set[i];
         while (head->next) {
             auto del = head;
             head = head->next;
-            delete del;
+            nodes.destroy(del);
         } set[i] = head;
     }
+    if (shrink_threshold > 0)
+        shrink_to_fit();
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::reset_statistics () {
+    counters.reset();
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::reserve(std::int64_t n) {
+    if (bins_for(n) > bins)
+        resize_bins(bins_for(n));
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::rehash(std::int64_t at_least_bins) {
+    resize_bins(at_least_bins > bins_for(used) ? at_least_bins : bins_for(used));
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::shrink_to_fit() {
+    rehash(0);
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::set_shrink_threshold(double low_water) {
+    shrink_threshold = low_water < 0 ? 0 : low_water > load_threshold/4 ? load_threshold/4 : low_water;
 }
 
 
-template<class T, int (*thash)(const T& a)>
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
 template<class Iterable>
-int HashSet<T,thash>::insert_all(const Iterable& i) {
-    int count = 0;
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::insert_all(const Iterable& i) {
+    std::int64_t count = 0;
     for (auto j : i) {
         count += insert(j);
     } return count;
 }
 
 
-template<class T, int (*thash)(const T& a)>
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
 template<class Iterable>
-int HashSet<T,thash>::erase_all(const Iterable& i) {
-    int count = 0;
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::erase_all(const Iterable& i) {
+    std::int64_t count = 0;
     for (auto j : i) {
         count += erase(j);
     } return count;
 }
 
 
-template<class T, int (*thash)(const T& a)>
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
 template<class Iterable>
-int HashSet<T,thash>::retain_all(const Iterable& i) {
-    HashSet<T,thash> newSet(i);
-    int counter = 0;
-    for (int i = 0; i < bins; i++) {
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::retain_all(const Iterable& i) {
+    HashSet<T,thash,NodeAllocator,Counters,Iteration> newSet(i);
+    std::int64_t counter = 0;
+    for (std::int64_t i = 0; i < bins; i++) {
         LN* head = set[i];
         while (head->next != nullptr) {
             if (!newSet.contains(head->value)) {
                 LN* del = head->next;
-                head->value = head->next->value;
-                head->next = head->next->next;
-                delete del;
+                head->value = std::move(del->value);
+                head->next = del->next;
+                nodes.destroy(del);
                 counter++;
                 used--;
             } else {
@@ -441,13 +639,13 @@ int HashSet<T,thash>::retain_all(const Iterable& i) {
 //
 //Operators
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>& HashSet<T,thash>::operator = (const HashSet<T,thash>& rhs) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>& HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator = (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) {
     if (this == &rhs) {
         return *this;
     }
     clear();
-    for (auto i = 0; i < rhs.bins; i++) {
+    for (std::int64_t i = 0; i < rhs.bins; i++) {
         auto head = rhs.set[i];
         while (head->next != nullptr) {
             insert(head->value);
@@ -457,15 +655,41 @@ HashSet<T,thash>& HashSet<T,thash>::operator = (const HashSet<T,thash>& rhs) {
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::operator == (const HashSet<T,thash>& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>& HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator = (HashSet<T,thash,NodeAllocator,Counters,Iteration>&& rhs) noexcept {
+    if (this == &rhs) {
+        return *this;
+    }
+
+    delete_hash_table(set, bins);
+    nodes = std::move(rhs.nodes);   //every node of this was just destroyed
+    hash = rhs.hash;
+    set = rhs.set;
+    load_threshold = rhs.load_threshold;
+    bins = rhs.bins;
+    bits = rhs.bits;
+    used = rhs.used;
+    shrink_threshold = rhs.shrink_threshold;
+
+    rhs.set = nullptr;
+    rhs.bins = 0;
+    rhs.bits = 0;
+    rhs.used = 0;
+    rhs.mod_count++;
+    mod_count++;
+    return *this;
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator == (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const {
     if (this == &rhs) {
         return true;
     } else if (used != rhs.used) {
         return false;
     }
 
-    for (int i = 0; i < bins; i++) {
+    for (std::int64_t i = 0; i < bins; i++) {
         LN *head = this->set[i];
         while (head->next != nullptr) {
             if (!rhs.find_element(head->value)) {
@@ -480,14 +704,14 @@ bool HashSet<T,thash>::operator == (const HashSet<T,thash>& rhs) const {
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::operator != (const HashSet<T,thash>& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator != (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const {
     return !(*this == rhs);
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::operator <= (const HashSet<T,thash>& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator <= (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const {
     if (this == &rhs) {
         return false;
     }
@@ -496,7 +720,7 @@ bool HashSet<T,thash>::operator <= (const HashSet<T,thash>& rhs) const {
         return false;
     }
 
-    for (int i =0; i < bins; i++) {
+    for (std::int64_t i =0; i < bins; i++) {
         LN* head = set[i];
         while (head->next != nullptr) {
             if (!rhs.contains(head->value)) {
@@ -508,8 +732,8 @@ bool HashSet<T,thash>::operator <= (const HashSet<T,thash>& rhs) const {
     } return true;
 }
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::operator < (const HashSet<T,thash>& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator < (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const {
     if (this == &rhs) {
         return false;
     }
@@ -518,7 +742,7 @@ bool HashSet<T,thash>::operator < (const HashSet<T,thash>& rhs) const {
         return false;
     }
 
-    for (int i = 0; i < bins; i++) {
+    for (std::int64_t i = 0; i < bins; i++) {
         LN* head = set[i];
         while (head->next != nullptr) {
             if (!rhs.contains(head->value)) {
@@ -531,22 +755,22 @@ bool HashSet<T,thash>::operator < (const HashSet<T,thash>& rhs) const {
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::operator >= (const HashSet<T,thash>& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator >= (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const {
     return rhs <= *this;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::operator > (const HashSet<T,thash>& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator > (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const {
     return rhs < *this;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-std::ostream& operator << (std::ostream& outs, const HashSet<T,thash>& s) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::ostream& operator << (std::ostream& outs, const HashSet<T,thash,NodeAllocator,Counters,Iteration>& s) {
     outs << "set[";
-    for (auto i = 0; i < s.bins; i++) {
+    for (std::int64_t i = 0; i < s.bins; i++) {
         auto head = s.set[i];
         while (head->next != nullptr) {
             outs << head->value;
@@ -561,15 +785,31 @@ std::ostream& operator << (std::ostream& outs, const HashSet<T,thash>& s) {
 //
 //Iterator constructors
 
-template<class T, int (*thash)(const T& a)>
-auto HashSet<T,thash>::begin () const -> HashSet<T,thash>::Iterator {
-    return Iterator(const_cast<HashSet<T, thash>*>(this),true);
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+auto HashSet<T,thash,NodeAllocator,Counters,Iteration>::begin () const -> HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator {
+    return Iterator(const_cast<HashSet<T,thash,NodeAllocator,Counters,Iteration>*>(this),true);
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+auto HashSet<T,thash,NodeAllocator,Counters,Iteration>::end () const -> HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator {
+    return Iterator(const_cast<HashSet<T,thash,NodeAllocator,Counters,Iteration>*>(this),false);
 }
 
 
-template<class T, int (*thash)(const T& a)>
-auto HashSet<T,thash>::end () const -> HashSet<T,thash>::Iterator {
-    return Iterator(const_cast<HashSet<T, thash>*>(this),false);
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+template<class Visitor>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::for_each (Visitor visit) const {
+    int expected_mod_count = mod_count;
+    for (std::int64_t b = 0; b < bins; b++) {
+        if (b + scan_ahead < bins)
+            ICS_PREFETCH(set[b + scan_ahead]);
+        for (LN* p = set[b]; p->next; p = p->next) {
+            visit(const_cast<const T&>(p->value));
+            if (Iteration::modified(expected_mod_count,mod_count))
+                throw ConcurrentModificationError("HashSet::for_each");
+        }
+    }
 }
 
 
@@ -577,34 +817,46 @@ auto HashSet<T,thash>::end () const -> HashSet<T,thash>::Iterator {
 //
 //Private helper methods
 
-template<class T, int (*thash)(const T& a)>
-int HashSet<T,thash>::hash_compress (const T& element) const {
-    int index = hash(element);
-    return (abs(index) % bins);
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::hash_compress (const T& element) const {
+    return bin_index(to_hash_code(hash(element)), bits);
 }
 
 
-template<class T, int (*thash)(const T& a)>
-typename HashSet<T,thash>::LN* HashSet<T,thash>::find_element (const T& element) const {
-    for (int i = 0; i < bins; i++) {
-        auto head = set[i];
-        while (head->next != nullptr) {
-            if (head->value == element) {
-                return head;
-            } else {
-                head = head->next;
-            }
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+typename HashSet<T,thash,NodeAllocator,Counters,Iteration>::LN* HashSet<T,thash,NodeAllocator,Counters,Iteration>::find_element (const T& element) const {
+    return find_element(element, to_hash_code(hash(element)));
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+template<class Probe>
+typename HashSet<T,thash,NodeAllocator,Counters,Iteration>::LN* HashSet<T,thash,NodeAllocator,Counters,Iteration>::find_element (const Probe& element, HashCode code) const {
+    if (bins == 0) {
+        return nullptr;
+    }
+    LN* head = set[bin_index(code, bits)];
+    int probes = 0;
+    while (head->next != nullptr) {
+        probes++;
+        if (head->value == element) {
+            counters.lookup(true, probes);
+            return head;
+        } else {
+            head = head->next;
         }
-    } return nullptr;
+    }
+    counters.lookup(false, probes);
+    return nullptr;
 }
 
-template<class T, int (*thash)(const T& a)>
-typename HashSet<T,thash>::LN* HashSet<T,thash>::copy_list (LN* l) const {
-    LN* head = new LN(l->value);
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+typename HashSet<T,thash,NodeAllocator,Counters,Iteration>::LN* HashSet<T,thash,NodeAllocator,Counters,Iteration>::copy_list (LN* l) {
+    LN* head = nodes.create(l->value);
     LN* runner = head;
     l = l->next;
     while (l) {
-        runner->next = new LN(l->value);
+        runner->next = nodes.create(l->value);
         runner = runner->next;
         l = l->next;
     }
@@ -613,54 +865,81 @@ typename HashSet<T,thash>::LN* HashSet<T,thash>::copy_list (LN* l) const {
 }
 
 
-template<class T, int (*thash)(const T& a)>
-typename HashSet<T,thash>::LN** HashSet<T,thash>::copy_hash_table (LN** ht, int bins) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+typename HashSet<T,thash,NodeAllocator,Counters,Iteration>::LN** HashSet<T,thash,NodeAllocator,Counters,Iteration>::copy_hash_table (LN** ht, std::int64_t bins) {
     LN** hashSet = new LN* [bins];
-    for (int i = 0; i < bins; i++) {
+    for (std::int64_t i = 0; i < bins; i++) {
         hashSet[i] = copy_list(ht[i]);
     } return hashSet;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-void HashSet<T,thash>::ensure_load_threshold(int new_used) {
-    if(new_used/bins > load_threshold) {
-        int b = bins;
-        bins*=2;
-        LN** new_set = set;
-        set = new LN*[bins];
-        for(int i = 0; i < bins; i ++) {
-            set[i] = new LN();
-        }
-        for(int i = 0 ; i < b; i++) {
-            auto p = new_set[i];
-            while (p->next) {
-                int index = hash_compress(p->value);
-                auto head = set[index];
-                while (head->next) {
-                    head = head->next;
-                }
-                head->value = p->value;
-                head->next = new LN();
-                p = p->next;
-            }
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::allocate_bins(std::int64_t at_least) {
+    bits = bin_bits(at_least);
+    bins = std::int64_t(1) << bits;
+    set = new LN*[bins];
+    nodes.reserve(bins);
+    for (std::int64_t i = 0; i < bins; i++)
+        set[i] = nodes.create();
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::ensure_load_threshold(std::int64_t new_used) {
+    if (double(new_used)/double(bins) <= load_threshold)
+        return;
+
+    resize_bins(2*bins);    //bins is 0 once moved from
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::bins_for(std::int64_t n) const {
+    auto b = std::int64_t(n/load_threshold);
+    return b*load_threshold < n ? b+1 : b;
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::resize_bins(std::int64_t at_least) {
+    if (bins != 0 && bins == std::int64_t(1) << bin_bits(at_least))
+        return;
+
+    counters.resized();
+    typename Counters::Timer timing(counters);
+    auto b = bins;
+    LN** old_set = set;
+    allocate_bins(at_least);
+    //Relink each old node at the front of its new bin: no copying, no walk to the trailer
+    for(std::int64_t i = 0 ; i < b; i++) {
+        auto p = old_set[i];
+        while (p->next) {
+            auto index = hash_compress(p->value);
+            auto to_move = p;
+            p = p->next;
+            to_move->next = set[index];
+            set[index] = to_move;
         }
-        delete new_set;
+        nodes.destroy(p);   //old trailer
     }
-    else return;
+    delete[] old_set;
+    mod_count++;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-void HashSet<T,thash>::delete_hash_table (LN**& ht, int bins) {
-    for (int i = 0; i < bins; i++) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::delete_hash_table (LN**& ht, std::int64_t bins) {
+    for (std::int64_t i = 0; i < bins; i++) {
         LN* head = ht[i];
-        while (head->next) {
+        while (head) {
             auto del = head;
             head = head->next;
-            delete head;
+            nodes.destroy(del);
         }
-    } delete ht;
+    }
+    delete[] ht;
+    ht = nullptr;
 }
 
 
@@ -672,31 +951,28 @@ void HashSet<T,thash>::delete_hash_table (LN**& ht, int bins) {
 //
 //Iterator class definitions
 
-template<class T, int (*thash)(const T& a)>
-void HashSet<T,thash>::Iterator::advance_cursors() {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::advance_cursors() {
     if (current.second && current.second->next && current.second->next->next) {
         current.second = current.second->next;
     } else {
-        int i = current.first+1;
-        bool found = false;
-        while (i < ref_set->bins) {
+        for (std::int64_t i = current.first+1; i < ref_set->bins; i++) {
+            if (i + scan_ahead < ref_set->bins)
+                ICS_PREFETCH(ref_set->set[i + scan_ahead]);   //the trailer of a bin ahead: empty bins cost a miss each
             if (ref_set->set[i]->next) {
-                found = true;
                 current.first = i;
                 current.second = ref_set->set[i];
                 return;
-            } i++;
-        }
-        if (!found) {
-            current.first = -1;
-            current.second = nullptr;
+            }
         }
+        current.first = -1;
+        current.second = nullptr;
     }
 }
 
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::Iterator::Iterator(HashSet<T,thash>* iterate_over, bool begin)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::Iterator(HashSet<T,thash,NodeAllocator,Counters,Iteration>* iterate_over, bool begin)
 : ref_set(iterate_over), expected_mod_count(ref_set->mod_count) {
     current.first = -1;
     current.second = nullptr;
@@ -706,14 +982,14 @@ HashSet<T,thash>::Iterator::Iterator(HashSet<T,thash>* iterate_over, bool begin)
 }
 
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::Iterator::~Iterator()
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::~Iterator()
 {}
 
 
-template<class T, int (*thash)(const T& a)>
-T HashSet<T,thash>::Iterator::erase() {
-    if (expected_mod_count != ref_set->mod_count)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+T HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::erase() {
+    if (Iteration::modified(expected_mod_count,ref_set->mod_count))
         throw ConcurrentModificationError("HashSet::Iterator::erase");
     if (!can_erase)
         throw CannotEraseError("HashSet::Iterator::erase Iterator cursor already erased");
@@ -721,11 +997,11 @@ T HashSet<T,thash>::Iterator::erase() {
         throw CannotEraseError("HashSet::Iterator::erase Iterator cursor beyond data structure");
 
     can_erase = false;
-    auto to_return = current.second->value;
+    auto to_return = std::move(current.second->value);
     LN* del = current.second->next;
-    current.second->value = current.second->next->value;
-    current.second->next = current.second->next->next;
-    delete del;
+    current.second->value = std::move(del->value);
+    current.second->next = del->next;
+    ref_set->nodes.destroy(del);
 
     ref_set->mod_count++;
     ref_set->used--;
@@ -735,17 +1011,17 @@ T HashSet<T,thash>::Iterator::erase() {
 }
 
 
-template<class T, int (*thash)(const T& a)>
-std::string HashSet<T,thash>::Iterator::str() const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::string HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::str() const {
   std::ostringstream answer;
   answer << current.second << "/expected_mod_count=" << expected_mod_count << "/can_erase=" << can_erase;
   return answer.str();
 }
 
 
-template<class T, int (*thash)(const T& a)>
-auto  HashSet<T,thash>::Iterator::operator ++ () -> HashSet<T,thash>::Iterator& {
-    if (expected_mod_count != ref_set->mod_count)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+auto  HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::operator ++ () -> HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& {
+    if (Iteration::modified(expected_mod_count,ref_set->mod_count))
         throw ConcurrentModificationError("HashSet::Iterator::operator ++");
 
     if (!current.second)
@@ -760,9 +1036,9 @@ auto  HashSet<T,thash>::Iterator::operator ++ () -> HashSet<T,thash>::Iterator&
 }
 
 
-template<class T, int (*thash)(const T& a)>
-auto  HashSet<T,thash>::Iterator::operator ++ (int) -> HashSet<T,thash>::Iterator {
-    if (expected_mod_count != ref_set->mod_count)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+auto  HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::operator ++ (int) -> HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator {
+    if (Iteration::modified(expected_mod_count,ref_set->mod_count))
         throw ConcurrentModificationError("HashSet::Iterator::operator ++(int)");
 
     if (!current.second)
@@ -778,12 +1054,12 @@ auto  HashSet<T,thash>::Iterator::operator ++ (int) -> HashSet<T,thash>::Iterato
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::Iterator::operator == (const HashSet<T,thash>::Iterator& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::operator == (const HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& rhs) const {
     const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
     if (rhsASI == 0)
         throw IteratorTypeError("HashSet::Iterator::operator ==");
-    if (expected_mod_count != ref_set->mod_count)
+    if (Iteration::modified(expected_mod_count,ref_set->mod_count))
         throw ConcurrentModificationError("HashSet::Iterator::operator ==");
     if (ref_set != rhsASI->ref_set)
         throw ComparingDifferentIteratorsError("HashSet::Iterator::operator ==");
@@ -792,12 +1068,12 @@ bool HashSet<T,thash>::Iterator::operator == (const HashSet<T,thash>::Iterator&
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::Iterator::operator != (const HashSet<T,thash>::Iterator& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::operator != (const HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& rhs) const {
     const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
     if (rhsASI == 0)
         throw IteratorTypeError("HashSet::Iterator::operator !=");
-    if (expected_mod_count != ref_set->mod_count)
+    if (Iteration::modified(expected_mod_count,ref_set->mod_count))
         throw ConcurrentModificationError("HashSet::Iterator::operator !=");
     if (ref_set != rhsASI->ref_set)
         throw ComparingDifferentIteratorsError("HashSet::Iterator::operator !=");
@@ -805,9 +1081,9 @@ bool HashSet<T,thash>::Iterator::operator != (const HashSet<T,thash>::Iterator&
     return this->current.second != rhsASI->current.second;
 }
 
-template<class T, int (*thash)(const T& a)>
-T& HashSet<T,thash>::Iterator::operator *() const {
-    if (expected_mod_count != ref_set->mod_count)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+T& HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::operator *() const {
+    if (Iteration::modified(expected_mod_count,ref_set->mod_count))
         throw ConcurrentModificationError("HashSet::Iterator::operator *");
     if (!can_erase || !current.second)
         throw IteratorPositionIllegal("HashSet::Iterator::operator * Iterator illegal");
@@ -815,9 +1091,9 @@ T& HashSet<T,thash>::Iterator::operator *() const {
     return current.second->value;
 }
 
-template<class T, int (*thash)(const T& a)>
-T* HashSet<T,thash>::Iterator::operator ->() const {
-  if (expected_mod_count != ref_set->mod_count)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+T* HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::operator ->() const {
+  if (Iteration::modified(expected_mod_count,ref_set->mod_count))
     throw ConcurrentModificationError("HashSet::Iterator::operator ->");
   if (!can_erase || !current.second)
     throw IteratorPositionIllegal("HashSet::Iterator::operator -> Iterator illegal");
@@ -0,0 +1,178 @@
+#ifndef HASH_STATISTICS_HPP_
+#define HASH_STATISTICS_HPP_
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <algorithm>            //std::sort
+#include <chrono>
+#include <cstdint>
+#include "hash_code.hpp"
+
+
+namespace ics {
+
+
+//What HashMap/HashSet::statistics() reports about a table's health.
+//The shape of the table (chains, codes) is computed by walking it when statistics() is called.
+//The counters (lookups, resizes) are kept only by containers instantiated with HashCounters
+//  (below); with the default NoHashCounters, counted is false and they are all 0.
+//collision_score compares the bins' chains with those a random hash function would make:
+//  sum over bins of len*(len+1)/2, divided by its expected value (used/(2*bins))*(used+2*bins-1).
+//  About 1.0 is good; a hash function that maps many keys to few bins (e.g., one that multiplies
+//  two hashes, so most codes are even) scores far above it.
+//shared_codes counts keys whose hash code equals an earlier key's: no number of bins separates
+//  them (e.g., an additive hash of the letters of anagrams).
+struct HashStatistics {
+  std::int64_t              bins            = 0;
+  std::int64_t              used            = 0;
+  std::vector<std::int64_t> chain_lengths;        //chain_lengths[k] = # bins holding k keys
+  int                       max_chain       = 0;
+  double                    collision_score = 0.0;
+  std::int64_t              shared_codes    = 0;
+
+  bool   counted        = false;         //true for HashCounters: the rest are counts, not 0
+  long   hits           = 0;             //lookups (has_key, [], put, erase, ...) that found their key
+  long   hit_probes     = 0;             //keys compared in them
+  long   misses         = 0;
+  long   miss_probes    = 0;
+  int    resizes        = 0;
+  double resize_seconds = 0.0;           //in ensure_load_threshold and incremental rehashing
+
+  double average_hit_probes  () const {return hits   == 0 ? 0.0 : double(hit_probes)/hits;}
+  double average_miss_probes () const {return misses == 0 ? 0.0 : double(miss_probes)/misses;}
+
+  //Called by statistics() for each bin (with its # of keys), then once with every key's hash code
+  void count_chain (int length);
+  void count_codes (std::vector<HashCode>& codes);
+
+  std::string str () const;
+};
+
+
+//Counter policies for HashMap/HashSet: NoHashCounters (the default) does nothing, so calls to
+//  it compile to nothing; HashCounters counts probes per lookup, resizes, and the time spent resizing.
+//Counters are mutable: queries count too. A copy or move of a container starts with no counts.
+class NoHashCounters {
+  public:
+    void lookup  (bool found, int probes) const {}
+    void resized ()                       const {}
+    void report  (HashStatistics& s)      const {}
+    void reset   ()                             {}
+
+    //Measures the time spent in its scope (when not nested in another Timer's)
+    class Timer {
+      public:
+        explicit Timer (const NoHashCounters& c) {}
+    };
+};
+
+class HashCounters {
+  public:
+    void lookup  (bool found, int probes) const {
+      if (found) {
+        ++hits;
+        hit_probes += probes;
+      }else{
+        ++misses;
+        miss_probes += probes;
+      }
+    }
+    void resized ()                       const {++resizes;}
+    void report  (HashStatistics& s)      const;
+    void reset   ();
+
+    class Timer {
+      public:
+        explicit Timer (const HashCounters& c) : counters(c) {
+          if (counters.timing++ == 0)
+            start = std::chrono::steady_clock::now();
+        }
+        ~Timer () {
+          if (--counters.timing == 0)
+            counters.resize_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+        }
+      private:
+        const HashCounters& counters;
+        std::chrono::steady_clock::time_point start;
+    };
+
+  private:
+    mutable long   hits           = 0;
+    mutable long   hit_probes     = 0;
+    mutable long   misses         = 0;
+    mutable long   miss_probes    = 0;
+    mutable int    resizes        = 0;
+    mutable double resize_seconds = 0.0;
+    mutable int    timing         = 0;   //# Timers alive
+};
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//HashStatistics/HashCounters definitions
+
+inline void HashStatistics::count_chain (int length) {
+  ++bins;
+  used += length;
+  if (length >= int(chain_lengths.size()))
+    chain_lengths.resize(length+1,0);
+  ++chain_lengths[length];
+  if (length > max_chain)
+    max_chain = length;
+}
+
+
+inline void HashStatistics::count_codes (std::vector<HashCode>& codes) {
+  std::sort(codes.begin(),codes.end());
+  shared_codes = 0;
+  for (std::size_t i=1; i<codes.size(); ++i)
+    shared_codes += codes[i] == codes[i-1];
+
+  double sum = 0.0;
+  for (int length=0; length<int(chain_lengths.size()); ++length)
+    sum += chain_lengths[length] * (double(length)*(length+1)/2);
+  double expected = bins == 0 ? 0.0 : (double(used)/(2.0*bins)) * (used+2.0*bins-1);
+  collision_score = expected == 0.0 ? 0.0 : sum/expected;
+}
+
+
+inline std::string HashStatistics::str () const {
+  std::ostringstream answer;
+  answer << "HashStatistics(bins=" << bins << ",used=" << used << ",max_chain=" << max_chain
+         << ",collision_score=" << collision_score << ",shared_codes=" << shared_codes << ",chain_lengths=[";
+  for (int length=0; length<int(chain_lengths.size()); ++length)
+    answer << (length == 0 ? "" : ",") << length << ":" << chain_lengths[length];
+  answer << "]";
+  if (counted)
+    answer << ",hits=" << hits << ",average_hit_probes=" << average_hit_probes()
+           << ",misses=" << misses << ",average_miss_probes=" << average_miss_probes()
+           << ",resizes=" << resizes << ",resize_seconds=" << resize_seconds;
+  answer << ")";
+  return answer.str();
+}
+
+
+inline void HashCounters::report (HashStatistics& s) const {
+  s.counted        = true;
+  s.hits           = hits;
+  s.hit_probes     = hit_probes;
+  s.misses         = misses;
+  s.miss_probes    = miss_probes;
+  s.resizes        = resizes;
+  s.resize_seconds = resize_seconds;
+}
+
+
+inline void HashCounters::reset () {
+  hits = hit_probes = misses = miss_probes = 0;
+  resizes = 0;
+  resize_seconds = 0.0;
+}
+
+
+}
+
+#endif /* HASH_STATISTICS_HPP_ */
@@ -0,0 +1,150 @@
+#ifndef HASHERS_HPP_
+#define HASHERS_HPP_
+
+#include <cstdint>
+#include <cstring>              //std::memcpy
+#include <string>
+#include <string_view>
+#include "pair.hpp"
+#include "array_queue.hpp"
+#include "hash_code.hpp"
+
+
+namespace ics {
+
+
+//Hash functions to supply as thash/chash for HashMap/HashSet (and the containers like them); each
+//  returns all 64 bits of its hash value (see hash_code.hpp).
+//hash_bytes is a wyhash-style hasher: it reads 8 bytes at a time and mixes them with a 64x64->128-bit
+//  multiply whose two halves are xored together. Inputs longer than 48 bytes go through three
+//  independent lanes per iteration, so the lanes' multiplies overlap instead of waiting on each other.
+//hash_combine mixes a value into a seed: unlike + or * it is not symmetric (combining a then b differs
+//  from b then a) and no value (like 0 for *) makes the result ignore the others.
+//hash_string and hash_string_view hash the same characters to the same value, so views can probe
+//  for strings (see HashMap's heterogeneous lookup).
+//hash_pair and hash_sequence combine their parts' hashes in order: pair[a,b] and pair[b,a] (or
+//  permutations of a sequence) hash differently.
+
+
+static constexpr std::uint64_t hash_secret[4] = {
+  0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull};
+
+
+//a*b as 128 bits: a = its low 64 bits, b = its high 64 bits
+inline void hash_multiply (std::uint64_t& a, std::uint64_t& b) {
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 product = (unsigned __int128)a * b;
+  a = std::uint64_t(product);
+  b = std::uint64_t(product >> 64);
+#else
+  std::uint64_t a_high = a >> 32, a_low = std::uint32_t(a), b_high = b >> 32, b_low = std::uint32_t(b);
+  std::uint64_t high_high = a_high*b_high, high_low = a_high*b_low, low_high = a_low*b_high, low_low = a_low*b_low;
+  std::uint64_t middle = (low_low >> 32) + std::uint32_t(high_low) + std::uint32_t(low_high);
+  a = (middle << 32) | std::uint32_t(low_low);
+  b = high_high + (high_low >> 32) + (low_high >> 32) + (middle >> 32);
+#endif
+}
+
+
+inline std::uint64_t hash_mix (std::uint64_t a, std::uint64_t b) {
+  hash_multiply(a,b);
+  return a ^ b;
+}
+
+
+//Unaligned reads (each memcpy compiles to one load)
+inline std::uint64_t hash_read8 (const unsigned char* p) {std::uint64_t v; std::memcpy(&v,p,8); return v;}
+inline std::uint64_t hash_read4 (const unsigned char* p) {std::uint32_t v; std::memcpy(&v,p,4); return v;}
+inline std::uint64_t hash_read3 (const unsigned char* p, std::size_t length)   //1 <= length <= 3
+{return (std::uint64_t(p[0]) << 16) | (std::uint64_t(p[length >> 1]) << 8) | p[length-1];}
+
+
+inline std::uint64_t hash_bytes (const void* data, std::size_t length, std::uint64_t seed = 0) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  seed ^= hash_mix(seed ^ hash_secret[0], hash_secret[1]);
+  std::uint64_t a, b;
+  if (length <= 16) {
+    if (length >= 4) {         //two (possibly overlapping) 4-byte reads from each end
+      std::size_t middle = (length >> 3) << 2;
+      a = (hash_read4(p) << 32) | hash_read4(p+middle);
+      b = (hash_read4(p+length-4) << 32) | hash_read4(p+length-4-middle);
+    }else if (length > 0) {
+      a = hash_read3(p,length);
+      b = 0;
+    }else
+      a = b = 0;
+  }else{
+    std::size_t i = length;
+    if (i > 48) {              //bulk loop: three lanes of 16 bytes
+      std::uint64_t lane1 = seed, lane2 = seed;
+      do {
+        seed  = hash_mix(hash_read8(p)    ^ hash_secret[1], hash_read8(p+8)  ^ seed);
+        lane1 = hash_mix(hash_read8(p+16) ^ hash_secret[2], hash_read8(p+24) ^ lane1);
+        lane2 = hash_mix(hash_read8(p+32) ^ hash_secret[3], hash_read8(p+40) ^ lane2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= lane1 ^ lane2;
+    }
+    for (; i > 16; i -= 16, p += 16)
+      seed = hash_mix(hash_read8(p) ^ hash_secret[1], hash_read8(p+8) ^ seed);
+    a = hash_read8(p+i-16);    //the last 16 bytes (overlapping bytes already mixed)
+    b = hash_read8(p+i-8);
+  }
+  a ^= hash_secret[1];
+  b ^= seed;
+  hash_multiply(a,b);
+  return hash_mix(a ^ hash_secret[0] ^ length, b ^ hash_secret[1]);
+}
+
+
+inline std::uint64_t hash_combine (std::uint64_t seed, std::uint64_t value) {
+  seed  ^= hash_secret[0];
+  value ^= hash_secret[1];
+  hash_multiply(seed,value);
+  return hash_mix(seed ^ hash_secret[0], value ^ hash_secret[1]);
+}
+
+
+template<class Integer>
+std::uint64_t hash_integer (const Integer& i) {
+  return hash_combine(hash_secret[2], to_hash_code(i));
+}
+
+
+inline std::uint64_t hash_string_view (const std::string_view& s) {
+  return hash_bytes(s.data(),s.size());
+}
+
+
+inline std::uint64_t hash_string (const std::string& s) {
+  return hash_bytes(s.data(),s.size());
+}
+
+
+//e.g., hash_pair<hash_string,hash_string,std::string,std::string> for ics::pair<std::string,std::string>
+template<auto first_hash, auto second_hash, class First, class Second>
+std::uint64_t hash_pair (const pair<First,Second>& p) {
+  return hash_combine(to_hash_code(first_hash(p.first)), to_hash_code(second_hash(p.second)));
+}
+
+
+//Any Iterable whose values element_hash hashes: e.g., hash_sequence<hash_string,ArrayQueue<std::string>>
+template<auto element_hash, class Iterable>
+std::uint64_t hash_sequence (const Iterable& i) {
+  std::uint64_t answer = hash_secret[3];
+  for (const auto& v : i)
+    answer = hash_combine(answer, to_hash_code(element_hash(v)));
+  return answer;
+}
+
+
+//The key of wordgenerator's corpus
+inline std::uint64_t hash_string_queue (const ArrayQueue<std::string>& q) {
+  return hash_sequence<hash_string>(q);
+}
+
+
+}
+
+#endif /* HASHERS_HPP_ */
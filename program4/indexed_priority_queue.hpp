@@ -0,0 +1,435 @@
+#ifndef INDEXED_PRIORITY_QUEUE_HPP_
+#define INDEXED_PRIORITY_QUEUE_HPP_
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <cstdint>
+#include <vector>
+#include <algorithm>            //std::sort (operator <<)
+#include <utility>              //std::move
+#include "ics_exceptions.hpp"
+#include "template_function.hpp"
+
+
+namespace ics {
+
+
+#ifndef undefinedgtdefined
+#define undefinedgtdefined
+template<class T>
+bool undefinedgt (const T& a, const T& b) {return false;}
+#endif /* undefinedgtdefined */
+
+//An IndexedHeapPriorityQueue is an addressable binary heap: enqueue returns a Handle for the value,
+//  which stays valid (wherever the value moves in the heap) until that value is dequeued or erased.
+//  With a Handle, a value's priority can be changed (decrease_key/update) or the value erased in
+//  O(log N); a HeapPriorityQueue can only find a value by scanning its array.
+//tgt/cgt are supplied and checked as for HeapPriorityQueue: gt(a,b) is true iff a has higher priority
+//  than b.
+//The heap stores each value with its slot; position[slot] is the value's index in the heap, kept up
+//  to date by percolate_up/percolate_down as they move values. A Handle is its slot and the slot's
+//  generation: a slot is reused once its value leaves the queue, but with a new generation, so a stale
+//  Handle is never mistaken for the new value's (contains is false for it).
+template<class T, bool (*tgt)(const T& a, const T& b) = undefinedgt<T>> class IndexedHeapPriorityQueue {
+  public:
+    typedef bool (*gtfunc) (const T& a, const T& b);
+    typedef std::uint64_t Handle;
+    static constexpr Handle no_handle = ~Handle(0);     //Never returned by enqueue
+
+    //Destructor/Constructors
+    ~IndexedHeapPriorityQueue();
+
+    IndexedHeapPriorityQueue(bool (*cgt)(const T& a, const T& b) = undefinedgt<T>);
+    IndexedHeapPriorityQueue(const IndexedHeapPriorityQueue<T,tgt>& to_copy);      //Handles are valid in both
+    IndexedHeapPriorityQueue(IndexedHeapPriorityQueue<T,tgt>&& to_move) noexcept;  //to_move is left empty
+
+
+    //Queries
+    bool         empty    () const;
+    std::int64_t size     () const;
+    const T&     peek     () const;                     //EmptyError if empty
+    Handle       peek_handle () const;                  //EmptyError if empty
+    bool         contains (Handle h) const;             //Whether h's value is still in the queue
+    const T&     value    (Handle h) const;             //KeyError if !contains(h)
+    std::string  str      () const; //supplies useful debugging information; contrast to operator <<
+
+
+    //Commands
+    Handle enqueue      (const T& element);
+    Handle enqueue      (T&& element);
+    T      dequeue      ();                             //EmptyError if empty
+    void   decrease_key (Handle h, const T& element);   //element must not have lower priority than h's value (IcsError)
+    void   update       (Handle h, const T& element);   //Any new priority
+    T      erase        (Handle h);                     //KeyError if !contains(h)
+    void   clear        ();                             //Every Handle becomes stale
+
+    //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
+    template <class Iterable>
+    std::int64_t enqueue_all (const Iterable& i);
+
+    //Internal iteration: visit(value) for each value (as a const T&) in the heap's array order, not
+    //  priority order; visit must not change the priority queue
+    template<class Visitor>
+    void for_each (Visitor visit) const;
+
+
+    //Operators
+    IndexedHeapPriorityQueue<T,tgt>& operator = (const IndexedHeapPriorityQueue<T,tgt>& rhs);
+    IndexedHeapPriorityQueue<T,tgt>& operator = (IndexedHeapPriorityQueue<T,tgt>&& rhs) noexcept;
+
+    template<class T2, bool (*gt2)(const T2& a, const T2& b)>
+    friend std::ostream& operator << (std::ostream& outs, const IndexedHeapPriorityQueue<T2,gt2>& pq);
+
+
+  private:
+    class Entry {
+      public:
+        T             value;
+        std::uint32_t slot;
+    };
+
+    TemplateFunction<gtfunc,tgt,undefinedgt<T>> gt; //The gt used by the heap (from template or constructor)
+    std::vector<Entry>         heap;               //Heap ordered by gt of the values
+    std::vector<std::int64_t>  position;           //position[slot]: index in heap of slot's value; -1 if free
+    std::vector<std::uint32_t> generation;         //generation[slot]: part of the Handle of slot's value
+    std::vector<std::uint32_t> free_slots;         //Slots whose values left the queue
+
+
+    //Helper methods
+    std::int64_t slot_index     (Handle h, const char* where) const;  //h's index in heap; KeyError if stale
+    Handle       new_handle     (std::int64_t index);                 //A free slot, recording index
+    T            remove_at      (std::int64_t i);                     //Remove heap[i]; free its slot
+    void         place          (std::int64_t i, Entry&& e);          //heap[i] = e, recording its position
+    void         percolate_up   (std::int64_t i);
+    void         percolate_down (std::int64_t i);
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//IndexedHeapPriorityQueue class and related definitions
+
+//Destructor/Constructors
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+IndexedHeapPriorityQueue<T,tgt>::~IndexedHeapPriorityQueue()
+{}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+IndexedHeapPriorityQueue<T,tgt>::IndexedHeapPriorityQueue(bool (*cgt)(const T& a, const T& b))
+: gt(tgt != (gtfunc)undefinedgt<T> ? tgt : cgt) {
+  if (gt == (gtfunc)undefinedgt<T>)
+    throw TemplateFunctionError("IndexedHeapPriorityQueue::default constructor: neither specified");
+  if (tgt != (gtfunc)undefinedgt<T> && cgt != (gtfunc)undefinedgt<T> && tgt != cgt)
+    throw TemplateFunctionError("IndexedHeapPriorityQueue::default constructor: both specified and different");
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+IndexedHeapPriorityQueue<T,tgt>::IndexedHeapPriorityQueue(const IndexedHeapPriorityQueue<T,tgt>& to_copy)
+: gt(to_copy.gt), heap(to_copy.heap), position(to_copy.position), generation(to_copy.generation), free_slots(to_copy.free_slots)
+{}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+IndexedHeapPriorityQueue<T,tgt>::IndexedHeapPriorityQueue(IndexedHeapPriorityQueue<T,tgt>&& to_move) noexcept
+: gt(to_move.gt), heap(std::move(to_move.heap)), position(std::move(to_move.position)),
+  generation(std::move(to_move.generation)), free_slots(std::move(to_move.free_slots)) {
+  to_move.clear();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Queries
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+bool IndexedHeapPriorityQueue<T,tgt>::empty() const {
+  return heap.empty();
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+std::int64_t IndexedHeapPriorityQueue<T,tgt>::size() const {
+  return heap.size();
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+const T& IndexedHeapPriorityQueue<T,tgt>::peek () const {
+  if (empty())
+    throw EmptyError("IndexedHeapPriorityQueue::peek");
+
+  return heap[0].value;
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+auto IndexedHeapPriorityQueue<T,tgt>::peek_handle () const -> Handle {
+  if (empty())
+    throw EmptyError("IndexedHeapPriorityQueue::peek_handle");
+
+  return (Handle(generation[heap[0].slot]) << 32) | heap[0].slot;
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+bool IndexedHeapPriorityQueue<T,tgt>::contains (Handle h) const {
+  std::uint32_t slot = std::uint32_t(h);
+  return slot < position.size() && position[slot] >= 0 && generation[slot] == std::uint32_t(h >> 32);
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+const T& IndexedHeapPriorityQueue<T,tgt>::value (Handle h) const {
+  return heap[slot_index(h,"IndexedHeapPriorityQueue::value")].value;
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+std::string IndexedHeapPriorityQueue<T,tgt>::str() const {
+  std::ostringstream answer;
+  answer << "IndexedHeapPriorityQueue[";
+  for (std::size_t i=0; i<heap.size(); ++i)
+    answer << (i == 0 ? "" : ",") << i << ":" << heap[i].value << "@" << heap[i].slot;
+  answer << "](size=" << heap.size() << ",slots=" << position.size() << ",free=" << free_slots.size() << ")";
+  return answer.str();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Commands
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+auto IndexedHeapPriorityQueue<T,tgt>::enqueue(const T& element) -> Handle {
+  return enqueue(T(element));
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+auto IndexedHeapPriorityQueue<T,tgt>::enqueue(T&& element) -> Handle {
+  std::int64_t i = heap.size();
+  Handle answer = new_handle(i);
+  heap.push_back(Entry{std::move(element),std::uint32_t(answer)});
+  percolate_up(i);
+  return answer;
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+T IndexedHeapPriorityQueue<T,tgt>::dequeue() {
+  if (empty())
+    throw EmptyError("IndexedHeapPriorityQueue::dequeue");
+
+  return remove_at(0);
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+void IndexedHeapPriorityQueue<T,tgt>::decrease_key(Handle h, const T& element) {
+  std::int64_t i = slot_index(h,"IndexedHeapPriorityQueue::decrease_key");
+  if (gt(heap[i].value,element))
+    throw IcsError("IndexedHeapPriorityQueue::decrease_key: new value has lower priority");
+
+  heap[i].value = element;
+  percolate_up(i);
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+void IndexedHeapPriorityQueue<T,tgt>::update(Handle h, const T& element) {
+  std::int64_t i = slot_index(h,"IndexedHeapPriorityQueue::update");
+  bool higher = gt(element,heap[i].value);
+  heap[i].value = element;
+  if (higher)
+    percolate_up(i);
+  else
+    percolate_down(i);
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+T IndexedHeapPriorityQueue<T,tgt>::erase(Handle h) {
+  return remove_at(slot_index(h,"IndexedHeapPriorityQueue::erase"));
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+void IndexedHeapPriorityQueue<T,tgt>::clear() {
+  for (const Entry& e : heap) {
+    position[e.slot] = -1;
+    ++generation[e.slot];
+    free_slots.push_back(e.slot);
+  }
+  heap.clear();
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+template <class Iterable>
+std::int64_t IndexedHeapPriorityQueue<T,tgt>::enqueue_all (const Iterable& i) {
+  std::int64_t count = 0;
+  for (const T& v : i) {
+    enqueue(v);
+    ++count;
+  }
+
+  return count;
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+template<class Visitor>
+void IndexedHeapPriorityQueue<T,tgt>::for_each (Visitor visit) const {
+  for (const Entry& e : heap)
+    visit(e.value);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Operators
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+IndexedHeapPriorityQueue<T,tgt>& IndexedHeapPriorityQueue<T,tgt>::operator = (const IndexedHeapPriorityQueue<T,tgt>& rhs) {
+  if (this == &rhs)
+    return *this;
+
+  gt         = rhs.gt;
+  heap       = rhs.heap;
+  position   = rhs.position;
+  generation = rhs.generation;
+  free_slots = rhs.free_slots;
+  return *this;
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+IndexedHeapPriorityQueue<T,tgt>& IndexedHeapPriorityQueue<T,tgt>::operator = (IndexedHeapPriorityQueue<T,tgt>&& rhs) noexcept {
+  if (this == &rhs)
+    return *this;
+
+  gt         = rhs.gt;
+  heap       = std::move(rhs.heap);
+  position   = std::move(rhs.position);
+  generation = std::move(rhs.generation);
+  free_slots = std::move(rhs.free_slots);
+  rhs.clear();
+  return *this;
+}
+
+
+//Highest priority first (sorting a copy of the values; the queue is unchanged)
+template<class T, bool (*tgt)(const T& a, const T& b)>
+std::ostream& operator << (std::ostream& outs, const IndexedHeapPriorityQueue<T,tgt>& p) {
+  std::vector<T> values;
+  p.for_each([&values] (const T& v) {values.push_back(v);});
+  std::sort(values.begin(),values.end(),[&p] (const T& a, const T& b) {return p.gt(a,b);});
+
+  outs << "indexed_priority_queue[";
+  for (std::size_t i=0; i<values.size(); ++i)
+    outs << (i == 0 ? "" : ",") << values[i];
+  outs << "]:highest";
+  return outs;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Private helper methods
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+std::int64_t IndexedHeapPriorityQueue<T,tgt>::slot_index (Handle h, const char* where) const {
+  if (!contains(h)) {
+    std::ostringstream answer;
+    answer << where << ": handle(" << h << ") not in queue";
+    throw KeyError(answer.str());
+  }
+  return position[std::uint32_t(h)];
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+auto IndexedHeapPriorityQueue<T,tgt>::new_handle (std::int64_t index) -> Handle {
+  std::uint32_t slot;
+  if (free_slots.empty()) {
+    slot = std::uint32_t(position.size());
+    position.push_back(index);
+    generation.push_back(0);
+  } else {
+    slot = free_slots.back();
+    free_slots.pop_back();
+    position[slot] = index;
+  }
+  return (Handle(generation[slot]) << 32) | slot;
+}
+
+
+//The last value fills the hole at i, then moves up or down (at most one of them does anything)
+template<class T, bool (*tgt)(const T& a, const T& b)>
+T IndexedHeapPriorityQueue<T,tgt>::remove_at (std::int64_t i) {
+  std::uint32_t slot = heap[i].slot;
+  T answer = std::move(heap[i].value);
+  position[slot] = -1;
+  ++generation[slot];
+  free_slots.push_back(slot);
+
+  std::int64_t last = std::int64_t(heap.size()) - 1;
+  if (i != last) {
+    place(i,std::move(heap[last]));
+    heap.pop_back();
+    percolate_up(i);
+    percolate_down(i);
+  } else
+    heap.pop_back();
+  return answer;
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+void IndexedHeapPriorityQueue<T,tgt>::place (std::int64_t i, Entry&& e) {
+  position[e.slot] = i;
+  heap[i] = std::move(e);
+}
+
+
+//Hole-based: the value at i is moved out once, ancestors of lower priority move down one level into
+//  the hole (recording their new positions), and the value is moved into the hole where it stops
+template<class T, bool (*tgt)(const T& a, const T& b)>
+void IndexedHeapPriorityQueue<T,tgt>::percolate_up (std::int64_t i) {
+  if (i == 0 || !gt(heap[i].value,heap[(i-1)/2].value))
+    return;
+  Entry moving = std::move(heap[i]);
+  for (/*parameter*/; i != 0 && gt(moving.value,heap[(i-1)/2].value); i = (i-1)/2)
+    place(i,std::move(heap[(i-1)/2]));
+  place(i,std::move(moving));
+}
+
+
+template<class T, bool (*tgt)(const T& a, const T& b)>
+void IndexedHeapPriorityQueue<T,tgt>::percolate_down (std::int64_t i) {
+  std::int64_t n = heap.size();
+  if (2*i+1 >= n)
+    return;
+  Entry moving = std::move(heap[i]);
+  for (std::int64_t l = 2*i+1; l < n; l = 2*i+1) {
+    std::int64_t r = l+1;
+    std::int64_t max_child = (r >= n || gt(heap[l].value,heap[r].value) ? l : r);
+    if (!gt(heap[max_child].value,moving.value))
+      break;
+    place(i,std::move(heap[max_child]));
+    i = max_child;
+  }
+  place(i,std::move(moving));
+}
+
+
+}
+
+#endif /* INDEXED_PRIORITY_QUEUE_HPP_ */
@@ -0,0 +1,616 @@
+#ifndef MAPPED_HASH_MAP_HPP_
+#define MAPPED_HASH_MAP_HPP_
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>                //open
+#include <unistd.h>               //close
+#include <sys/mman.h>             //mmap, munmap
+#include <sys/stat.h>             //fstat
+#include "ics_exceptions.hpp"
+#include "pair.hpp"
+#include "hash_image.hpp"
+
+
+namespace ics {
+
+
+#ifndef undefinedhashdefined
+#define undefinedhashdefined
+template<class T, class R = int>
+R undefinedhash (const T& a) {return 0;}
+#endif /* undefinedhashdefined */
+
+//MappedImage is a file written by HashMap/HashSet::write_image, mapped (mmap) read-only into memory,
+//  with the helpers that MappedHashMap and MappedHashSet (below) use to search it in place.
+//Its constructor throws IcsError if the file cannot be mapped, or if its header does not describe an
+//  image of the expected kind (map/set) and key/value fields. Past the header, the image is trusted.
+//Mapping costs nearly nothing whatever the image's size: the operating system reads each page of
+//  the file the first time it is used (and can share the pages among processes mapping the file).
+template<class KEY,class T>
+class MappedImage {
+  public:
+    typedef typename ImageField<KEY>::View KeyView;
+    typedef typename ImageField<T>::View   ValueView;
+
+    ~MappedImage ();
+    MappedImage  (const std::string& file_name, bool is_map, const std::string& who);
+    MappedImage  (const MappedImage<KEY,T>& to_copy) = delete;
+    MappedImage<KEY,T>& operator = (const MappedImage<KEY,T>& rhs) = delete;
+
+    std::int64_t size  ()                             const {return header->used;}
+    const char*  entry (uint64_t i)                   const {return image + header->entries_offset + i*header->entry_size;}
+    KeyView      key   (const char* e)                const {return ImageField<KEY>::read(image,*header,e+8);}
+    ValueView    value (const char* e)                const {return ImageField<T>::read(image,*header,e+8+ImageField<KEY>::size);}
+    const char*  find  (const KEY& key, HashCode code) const;  //Returns key's entry or nullptr
+
+  private:
+    const char*        image  = nullptr;  //The mapped file
+    size_t             length = 0;        //# bytes mapped
+    const ImageHeader* header = nullptr;  //At image
+    const uint64_t*    bin_start;         //At image + header->bins_offset
+    int                bits;              //header->bins == 2^bits
+
+    //Helper methods
+    void check (bool is_map, const std::string& problem_prefix) const;  //Throw IcsError if not the expected image
+};
+
+
+//Instantiate the templated classes supplying thash(a): produces a hash value for a.
+//If thash is defaulted to undefinedhash in the template, then a constructor must supply chash.
+//If both thash and chash are supplied, then they must be the same (by ==) function.
+//If neither is supplied, or both are supplied but different, TemplateFunctionError is raised.
+//The (unique) non-undefinedhash value supplied by thash/chash is stored in the instance variable hash;
+//  it must be the hash function of the HashMap/HashSet that wrote the image.
+//A MappedHashMap/MappedHashSet is read-only: it answers queries from the image without building
+//  any table. Its keys (and values) are ImageField Views: std::string as std::string_view (pointing
+//  into the image, valid while it is mapped), others as copies. There is no mod_count: the image
+//  never changes.
+template<class KEY,class T, auto thash = undefinedhash<KEY>> class MappedHashMap {
+  public:
+    typedef typename MappedImage<KEY,T>::KeyView   KeyView;
+    typedef typename MappedImage<KEY,T>::ValueView ValueView;
+    typedef ics::pair<KeyView,ValueView>           Entry;
+    typedef decltype(thash) hashfunc;
+
+    //Destructor/Constructors
+    ~MappedHashMap ();
+
+    explicit MappedHashMap (const std::string& file_name, hashfunc chash = undefinedhash<KEY>);
+
+
+    //Queries
+    bool empty      () const;
+    std::int64_t size () const;
+    bool has_key    (const KEY& key) const;
+    std::string str () const; //supplies useful debugging information; contrast to operator <<
+
+
+    //Operators
+
+    ValueView operator [] (const KEY& key) const;   //KeyError if absent
+
+    template<class KEY2,class T2, auto hash2>
+    friend std::ostream& operator << (std::ostream& outs, const MappedHashMap<KEY2,T2,hash2>& m);
+
+
+
+    class Iterator {
+      public:
+        //Private constructor called in begin/end, which are friends of MappedHashMap<T>
+        ~Iterator();
+        std::string str  () const;
+        MappedHashMap<KEY,T,thash>::Iterator& operator ++ ();
+        MappedHashMap<KEY,T,thash>::Iterator  operator ++ (int);
+        bool operator == (const MappedHashMap<KEY,T,thash>::Iterator& rhs) const;
+        bool operator != (const MappedHashMap<KEY,T,thash>::Iterator& rhs) const;
+        const Entry& operator *  () const;
+        const Entry* operator -> () const;
+        friend std::ostream& operator << (std::ostream& outs, const MappedHashMap<KEY,T,thash>::Iterator& i) {
+          outs << i.str(); //Use the same meaning as the debugging .str() method
+          return outs;
+        }
+        friend Iterator MappedHashMap<KEY,T,thash>::begin () const;
+        friend Iterator MappedHashMap<KEY,T,thash>::end   () const;
+
+      private:
+        std::int64_t current; //Index of entry in image (entries are in bin order); stop: current == size()
+        Entry        entry;   //Views of current's key and value
+        const MappedHashMap<KEY,T,thash>* ref_map;
+
+        //Called in friends begin/end
+        Iterator(const MappedHashMap<KEY,T,thash>* iterate_over, std::int64_t initial);
+    };
+
+
+    Iterator begin () const;
+    Iterator end   () const;
+
+
+  private:
+    hashfunc hash;              //Hashing function used (from template or constructor)
+    MappedImage<KEY,T> image;
+};
+
+
+template<class T, auto thash = undefinedhash<T>> class MappedHashSet {
+  public:
+    typedef typename MappedImage<T,T>::KeyView View;
+    typedef decltype(thash) hashfunc;
+
+    //Destructor/Constructors
+    ~MappedHashSet ();
+
+    explicit MappedHashSet (const std::string& file_name, hashfunc chash = undefinedhash<T>);
+
+
+    //Queries
+    bool empty      () const;
+    std::int64_t size () const;
+    bool contains   (const T& element) const;
+    std::string str () const; //supplies useful debugging information; contrast to operator <<
+
+
+    //Operators
+
+    template<class T2, auto hash2>
+    friend std::ostream& operator << (std::ostream& outs, const MappedHashSet<T2,hash2>& s);
+
+
+
+    class Iterator {
+      public:
+        //Private constructor called in begin/end, which are friends of MappedHashSet<T>
+        ~Iterator();
+        std::string str  () const;
+        MappedHashSet<T,thash>::Iterator& operator ++ ();
+        MappedHashSet<T,thash>::Iterator  operator ++ (int);
+        bool operator == (const MappedHashSet<T,thash>::Iterator& rhs) const;
+        bool operator != (const MappedHashSet<T,thash>::Iterator& rhs) const;
+        View operator *  () const;
+        friend std::ostream& operator << (std::ostream& outs, const MappedHashSet<T,thash>::Iterator& i) {
+          outs << i.str(); //Use the same meaning as the debugging .str() method
+          return outs;
+        }
+        friend Iterator MappedHashSet<T,thash>::begin () const;
+        friend Iterator MappedHashSet<T,thash>::end   () const;
+
+      private:
+        std::int64_t current; //Index of element in image; stop: current == size()
+        const MappedHashSet<T,thash>* ref_set;
+
+        //Called in friends begin/end
+        Iterator(const MappedHashSet<T,thash>* iterate_over, std::int64_t initial);
+    };
+
+
+    Iterator begin () const;
+    Iterator end   () const;
+
+
+  private:
+    hashfunc hash;              //Hashing function used (from template or constructor)
+    MappedImage<T,T> image;
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//MappedImage class definitions
+
+template<class KEY,class T>
+MappedImage<KEY,T>::~MappedImage() {
+  if (image != nullptr)
+    munmap(const_cast<char*>(image),length);
+}
+
+
+template<class KEY,class T>
+MappedImage<KEY,T>::MappedImage(const std::string& file_name, bool is_map, const std::string& who) {
+  std::string problem_prefix = who + ": " + file_name + ": ";
+  int fd = open(file_name.c_str(),O_RDONLY);
+  if (fd < 0)
+    throw IcsError(problem_prefix + "cannot open: " + std::strerror(errno));
+
+  struct stat status;
+  if (fstat(fd,&status) != 0 || status.st_size < off_t(sizeof(ImageHeader))) {
+    close(fd);
+    throw IcsError(problem_prefix + "not a hash image (too short)");
+  }
+  length = status.st_size;
+  void* mapped = mmap(nullptr,length,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);                                    //the mapping keeps the file open
+  if (mapped == MAP_FAILED)
+    throw IcsError(problem_prefix + "cannot map: " + std::strerror(errno));
+
+  image  = static_cast<const char*>(mapped);
+  header = reinterpret_cast<const ImageHeader*>(image);
+  try {
+    check(is_map,problem_prefix);
+  } catch (IcsError& e) {
+    munmap(mapped,length);                      //the destructor will not run
+    throw;
+  }
+  bin_start = reinterpret_cast<const uint64_t*>(image + header->bins_offset);
+  bits      = bin_bits(header->bins);
+}
+
+
+template<class KEY,class T>
+const char* MappedImage<KEY,T>::find (const KEY& key, HashCode code) const {
+  std::int64_t b = bin_index(code,bits);
+  for (uint64_t i=bin_start[b]; i<bin_start[b+1]; ++i) {
+    const char* e = entry(i);
+    HashCode e_code;
+    std::memcpy(&e_code,e,sizeof(e_code));
+    if (e_code == code && this->key(e) == key)
+      return e;
+  }
+  return nullptr;
+}
+
+
+template<class KEY,class T>
+void MappedImage<KEY,T>::check (bool is_map, const std::string& problem_prefix) const {
+  const ImageHeader& h = *header;
+  const char* problem = nullptr;
+  uint64_t entry_size = 8 + ImageField<KEY>::size + (is_map ? ImageField<T>::size : 0);
+  if (std::memcmp(h.magic,image_magic,sizeof(h.magic)) != 0)
+    problem = "not a hash image";
+  else if (h.version != image_version)
+    problem = "unsupported image version";
+  else if (h.is_map != uint32_t(is_map))
+    problem = is_map ? "image of a HashSet, not a HashMap" : "image of a HashMap, not a HashSet";
+  else if (h.key_tag != ImageField<KEY>::tag || h.value_tag != (is_map ? ImageField<T>::tag : 0) || h.entry_size != entry_size)
+    problem = "image of different key/value types";
+  else if (h.bins < 1 || (h.bins & (h.bins-1)) != 0 || h.bins_offset != (sizeof(ImageHeader)+7)/8*8
+        || h.entries_offset != h.bins_offset + (h.bins+1)*sizeof(uint64_t)
+        || h.strings_offset != h.entries_offset + h.used*h.entry_size
+        || h.image_size < h.strings_offset || h.image_size > length)
+    problem = "damaged or truncated image";
+  else if (reinterpret_cast<const uint64_t*>(image + h.bins_offset)[h.bins] != h.used)
+    problem = "damaged image";
+
+  if (problem != nullptr)
+    throw IcsError(problem_prefix + problem);
+}
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//MappedHashMap class and related definitions
+
+//Destructor/Constructors
+
+template<class KEY,class T, auto thash>
+MappedHashMap<KEY,T,thash>::~MappedHashMap()
+{}
+
+
+template<class KEY,class T, auto thash>
+MappedHashMap<KEY,T,thash>::MappedHashMap(const std::string& file_name, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), image(file_name,true,"MappedHashMap") {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("MappedHashMap::constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("MappedHashMap::constructor: both specified and different");
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Queries
+
+template<class KEY,class T, auto thash>
+bool MappedHashMap<KEY,T,thash>::empty() const {
+  return image.size() == 0;
+}
+
+
+template<class KEY,class T, auto thash>
+std::int64_t MappedHashMap<KEY,T,thash>::size() const {
+  return image.size();
+}
+
+
+template<class KEY,class T, auto thash>
+bool MappedHashMap<KEY,T,thash>::has_key (const KEY& key) const {
+  return image.find(key,to_hash_code(hash(key))) != nullptr;
+}
+
+
+template<class KEY,class T, auto thash>
+std::string MappedHashMap<KEY,T,thash>::str() const {
+  std::ostringstream answer;
+  answer << "MappedHashMap[";
+  for (std::int64_t i=0; i<image.size(); ++i)
+    answer << (i == 0 ? "" : ",") << image.key(image.entry(i)) << "->" << image.value(image.entry(i));
+  answer << "](used=" << image.size() << ")";
+  return answer.str();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Operators
+
+template<class KEY,class T, auto thash>
+auto MappedHashMap<KEY,T,thash>::operator [] (const KEY& key) const -> ValueView {
+  const char* e = image.find(key,to_hash_code(hash(key)));
+  if (e != nullptr)
+    return image.value(e);
+
+  std::ostringstream answer;
+  answer << "MappedHashMap::operator []: key(" << key << ") not in Map";
+  throw KeyError(answer.str());
+}
+
+
+template<class KEY,class T, auto thash>
+std::ostream& operator << (std::ostream& outs, const MappedHashMap<KEY,T,thash>& m) {
+  outs << "map[";
+  for (std::int64_t i=0; i<m.image.size(); ++i)
+    outs << (i == 0 ? "" : ",") << m.image.key(m.image.entry(i)) << "->" << m.image.value(m.image.entry(i));
+  outs << "]";
+  return outs;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator constructors
+
+template<class KEY,class T, auto thash>
+auto MappedHashMap<KEY,T,thash>::begin () const -> MappedHashMap<KEY,T,thash>::Iterator {
+  return Iterator(this,0);
+}
+
+
+template<class KEY,class T, auto thash>
+auto MappedHashMap<KEY,T,thash>::end () const -> MappedHashMap<KEY,T,thash>::Iterator {
+  return Iterator(this,image.size());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator class definitions
+
+template<class KEY,class T, auto thash>
+MappedHashMap<KEY,T,thash>::Iterator::Iterator(const MappedHashMap<KEY,T,thash>* iterate_over, std::int64_t initial)
+: current(initial), ref_map(iterate_over) {
+  if (current < ref_map->image.size())
+    entry = Entry(ref_map->image.key(ref_map->image.entry(current)),ref_map->image.value(ref_map->image.entry(current)));
+}
+
+
+template<class KEY,class T, auto thash>
+MappedHashMap<KEY,T,thash>::Iterator::~Iterator()
+{}
+
+
+template<class KEY,class T, auto thash>
+std::string MappedHashMap<KEY,T,thash>::Iterator::str () const {
+  std::ostringstream answer;
+  answer << "MappedHashMap::Iterator(current=" << current << "/" << ref_map->image.size() << ")";
+  return answer.str();
+}
+
+
+template<class KEY,class T, auto thash>
+auto MappedHashMap<KEY,T,thash>::Iterator::operator ++ () -> MappedHashMap<KEY,T,thash>::Iterator& {
+  if (current == ref_map->image.size())
+    return *this;
+
+  if (++current < ref_map->image.size())
+    entry = Entry(ref_map->image.key(ref_map->image.entry(current)),ref_map->image.value(ref_map->image.entry(current)));
+  return *this;
+}
+
+
+template<class KEY,class T, auto thash>
+auto MappedHashMap<KEY,T,thash>::Iterator::operator ++ (int) -> MappedHashMap<KEY,T,thash>::Iterator {
+  Iterator to_return(*this);
+  ++(*this);
+  return to_return;
+}
+
+
+template<class KEY,class T, auto thash>
+bool MappedHashMap<KEY,T,thash>::Iterator::operator == (const MappedHashMap<KEY,T,thash>::Iterator& rhs) const {
+  if (ref_map != rhs.ref_map)
+    throw ComparingDifferentIteratorsError("MappedHashMap::Iterator::operator ==");
+
+  return current == rhs.current;
+}
+
+
+template<class KEY,class T, auto thash>
+bool MappedHashMap<KEY,T,thash>::Iterator::operator != (const MappedHashMap<KEY,T,thash>::Iterator& rhs) const {
+  return !(*this == rhs);
+}
+
+
+template<class KEY,class T, auto thash>
+auto MappedHashMap<KEY,T,thash>::Iterator::operator *() const -> const Entry& {
+  if (current == ref_map->image.size())
+    throw IteratorPositionIllegal("MappedHashMap::Iterator::operator * Iterator illegal: exhausted");
+
+  return entry;
+}
+
+
+template<class KEY,class T, auto thash>
+auto MappedHashMap<KEY,T,thash>::Iterator::operator ->() const -> const Entry* {
+  if (current == ref_map->image.size())
+    throw IteratorPositionIllegal("MappedHashMap::Iterator::operator -> Iterator illegal: exhausted");
+
+  return &entry;
+}
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//MappedHashSet class and related definitions
+
+//Destructor/Constructors
+
+template<class T, auto thash>
+MappedHashSet<T,thash>::~MappedHashSet()
+{}
+
+
+template<class T, auto thash>
+MappedHashSet<T,thash>::MappedHashSet(const std::string& file_name, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), image(file_name,false,"MappedHashSet") {
+  if (hash == (hashfunc)undefinedhash<T>)
+    throw TemplateFunctionError("MappedHashSet::constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
+    throw TemplateFunctionError("MappedHashSet::constructor: both specified and different");
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Queries
+
+template<class T, auto thash>
+bool MappedHashSet<T,thash>::empty() const {
+  return image.size() == 0;
+}
+
+
+template<class T, auto thash>
+std::int64_t MappedHashSet<T,thash>::size() const {
+  return image.size();
+}
+
+
+template<class T, auto thash>
+bool MappedHashSet<T,thash>::contains (const T& element) const {
+  return image.find(element,to_hash_code(hash(element))) != nullptr;
+}
+
+
+template<class T, auto thash>
+std::string MappedHashSet<T,thash>::str() const {
+  std::ostringstream answer;
+  answer << "MappedHashSet[";
+  for (std::int64_t i=0; i<image.size(); ++i)
+    answer << (i == 0 ? "" : ",") << image.key(image.entry(i));
+  answer << "](used=" << image.size() << ")";
+  return answer.str();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Operators
+
+template<class T, auto thash>
+std::ostream& operator << (std::ostream& outs, const MappedHashSet<T,thash>& s) {
+  outs << "set[";
+  for (std::int64_t i=0; i<s.image.size(); ++i)
+    outs << (i == 0 ? "" : ",") << s.image.key(s.image.entry(i));
+  outs << "]";
+  return outs;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator constructors
+
+template<class T, auto thash>
+auto MappedHashSet<T,thash>::begin () const -> MappedHashSet<T,thash>::Iterator {
+  return Iterator(this,0);
+}
+
+
+template<class T, auto thash>
+auto MappedHashSet<T,thash>::end () const -> MappedHashSet<T,thash>::Iterator {
+  return Iterator(this,image.size());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator class definitions
+
+template<class T, auto thash>
+MappedHashSet<T,thash>::Iterator::Iterator(const MappedHashSet<T,thash>* iterate_over, std::int64_t initial)
+: current(initial), ref_set(iterate_over)
+{}
+
+
+template<class T, auto thash>
+MappedHashSet<T,thash>::Iterator::~Iterator()
+{}
+
+
+template<class T, auto thash>
+std::string MappedHashSet<T,thash>::Iterator::str () const {
+  std::ostringstream answer;
+  answer << "MappedHashSet::Iterator(current=" << current << "/" << ref_set->image.size() << ")";
+  return answer.str();
+}
+
+
+template<class T, auto thash>
+auto MappedHashSet<T,thash>::Iterator::operator ++ () -> MappedHashSet<T,thash>::Iterator& {
+  if (current < ref_set->image.size())
+    ++current;
+  return *this;
+}
+
+
+template<class T, auto thash>
+auto MappedHashSet<T,thash>::Iterator::operator ++ (int) -> MappedHashSet<T,thash>::Iterator {
+  Iterator to_return(*this);
+  ++(*this);
+  return to_return;
+}
+
+
+template<class T, auto thash>
+bool MappedHashSet<T,thash>::Iterator::operator == (const MappedHashSet<T,thash>::Iterator& rhs) const {
+  if (ref_set != rhs.ref_set)
+    throw ComparingDifferentIteratorsError("MappedHashSet::Iterator::operator ==");
+
+  return current == rhs.current;
+}
+
+
+template<class T, auto thash>
+bool MappedHashSet<T,thash>::Iterator::operator != (const MappedHashSet<T,thash>::Iterator& rhs) const {
+  return !(*this == rhs);
+}
+
+
+template<class T, auto thash>
+auto MappedHashSet<T,thash>::Iterator::operator *() const -> View {
+  if (current == ref_set->image.size())
+    throw IteratorPositionIllegal("MappedHashSet::Iterator::operator * Iterator illegal: exhausted");
+
+  return ref_set->image.key(ref_set->image.entry(current));
+}
+
+
+}
+
+#endif /* MAPPED_HASH_MAP_HPP_ */
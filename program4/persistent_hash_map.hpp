@@ -0,0 +1,793 @@
+#ifndef PERSISTENT_HASH_MAP_HPP_
+#define PERSISTENT_HASH_MAP_HPP_
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <initializer_list>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <utility>              //std::move, std::swap
+#include "ics_exceptions.hpp"
+#include "pair.hpp"
+#include "hash_code.hpp"
+#include "template_function.hpp"
+
+
+namespace ics {
+
+
+#ifndef undefinedhashdefined
+#define undefinedhashdefined
+template<class T, class R = int>
+R undefinedhash (const T& a) {return 0;}
+#endif /* undefinedhashdefined */
+
+//PersistentHashMap is an immutable map: put and erase do not change it, they return a new version
+//  of it, and every older version stays valid and unchanged. It has HashMap's queries, operators and
+//  (read-only) Iterator; copying one (a snapshot) is O(1), instead of copying every node.
+//It is a hash array mapped trie (HAMT): each level of the trie uses 5 more bits of a key's hash code
+//  to choose among (up to) 32 children, so a lookup follows at most max_depth+1 nodes and a branch
+//  stores only the children that exist (bitmap says which; its popcount indexes them).
+//A new version copies just the nodes on the path to the key, O(log32 N), and shares the rest with
+//  the version it came from (structural sharing). Nodes are reference counted (atomically), so
+//  versions can be made, read and destroyed in different threads.
+//Versions never change: any number of threads may read and iterate over versions at once. A
+//  PersistentHashMap variable, like an int variable, must not be assigned by one thread while
+//  others use it: hand each thread its own snapshot (copy) instead.
+//Codes are first multiplied by 2^64/phi (as in hash_code.hpp) and consumed from the top bits, so
+//  codes that differ only in a few bits still spread over the root's children.
+//
+//Instantiate the templated class supplying thash(a): produces a hash value for a.
+//If thash is defaulted to undefinedhash in the template, then a constructor must supply chash.
+//If both thash and chash are supplied, then they must be the same (by ==) function.
+//If neither is supplied, or both are supplied but different, TemplateFunctionError is raised.
+//The (unique) non-undefinedhash value supplied by thash/chash is stored in the instance variable hash.
+template<class KEY,class T, auto thash = undefinedhash<KEY>> class PersistentHashMap {
+  public:
+    typedef ics::pair<KEY,T>   Entry;
+    typedef decltype(thash) hashfunc;  //int or 64-bit hash values: see hash_code.hpp
+
+    static const int bits_per_level = 5;
+    static const int max_depth      = 11;  //Levels 0..11 use 60 bits; keys in one leaf at level 12 share them
+
+    //Destructor/Constructors
+    ~PersistentHashMap ();
+
+    PersistentHashMap          (hashfunc chash = undefinedhash<KEY>);
+    PersistentHashMap          (const PersistentHashMap<KEY,T,thash>& to_copy);      //O(1): shares to_copy's trie
+    PersistentHashMap          (PersistentHashMap<KEY,T,thash>&& to_move) noexcept;  //to_move is left empty
+    explicit PersistentHashMap (const std::initializer_list<Entry>& il, hashfunc chash = undefinedhash<KEY>);
+
+    //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
+    template <class Iterable>
+    explicit PersistentHashMap (const Iterable& i, hashfunc chash = undefinedhash<KEY>);
+
+
+    //Queries
+    bool empty      () const;
+    std::int64_t size () const;
+    bool has_key    (const KEY& key) const;
+    bool has_value  (const T& value) const;
+    std::string str () const; //supplies useful debugging information; contrast to operator <<
+
+
+    //New versions: each leaves *this unchanged (use m = m.put(k,v) to update a variable)
+    PersistentHashMap<KEY,T,thash> put      (const KEY& key, const T& value) const;
+    PersistentHashMap<KEY,T,thash> erase    (const KEY& key) const;  //KeyError if key is not in the map
+    PersistentHashMap<KEY,T,thash> clear    () const;                //An empty map with the same hash
+    PersistentHashMap<KEY,T,thash> snapshot () const;                //*this, in O(1)
+
+    //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
+    template <class Iterable>
+    PersistentHashMap<KEY,T,thash> put_all (const Iterable& i) const;
+
+
+    //Operators
+
+    const T& operator [] (const KEY&) const;  //KeyError if key is not in the map
+    PersistentHashMap<KEY,T,thash>& operator = (const PersistentHashMap<KEY,T,thash>& rhs);      //O(1)
+    PersistentHashMap<KEY,T,thash>& operator = (PersistentHashMap<KEY,T,thash>&& rhs) noexcept;  //rhs is left empty
+    bool operator == (const PersistentHashMap<KEY,T,thash>& rhs) const;
+    bool operator != (const PersistentHashMap<KEY,T,thash>& rhs) const;
+
+    template<class KEY2,class T2, auto hash2>
+    friend std::ostream& operator << (std::ostream& outs, const PersistentHashMap<KEY2,T2,hash2>& m);
+
+
+
+  private:
+    class Node;
+
+  public:
+    //Iterates over the version begin() was called on, even if the variable is later assigned
+    //  another version; it never throws ConcurrentModificationError (versions do not change)
+    //  and has no erase (use erase on the map, which makes a new version)
+    class Iterator {
+      public:
+        //Private constructor called in begin/end, which are friends of PersistentHashMap<T>
+        ~Iterator();
+        Iterator (const Iterator& i);
+        Iterator& operator = (const Iterator& rhs);
+        std::string str  () const;
+        PersistentHashMap<KEY,T,thash>::Iterator& operator ++ ();
+        PersistentHashMap<KEY,T,thash>::Iterator  operator ++ (int);
+        bool operator == (const PersistentHashMap<KEY,T,thash>::Iterator& rhs) const;
+        bool operator != (const PersistentHashMap<KEY,T,thash>::Iterator& rhs) const;
+        const Entry& operator *  () const;
+        const Entry* operator -> () const;
+        friend std::ostream& operator << (std::ostream& outs, const PersistentHashMap<KEY,T,thash>::Iterator& i) {
+          outs << i.str(); //Use the same meaning as the debugging .str() method
+          return outs;
+        }
+        friend Iterator PersistentHashMap<KEY,T,thash>::begin () const;
+        friend Iterator PersistentHashMap<KEY,T,thash>::end   () const;
+
+      private:
+        //path[0..top] are the branches above leaf; path[d] is at child[d] of its children
+        Node*       root;                    //Retained: the version being iterated over
+        Node*       path [max_depth+1];
+        int         child[max_depth+1];
+        int         top   = -1;
+        Node*       leaf  = nullptr;         //stop: leaf == nullptr
+        std::size_t entry = 0;               //Index in leaf->entries
+
+        //Helper methods
+        void descend        (Node* n, int depth);  //To the first leaf under n (at depth)
+        void advance_cursors();
+
+        //Called in friends begin/end
+        Iterator(Node* iterate_over, bool from_begin);
+    };
+
+
+    Iterator begin () const;
+    Iterator end   () const;
+
+
+  private:
+    //A branch has bitmap/children; a leaf has entries (more than one only when their codes match in
+    //  every bit the levels above it used). The empty map has no root.
+    class Node {
+      public:
+        Node (bool is_leaf) : leaf(is_leaf) {}
+
+        mutable std::atomic<int> references{1};
+        bool                     leaf;
+        std::uint32_t            bitmap = 0;   //Branch: bit i is set when the i-th of the 32 children exists
+        std::vector<Node*>       children;     //Branch: the existing children, in bit order
+        std::vector<Entry>       entries;      //Leaf
+        HashCode                 code   = 0;   //Leaf: mixed code of entries[0]
+    };
+
+  TemplateFunction<hashfunc,thash,undefinedhash<KEY>> hash;  //Hashing function used (from template or constructor)
+  Node*        root = nullptr;   //Shared with other versions
+  std::int64_t used = 0;         //Cache for number of key->value pairs in the trie
+
+
+  //Helper methods
+  PersistentHashMap (const PersistentHashMap<KEY,T,thash>& version, Node* new_root, std::int64_t new_used); //Takes new_root's reference
+
+  HashCode      mixed_code   (const KEY& key)                 const;
+  static int    child_index  (HashCode code, int depth);            //0..31: bits of code used at depth
+  static int    popcount     (std::uint32_t bits);
+  static Node*  retain       (Node* n);
+  static void   release      (Node* n);
+  static Node*  new_leaf     (const Entry& e, HashCode code);
+  static Node*  copy_branch  (const Node* n);                       //Shares (retains) n's children
+  const Entry*  find_key     (const KEY& key)                 const; //Returns pointer to key's entry or nullptr
+  Node*         put_node     (const Node* n, int depth, HashCode code, const Entry& e, bool& added) const;
+  static Node*  merge_leaves (Node* a, Node* b, int depth);         //A branch at depth holding leaves a and b
+  Node*         erase_node   (const Node* n, int depth, HashCode code, const KEY& key) const; //nullptr if now empty
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//PersistentHashMap class and related definitions
+
+//Destructor/Constructors
+
+template<class KEY,class T, auto thash>
+PersistentHashMap<KEY,T,thash>::~PersistentHashMap() {
+  release(root);
+}
+
+
+template<class KEY,class T, auto thash>
+PersistentHashMap<KEY,T,thash>::PersistentHashMap(hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("PersistentHashMap::default constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("PersistentHashMap::default constructor: both specified and different");
+}
+
+
+template<class KEY,class T, auto thash>
+PersistentHashMap<KEY,T,thash>::PersistentHashMap(const PersistentHashMap<KEY,T,thash>& to_copy)
+: hash(to_copy.hash), root(retain(to_copy.root)), used(to_copy.used)
+{}
+
+
+template<class KEY,class T, auto thash>
+PersistentHashMap<KEY,T,thash>::PersistentHashMap(PersistentHashMap<KEY,T,thash>&& to_move) noexcept
+: hash(to_move.hash), root(to_move.root), used(to_move.used) {
+  to_move.root = nullptr;
+  to_move.used = 0;
+}
+
+
+template<class KEY,class T, auto thash>
+PersistentHashMap<KEY,T,thash>::PersistentHashMap(const std::initializer_list<Entry>& il, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("PersistentHashMap::initializer_list constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("PersistentHashMap::initializer_list constructor: both specified and different");
+
+  for (const Entry& m_entry : il)
+    *this = put(m_entry.first,m_entry.second);
+}
+
+
+template<class KEY,class T, auto thash>
+template <class Iterable>
+PersistentHashMap<KEY,T,thash>::PersistentHashMap(const Iterable& i, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash) {
+  if (hash == (hashfunc)undefinedhash<KEY>)
+    throw TemplateFunctionError("PersistentHashMap::Iterable constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
+    throw TemplateFunctionError("PersistentHashMap::Iterable constructor: both specified and different");
+
+  for (const Entry& m_entry : i)
+    *this = put(m_entry.first,m_entry.second);
+}
+
+
+template<class KEY,class T, auto thash>
+PersistentHashMap<KEY,T,thash>::PersistentHashMap(const PersistentHashMap<KEY,T,thash>& version, Node* new_root, std::int64_t new_used)
+: hash(version.hash), root(new_root), used(new_used)
+{}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Queries
+
+template<class KEY,class T, auto thash>
+bool PersistentHashMap<KEY,T,thash>::empty() const {
+  return used == 0;
+}
+
+
+template<class KEY,class T, auto thash>
+std::int64_t PersistentHashMap<KEY,T,thash>::size() const {
+  return used;
+}
+
+
+template<class KEY,class T, auto thash>
+bool PersistentHashMap<KEY,T,thash>::has_key (const KEY& key) const {
+  return find_key(key) != nullptr;
+}
+
+
+template<class KEY,class T, auto thash>
+bool PersistentHashMap<KEY,T,thash>::has_value (const T& value) const {
+  for (const Entry& m_entry : *this)
+    if (value == m_entry.second)
+      return true;
+
+  return false;
+}
+
+
+template<class KEY,class T, auto thash>
+std::string PersistentHashMap<KEY,T,thash>::str() const {
+  std::ostringstream answer;
+  answer << "PersistentHashMap[";
+  for (Iterator i = begin(); i != end(); ++i)
+    answer << std::endl << "  " << i->first << "->" << i->second << " (depth=" << i.top+1 << ")";
+  answer << "](used=" << used << ",root references=" << (root == nullptr ? 0 : root->references.load()) << ")";
+  return answer.str();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//New versions
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::put(const KEY& key, const T& value) const -> PersistentHashMap<KEY,T,thash> {
+  Entry e(key,value);
+  HashCode code = mixed_code(key);
+  if (root == nullptr) {
+    Node* branch = new Node(false);
+    branch->bitmap = std::uint32_t(1) << child_index(code,0);
+    branch->children.push_back(new_leaf(e,code));
+    return PersistentHashMap<KEY,T,thash>(*this,branch,1);
+  }
+
+  bool added = false;
+  Node* new_root = put_node(root,0,code,e,added);
+  return PersistentHashMap<KEY,T,thash>(*this,new_root,used + (added ? 1 : 0));
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::erase(const KEY& key) const -> PersistentHashMap<KEY,T,thash> {
+  if (find_key(key) == nullptr) {
+    std::ostringstream answer;
+    answer << "PersistentHashMap::erase: key(" << key << ") not in Map";
+    throw KeyError(answer.str());
+  }
+
+  return PersistentHashMap<KEY,T,thash>(*this,erase_node(root,0,mixed_code(key),key),used-1);
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::clear() const -> PersistentHashMap<KEY,T,thash> {
+  return PersistentHashMap<KEY,T,thash>(*this,nullptr,0);
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::snapshot() const -> PersistentHashMap<KEY,T,thash> {
+  return *this;
+}
+
+
+template<class KEY,class T, auto thash>
+template<class Iterable>
+auto PersistentHashMap<KEY,T,thash>::put_all(const Iterable& i) const -> PersistentHashMap<KEY,T,thash> {
+  PersistentHashMap<KEY,T,thash> answer(*this);
+  for (const Entry& m_entry : i)
+    answer = answer.put(m_entry.first, m_entry.second);
+
+  return answer;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Operators
+
+template<class KEY,class T, auto thash>
+const T& PersistentHashMap<KEY,T,thash>::operator [] (const KEY& key) const {
+  const Entry* e = find_key(key);
+  if (e != nullptr)
+    return e->second;
+
+  std::ostringstream answer;
+  answer << "PersistentHashMap::operator []: key(" << key << ") not in Map";
+  throw KeyError(answer.str());
+}
+
+
+template<class KEY,class T, auto thash>
+PersistentHashMap<KEY,T,thash>& PersistentHashMap<KEY,T,thash>::operator = (const PersistentHashMap<KEY,T,thash>& rhs) {
+  Node* old_root = root;
+  root = retain(rhs.root);       //Before releasing: rhs may share (or be) old_root's trie
+  release(old_root);
+  hash = rhs.hash;
+  used = rhs.used;
+  return *this;
+}
+
+
+template<class KEY,class T, auto thash>
+PersistentHashMap<KEY,T,thash>& PersistentHashMap<KEY,T,thash>::operator = (PersistentHashMap<KEY,T,thash>&& rhs) noexcept {
+  if (this == &rhs)
+    return *this;
+
+  Node* old_root = root;
+  root = rhs.root;
+  hash = rhs.hash;
+  used = rhs.used;
+  rhs.root = nullptr;
+  rhs.used = 0;
+  release(old_root);
+  return *this;
+}
+
+
+template<class KEY,class T, auto thash>
+bool PersistentHashMap<KEY,T,thash>::operator == (const PersistentHashMap<KEY,T,thash>& rhs) const {
+  if (root == rhs.root)
+    return true;
+  if (used != rhs.size())
+    return false;
+
+  for (const Entry& m_entry : *this) {
+    // Uses ! and ==, so != on T need not be defined
+    const Entry* rhs_entry = rhs.find_key(m_entry.first);
+    if (rhs_entry == nullptr || !(m_entry.second == rhs_entry->second))
+      return false;
+  }
+
+  return true;
+}
+
+
+template<class KEY,class T, auto thash>
+bool PersistentHashMap<KEY,T,thash>::operator != (const PersistentHashMap<KEY,T,thash>& rhs) const {
+  return !(*this == rhs);
+}
+
+
+template<class KEY,class T, auto thash>
+std::ostream& operator << (std::ostream& outs, const PersistentHashMap<KEY,T,thash>& m) {
+  outs << "map[";
+
+  int printed = 0;
+  for (const auto& m_entry : m)
+    outs << (printed++ == 0? "" : ",") << m_entry.first << "->" << m_entry.second;
+
+  outs << "]";
+  return outs;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator constructors
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::begin () const -> PersistentHashMap<KEY,T,thash>::Iterator {
+  return Iterator(root,true);
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::end () const -> PersistentHashMap<KEY,T,thash>::Iterator {
+  return Iterator(root,false);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Private helper methods
+
+template<class KEY,class T, auto thash>
+HashCode PersistentHashMap<KEY,T,thash>::mixed_code (const KEY& key) const {
+  return to_hash_code(hash(key))*11400714819323198485ull;   //Odd: distinct codes stay distinct
+}
+
+
+template<class KEY,class T, auto thash>
+int PersistentHashMap<KEY,T,thash>::child_index (HashCode code, int depth) {
+  return int((code >> (64 - bits_per_level*(depth+1))) & 31);
+}
+
+
+template<class KEY,class T, auto thash>
+int PersistentHashMap<KEY,T,thash>::popcount (std::uint32_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcount(bits);
+#else
+  int answer = 0;
+  for (; bits != 0; bits &= bits-1)
+    ++answer;
+  return answer;
+#endif
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::retain (Node* n) -> Node* {
+  if (n != nullptr)
+    n->references.fetch_add(1,std::memory_order_relaxed);
+  return n;
+}
+
+
+template<class KEY,class T, auto thash>
+void PersistentHashMap<KEY,T,thash>::release (Node* n) {
+  if (n == nullptr || n->references.fetch_sub(1,std::memory_order_acq_rel) != 1)
+    return;
+  for (Node* c : n->children)
+    release(c);
+  delete n;
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::new_leaf (const Entry& e, HashCode code) -> Node* {
+  Node* answer = new Node(true);
+  answer->entries.push_back(e);
+  answer->code = code;
+  return answer;
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::copy_branch (const Node* n) -> Node* {
+  Node* answer = new Node(false);
+  answer->bitmap   = n->bitmap;
+  answer->children = n->children;
+  for (Node* c : answer->children)
+    retain(c);
+  return answer;
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::find_key (const KEY& key) const -> const Entry* {
+  if (root == nullptr)
+    return nullptr;
+
+  HashCode code = mixed_code(key);
+  const Node* n = root;
+  for (int depth = 0; !n->leaf; ++depth) {
+    std::uint32_t bit = std::uint32_t(1) << child_index(code,depth);
+    if ((n->bitmap & bit) == 0)
+      return nullptr;
+    n = n->children[popcount(n->bitmap & (bit-1))];
+  }
+  for (const Entry& e : n->entries)
+    if (key == e.first)
+      return &e;
+
+  return nullptr;
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::put_node (const Node* n, int depth, HashCode code, const Entry& e, bool& added) const -> Node* {
+  if (n->leaf) {
+    added = true;
+    for (const Entry& old : n->entries)
+      if (e.first == old.first)
+        added = false;
+    if (added && n->code != code && depth <= max_depth) //Another code: push n down beside e's new leaf
+      return merge_leaves(retain(const_cast<Node*>(n)),new_leaf(e,code),depth);
+
+    Node* answer = new Node(true);
+    answer->entries = n->entries;
+    answer->code    = n->code;
+    if (added)
+      answer->entries.push_back(e);
+    else
+      for (Entry& old : answer->entries)
+        if (e.first == old.first)
+          old.second = e.second;
+    return answer;
+  }
+
+  std::uint32_t bit = std::uint32_t(1) << child_index(code,depth);
+  int           c   = popcount(n->bitmap & (bit-1));
+  Node* answer = copy_branch(n);
+  if (n->bitmap & bit) {
+    answer->children[c] = put_node(n->children[c],depth+1,code,e,added);
+    release(n->children[c]);                        //answer no longer shares it
+  }else{
+    added = true;
+    answer->bitmap |= bit;
+    answer->children.insert(answer->children.begin()+c,new_leaf(e,code));
+  }
+  return answer;
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::merge_leaves (Node* a, Node* b, int depth) -> Node* {
+  if (depth > max_depth) {                          //Out of bits: one leaf holds both
+    Node* answer = new Node(true);
+    answer->entries = a->entries;
+    answer->entries.insert(answer->entries.end(),b->entries.begin(),b->entries.end());
+    answer->code = a->code;
+    release(a);
+    release(b);
+    return answer;
+  }
+
+  Node* answer = new Node(false);
+  int ia = child_index(a->code,depth), ib = child_index(b->code,depth);
+  if (ia == ib) {
+    answer->bitmap = std::uint32_t(1) << ia;
+    answer->children.push_back(merge_leaves(a,b,depth+1));
+  }else{
+    answer->bitmap = (std::uint32_t(1) << ia) | (std::uint32_t(1) << ib);
+    answer->children.push_back(ia < ib ? a : b);
+    answer->children.push_back(ia < ib ? b : a);
+  }
+  return answer;
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::erase_node (const Node* n, int depth, HashCode code, const KEY& key) const -> Node* {
+  if (n->leaf) {
+    if (n->entries.size() == 1)
+      return nullptr;
+    Node* answer = new Node(true);
+    for (const Entry& e : n->entries)
+      if (!(key == e.first))
+        answer->entries.push_back(e);
+    answer->code = code == n->code ? mixed_code(answer->entries[0].first) : n->code;
+    return answer;
+  }
+
+  std::uint32_t bit       = std::uint32_t(1) << child_index(code,depth);
+  int           c         = popcount(n->bitmap & (bit-1));
+  Node*         new_child = erase_node(n->children[c],depth+1,code,key);
+
+  //A branch (below the root) left with one child that is a leaf is replaced by that leaf
+  int others = int(n->children.size()) - 1;
+  if (depth > 0 && new_child == nullptr && others == 1 && n->children[1-c]->leaf)
+    return retain(n->children[1-c]);
+  if (depth > 0 && others == 0 && new_child != nullptr && new_child->leaf)
+    return new_child;
+  if (new_child == nullptr && others == 0)
+    return nullptr;
+
+  Node* answer = copy_branch(n);
+  release(n->children[c]);                          //answer no longer shares it
+  if (new_child == nullptr) {
+    answer->bitmap &= ~bit;
+    answer->children.erase(answer->children.begin()+c);
+  }else
+    answer->children[c] = new_child;
+  return answer;
+}
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator class definitions
+
+template<class KEY,class T, auto thash>
+void PersistentHashMap<KEY,T,thash>::Iterator::descend(Node* n, int depth){
+  for (; !n->leaf; ++depth) {
+    path [depth] = n;
+    child[depth] = 0;
+    n = n->children[0];
+  }
+  top   = depth-1;
+  leaf  = n;
+  entry = 0;
+}
+
+
+template<class KEY,class T, auto thash>
+void PersistentHashMap<KEY,T,thash>::Iterator::advance_cursors(){
+  if (++entry < leaf->entries.size())
+    return;
+
+  for (int depth = top; depth >= 0; --depth)
+    if (++child[depth] < int(path[depth]->children.size())) {
+      descend(path[depth]->children[child[depth]],depth+1);
+      return;
+    }
+
+  //Not found
+  leaf  = nullptr;
+  entry = 0;
+  top   = -1;
+}
+
+
+template<class KEY,class T, auto thash>
+PersistentHashMap<KEY,T,thash>::Iterator::Iterator(Node* iterate_over, bool from_begin)
+: root(retain(iterate_over)) {
+  if (from_begin && root != nullptr)
+    descend(root,0);
+}
+
+
+template<class KEY,class T, auto thash>
+PersistentHashMap<KEY,T,thash>::Iterator::Iterator(const Iterator& i)
+: root(retain(i.root)), top(i.top), leaf(i.leaf), entry(i.entry) {
+  for (int depth = 0; depth <= top; ++depth) {
+    path [depth] = i.path [depth];
+    child[depth] = i.child[depth];
+  }
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::Iterator::operator = (const Iterator& rhs) -> Iterator& {
+  Node* old_root = root;
+  root  = retain(rhs.root);
+  release(old_root);
+  top   = rhs.top;
+  leaf  = rhs.leaf;
+  entry = rhs.entry;
+  for (int depth = 0; depth <= top; ++depth) {
+    path [depth] = rhs.path [depth];
+    child[depth] = rhs.child[depth];
+  }
+  return *this;
+}
+
+
+template<class KEY,class T, auto thash>
+PersistentHashMap<KEY,T,thash>::Iterator::~Iterator() {
+  release(root);
+}
+
+
+template<class KEY,class T, auto thash>
+std::string PersistentHashMap<KEY,T,thash>::Iterator::str() const {
+  std::ostringstream answer;
+  answer << "PersistentHashMap::Iterator(";
+  if (leaf == nullptr)
+    answer << "end";
+  else
+    answer << "current=" << leaf->entries[entry].first << "->" << leaf->entries[entry].second << ",depth=" << top+1;
+  answer << ")";
+  return answer.str();
+}
+
+template<class KEY,class T, auto thash>
+auto  PersistentHashMap<KEY,T,thash>::Iterator::operator ++ () -> PersistentHashMap<KEY,T,thash>::Iterator& {
+  if (leaf != nullptr)
+    advance_cursors();
+  return *this;
+}
+
+
+template<class KEY,class T, auto thash>
+auto  PersistentHashMap<KEY,T,thash>::Iterator::operator ++ (int) -> PersistentHashMap<KEY,T,thash>::Iterator {
+  Iterator to_return(*this);
+  if (leaf != nullptr)
+    advance_cursors();
+  return to_return;
+}
+
+
+template<class KEY,class T, auto thash>
+bool PersistentHashMap<KEY,T,thash>::Iterator::operator == (const PersistentHashMap<KEY,T,thash>::Iterator& rhs) const {
+  const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
+  if (rhsASI == 0)
+    throw IteratorTypeError("PersistentHashMap::Iterator::operator ==");
+  if (root != rhsASI->root)
+    throw ComparingDifferentIteratorsError("PersistentHashMap::Iterator::operator ==");
+
+  return leaf == rhsASI->leaf && entry == rhsASI->entry;
+}
+
+
+template<class KEY,class T, auto thash>
+bool PersistentHashMap<KEY,T,thash>::Iterator::operator != (const PersistentHashMap<KEY,T,thash>::Iterator& rhs) const {
+  const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
+  if (rhsASI == 0)
+    throw IteratorTypeError("PersistentHashMap::Iterator::operator !=");
+  if (root != rhsASI->root)
+    throw ComparingDifferentIteratorsError("PersistentHashMap::Iterator::operator !=");
+
+  return leaf != rhsASI->leaf || entry != rhsASI->entry;
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::Iterator::operator *() const -> const Entry& {
+  if (leaf == nullptr)
+    throw IteratorPositionIllegal("PersistentHashMap::Iterator::operator * Iterator illegal");
+
+  return leaf->entries[entry];
+}
+
+
+template<class KEY,class T, auto thash>
+auto PersistentHashMap<KEY,T,thash>::Iterator::operator ->() const -> const Entry* {
+  if (leaf == nullptr)
+    throw IteratorPositionIllegal("PersistentHashMap::Iterator::operator -> Iterator illegal");
+
+  return &(leaf->entries[entry]);
+}
+
+
+}
+
+#endif /* PERSISTENT_HASH_MAP_HPP_ */
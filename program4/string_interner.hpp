@@ -0,0 +1,313 @@
+#ifndef STRING_INTERNER_HPP_
+#define STRING_INTERNER_HPP_
+
+#include <cstdint>
+#include <cstring>              //std::memcpy
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <vector>
+#include <memory>               //std::unique_ptr
+#include <utility>              //std::move, std::swap
+#include "ics_exceptions.hpp"
+#include "pair.hpp"
+#include "hash_code.hpp"
+#include "hashers.hpp"
+#include "hash_map.hpp"
+#include "hash_set.hpp"
+
+
+namespace ics {
+
+
+//A StringInterner stores one copy of each distinct string (name) it is given and numbers them: the
+//  first name interned is Symbol 0, the next new one Symbol 1, ... A container keyed by Symbols
+//  stores 4 bytes per key (instead of a std::string: 32 bytes, plus a heap block for names longer
+//  than its small-string buffer), and compares and hashes keys as integers.
+//Names are copied into an arena: chunks of chunk_bytes characters, each filled front to back and
+//  never moved, so a name's string_view stays valid (until clear or the interner's destruction).
+//  A name longer than chunk_bytes gets a chunk of its own.
+//Names are found by an open addressing (linear probing) table of Symbols, at most half full; each
+//  symbol's hash code is kept, so doubling the table does not rehash any names, and a probe compares
+//  names only when their codes match.
+//Symbols are never reused: interning a name again returns its original Symbol; a copy of an
+//  interner has the same names with the same Symbols.
+typedef std::uint32_t               Symbol;
+typedef pair<Symbol,Symbol>         SymbolEdge;
+
+
+class StringInterner {
+  public:
+    static constexpr Symbol no_symbol = ~Symbol(0);   //find's answer for a name never interned
+
+    //Destructor/Constructors
+    ~StringInterner ();
+
+    StringInterner          (std::size_t chunk_bytes = 64*1024);
+    StringInterner          (const StringInterner& to_copy);   //Same names, same Symbols
+    StringInterner          (StringInterner&& to_move) noexcept;  //to_move is left empty
+
+
+    //Queries
+    bool             empty () const;
+    std::int64_t     size  () const;                    //Symbols are 0..size()-1
+    bool             has   (std::string_view name) const;
+    Symbol           find  (std::string_view name) const;  //no_symbol if name was never interned
+    std::string_view name  (Symbol s) const;               //KeyError if s is not one of this interner's Symbols
+    std::int64_t     bytes () const;                    //Bytes allocated: arena chunks and tables
+    std::string      str   () const; //supplies useful debugging information
+
+
+    //Commands
+    Symbol intern (std::string_view name);              //name's Symbol: the first time, name is copied into the arena
+    void   clear  ();
+
+
+    //Operators
+    StringInterner& operator = (const StringInterner& rhs);
+    StringInterner& operator = (StringInterner&& rhs) noexcept;
+
+
+  private:
+    std::size_t                          chunk_bytes;
+    std::vector<std::unique_ptr<char[]>> chunks;         //The arena: chunks.back() is being filled
+    std::size_t                          chunk_used = 0; //Characters used in chunks.back()
+    std::vector<std::string_view>        names;          //names[s] is Symbol s's name (in the arena)
+    std::vector<std::uint32_t>           codes;          //codes[s] is the (high 32 bits of the) hash of names[s]
+    std::vector<Symbol>                  table;          //2^bits slots: a Symbol or no_symbol
+    int                                  bits = 0;
+
+    //Helper methods
+    static std::uint32_t code_of  (std::string_view name);
+    std::int64_t         slot_of  (std::string_view name, std::uint32_t code) const; //name's slot, or the empty slot ending its probe
+    const char*          store    (std::string_view name);                          //A copy of name in the arena
+    void                 grow_table ();
+};
+
+
+//Hash functions and containers for interned keys: Symbols are dense (0,1,2,...), and Fibonacci
+//  hashing (see hash_code.hpp) spreads them over the bins as they are: no mixing is needed
+inline std::uint64_t hash_symbol (const Symbol& s) {
+  return s;
+}
+
+
+inline std::uint64_t hash_symbol_edge (const SymbolEdge& e) {
+  return (std::uint64_t(e.first) << 32) | e.second;
+}
+
+
+template<class T>
+using SymbolMap     = HashMap<Symbol,T,hash_symbol>;
+template<class T>
+using SymbolEdgeMap = HashMap<SymbolEdge,T,hash_symbol_edge>;
+typedef HashSet<Symbol,hash_symbol>          SymbolSet;
+typedef HashSet<SymbolEdge,hash_symbol_edge> SymbolEdgeSet;
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//StringInterner class and related definitions
+
+//Destructor/Constructors
+
+inline StringInterner::~StringInterner ()
+{}
+
+
+inline StringInterner::StringInterner (std::size_t chunk_bytes)
+: chunk_bytes(chunk_bytes > 0 ? chunk_bytes : 1)
+{}
+
+
+inline StringInterner::StringInterner (const StringInterner& to_copy)
+: chunk_bytes(to_copy.chunk_bytes) {
+  for (std::string_view n : to_copy.names)
+    intern(n);
+}
+
+
+inline StringInterner::StringInterner (StringInterner&& to_move) noexcept
+: chunk_bytes(to_move.chunk_bytes), chunks(std::move(to_move.chunks)), chunk_used(to_move.chunk_used),
+  names(std::move(to_move.names)), codes(std::move(to_move.codes)), table(std::move(to_move.table)), bits(to_move.bits) {
+  to_move.clear();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Queries
+
+inline bool StringInterner::empty () const {
+  return names.empty();
+}
+
+
+inline std::int64_t StringInterner::size () const {
+  return names.size();
+}
+
+
+inline bool StringInterner::has (std::string_view name) const {
+  return find(name) != no_symbol;
+}
+
+
+inline Symbol StringInterner::find (std::string_view name) const {
+  if (table.empty())
+    return no_symbol;
+  return table[slot_of(name,code_of(name))];
+}
+
+
+inline std::string_view StringInterner::name (Symbol s) const {
+  if (s >= names.size()) {
+    std::ostringstream answer;
+    answer << "StringInterner::name: Symbol(" << s << ") not interned";
+    throw KeyError(answer.str());
+  }
+  return names[s];
+}
+
+
+inline std::int64_t StringInterner::bytes () const {
+  std::int64_t answer = chunks.size()*chunk_bytes;  //Only oversized names' chunks are bigger: added below
+  for (std::string_view n : names)
+    if (n.size() > chunk_bytes)
+      answer += n.size() - chunk_bytes;
+  return answer + names.capacity()*sizeof(std::string_view) + codes.capacity()*sizeof(std::uint32_t)
+                + table.capacity()*sizeof(Symbol) + chunks.capacity()*sizeof(std::unique_ptr<char[]>);
+}
+
+
+inline std::string StringInterner::str () const {
+  std::ostringstream answer;
+  answer << "StringInterner[";
+  for (std::size_t s=0; s<names.size(); ++s)
+    answer << (s == 0 ? "" : ",") << s << ":" << names[s];
+  answer << "](size=" << names.size() << ",chunks=" << chunks.size() << ",table=" << table.size() << ",bytes=" << bytes() << ")";
+  return answer.str();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Commands
+
+inline Symbol StringInterner::intern (std::string_view name) {
+  if (2*(names.size()+1) > table.size())
+    grow_table();
+
+  std::uint32_t code = code_of(name);
+  std::int64_t  slot = slot_of(name,code);
+  if (table[slot] != no_symbol)
+    return table[slot];
+
+  Symbol answer = Symbol(names.size());
+  names.push_back(std::string_view(store(name),name.size()));
+  codes.push_back(code);
+  table[slot] = answer;
+  return answer;
+}
+
+
+inline void StringInterner::clear () {
+  chunks.clear();
+  chunk_used = 0;
+  names.clear();
+  codes.clear();
+  table.clear();
+  bits = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Operators
+
+inline StringInterner& StringInterner::operator = (const StringInterner& rhs) {
+  if (this == &rhs)
+    return *this;
+  clear();
+  chunk_bytes = rhs.chunk_bytes;
+  for (std::string_view n : rhs.names)
+    intern(n);
+  return *this;
+}
+
+
+inline StringInterner& StringInterner::operator = (StringInterner&& rhs) noexcept {
+  if (this == &rhs)
+    return *this;
+  std::swap(chunk_bytes,rhs.chunk_bytes);
+  std::swap(chunks,rhs.chunks);
+  std::swap(chunk_used,rhs.chunk_used);
+  std::swap(names,rhs.names);
+  std::swap(codes,rhs.codes);
+  std::swap(table,rhs.table);
+  std::swap(bits,rhs.bits);
+  return *this;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Private helper methods
+
+inline std::uint32_t StringInterner::code_of (std::string_view name) {
+  return std::uint32_t(hash_string_view(name) >> 32);
+}
+
+
+inline std::int64_t StringInterner::slot_of (std::string_view name, std::uint32_t code) const {
+  std::int64_t mask = std::int64_t(table.size()) - 1;
+  for (std::int64_t slot = bin_index(code,bits); ; slot = (slot+1) & mask) {
+    Symbol s = table[slot];
+    if (s == no_symbol || (codes[s] == code && names[s] == name))
+      return slot;
+  }
+}
+
+
+inline const char* StringInterner::store (std::string_view name) {
+  if (name.size() > chunk_bytes) {                 //Its own chunk, before the one being filled
+    std::unique_ptr<char[]> big(new char[name.size()]);
+    std::memcpy(big.get(),name.data(),name.size());
+    const char* answer = big.get();
+    chunks.insert(chunks.empty() ? chunks.end() : chunks.end()-1, std::move(big));
+    if (chunks.size() == 1)
+      chunk_used = chunk_bytes;                    //No chunk is being filled yet
+    return answer;
+  }
+
+  if (chunks.empty() || chunk_used + name.size() > chunk_bytes) {
+    chunks.push_back(std::unique_ptr<char[]>(new char[chunk_bytes]));
+    chunk_used = 0;
+  }
+  char* answer = chunks.back().get() + chunk_used;
+  if (!name.empty())
+    std::memcpy(answer,name.data(),name.size());
+  chunk_used += name.size();
+  return answer;
+}
+
+
+inline void StringInterner::grow_table () {
+  bits = table.empty() ? 4 : bits+1;
+  table.assign(std::size_t(1) << bits, no_symbol);
+  std::int64_t mask = std::int64_t(table.size()) - 1;
+  for (Symbol s = 0; s < names.size(); ++s) {       //Names are distinct: just find an empty slot
+    std::int64_t slot = bin_index(codes[s],bits);
+    while (table[slot] != no_symbol)
+      slot = (slot+1) & mask;
+    table[slot] = s;
+  }
+}
+
+
+}
+
+#endif /* STRING_INTERNER_HPP_ */
@@ -0,0 +1,851 @@
+#ifndef SWISS_HASH_SET_HPP_
+#define SWISS_HASH_SET_HPP_
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <initializer_list>
+#include <cstdint>
+#include "ics_exceptions.hpp"
+#include "pair.hpp"
+#include "hash_code.hpp"
+#include "template_function.hpp"
+#if defined(__SSE2__)
+#include <emmintrin.h>          //For _mm_cmpeq_epi8/_mm_movemask_epi8 (16 control bytes at once)
+#endif
+
+
+namespace ics {
+
+
+#ifndef undefinedhashdefined
+#define undefinedhashdefined
+template<class T, class R = int>
+R undefinedhash (const T& a) {return 0;}
+#endif /* undefinedhashdefined */
+
+//SwissHashSet has the same interface as HashSet, but stores its elements in one
+//  array of slots (open addressing) and keeps a separate array of 1-byte control
+//  tags: EMPTY, DELETED, or (for a full slot) 7 bits of the element's hash.
+//Slots are probed in aligned groups of 16: one SSE2 compare/movemask finds every
+//  slot in a group whose tag matches, so == is only called on likely matches; a
+//  group with an EMPTY tag ends an unsuccessful search (usually the first group).
+//Without SSE2 the same group operations are done by a scalar loop.
+//Groups are probed quadratically (1,2,3,... groups further on); bins is a power
+//  of 2 and a multiple of 16, so this probe sequence visits every group.
+//An element's first group and its tag are the top bits of its Fibonacci hash (bin_index, see
+//  hash_code.hpp): the group index, then the 7 bits below it, so every bit of the hash code
+//  affects both.
+//
+//Instantiate the templated class supplying thash(a): produces a hash value for a.
+//If thash is defaulted to undefinedhash in the template, then a constructor must supply chash.
+//If both thash and chash are supplied, then they must be the same (by ==) function.
+//If neither is supplied, or both are supplied but different, TemplateFunctionError is raised.
+//The (unique) non-undefinedhash value supplied by thash/chash is stored in the instance variable hash.
+//As in HashSet, thash is called directly (see template_function.hpp) and may return an int or a 64-bit
+//  value (e.g., the hashers in hashers.hpp); sizes and slot indexes are 64-bit.
+//The load_threshold (counting DELETED slots as used) must be < 1; larger values are clamped.
+template<class T, auto thash = undefinedhash<T>> class SwissHashSet {
+  public:
+    typedef decltype(thash) hashfunc;  //int or 64-bit hash values: see hash_code.hpp
+
+    //Destructor/Constructors
+    ~SwissHashSet ();
+
+    SwissHashSet (double the_load_threshold = 0.875, hashfunc chash = undefinedhash<T>);
+    explicit SwissHashSet (int initial_bins, double the_load_threshold = 0.875, hashfunc chash = undefinedhash<T>);
+    SwissHashSet (const SwissHashSet<T,thash>& to_copy, double the_load_threshold = 0.875, hashfunc chash = undefinedhash<T>);
+    explicit SwissHashSet (const std::initializer_list<T>& il, double the_load_threshold = 0.875, hashfunc chash = undefinedhash<T>);
+
+    //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
+    template <class Iterable>
+    explicit SwissHashSet (const Iterable& i, double the_load_threshold = 0.875, hashfunc chash = undefinedhash<T>);
+
+
+    //Queries
+    bool empty      () const;
+    std::int64_t size () const;
+    bool contains   (const T& element) const;
+    std::string str () const; //supplies useful debugging information; contrast to operator <<
+
+    //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
+    template <class Iterable>
+    bool contains_all (const Iterable& i) const;
+
+
+    //Commands
+    int  insert (const T& element);
+    int  erase  (const T& element);
+    void clear  ();
+
+    //Iterable class must support "for" loop: .begin()/.end() and prefix ++ on returned result
+
+    template <class Iterable>
+    std::int64_t insert_all(const Iterable& i);
+
+    template <class Iterable>
+    std::int64_t erase_all(const Iterable& i);
+
+    template<class Iterable>
+    std::int64_t retain_all(const Iterable& i);
+
+
+    //Operators
+    SwissHashSet<T,thash>& operator = (const SwissHashSet<T,thash>& rhs);
+    bool operator == (const SwissHashSet<T,thash>& rhs) const;
+    bool operator != (const SwissHashSet<T,thash>& rhs) const;
+    bool operator <= (const SwissHashSet<T,thash>& rhs) const;
+    bool operator <  (const SwissHashSet<T,thash>& rhs) const;
+    bool operator >= (const SwissHashSet<T,thash>& rhs) const;
+    bool operator >  (const SwissHashSet<T,thash>& rhs) const;
+
+    template<class T2, auto hash2>
+    friend std::ostream& operator << (std::ostream& outs, const SwissHashSet<T2,hash2>& s);
+
+
+
+  public:
+    class Iterator {
+      public:
+        //Private constructor called in begin/end, which are friends of SwissHashSet<T,thash>
+        ~Iterator();
+        T           erase();
+        std::string str  () const;
+        SwissHashSet<T,thash>::Iterator& operator ++ ();
+        SwissHashSet<T,thash>::Iterator  operator ++ (int);
+        bool operator == (const SwissHashSet<T,thash>::Iterator& rhs) const;
+        bool operator != (const SwissHashSet<T,thash>::Iterator& rhs) const;
+        T& operator *  () const;
+        T* operator -> () const;
+        friend std::ostream& operator << (std::ostream& outs, const SwissHashSet<T,thash>::Iterator& i) {
+          outs << i.str(); //Use the same meaning as the debugging .str() method
+          return outs;
+        }
+        friend Iterator SwissHashSet<T,thash>::begin () const;
+        friend Iterator SwissHashSet<T,thash>::end   () const;
+
+      private:
+        //If can_erase is false, current indexes the "next" value (must ++ to reach it)
+        std::int64_t           current; //Slot index; stop: current == -1
+        SwissHashSet<T,thash>* ref_set;
+        int                    expected_mod_count;
+        bool                   can_erase = true;
+
+        //Helper methods
+        void advance_cursors();
+
+        //Called in friends begin/end
+        Iterator(SwissHashSet<T,thash>* iterate_over, bool from_begin);
+    };
+
+
+    Iterator begin () const;
+    Iterator end   () const;
+
+
+  private:
+    static const int           group_size = 16;   //Slots examined by one SSE2 compare
+    static const unsigned char empty_tag  = 0x80; //Control byte for a never-used slot (high bit set)
+    static const unsigned char deleted_tag= 0xFE; //Control byte for an erased slot   (high bit set)
+                                                  //Full slots store 7 hash bits: high bit clear
+
+public:
+  TemplateFunction<hashfunc,thash,undefinedhash<T>> hash;  //Hashing function used (from template or constructor)
+private:
+  unsigned char* ctrl = nullptr;//Control byte for each slot: empty_tag, deleted_tag, or 7 hash bits
+  T*  set             = nullptr;//Array of slots: the element in slot s is valid iff ctrl[s] is a hash tag
+  double load_threshold;        //(used+deleted)/bins <= load_threshold < 1
+  std::int64_t bins = group_size;//# slots in array (a power of 2, and a multiple of group_size)
+  int group_bits    = 0;        //bins == group_size * 2^group_bits
+  std::int64_t used = 0;        //Cache for number of elements in the hash table
+  std::int64_t deleted = 0;     //Number of deleted_tag slots (they lengthen searches until a rehash)
+  int mod_count = 0;            //For sensing concurrent modification
+
+
+  //Helper methods
+  std::int64_t mix_hash       (const T& element)         const;  //First group (h >> 7) and tag (h & 0x7F)
+  std::int64_t find_element   (const T& element)         const;  //Returns element's slot index or -1
+  std::int64_t find_free      (std::int64_t h)           const;  //Returns first empty/deleted slot on h's probe sequence
+  void  erase_slot            (std::int64_t s);                  //Mark slot s empty (or deleted), release its element
+  void  allocate_table        (std::int64_t new_bins);           //Fresh all-empty ctrl/set arrays (old ones not deleted)
+
+  void  ensure_load_threshold (std::int64_t new_used);           //Reallocate if load_factor > load_threshold
+
+  static int    match_tag     (const unsigned char* g, unsigned char tag); //Bit i set iff g[i] == tag
+  static int    match_empty   (const unsigned char* g);                    //Bit i set iff g[i] == empty_tag
+  static int    match_free    (const unsigned char* g);                    //Bit i set iff g[i] is empty or deleted
+  static int    low_bit       (int mask);                                  //Index of the lowest set bit (mask != 0)
+  static std::int64_t round_up_bins (std::int64_t n);                      //Smallest legal bins >= n
+  static double clamp_threshold(double lt);                                //Keep load_threshold in (0,0.9375]
+};
+
+
+
+
+
+//SwissHashSet class and related definitions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Destructor/Constructors
+
+template<class T, auto thash>
+SwissHashSet<T,thash>::~SwissHashSet() {
+  delete[] ctrl;
+  delete[] set;
+}
+
+
+template<class T, auto thash>
+SwissHashSet<T,thash>::SwissHashSet(double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)) {
+  if (hash == (hashfunc)undefinedhash<T>)
+    throw TemplateFunctionError("SwissHashSet::default constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
+    throw TemplateFunctionError("SwissHashSet::default constructor: both specified and different");
+
+  allocate_table(bins);
+}
+
+
+template<class T, auto thash>
+SwissHashSet<T,thash>::SwissHashSet(int initial_bins, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)) {
+  if (hash == (hashfunc)undefinedhash<T>)
+    throw TemplateFunctionError("SwissHashSet::length constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
+    throw TemplateFunctionError("SwissHashSet::length constructor: both specified and different");
+
+  allocate_table(round_up_bins(initial_bins));
+}
+
+
+template<class T, auto thash>
+SwissHashSet<T,thash>::SwissHashSet(const SwissHashSet<T,thash>& to_copy, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)) {
+  if (hash == (hashfunc)undefinedhash<T>)
+    hash = to_copy.hash;//throw TemplateFunctionError("SwissHashSet::copy constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
+    throw TemplateFunctionError("SwissHashSet::copy constructor: both specified and different");
+
+  if (hash == to_copy.hash && double(to_copy.used+to_copy.deleted)/to_copy.bins <= load_threshold) {
+    allocate_table(to_copy.bins);   //Same hash and bins: every slot (and tag) keeps its position
+    used    = to_copy.used;
+    deleted = to_copy.deleted;
+    for (std::int64_t s=0; s<bins; ++s) {
+      ctrl[s] = to_copy.ctrl[s];
+      if (!(ctrl[s] & 0x80))
+        set[s] = to_copy.set[s];
+    }
+  }else {
+    allocate_table(round_up_bins(std::int64_t(to_copy.size()/load_threshold)+1));
+    for (std::int64_t s=0; s<to_copy.bins; ++s)
+      if (!(to_copy.ctrl[s] & 0x80))
+        insert(to_copy.set[s]);
+  }
+}
+
+
+template<class T, auto thash>
+SwissHashSet<T,thash>::SwissHashSet(const std::initializer_list<T>& il, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)) {
+  if (hash == (hashfunc)undefinedhash<T>)
+    throw TemplateFunctionError("SwissHashSet::initializer_list constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
+    throw TemplateFunctionError("SwissHashSet::initializer_list constructor: both specified and different");
+
+  allocate_table(round_up_bins(std::int64_t(il.size()/load_threshold)+1));
+  for (const T& v : il)
+    insert(v);
+}
+
+
+template<class T, auto thash>
+template<class Iterable>
+SwissHashSet<T,thash>::SwissHashSet(const Iterable& i, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(clamp_threshold(the_load_threshold)) {
+  if (hash == (hashfunc)undefinedhash<T>)
+    throw TemplateFunctionError("SwissHashSet::Iterable constructor: neither specified");
+  if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
+    throw TemplateFunctionError("SwissHashSet::Iterable constructor: both specified and different");
+
+  allocate_table(round_up_bins(std::int64_t(i.size()/load_threshold)+1));
+  for (const T& v : i)
+    insert(v);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Queries
+
+template<class T, auto thash>
+bool SwissHashSet<T,thash>::empty() const {
+  return used == 0;
+}
+
+
+template<class T, auto thash>
+std::int64_t SwissHashSet<T,thash>::size() const {
+  return used;
+}
+
+
+template<class T, auto thash>
+bool SwissHashSet<T,thash>::contains (const T& element) const {
+  return find_element(element) != -1;
+}
+
+
+template<class T, auto thash>
+std::string SwissHashSet<T,thash>::str() const {
+  std::ostringstream answer;
+  answer << "SwissHashSet[";
+  if (bins != 0) {
+    answer << std::endl;
+    for (std::int64_t g=0; g<bins; g+=group_size) {
+      answer << "group[" << g/group_size << "] = ";
+      for (std::int64_t s=g; s<g+group_size; ++s)
+        if (ctrl[s] == empty_tag)
+          answer << "EMPTY ";
+        else if (ctrl[s] == deleted_tag)
+          answer << "DELETED ";
+        else
+          answer << set[s] << "(" << int(ctrl[s]) << ") ";
+      answer << std::endl;
+    }
+  }
+
+  answer  << "(load_threshold=" << load_threshold << ",bins=" << bins << ",used=" <<used << ",deleted=" << deleted <<",mod_count=" << mod_count << ")";
+  return answer.str();
+}
+
+
+template<class T, auto thash>
+template <class Iterable>
+bool SwissHashSet<T,thash>::contains_all(const Iterable& i) const {
+  for (const T& v : i)
+    if (!contains(v))
+      return false;
+
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Commands
+
+template<class T, auto thash>
+int SwissHashSet<T,thash>::insert(const T& element) {
+  if (find_element(element) != -1)
+      return 0;
+
+  ensure_load_threshold(used+1);
+
+  ++used;
+  ++mod_count;
+  std::int64_t h = mix_hash(element);   //bins may have changed in ensure_load_threshold!
+  std::int64_t s = find_free(h);
+  if (ctrl[s] == deleted_tag)
+    --deleted;
+  ctrl[s] = h & 0x7F;                   //Low 7 bits: the group index is the bits above them
+  set[s]  = element;
+  return 1;
+}
+
+
+template<class T, auto thash>
+int SwissHashSet<T,thash>::erase(const T& element) {
+  std::int64_t s = find_element(element);
+  if (s == -1)
+    return 0;
+
+  erase_slot(s);
+  --used;
+  ++mod_count;
+  return 1;
+}
+
+
+template<class T, auto thash>
+void SwissHashSet<T,thash>::clear() {
+  for (std::int64_t s=0; s<bins; ++s)
+    if (!(ctrl[s] & 0x80))
+      set[s] = T();
+  for (std::int64_t s=0; s<bins; ++s)
+    ctrl[s] = empty_tag;
+
+  used    = 0;
+  deleted = 0;
+  ++mod_count;
+}
+
+
+template<class T, auto thash>
+template<class Iterable>
+std::int64_t SwissHashSet<T,thash>::insert_all(const Iterable& i) {
+  std::int64_t count = 0;
+  for (const T& v : i)
+    count += insert(v);
+
+  return count;
+}
+
+
+template<class T, auto thash>
+template<class Iterable>
+std::int64_t SwissHashSet<T,thash>::erase_all(const Iterable& i) {
+  std::int64_t count = 0;
+  for (const T& v : i)
+    count += erase(v);
+  return count;
+}
+
+
+template<class T, auto thash>
+template<class Iterable>
+std::int64_t SwissHashSet<T,thash>::retain_all(const Iterable& i) {
+  SwissHashSet<T,thash> s(i,load_threshold,hash);
+
+  std::int64_t count = 0;
+  for (std::int64_t b=0; b<bins; ++b)
+    if (!(ctrl[b] & 0x80) && !s.contains(set[b])) {
+      erase_slot(b);
+      ++count;
+    }
+
+  used -= count;
+  if (count != 0)
+    ++mod_count;
+  return count;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Operators
+
+template<class T, auto thash>
+SwissHashSet<T,thash>& SwissHashSet<T,thash>::operator = (const SwissHashSet<T,thash>& rhs) {
+  if (this == &rhs)
+    return *this;
+
+  if (hash == rhs.hash && double(rhs.used+rhs.deleted)/rhs.bins <= load_threshold) {
+    delete[] ctrl;
+    delete[] set;
+    allocate_table(rhs.bins);
+    used    = rhs.used;
+    deleted = rhs.deleted;
+    for (std::int64_t s=0; s<bins; ++s) {
+      ctrl[s] = rhs.ctrl[s];
+      if (!(ctrl[s] & 0x80))
+        set[s] = rhs.set[s];
+    }
+  }else{
+    clear();
+    for (std::int64_t s=0; s<rhs.bins; ++s)
+      if (!(rhs.ctrl[s] & 0x80))
+        insert(rhs.set[s]);
+  }
+
+  ++mod_count;
+  return *this;
+}
+
+
+template<class T, auto thash>
+bool SwissHashSet<T,thash>::operator == (const SwissHashSet<T,thash>& rhs) const {
+  if (this == &rhs)
+    return true;
+  if (used != rhs.size())
+    return false;
+
+  for (std::int64_t s=0; s<bins; ++s)
+    if (!(ctrl[s] & 0x80) && !rhs.contains(set[s]))
+      return false;
+
+  return true;
+}
+
+
+template<class T, auto thash>
+bool SwissHashSet<T,thash>::operator != (const SwissHashSet<T,thash>& rhs) const {
+  return !(*this == rhs);
+}
+
+
+template<class T, auto thash>
+bool SwissHashSet<T,thash>::operator <= (const SwissHashSet<T,thash>& rhs) const {
+  if (this == &rhs)
+    return true;
+  if (used > rhs.size())
+    return false;
+
+  for (std::int64_t s=0; s<bins; ++s)
+    if (!(ctrl[s] & 0x80) && !rhs.contains(set[s]))
+      return false;
+
+  return true;
+}
+
+template<class T, auto thash>
+bool SwissHashSet<T,thash>::operator < (const SwissHashSet<T,thash>& rhs) const {
+  if (this == &rhs)
+    return false;
+  if (used >= rhs.size())
+    return false;
+
+  for (std::int64_t s=0; s<bins; ++s)
+    if (!(ctrl[s] & 0x80) && !rhs.contains(set[s]))
+      return false;
+
+  return true;
+}
+
+
+template<class T, auto thash>
+bool SwissHashSet<T,thash>::operator >= (const SwissHashSet<T,thash>& rhs) const {
+  return rhs <= *this;
+}
+
+
+template<class T, auto thash>
+bool SwissHashSet<T,thash>::operator > (const SwissHashSet<T,thash>& rhs) const {
+  return rhs < *this;
+}
+
+
+template<class T, auto thash>
+std::ostream& operator << (std::ostream& outs, const SwissHashSet<T,thash>& s) {
+  outs  << "set[";
+
+  int printed = 0;
+  for (std::int64_t b=0; b<s.bins; ++b)
+    if (!(s.ctrl[b] & 0x80))
+      outs << (printed++ == 0? "" : ",") << s.set[b];
+
+  outs << "]";
+  return outs;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator constructors
+
+template<class T, auto thash>
+auto SwissHashSet<T,thash>::begin () const -> SwissHashSet<T,thash>::Iterator {
+  return Iterator(const_cast<SwissHashSet<T,thash>*>(this),true);
+}
+
+
+template<class T, auto thash>
+auto SwissHashSet<T,thash>::end () const -> SwissHashSet<T,thash>::Iterator {
+  return Iterator(const_cast<SwissHashSet<T,thash>*>(this),false);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Private helper methods
+
+//Multiplicative (Fibonacci) mixing: user hashes such as std::hash<int> are the
+//  identity, which would put consecutive ints in the same group with equal tags
+template<class T, auto thash>
+std::int64_t SwissHashSet<T,thash>::mix_hash (const T& element) const {
+  return bin_index(to_hash_code(hash(element)),group_bits+7);
+}
+
+
+template<class T, auto thash>
+std::int64_t SwissHashSet<T,thash>::find_element (const T& element) const {
+  std::int64_t  h      = mix_hash(element);
+  unsigned char tag    = h & 0x7F;
+  std::int64_t  groups = bins/group_size;
+  for (std::int64_t g = h >> 7, step = 1; /*See body*/; g = (g+step++) & (groups-1)) {
+    const unsigned char* group = ctrl + g*group_size;
+    for (int m = match_tag(group,tag); m != 0; m &= m-1) {
+      std::int64_t s = g*group_size + low_bit(m);
+      if (element == set[s])
+        return s;
+    }
+    if (match_empty(group) != 0)   //element would have been put in this group (or an earlier one)
+      return -1;
+  }
+}
+
+
+template<class T, auto thash>
+std::int64_t SwissHashSet<T,thash>::find_free (std::int64_t h) const {
+  std::int64_t groups = bins/group_size;
+  for (std::int64_t g = h >> 7, step = 1; /*See body*/; g = (g+step++) & (groups-1)) {
+    int m = match_free(ctrl + g*group_size);
+    if (m != 0)
+      return g*group_size + low_bit(m);
+  }
+}
+
+
+template<class T, auto thash>
+void SwissHashSet<T,thash>::erase_slot (std::int64_t s) {
+  //If s's group still has an EMPTY slot, every search reaching this group already
+  //  stops here, so s can become EMPTY too; otherwise searches must probe past it
+  const unsigned char* group = ctrl + (s/group_size)*group_size;
+  if (match_empty(group) != 0)
+    ctrl[s] = empty_tag;
+  else {
+    ctrl[s] = deleted_tag;
+    ++deleted;
+  }
+  set[s] = T();
+}
+
+
+template<class T, auto thash>
+void SwissHashSet<T,thash>::allocate_table (std::int64_t new_bins) {
+  bins       = new_bins;
+  group_bits = bin_bits(bins/group_size);
+  ctrl = new unsigned char[bins];
+  set  = new T[bins];
+  for (std::int64_t s=0; s<bins; ++s)
+    ctrl[s] = empty_tag;
+}
+
+
+template<class T, auto thash>
+void SwissHashSet<T,thash>::ensure_load_threshold(std::int64_t new_used) {
+  if (double(new_used+deleted)/double(bins) <= load_threshold)
+    return;
+
+  unsigned char* old_ctrl = ctrl;
+  T*             old_set  = set;
+  std::int64_t   old_bins = bins;
+
+  //Mostly DELETED slots: rehashing at the same size is enough to reclaim them
+  allocate_table(double(new_used)/double(old_bins) <= load_threshold/2 ? old_bins : 2*old_bins);
+  deleted = 0;
+
+  for (std::int64_t s=0; s<old_bins; ++s)
+    if (!(old_ctrl[s] & 0x80)) {
+      std::int64_t h = mix_hash(old_set[s]);
+      std::int64_t to = find_free(h);
+      ctrl[to] = h & 0x7F;
+      set[to]  = old_set[s];
+    }
+
+  delete [] old_ctrl;
+  delete [] old_set;
+}
+
+
+template<class T, auto thash>
+int SwissHashSet<T,thash>::match_tag (const unsigned char* g, unsigned char tag) {
+#if defined(__SSE2__)
+  __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(g));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(group,_mm_set1_epi8(char(tag))));
+#else
+  int answer = 0;
+  for (int i=0; i<group_size; ++i)
+    if (g[i] == tag)
+      answer |= 1 << i;
+  return answer;
+#endif
+}
+
+
+template<class T, auto thash>
+int SwissHashSet<T,thash>::match_empty (const unsigned char* g) {
+  return match_tag(g,empty_tag);
+}
+
+
+template<class T, auto thash>
+int SwissHashSet<T,thash>::match_free (const unsigned char* g) {
+#if defined(__SSE2__)
+  //empty_tag and deleted_tag are the only control bytes with the high bit set
+  return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(g)));
+#else
+  int answer = 0;
+  for (int i=0; i<group_size; ++i)
+    if (g[i] & 0x80)
+      answer |= 1 << i;
+  return answer;
+#endif
+}
+
+
+template<class T, auto thash>
+int SwissHashSet<T,thash>::low_bit (int mask) {
+#if defined(__GNUC__)
+  return __builtin_ctz(mask);
+#else
+  int answer = 0;
+  for (; (mask & 1) == 0; mask >>= 1)
+    ++answer;
+  return answer;
+#endif
+}
+
+
+template<class T, auto thash>
+std::int64_t SwissHashSet<T,thash>::round_up_bins (std::int64_t n) {
+  std::int64_t answer = group_size;
+  while (answer < n)
+    answer *= 2;
+  return answer;
+}
+
+
+template<class T, auto thash>
+double SwissHashSet<T,thash>::clamp_threshold (double lt) {
+  return lt <= 0. || lt > .9375 ? .9375 : lt;
+}
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Iterator class definitions
+
+template<class T, auto thash>
+void SwissHashSet<T,thash>::Iterator::advance_cursors() {
+  for (std::int64_t s=current+1; s<ref_set->bins; ++s)
+    if (!(ref_set->ctrl[s] & 0x80)) {
+      current = s;
+      return;
+    }
+
+  //Not found
+  current = -1;
+}
+
+
+template<class T, auto thash>
+SwissHashSet<T,thash>::Iterator::Iterator(SwissHashSet<T,thash>* iterate_over, bool from_begin)
+: current(-1), ref_set(iterate_over), expected_mod_count(ref_set->mod_count) {
+  if (from_begin)
+     advance_cursors();
+}
+
+
+template<class T, auto thash>
+SwissHashSet<T,thash>::Iterator::~Iterator()
+{}
+
+
+template<class T, auto thash>
+T SwissHashSet<T,thash>::Iterator::erase() {
+  if (expected_mod_count != ref_set->mod_count)
+    throw ConcurrentModificationError("SwissHashSet::Iterator::erase");
+  if (!can_erase)
+    throw CannotEraseError("SwissHashSet::Iterator::erase Iterator cursor already erased");
+  if (current == -1)
+    throw CannotEraseError("SwissHashSet::Iterator::erase Iterator cursor beyond data structure");
+
+  can_erase = false;
+  T to_return = ref_set->set[current];
+  ref_set->erase_slot(current);       //Nothing moves: ++ just goes on to the next full slot
+
+  --ref_set->used;
+  ++ref_set->mod_count;
+  expected_mod_count = ref_set->mod_count;
+
+  return to_return;
+}
+
+
+template<class T, auto thash>
+std::string SwissHashSet<T,thash>::Iterator::str() const {
+  std::ostringstream answer;
+  answer << ref_set->str() << "(current=" << current << ",expected_mod_count=" << expected_mod_count << ",can_erase=" << can_erase << ")";
+  return answer.str();
+}
+
+
+template<class T, auto thash>
+auto  SwissHashSet<T,thash>::Iterator::operator ++ () -> SwissHashSet<T,thash>::Iterator& {
+  if (expected_mod_count != ref_set->mod_count)
+    throw ConcurrentModificationError("SwissHashSet::Iterator::operator ++");
+
+  if (current == -1)
+    return *this;
+
+  if (can_erase || (ref_set->ctrl[current] & 0x80))
+    advance_cursors();
+
+  can_erase = true;
+  return *this;
+}
+
+
+template<class T, auto thash>
+auto  SwissHashSet<T,thash>::Iterator::operator ++ (int) -> SwissHashSet<T,thash>::Iterator {
+  if (expected_mod_count != ref_set->mod_count)
+    throw ConcurrentModificationError("SwissHashSet::Iterator::operator ++(int)");
+
+  if (current == -1)
+    return *this;
+
+  Iterator to_return = Iterator(*this);
+  if (can_erase || (ref_set->ctrl[current] & 0x80))
+    advance_cursors();
+
+  can_erase = true;
+  return to_return;
+}
+
+
+template<class T, auto thash>
+bool SwissHashSet<T,thash>::Iterator::operator == (const SwissHashSet<T,thash>::Iterator& rhs) const {
+  const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
+  if (rhsASI == 0)
+    throw IteratorTypeError("SwissHashSet::Iterator::operator ==");
+  if (expected_mod_count != ref_set->mod_count)
+    throw ConcurrentModificationError("SwissHashSet::Iterator::operator ==");
+  if (ref_set != rhsASI->ref_set)
+    throw ComparingDifferentIteratorsError("SwissHashSet::Iterator::operator ==");
+
+  return this->current == rhsASI->current;
+}
+
+
+template<class T, auto thash>
+bool SwissHashSet<T,thash>::Iterator::operator != (const SwissHashSet<T,thash>::Iterator& rhs) const {
+  const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
+  if (rhsASI == 0)
+    throw IteratorTypeError("SwissHashSet::Iterator::operator !=");
+  if (expected_mod_count != ref_set->mod_count)
+    throw ConcurrentModificationError("SwissHashSet::Iterator::operator !=");
+  if (ref_set != rhsASI->ref_set)
+    throw ComparingDifferentIteratorsError("SwissHashSet::Iterator::operator !=");
+
+  return this->current != rhsASI->current;
+}
+
+template<class T, auto thash>
+T& SwissHashSet<T,thash>::Iterator::operator *() const {
+  if (expected_mod_count != ref_set->mod_count)
+    throw ConcurrentModificationError("SwissHashSet::Iterator::operator *");
+  if (!can_erase || current == -1)
+    throw IteratorPositionIllegal("SwissHashSet::Iterator::operator * Iterator illegal");
+
+  return ref_set->set[current];
+}
+
+template<class T, auto thash>
+T* SwissHashSet<T,thash>::Iterator::operator ->() const {
+  if (expected_mod_count != ref_set->mod_count)
+    throw ConcurrentModificationError("SwissHashSet::Iterator::operator ->");
+  if (!can_erase || current == -1)
+    throw IteratorPositionIllegal("SwissHashSet::Iterator::operator -> Iterator illegal");
+
+  return &(ref_set->set[current]);
+}
+
+}
+
+#endif /* SWISS_HASH_SET_HPP_ */
@@ -0,0 +1,165 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>                 // std::min
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "hash_map.hpp"
+#include "hash_set.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static int hash_int    (const int& i)         {std::hash<int> int_hash; return int_hash(i);}
+static int hash_string (const std::string& s) {std::hash<std::string> str_hash; return str_hash(s);}
+
+typedef ics::HashMap<int,int,hash_int>                                                  MapTypeInt;
+typedef ics::HashMap<std::string,int,hash_string,ics::HeapNodeAllocator,ics::CacheHash> CacheMapTypeStr;
+typedef ics::HashSet<int,hash_int>                                                      SetTypeInt;
+
+static const int speed_size   = 1000000;  //speed_out_of_cache (keys in the map: far more than the caches hold)
+static const int speed_probes = 4000000;  //speed_out_of_cache (probes, half of them hits)
+static const int speed_buffer = 1024;     //speed_out_of_cache (probes per contains_many/get_many call)
+
+
+class BatchLookupTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+//Check get_many and contains_many against has_key and [] for keys 0..n-1 (not a multiple of the batch)
+template<class Map, class Key>
+static ::testing::AssertionResult batch_matches(const Map& m, const std::vector<Key>& keys) {
+  int n = keys.size();
+  std::vector<const int*> values(n+1,nullptr);
+  bool* found = new bool[n+1];
+  found[n] = true;                                   //guards: not written
+  int count = 0;
+  for (const Key& k : keys)
+    count += m.has_key(k);
+
+  ::testing::AssertionResult answer = ::testing::AssertionSuccess();
+  if (m.get_many(keys.data(),n,values.data()) != count || m.contains_many(keys.data(),n,found) != count)
+    answer = ::testing::AssertionFailure() << "count";
+  for (int i=0; i<n && answer; ++i)
+    if (found[i] != m.has_key(keys[i]) || (values[i] != nullptr) != found[i] || (found[i] && *values[i] != m[keys[i]]))
+      answer = ::testing::AssertionFailure() << "key " << keys[i];
+  if (answer && (!found[n] || values[n] != nullptr))
+    answer = ::testing::AssertionFailure() << "wrote past n";
+  delete[] found;
+  return answer;
+}
+
+
+
+TEST_F(BatchLookupTest, map_get_many) {
+  std::vector<int> keys;
+  for (int i=0; i<1003; ++i)
+    keys.push_back(i);
+
+  for (int step : {0,1}) {
+    MapTypeInt m;
+    m.set_rehash_step(step);
+    for (int i=0; i<1003; i+=3)
+      m.put(i,-i);
+    ASSERT_TRUE(batch_matches(m,keys));
+    ASSERT_TRUE(batch_matches(m,std::vector<int>()));
+
+    MapTypeInt moved(std::move(m));
+    ASSERT_TRUE(batch_matches(moved,keys));
+    ASSERT_TRUE(batch_matches(m,keys));              //no bins: nothing found
+  }
+
+  CacheMapTypeStr s;
+  std::vector<std::string> words;
+  for (int i=0; i<100; ++i) {
+    words.push_back(std::to_string(i));
+    if (i%2 == 0)
+      s[std::to_string(i)] = i;
+  }
+  ASSERT_TRUE(batch_matches(s,words));
+}
+
+
+TEST_F(BatchLookupTest, set_contains_many) {
+  SetTypeInt s;
+  std::vector<int> elements;
+  for (int i=0; i<1003; ++i) {
+    elements.push_back(i);
+    if (i%5 == 0)
+      s.insert(i);
+  }
+  bool found[1003];
+  ASSERT_EQ(201,s.contains_many(elements.data(),1003,found));
+  for (int i=0; i<1003; ++i)
+    ASSERT_EQ(i%5 == 0,found[i]);
+
+  SetTypeInt moved(std::move(s));
+  ASSERT_EQ(0,s.contains_many(elements.data(),1003,found));
+  ASSERT_EQ(201,moved.contains_many(elements.data(),1003,found));
+}
+
+
+//Random probes (half hits) of a map/set too big for the caches: one has_key/[]/contains at a time,
+//  versus speed_buffer at a time through contains_many/get_many
+TEST_F(BatchLookupTest, speed_out_of_cache) {
+  MapTypeInt m;
+  SetTypeInt s;
+  for (int i=0; i<speed_size; ++i) {
+    m.put(2*i,i);
+    s.insert(2*i);
+  }
+  std::mt19937 gen(46);
+  std::uniform_int_distribution<int> pick(0,2*speed_size-1);
+  std::vector<int> probes;
+  for (int p=0; p<speed_probes; ++p)
+    probes.push_back(pick(gen));
+
+  int one_count = 0, one_sum = 0, many_count = 0, many_sum = 0, set_one = 0, set_many = 0;
+  bool found[speed_buffer];
+  const int* values[speed_buffer];
+  ics::Stopwatch s_one, s_many, s_get_one, s_get_many, s_set_one, s_set_many;
+
+  s_one.start();
+  for (int k : probes)
+    one_count += m.has_key(k);
+  s_one.stop();
+  s_many.start();
+  for (int first=0; first<speed_probes; first+=speed_buffer)
+    many_count += m.contains_many(&probes[first],std::min(speed_buffer,speed_probes-first),found);
+  s_many.stop();
+  ASSERT_EQ(one_count,many_count);
+
+  s_get_one.start();
+  for (int k : probes)
+    if (m.has_key(k))
+      one_sum += m[k];
+  s_get_one.stop();
+  s_get_many.start();
+  for (int first=0; first<speed_probes; first+=speed_buffer) {
+    int n = std::min(speed_buffer,speed_probes-first);
+    m.get_many(&probes[first],n,values);
+    for (int i=0; i<n; ++i)
+      if (values[i] != nullptr)
+        many_sum += *values[i];
+  }
+  s_get_many.stop();
+  ASSERT_EQ(one_sum,many_sum);
+
+  s_set_one.start();
+  for (int k : probes)
+    set_one += s.contains(k);
+  s_set_one.stop();
+  s_set_many.start();
+  for (int first=0; first<speed_probes; first+=speed_buffer)
+    set_many += s.contains_many(&probes[first],std::min(speed_buffer,speed_probes-first),found);
+  s_set_many.stop();
+  ASSERT_EQ(set_one,set_many);
+
+  std::cout << "speed_out_of_cache (" << speed_probes << " probes of " << speed_size << " keys, seconds)" << std::endl;
+  std::cout << "  HashMap has_key       = " << s_one.read()     << "   contains_many = " << s_many.read()     << std::endl;
+  std::cout << "  HashMap has_key+[]    = " << s_get_one.read() << "   get_many      = " << s_get_many.read() << std::endl;
+  std::cout << "  HashSet contains      = " << s_set_one.read() << "   contains_many = " << s_set_many.read() << std::endl;
+}
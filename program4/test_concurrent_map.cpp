@@ -0,0 +1,256 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <climits>                   // INT_MIN
+#include <cstdint>
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "hash_map.hpp"
+#include "concurrent_hash_map.hpp"
+#include "hashers.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static int hash_string  (const std::string& s) {std::hash<std::string> str_hash; return str_hash(s);}
+static int hash_int_min (const int& i)         {return i == 0 ? INT_MIN : i;}
+static std::uint64_t hash_int64 (const std::int64_t& i) {return i;}  //all 64 bits; keys differing only in their high 32 bits
+
+typedef ics::ConcurrentHashMap<std::string,int,hash_string> ConcurrentMapTypeStr;
+typedef ics::HashMap<std::string,int,hash_string>           MapTypeStr;
+
+static const int threads      = 8;        //tests run with more than one thread
+static const int thread_keys  = 20000;    //parallel_put_erase (keys per thread)
+static const int speed_keys   = 100000;   //speed_scaling (distinct words)
+static const int speed_ops    = 2000000;  //speed_scaling (updates, split among the threads)
+
+
+class ConcurrentMapTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+//Run body(t) in each of n threads t = 0..n-1 and wait for all of them
+template<class Body>
+static void in_parallel(int n, Body body) {
+  std::vector<std::thread> running;
+  for (int t=0; t<n; ++t)
+    running.push_back(std::thread(body,t));
+  for (std::thread& r : running)
+    r.join();
+}
+
+
+static std::string word (int i) {return "word-" + std::to_string(i);}
+
+
+
+TEST_F(ConcurrentMapTest, operations) {
+  ConcurrentMapTypeStr m;
+  ASSERT_TRUE(m.empty());
+  for (int i=0; i<1000; ++i)
+    ASSERT_EQ(i,m.put(word(i),i));
+  ASSERT_EQ(1000,m.size());
+  ASSERT_EQ(5,m.put(word(5),-5));
+  ASSERT_EQ(-5,m.get(word(5)));
+  ASSERT_EQ(-5,m.erase(word(5)));
+  ASSERT_FALSE(m.has_key(word(5)));
+  ASSERT_THROW(m.erase(word(5)),ics::KeyError);
+  ASSERT_THROW(m.get(word(5)),ics::KeyError);
+  ASSERT_EQ(999,m.size());
+
+  ASSERT_TRUE(m.compute_if_absent(word(5),[] (const std::string& k) {return int(k.size());}));
+  ASSERT_FALSE(m.compute_if_absent(word(5),[] (const std::string& k) -> int {throw ics::KeyError("called");}));
+  ASSERT_EQ(6,m.get(word(5)));
+  ASSERT_TRUE(m.update(word(6),[] (int& v) {v *= 10;}));
+  ASSERT_FALSE(m.update(word(-1),[] (int& v) {v += 7;}));     //put with T() first
+  ASSERT_EQ(60,m.get(word(6)));
+  ASSERT_EQ(7,m.get(word(-1)));
+
+  int count = 0, sum = 0;
+  for (const ConcurrentMapTypeStr::Entry& e : m) {
+    ++count;
+    sum += e.second;
+  }
+  ASSERT_EQ(1001,count);
+  ASSERT_EQ(999*1000/2 - 5 + 6 - 6 + 60 + 7,sum);
+  ASSERT_THROW(*m.end(),ics::IteratorPositionIllegal);
+
+  std::ostringstream out;
+  ConcurrentMapTypeStr one({{"a",1}});
+  out << one;
+  ASSERT_EQ("map[a->1]",out.str());
+
+  m.clear();
+  ASSERT_TRUE(m.empty());
+  ASSERT_TRUE(m.begin() == m.end());
+  m.put("b",2);
+  ASSERT_EQ(2,m.get("b"));
+}
+
+
+TEST_F(ConcurrentMapTest, parallel_put_erase) {
+  ConcurrentMapTypeStr m;
+  in_parallel(threads,[&m] (int t) {          //disjoint keys: many resizes while other threads put
+    for (int i=0; i<thread_keys; ++i)
+      m.put(word(t*thread_keys+i),t);
+    for (int i=0; i<thread_keys; i+=2)
+      m.erase(word(t*thread_keys+i));
+  });
+
+  ASSERT_EQ(threads*thread_keys/2,m.size());
+  for (int t=0; t<threads; ++t)
+    for (int i=0; i<thread_keys; ++i)
+      ASSERT_EQ(i%2 == 1,m.has_key(word(t*thread_keys+i)));
+}
+
+
+TEST_F(ConcurrentMapTest, compute_if_absent_once) {
+  ConcurrentMapTypeStr m;
+  std::atomic<int> made(0), won(0);
+  in_parallel(threads,[&] (int t) {           //every thread races for the same keys
+    for (int i=0; i<thread_keys; ++i)
+      won += m.compute_if_absent(word(i),[&made,t] (const std::string& k) {++made; return t;});
+  });
+
+  ASSERT_EQ(thread_keys,made);
+  ASSERT_EQ(thread_keys,won);
+  ASSERT_EQ(thread_keys,m.size());
+}
+
+
+TEST_F(ConcurrentMapTest, update_counts) {
+  ConcurrentMapTypeStr m;
+  in_parallel(threads,[&m] (int t) {
+    for (int i=0; i<thread_keys; ++i)
+      m.update(word(i%1000),[] (int& count) {++count;});
+  });
+
+  ASSERT_EQ(1000,m.size());
+  for (int i=0; i<1000; ++i)
+    ASSERT_EQ(threads*thread_keys/1000,m.get(word(i)));
+}
+
+
+//abs(INT_MIN) is INT_MIN: the old codes could be negative (a negative stripe and bin index);
+//  also with a number of stripes that is not a power of 2
+template<int stripes>
+static void int_min_keys() {
+  ics::ConcurrentHashMap<int,int,hash_int_min,stripes> m;
+  for (int i=0; i<1000; ++i)
+    m.put(i,-i);
+  ASSERT_TRUE(m.has_key(0));
+  ASSERT_EQ(0,m.get(0));
+  ASSERT_EQ(0,m.erase(0));
+  ASSERT_FALSE(m.has_key(0));
+  ASSERT_EQ(999,m.size());
+
+  std::vector<int> seen(1000,0);
+  for (const typename ics::ConcurrentHashMap<int,int,hash_int_min,stripes>::Entry& e : m)
+    ++seen[e.first];
+  for (int i=1; i<1000; ++i)
+    ASSERT_EQ(1,seen[i]);
+}
+
+
+TEST_F(ConcurrentMapTest, int_min_hash) {
+  int_min_keys<16>();
+  int_min_keys<3>();
+  int_min_keys<1>();
+}
+
+
+//64-bit hashers (hashers.hpp) instantiate ConcurrentHashMap as they do HashMap
+TEST_F(ConcurrentMapTest, hashers_64_bit) {
+  ics::ConcurrentHashMap<std::string,int,ics::hash_string> m;
+  in_parallel(threads,[&m] (int t) {
+    for (int i=0; i<thread_keys; ++i)
+      m.put(word(t*thread_keys+i),t);
+  });
+  ASSERT_EQ(threads*thread_keys,m.size());
+  for (int t=0; t<threads; ++t)
+    ASSERT_EQ(t,m.get(word(t*thread_keys)));
+
+  ics::ConcurrentHashMap<std::int64_t,int,hash_int64> high;
+  for (int i=0; i<thread_keys; ++i)
+    high.put(std::int64_t(i) << 32,i);
+  for (int i=0; i<thread_keys; i+=2)
+    ASSERT_EQ(i,high.erase(std::int64_t(i) << 32));
+  ASSERT_EQ(thread_keys/2,high.size());
+  for (int i=0; i<thread_keys; ++i)
+    ASSERT_EQ(i%2 == 1,high.has_key(std::int64_t(i) << 32));
+
+  ics::ConcurrentHashMap<std::string,int,ics::undefinedhash<std::string,std::uint64_t>> none(1.0,ics::hash_string);
+  none.put("x",1);
+  ASSERT_TRUE(none.has_key("x"));
+}
+
+
+TEST_F(ConcurrentMapTest, weak_iteration) {
+  ConcurrentMapTypeStr m;
+  for (int i=0; i<thread_keys; ++i)
+    m.put(word(i),i);
+
+  std::atomic<bool> done(false);
+  std::thread churn([&] {                    //puts/erases other keys (and resizes) while iterating
+    for (int i=0; !done; i = (i+1) % (4*thread_keys)) {
+      m.put(word(-1-i),i);
+      if (i%2 == 0)
+        m.erase(word(-1-i));
+    }
+  });
+
+  std::vector<int> seen(thread_keys,0);
+  for (int pass=0; pass<5; ++pass)
+    for (const ConcurrentMapTypeStr::Entry& e : m)
+      if (e.second >= 0 && e.first == word(e.second))
+        ++seen[e.second];
+  done = true;
+  churn.join();
+
+  for (int i=0; i<thread_keys; ++i)
+    ASSERT_EQ(5,seen[i]);
+}
+
+
+//Count speed_ops words (speed_keys different ones) split among n threads, each updating the shared
+//  map for its shard; returns the seconds taken and checks that every word is counted
+template<class Count>
+static double count_words(int n, Count count, int& total) {
+  ics::Stopwatch s;
+  s.start();
+  in_parallel(n,[n,count] (int t) {
+    for (int i=t*(speed_ops/n); i<(t+1)*(speed_ops/n); ++i)
+      count(word(i*7 % speed_keys));
+  });
+  s.stop();
+  total = (speed_ops/n)*n;
+  return s.read();
+}
+
+
+TEST_F(ConcurrentMapTest, speed_scaling) {
+  std::cout << "speed_scaling (" << speed_ops << " word counts of " << speed_keys << " words, seconds; "
+            << std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+  for (int n : {1,2,4,8,16}) {
+    int total;
+    MapTypeStr locked_map;
+    std::mutex global;
+    double locked = count_words(n,[&] (const std::string& w) {std::lock_guard<std::mutex> guard(global); ++locked_map[w];},total);
+
+    ConcurrentMapTypeStr striped_map;
+    double striped = count_words(n,[&] (const std::string& w) {striped_map.update(w,[] (int& c) {++c;});},total);
+
+    std::cout << "  " << n << " threads: HashMap+mutex = " << locked << "   ConcurrentHashMap = " << striped << std::endl;
+    int sum = 0;
+    for (const ConcurrentMapTypeStr::Entry& e : striped_map)
+      sum += e.second;
+    ASSERT_EQ(total,sum);
+    ASSERT_EQ(speed_keys,striped_map.size());
+    ASSERT_EQ(speed_keys,locked_map.size());
+  }
+}
@@ -0,0 +1,277 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <algorithm>                 // std::random_shuffle, std::sort
+#include <chrono>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>               // __rdtsc, _mm_lfence
+#endif
+#include "ics46goody.hpp"
+#include "gtest/gtest.h"
+#include "array_queue.hpp"           // must leave in for use in iterator_erase
+#include "hash_map.hpp"
+#include "cuckoo_hash_map.hpp"
+#include "hashers.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static int hash_cuckoo_string (const std::string& s) {std::hash<std::string> str_hash; return str_hash(s);}
+static int hash_cuckoo_bad    (const int& s)         {return s % 16;}  //Many keys share each code on purpose
+
+typedef ics::pair<std::string,int>                                   EntryType;
+typedef ics::CuckooHashMap<std::string,int,hash_cuckoo_string>       CuckooMapTypeStr;
+typedef ics::CuckooHashMap<int,int,ics::hash_integer<int>>           CuckooMapTypeInt;
+typedef ics::CuckooHashMap<int,int,hash_cuckoo_bad>                  CuckooMapTypeBad;
+typedef ics::HashMap<int,int,ics::hash_integer<int>>                 ChainMapTypeInt64;
+
+static const int test_size    = 10000;    //large_scale
+static const int speed_size   = 1000000;  //speed_lookup_cycles (entries in each map)
+static const int speed_probes = 1000000;  //speed_lookup_cycles (timed lookups in each map)
+
+
+class CuckooMapTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+static void load(CuckooMapTypeStr& m, std::string keys, std::vector<int> values) {
+  for (unsigned i=0; i<keys.size(); ++i)
+    m[std::string(1,keys[i])] = values[i];
+}
+
+
+static ::testing::AssertionResult mapsto(const CuckooMapTypeStr& m, std::string keys, std::vector<int> values) {
+  for (unsigned i=0; i<keys.size(); ++i)
+    if (!m.has_key(std::string(1,keys[i])) || m[std::string(1,keys[i])] != values[i])
+      return ::testing::AssertionFailure() << "key " << keys[i];
+  return ::testing::AssertionSuccess();
+}
+
+
+//Cycles on x86 (the time stamp counter); elsewhere nanoseconds
+static std::uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_lfence();                      //Earlier lookups finish before the counter is read
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+
+TEST_F(CuckooMapTest, empty) {
+  CuckooMapTypeStr m;
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(0,m.size());
+  ASSERT_FALSE(m.has_key("a"));
+  ASSERT_FALSE(m.has_value(1));
+}
+
+
+TEST_F(CuckooMapTest, put_erase_index) {
+  CuckooMapTypeStr m;
+  ASSERT_EQ(4,m.put("d",4));
+  ASSERT_EQ(1,m.put("a",1));
+  ASSERT_EQ(4,m.put("d",5));
+  load(m,"bcefgh",{2,3,6,7,8,9});
+  ASSERT_EQ(8,m.size());
+  ASSERT_TRUE(mapsto(m,"abcdefgh",{1,2,3,5,6,7,8,9}));
+  ASSERT_TRUE(m.has_value(9));
+  ASSERT_FALSE(m.has_value(4));
+
+  ASSERT_EQ(5,m.erase("d"));
+  ASSERT_THROW(m.erase("d"),ics::KeyError);
+  ASSERT_FALSE(m.has_key("d"));
+  ASSERT_EQ(7,m.size());
+  ++m["a"];
+  ASSERT_EQ(2,m["a"]);
+  const CuckooMapTypeStr& cm = m;
+  ASSERT_THROW(cm["z"],ics::KeyError);
+
+  m.clear();
+  ASSERT_TRUE(m.empty());
+  ASSERT_FALSE(m.has_key("a"));
+}
+
+
+//Only 16 distinct codes: more than 2*slots keys share each pair of buckets, so the stash fills
+TEST_F(CuckooMapTest, stash) {
+  CuckooMapTypeBad m;
+  for (int i=0; i<300; ++i)
+    ASSERT_EQ(i,m.put(i,i));
+  ASSERT_EQ(300,m.size());
+  ASSERT_GT(m.stash_size(),0);
+  for (int i=0; i<300; ++i)
+    ASSERT_EQ(i,m[i]);
+  ASSERT_FALSE(m.has_key(300));
+
+  for (int i=0; i<300; i+=2)
+    ASSERT_EQ(i,m.erase(i));
+  ASSERT_EQ(150,m.size());
+  for (int i=0; i<300; ++i)
+    ASSERT_EQ(i%2 == 1,m.has_key(i));
+}
+
+
+TEST_F(CuckooMapTest, operator_rel) {
+  CuckooMapTypeStr m1, m2(1000);
+  load(m1,"abcdefgh",{1,2,3,4,5,6,7,8});
+  load(m2,"hgfedcba",{8,7,6,5,4,3,2,1});
+  ASSERT_TRUE(m1 == m2);
+  ASSERT_FALSE(m1 != m2);
+  m2["a"] = 0;
+  ASSERT_TRUE(m1 != m2);
+  m2.erase("a");
+  ASSERT_FALSE(m1 == m2);
+}
+
+
+TEST_F(CuckooMapTest, constructors) {
+  CuckooMapTypeStr m;
+  load(m,"abcdefgh",{1,2,3,4,5,6,7,8});
+
+  CuckooMapTypeStr copy(m);
+  ASSERT_EQ(m,copy);
+  CuckooMapTypeStr assigned;
+  assigned = m;
+  ASSERT_EQ(m,assigned);
+  CuckooMapTypeStr il({EntryType("a",1),EntryType("b",2)});
+  ASSERT_TRUE(mapsto(il,"ab",{1,2}));
+  ics::ArrayQueue<EntryType> q;
+  for (EntryType e : m)
+    q.enqueue(e);
+  CuckooMapTypeStr iterable(q);
+  ASSERT_EQ(m,iterable);
+
+  CuckooMapTypeStr moved(std::move(copy));
+  ASSERT_EQ(m,moved);
+  ASSERT_TRUE(copy.empty());
+  copy["z"] = 26;                     //A moved-from map allocates its buckets when next needed
+  ASSERT_TRUE(mapsto(copy,"z",{26}));
+
+  std::ostringstream out;
+  out << il;
+  ASSERT_TRUE(out.str() == "map[a->1,b->2]" || out.str() == "map[b->2,a->1]");
+}
+
+
+TEST_F(CuckooMapTest, iterator_erase) {
+  ics::ArrayQueue<EntryType> erased;
+  CuckooMapTypeStr m;
+  load(m,"fcijbdegah",{6,3,9,10,2,4,5,7,1,8});
+  CuckooMapTypeStr::Iterator it(m.begin());
+
+  erased.enqueue(it.erase());
+  ASSERT_THROW(it.erase(),ics::CannotEraseError);
+  ASSERT_THROW(*it,ics::IteratorPositionIllegal);
+  ++it;
+  ++it;
+  erased.enqueue(it.erase());
+  ++it;
+  erased.enqueue(it.erase());
+
+  CuckooMapTypeStr m2;
+  ASSERT_EQ(3,m2.put_all(erased));
+  ASSERT_EQ(7,m.size());
+  for (EntryType x : m2)
+    ASSERT_FALSE(m.has_key(x.first));
+
+  //erase all in the map: each entry (in buckets or the stash) is visited exactly once
+  CuckooMapTypeBad bm;
+  for (int i=0; i<300; ++i)
+    bm[i] = i;
+  int count = 0;
+  for (CuckooMapTypeBad::Iterator i(bm.begin()); i != bm.end(); ++i) {
+    int k = i->first;
+    ASSERT_EQ(k,i.erase().second);
+    ASSERT_FALSE(bm.has_key(k));
+    ++count;
+  }
+  ASSERT_EQ(300,count);
+  ASSERT_TRUE(bm.empty());
+}
+
+
+TEST_F(CuckooMapTest, iterator_exception_concurrent_modification_error) {
+  CuckooMapTypeStr m;
+  load(m,"fcijbdegah",{6,3,9,10,2,4,5,7,1,8});
+  CuckooMapTypeStr::Iterator it(m.begin());
+  m.erase("a");
+  ASSERT_THROW(++it,ics::ConcurrentModificationError);
+  ASSERT_THROW(it++,ics::ConcurrentModificationError);
+  ASSERT_THROW(*it,ics::ConcurrentModificationError);
+}
+
+
+TEST_F(CuckooMapTest, large_scale) {
+  CuckooMapTypeInt lm;
+
+  std::vector<int> values;
+  for (int i=0; i<test_size; ++i)
+    values.push_back(i);
+  std::random_shuffle(values.begin(),values.end());
+
+  for (int test=1; test<=5; ++test) {
+    int inserted = 0;
+    int erased   = 0;
+    while (erased != test_size) {
+      int to_insert = ics::rand_range(0,test_size-inserted);
+      for (int i=0; i <to_insert; ++i) {
+        ASSERT_EQ(inserted,lm.put(values[inserted],inserted));
+        ASSERT_TRUE(lm.has_key(values[inserted]));
+        ASSERT_EQ(inserted,lm[values[inserted]]);
+        ++inserted;
+      };
+
+      int to_erase = ics::rand_range(0,inserted-erased);
+      for (int i=0; i <to_erase; ++i) {
+        ASSERT_EQ(erased,lm.erase(values[erased]));
+        ASSERT_FALSE(lm.has_key(values[erased]));
+        ++erased;
+      }
+    }
+  }
+  ASSERT_TRUE(lm.empty());
+  ASSERT_EQ(0,lm.size());
+}
+
+
+//Time each of speed_probes hit lookups (in shuffled order) separately; report the distribution,
+//  which is what worst-case O(1) lookups improve (the chained map's long chains show up at p99/max)
+template<class MapType>
+void time_lookups(const char* name, const std::vector<int>& keys, const std::vector<int>& probes, int& checksum) {
+  MapType m;
+  for (int k : keys)
+    m.put(k,k);
+
+  std::vector<std::uint64_t> cycles;
+  cycles.reserve(probes.size());
+  for (int k : probes) {
+    std::uint64_t start = read_cycles();
+    checksum += m.has_key(k);
+    cycles.push_back(read_cycles()-start);
+  }
+  std::sort(cycles.begin(),cycles.end());
+  std::cout << "  " << name << ": p50 = " << cycles[cycles.size()/2] << ", p99 = " << cycles[cycles.size()*99/100]
+            << ", max = " << cycles.back() << std::endl;
+}
+
+
+TEST_F(CuckooMapTest, speed_lookup_cycles) {
+  std::vector<int> keys, probes;
+  for (int i=0; i<speed_size; ++i)
+    keys.push_back(i);
+  std::random_shuffle(keys.begin(),keys.end());
+  for (int i=0; i<speed_probes; ++i)
+    probes.push_back(keys[ics::rand_range(0,speed_size-1)]);
+
+  int checksum = 0;
+  std::cout << "speed_lookup_cycles (" << speed_probes << " hits among " << speed_size << " int keys; "
+            << "cycles per lookup, including reading the counter)" << std::endl;
+  time_lookups<ChainMapTypeInt64>("HashMap      ",keys,probes,checksum);
+  time_lookups<CuckooMapTypeInt> ("CuckooHashMap",keys,probes,checksum);
+  ASSERT_EQ(2*speed_probes,checksum);
+}
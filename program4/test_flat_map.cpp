@@ -0,0 +1,336 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <algorithm>                 // std::random_shuffle
+#include <cstdint>
+#include "ics46goody.hpp"
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "array_queue.hpp"           // must leave in for use in iterator_erase
+#include "hash_map.hpp"
+#include "flat_hash_map.hpp"
+#include "hashers.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static int hash_string  (const std::string& s) {std::hash<std::string> str_hash; return str_hash(s);}
+static int hash_int     (const int& s)         {std::hash<int> str_hash; return str_hash(s);}
+static int hash_bad     (const int& s)         {return s % 4;}  //Long probe sequences on purpose
+static std::uint64_t hash_int64 (const std::int64_t& i) {return i;}  //all 64 bits; keys differing only in their high 32 bits
+
+typedef ics::pair<std::string,int>                    EntryType;
+typedef ics::FlatHashMap<std::string,int,hash_string> FlatMapTypeStr;
+typedef ics::FlatHashMap<int,int,hash_int>            FlatMapTypeInt;
+typedef ics::HashMap<int,int,hash_int>                ChainMapTypeInt;
+
+static const int test_size  = 10000;    //hashers_64_bit, large_scale
+static const int speed_size = 1000000;  //speed_vs_chained (entries in each map)
+
+
+class FlatMapTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+static void load(FlatMapTypeStr& m, std::string keys, std::vector<int> values) {
+  for (unsigned i=0; i<keys.size(); ++i)
+    m[std::string(1,keys[i])] = values[i];
+}
+
+
+static ::testing::AssertionResult mapsto(const FlatMapTypeStr& m, std::string keys, std::vector<int> values) {
+  for (unsigned i=0; i<keys.size(); ++i)
+    if (!m.has_key(std::string(1,keys[i])) || m[std::string(1,keys[i])] != values[i])
+      return ::testing::AssertionFailure() << "key " << keys[i];
+  return ::testing::AssertionSuccess();
+}
+
+
+
+TEST_F(FlatMapTest, empty) {
+  FlatMapTypeStr m;
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(0,m.size());
+  ASSERT_FALSE(m.has_key("a"));
+  ASSERT_FALSE(m.has_value(1));
+}
+
+
+TEST_F(FlatMapTest, put) {
+  FlatMapTypeStr m;
+  ASSERT_EQ(4,m.put("d",4));
+  ASSERT_EQ(1,m.put("a",1));
+  ASSERT_EQ(3,m.put("c",3));
+  ASSERT_EQ(2,m.put("b",2));
+  ASSERT_EQ(4, m.size());
+  ASSERT_TRUE(mapsto(m,"dacb",{4,1,3,2}));
+  ASSERT_FALSE(m.has_key("x"));
+  ASSERT_FALSE(m.has_value(100));
+
+  ASSERT_EQ(4,m.put("d",14));
+  ASSERT_EQ(1,m.put("a",11));
+  ASSERT_EQ(4, m.size());
+  ASSERT_TRUE(mapsto(m,"dacb",{14,11,3,2}));
+  ASSERT_TRUE(m.has_value(11));
+  ASSERT_FALSE(m.has_value(1));
+}
+
+
+TEST_F(FlatMapTest, put_index) {
+  FlatMapTypeStr m;
+  m["a"] = 1;
+  m["b"] = 2;
+  ++m["a"];
+  ASSERT_EQ(2, m.size());
+  ASSERT_TRUE(mapsto(m,"ab",{2,2}));
+
+  const FlatMapTypeStr& cm = m;
+  ASSERT_EQ(2,cm["b"]);
+  ASSERT_THROW(cm["x"],ics::KeyError);
+}
+
+
+TEST_F(FlatMapTest, erase) {
+  FlatMapTypeStr m;
+  load(m,"fcijbdegah",{6,3,9,10,2,4,5,7,1,8});
+  ASSERT_THROW(m.erase("x"),ics::KeyError);
+  ASSERT_EQ(6,m.erase("f"));
+  ASSERT_EQ(1,m.erase("a"));
+  ASSERT_EQ(8,m.size());
+  ASSERT_FALSE(m.has_key("f"));
+  ASSERT_FALSE(m.has_key("a"));
+  ASSERT_TRUE(mapsto(m,"cijbdegh",{3,9,10,2,4,5,7,8}));
+
+  m.clear();
+  ASSERT_TRUE(m.empty());
+  ASSERT_FALSE(m.has_key("c"));
+}
+
+
+TEST_F(FlatMapTest, collisions) {
+  //All keys fall in 4 home bins: exercises Robin Hood displacement, wrap around and backward shift
+  ics::FlatHashMap<int,int,hash_bad> m(8);
+  for (int i=0; i<200; ++i)
+    m.put(i,i*10);
+  ASSERT_EQ(200,m.size());
+  for (int i=0; i<200; i+=2)
+    ASSERT_EQ(i*10,m.erase(i));
+  ASSERT_EQ(100,m.size());
+  for (int i=0; i<200; ++i)
+    ASSERT_EQ(i%2 == 1, m.has_key(i));
+  for (int i=1; i<200; i+=2)
+    ASSERT_EQ(i*10,m[i]);
+}
+
+
+TEST_F(FlatMapTest, operator_rel) {
+  FlatMapTypeStr m1, m2;
+  load(m1,"abcde",{1,2,3,4,5});
+  load(m2,"edcba",{5,4,3,2,1});
+  ASSERT_EQ(m1,m2);
+  m2["a"] = 7;
+  ASSERT_NE(m1,m2);
+
+  FlatMapTypeStr m3(m1), m4;
+  m4 = m1;
+  ASSERT_EQ(m1,m3);
+  ASSERT_EQ(m1,m4);
+
+  std::ostringstream out;
+  FlatMapTypeStr m5;
+  m5["a"] = 1;
+  out << m5;
+  ASSERT_EQ("map[a->1]",out.str());
+}
+
+
+TEST_F(FlatMapTest, constructors) {
+  FlatMapTypeStr m1({EntryType("a",1),EntryType("b",2)});
+  ASSERT_TRUE(mapsto(m1,"ab",{1,2}));
+
+  FlatMapTypeStr m2(m1, 0.5);
+  ASSERT_EQ(m1,m2);
+
+  ics::ArrayQueue<EntryType> q;
+  q.enqueue(EntryType("a",1));
+  q.enqueue(EntryType("b",2));
+  FlatMapTypeStr m3(q);
+  ASSERT_EQ(m1,m3);
+
+  ics::FlatHashMap<std::string,int> none(0.875, hash_string);
+  none.put("x",1);
+  ASSERT_TRUE(none.has_key("x"));
+  ASSERT_THROW((ics::FlatHashMap<std::string,int>()),ics::TemplateFunctionError);
+}
+
+
+TEST_F(FlatMapTest, iterator_simple) {
+  FlatMapTypeStr m, m_iter;
+  load(m,"fcijbdegah",{6,3,9,10,2,4,5,7,1,8});
+
+  for (EntryType x : m)
+    m_iter.put(x.first,x.second);
+  ASSERT_EQ(m,m_iter);
+
+  m_iter.clear();
+  for (FlatMapTypeStr::Iterator it(m.begin()); it != m.end(); it++)
+    m_iter.put(it->first,it->second);
+  ASSERT_EQ(m,m_iter);
+}
+
+
+TEST_F(FlatMapTest, iterator_erase) {
+  ics::ArrayQueue<EntryType> erased;
+  FlatMapTypeStr m;
+  load(m,"fcijbdegah",{6,3,9,10,2,4,5,7,1,8});
+  FlatMapTypeStr::Iterator it(m.begin());
+
+  erased.enqueue(it.erase());
+  ASSERT_THROW(it.erase(),ics::CannotEraseError);
+  ASSERT_THROW(*it,ics::IteratorPositionIllegal);
+  ++it;
+  ++it;
+  erased.enqueue(it.erase());
+  ++it;
+  erased.enqueue(it.erase());
+
+  FlatMapTypeStr m2;
+  ASSERT_EQ(3,m2.put_all(erased));
+  ASSERT_EQ(7,m.size());
+  for (EntryType x : m2)
+    ASSERT_FALSE(m.has_key(x.first));
+
+  //erase all in the map: each entry is visited exactly once even as entries shift back
+  ics::FlatHashMap<int,int,hash_bad> bm;
+  for (int i=0; i<100; ++i)
+    bm[i] = i;
+  int count = 0;
+  for (ics::FlatHashMap<int,int,hash_bad>::Iterator i(bm.begin()); i != bm.end(); ++i) {
+    int k = i->first;
+    ASSERT_EQ(k,i.erase().second);
+    ASSERT_FALSE(bm.has_key(k));
+    ++count;
+  }
+  ASSERT_EQ(100,count);
+  ASSERT_TRUE(bm.empty());
+}
+
+
+TEST_F(FlatMapTest, iterator_exception_concurrent_modification_error) {
+  FlatMapTypeStr m;
+  load(m,"fcijbdegah",{6,3,9,10,2,4,5,7,1,8});
+  FlatMapTypeStr::Iterator it(m.begin());
+
+  m.erase("a");
+  ASSERT_THROW(it.erase(),ics::ConcurrentModificationError);
+  ASSERT_THROW(++it,ics::ConcurrentModificationError);
+  ASSERT_THROW(it++,ics::ConcurrentModificationError);
+  ASSERT_THROW(*it,ics::ConcurrentModificationError);
+}
+
+
+//64-bit hashers (hashers.hpp) instantiate FlatHashMap as they do HashMap, so either can be swapped in
+TEST_F(FlatMapTest, hashers_64_bit) {
+  ics::FlatHashMap<std::string,int,ics::hash_string> m;
+  ics::HashMap<std::string,int,ics::hash_string>     chained;
+  for (int i=0; i<test_size; ++i) {
+    m.put(std::to_string(i),i);
+    chained.put(std::to_string(i),i);
+  }
+  ASSERT_EQ(chained.size(),m.size());
+  for (const ics::pair<std::string,int>& e : chained)
+    ASSERT_EQ(e.second,m[e.first]);
+
+  ics::FlatHashMap<std::int64_t,int,hash_int64> high;
+  for (int i=0; i<test_size; ++i)
+    high.put(std::int64_t(i) << 32,i);
+  for (int i=0; i<test_size; i+=2)
+    ASSERT_EQ(i,high.erase(std::int64_t(i) << 32));
+  ASSERT_EQ(test_size/2,high.size());
+  for (int i=0; i<test_size; ++i)
+    ASSERT_EQ(i%2 == 1,high.has_key(std::int64_t(i) << 32));
+
+  ics::FlatHashMap<std::string,int,ics::undefinedhash<std::string,std::uint64_t>> none(0.875,ics::hash_string);
+  none.put("x",1);
+  ASSERT_TRUE(none.has_key("x"));
+}
+
+
+TEST_F(FlatMapTest, large_scale) {
+  FlatMapTypeInt lm;
+
+  std::vector<int> values;
+  for (int i=0; i<test_size; ++i)
+    values.push_back(i);
+  std::random_shuffle(values.begin(),values.end());
+
+  for (int test=1; test<=5; ++test) {
+    int inserted = 0;
+    int erased   = 0;
+    while (erased != test_size) {
+      int to_insert = ics::rand_range(0,test_size-inserted);
+      for (int i=0; i <to_insert; ++i) {
+        ASSERT_EQ(inserted,lm.put(values[inserted],inserted));
+        ASSERT_TRUE(lm.has_key(values[inserted]));
+        ASSERT_EQ(inserted,lm[values[inserted]]);
+        ++inserted;
+      };
+
+      int to_erase = ics::rand_range(0,inserted-erased);
+      for (int i=0; i <to_erase; ++i) {
+        ASSERT_EQ(erased,lm.erase(values[erased]));
+        ASSERT_FALSE(lm.has_key(values[erased]));
+        ++erased;
+      }
+    }
+  }
+  ASSERT_TRUE(lm.empty());
+  ASSERT_EQ(0,lm.size());
+}
+
+
+//Time insert, hit lookup, miss lookup and erase of speed_size int keys in each map;
+//  keys are shuffled so neither map sees them in bin order
+template<class MapType>
+void time_map(const char* name, const std::vector<int>& keys, int& checksum) {
+  ics::Stopwatch s_insert, s_hit, s_miss, s_erase;
+  MapType m;
+
+  s_insert.start();
+  for (int k : keys)
+    m.put(k,k);
+  s_insert.stop();
+
+  s_hit.start();
+  for (int k : keys)
+    checksum += m.has_key(k);
+  s_hit.stop();
+
+  s_miss.start();
+  for (int k : keys)
+    checksum += m.has_key(-k-1);
+  s_miss.stop();
+
+  s_erase.start();
+  for (int k : keys)
+    checksum += m.erase(k) == k;
+  s_erase.stop();
+
+  std::cout << "  " << name << ": insert = " << s_insert.read() << ", hit = " << s_hit.read()
+            << ", miss = " << s_miss.read() << ", erase = " << s_erase.read() << std::endl;
+}
+
+
+TEST_F(FlatMapTest, speed_vs_chained) {
+  std::vector<int> keys;
+  for (int i=0; i<speed_size; ++i)
+    keys.push_back(i);
+  std::random_shuffle(keys.begin(),keys.end());
+
+  int checksum = 0;
+  std::cout << "speed_vs_chained (" << speed_size << " int keys, seconds)" << std::endl;
+  time_map<ChainMapTypeInt>("HashMap    ",keys,checksum);
+  time_map<FlatMapTypeInt> ("FlatHashMap",keys,checksum);
+  ASSERT_EQ(4*speed_size,checksum);   //hits + erases in both maps; no false positives on misses
+}
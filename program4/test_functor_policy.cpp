@@ -0,0 +1,159 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>                // std::greater
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "hash_map.hpp"
+#include "hash_set.hpp"
+#include "heap_priority_queue.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static int  hash_int (const int& i)               {return i*2654435761u;}
+static bool gt_int   (const int& a, const int& b) {return a > b;}
+
+//The same functions as stateless functor classes
+struct IntHash {
+  int operator () (int i) const {return i*2654435761u;}
+};
+struct IntGt {
+  bool operator () (int a, int b) const {return a > b;}
+};
+
+typedef ics::HashMap<int,int>                            MapTypeIntArg;       //hash_int supplied to the constructor
+typedef ics::HashMap<int,int,hash_int>                   MapTypeInt;
+typedef ics::HashMap<int,int,ics::functor<IntHash>>      MapTypeIntFunctor;
+typedef ics::HashSet<int>                                SetTypeIntArg;
+typedef ics::HashSet<int,hash_int>                       SetTypeInt;
+typedef ics::HashSet<int,ics::functor<IntHash>>          SetTypeIntFunctor;
+typedef ics::HeapPriorityQueue<int>                      PriorityQueueTypeIntArg;
+typedef ics::HeapPriorityQueue<int,gt_int>               PriorityQueueTypeInt;
+typedef ics::HeapPriorityQueue<int,ics::functor<IntGt>>  PriorityQueueTypeIntFunctor;
+typedef ics::HeapPriorityQueue<int,ics::functor<std::greater<int>>> PriorityQueueTypeIntStd;
+
+static const int speed_size  = 1000000;  //speed_int_keys (keys/values)
+static const int speed_gets  = 5;        //speed_int_keys (lookups of every key)
+
+
+class FunctorPolicyTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+
+TEST_F(FunctorPolicyTest, same_behavior) {
+  MapTypeIntArg     arg(1.0,hash_int);
+  MapTypeInt        pointer;
+  MapTypeIntFunctor functor;
+  for (int i=0; i<1000; i+=3) {
+    arg.put(i,-i);
+    pointer.put(i,-i);
+    functor.put(i,-i);
+  }
+  for (int i=0; i<1000; ++i) {
+    ASSERT_EQ(pointer.has_key(i),functor.has_key(i));
+    ASSERT_EQ(arg.has_key(i),functor.has_key(i));
+  }
+  ASSERT_EQ(-999,functor[999]);
+  MapTypeIntFunctor copy(functor);
+  ASSERT_TRUE(copy == functor);
+  ASSERT_THROW(MapTypeIntFunctor(1.0,hash_int),ics::TemplateFunctionError);  //different from the template's
+  ASSERT_THROW(MapTypeIntArg(),ics::TemplateFunctionError);                  //neither
+
+  SetTypeIntFunctor s({1,2,3});
+  ASSERT_TRUE(s.contains(2));
+  ASSERT_FALSE(s.contains(4));
+
+  PriorityQueueTypeIntFunctor q({3,1,4,1,5,9,2,6});
+  PriorityQueueTypeIntStd     r({3,1,4,1,5,9,2,6});
+  PriorityQueueTypeIntArg     a({3,1,4,1,5,9,2,6},gt_int);
+  for (int expected : {9,6,5,4,3,2,1,1}) {
+    ASSERT_EQ(expected,q.dequeue());
+    ASSERT_EQ(expected,r.dequeue());
+    ASSERT_EQ(expected,a.dequeue());
+  }
+  PriorityQueueTypeIntFunctor q2({7,8});
+  PriorityQueueTypeIntFunctor q3(q2);
+  ASSERT_TRUE(q2 == q3);
+}
+
+
+template<class Map>
+static double time_map(Map& m, long& sum) {
+  ics::Stopwatch s;
+  s.start();
+  for (int i=0; i<speed_size; ++i)
+    m.put(i,i);
+  for (int g=0; g<speed_gets; ++g)
+    for (int i=0; i<2*speed_size; i+=2)
+      sum += m.has_key(i);
+  s.stop();
+  return s.read();
+}
+
+
+template<class Set>
+static double time_set(Set& s, long& sum) {
+  ics::Stopwatch w;
+  w.start();
+  for (int i=0; i<speed_size; ++i)
+    s.insert(i);
+  for (int g=0; g<speed_gets; ++g)
+    for (int i=0; i<2*speed_size; i+=2)
+      sum += s.contains(i);
+  w.stop();
+  return w.read();
+}
+
+
+template<class PriorityQueue>
+static double time_priority_queue(PriorityQueue& q, long& sum) {
+  ics::Stopwatch s;
+  s.start();
+  for (int i=0; i<speed_size; ++i)
+    q.enqueue(int(i*2654435761u % speed_size));
+  while (!q.empty())
+    sum += q.dequeue();
+  s.stop();
+  return s.read();
+}
+
+
+//The function as a constructor argument (always called through a pointer), a template argument
+//  (now called directly), and a functor class
+TEST_F(FunctorPolicyTest, speed_int_keys) {
+  long sums[3] = {0,0,0};
+  MapTypeIntArg     m_arg(1.0,hash_int);
+  MapTypeInt        m_pointer;
+  MapTypeIntFunctor m_functor;
+  double map_arg     = time_map(m_arg,sums[0]);
+  double map_pointer = time_map(m_pointer,sums[1]);
+  double map_functor = time_map(m_functor,sums[2]);
+  ASSERT_EQ(sums[0],sums[1]);
+  ASSERT_EQ(sums[0],sums[2]);
+
+  SetTypeIntArg     s_arg(1.0,hash_int);
+  SetTypeInt        s_pointer;
+  SetTypeIntFunctor s_functor;
+  double set_arg     = time_set(s_arg,sums[0]);
+  double set_pointer = time_set(s_pointer,sums[1]);
+  double set_functor = time_set(s_functor,sums[2]);
+  ASSERT_EQ(sums[0],sums[1]);
+  ASSERT_EQ(sums[0],sums[2]);
+
+  PriorityQueueTypeIntArg     q_arg(gt_int);
+  PriorityQueueTypeInt        q_pointer;
+  PriorityQueueTypeIntFunctor q_functor;
+  double pq_arg     = time_priority_queue(q_arg,sums[0]);
+  double pq_pointer = time_priority_queue(q_pointer,sums[1]);
+  double pq_functor = time_priority_queue(q_functor,sums[2]);
+  ASSERT_EQ(sums[0],sums[1]);
+  ASSERT_EQ(sums[0],sums[2]);
+
+  std::cout << "speed_int_keys (" << speed_size << " ints, seconds: constructor argument / template argument / functor)" << std::endl;
+  std::cout << "  HashMap put+has_key          = " << map_arg << " / " << map_pointer << " / " << map_functor << std::endl;
+  std::cout << "  HashSet insert+contains      = " << set_arg << " / " << set_pointer << " / " << set_functor << std::endl;
+  std::cout << "  HeapPriorityQueue enq+deq    = " << pq_arg  << " / " << pq_pointer  << " / " << pq_functor  << std::endl;
+}
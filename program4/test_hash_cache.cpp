@@ -0,0 +1,174 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "array_queue.hpp"
+#include "hash_map.hpp"
+
+typedef ics::ArrayQueue<std::string> WordQueue;
+
+//static: every test_*.cpp is linked into the same executable
+//Like wordgenerator's hashfunct (sums its words' hashes), counting its calls
+static int hash_calls = 0;
+static int hash_word_queue (const WordQueue& wq) {
+  ++hash_calls;
+  std::hash<std::string> str_hash;
+  int answer = 0;
+  for (const std::string& w : wq)
+    answer += str_hash(w);
+  return answer;
+}
+
+typedef ics::HashMap<WordQueue,int,hash_word_queue,ics::HeapNodeAllocator,ics::RecomputeHash> RecomputeCorpus;
+typedef ics::HashMap<WordQueue,int,hash_word_queue,ics::HeapNodeAllocator,ics::CacheHash>     CacheCorpus;
+
+static const int order        = 3;        //words in each WordQueue key
+static const int vocabulary   = 2000;     //distinct words in the generated text
+static const int speed_words  = 200000;   //speed_word_queue (words of text: about as many keys)
+static const int speed_probes = 5;        //speed_word_queue (lookups of every window)
+
+
+class HashCacheTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+//Every window of order consecutive words in n words of (seeded) random text, with long-ish words
+static std::vector<WordQueue> windows(int n) {
+  std::mt19937 gen(46);
+  std::uniform_int_distribution<int> pick(0,vocabulary-1);
+  std::vector<WordQueue> answer;
+  WordQueue wq;
+  for (int i=0; i<n; ++i) {
+    wq.enqueue("word-" + std::to_string(pick(gen)) + "-of-the-generated-text");
+    if (wq.size() > order)
+      wq.dequeue();
+    if (wq.size() == order)
+      answer.push_back(wq);
+  }
+  return answer;
+}
+
+
+//Key by key: HashMap::operator == calls has_value for each key (O(N^2) on large maps)
+template<class Map1, class Map2>
+static bool same(const Map1& a, const Map2& b) {
+  if (a.size() != b.size())
+    return false;
+  for (const typename Map1::Entry& e : a)
+    if (!b.has_key(e.first) || b[e.first] != e.second)
+      return false;
+  return true;
+}
+
+
+template<class Corpus>
+static void mutate(Corpus& c, const std::vector<WordQueue>& keys) {
+  for (int i=0; i<int(keys.size()); ++i)
+    c[keys[i]] += i;
+  for (int i=0; i<int(keys.size()); i+=3)
+    if (c.has_key(keys[i]))
+      c.erase(keys[i]);
+  int count = 0;
+  for (typename Corpus::Iterator it = c.begin(); it != c.end(); ++it)
+    if (++count % 5 == 0)
+      it.erase();
+  for (int i=0; i<int(keys.size()); i+=7)
+    c.put(keys[i],-i);
+}
+
+
+
+TEST_F(HashCacheTest, same_contents) {
+  std::vector<WordQueue> keys = windows(5000);
+  for (int step : {0,1}) {
+    RecomputeCorpus r;
+    CacheCorpus     c;
+    r.set_rehash_step(step);
+    c.set_rehash_step(step);
+    mutate(r,keys);
+    mutate(c,keys);
+    ASSERT_TRUE(same(r,c));
+
+    CacheCorpus copy(c), assigned;
+    assigned = c;
+    ASSERT_TRUE(same(copy,r));
+    ASSERT_TRUE(same(assigned,r));
+    for (const WordQueue& k : keys)         //copies keep the codes (erasing finds every key)
+      if (copy.has_key(k))
+        copy.erase(k);
+    ASSERT_TRUE(copy.empty());
+
+    CacheCorpus moved(std::move(c));
+    ASSERT_TRUE(same(moved,r));
+    ASSERT_TRUE(c.empty());
+  }
+}
+
+
+TEST_F(HashCacheTest, resize_never_hashes) {
+  std::vector<WordQueue> keys = windows(20000);
+  RecomputeCorpus r;
+  CacheCorpus     c;
+  int recompute_calls, cache_calls;
+
+  hash_calls = 0;
+  for (const WordQueue& k : keys)
+    r.put(k,1);
+  recompute_calls = hash_calls;
+  hash_calls = 0;
+  for (const WordQueue& k : keys)
+    c.put(k,1);
+  cache_calls = hash_calls;
+
+  ASSERT_EQ(int(keys.size()),cache_calls);      //once per put: none while resizing
+  ASSERT_LT(cache_calls+r.size(),recompute_calls);
+
+  hash_calls = 0;
+  CacheCorpus copy(c);
+  copy.set_rehash_step(1);
+  for (int i=0; i<int(keys.size()); ++i)
+    copy[keys[i]] = i;
+  ASSERT_EQ(int(keys.size()),hash_calls);
+  for (const WordQueue& k : keys)
+    ASSERT_TRUE(copy.has_key(k));
+  ASSERT_EQ(2*int(keys.size()),hash_calls);
+}
+
+
+//Build a corpus (as wordgenerator does) from the windows and look each up speed_probes times;
+//  report the build and lookup seconds and the calls to the hash function
+template<class Corpus>
+static void corpus_speed(const char* name, const std::vector<WordQueue>& keys, int& checksum) {
+  Corpus c;
+  ics::Stopwatch s_build, s_lookup;
+  hash_calls = 0;
+  s_build.start();
+  for (const WordQueue& k : keys)
+    ++c[k];
+  s_build.stop();
+  int build_calls = hash_calls;
+
+  s_lookup.start();
+  for (int p=0; p<speed_probes; ++p)
+    for (const WordQueue& k : keys)
+      checksum += c[k];
+  s_lookup.stop();
+  std::cout << "  " << name << " build = " << s_build.read() << "/" << build_calls
+            << "   lookup = " << s_lookup.read() << "/" << hash_calls-build_calls << std::endl;
+}
+
+
+TEST_F(HashCacheTest, speed_word_queue) {
+  std::vector<WordQueue> keys = windows(speed_words);
+  int recompute_checksum = 0, cache_checksum = 0;
+  std::cout << "speed_word_queue (" << keys.size() << " " << order << "-word windows, seconds/hash calls)" << std::endl;
+  corpus_speed<RecomputeCorpus>("RecomputeHash",keys,recompute_checksum);
+  corpus_speed<CacheCorpus>    ("CacheHash    ",keys,cache_checksum);
+  ASSERT_EQ(recompute_checksum,cache_checksum);
+}
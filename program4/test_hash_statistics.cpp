@@ -0,0 +1,214 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "array_queue.hpp"
+#include "pair.hpp"
+#include "hash_map.hpp"
+#include "hash_set.hpp"
+
+typedef ics::ArrayQueue<std::string> WordQueue;
+typedef ics::pair<std::string,std::string> Edge;
+
+//static: every test_*.cpp is linked into the same executable
+static int hash_int      (const int& i)         {std::hash<int> int_hash; return int_hash(i);}
+static int hash_constant (const int& i)         {return 7;}
+static int hash_string   (const std::string& s) {std::hash<std::string> str_hash; return str_hash(s);}
+
+//Like HashGraph's hash_pair_str (multiplies its nodes' hashes) and a hash that combines them
+static int hash_edge_product (const Edge& e) {return hash_string(e.first) * hash_string(e.second);}
+static int hash_edge_combine (const Edge& e) {return hash_string(e.first) * 31 + hash_string(e.second);}
+
+//Like wordgenerator's hashfunct (sums its words' hashes) and one that depends on their order
+static int hash_word_sum (const WordQueue& wq) {
+  int answer = 0;
+  for (const std::string& w : wq)
+    answer += hash_string(w);
+  return answer;
+}
+static int hash_word_ordered (const WordQueue& wq) {
+  int answer = 0;
+  for (const std::string& w : wq)
+    answer = answer*31 + hash_string(w);
+  return answer;
+}
+
+typedef ics::HashMap<int,int,hash_int>                                                                     MapTypeInt;
+typedef ics::HashMap<int,int,hash_int,ics::HeapNodeAllocator,ics::RecomputeHash,ics::HashCounters>         CountedMapTypeInt;
+typedef ics::HashMap<int,int,hash_constant,ics::HeapNodeAllocator,ics::RecomputeHash,ics::HashCounters>    CountedMapTypeConstant;
+typedef ics::HashSet<int,hash_int>                                                                         SetTypeInt;
+typedef ics::HashSet<int,hash_constant,ics::HeapNodeAllocator,ics::HashCounters>                           CountedSetTypeConstant;
+
+static const int test_keys   = 1000;     //shape_of_table/bad_hash_functions
+static const int chain_keys  = 100;      //counted_lookups (all in one chain)
+static const int speed_keys  = 1000000;  //speed_counting
+static const int speed_gets  = 5;        //speed_counting (lookups of every key)
+
+
+class HashStatisticsTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+//The histogram must account for every bin and key
+static ::testing::AssertionResult consistent(const ics::HashStatistics& s, int used) {
+  int bins = 0, keys = 0, longest = 0;
+  for (int length=0; length<int(s.chain_lengths.size()); ++length) {
+    bins += s.chain_lengths[length];
+    keys += length*s.chain_lengths[length];
+    if (s.chain_lengths[length] != 0)
+      longest = length;
+  }
+  if (s.used != used || keys != used || bins != s.bins || longest != s.max_chain)
+    return ::testing::AssertionFailure() << s.str();
+  return ::testing::AssertionSuccess();
+}
+
+
+
+TEST_F(HashStatisticsTest, shape_of_table) {
+  for (int step : {0,1}) {
+    MapTypeInt m;
+    m.set_rehash_step(step);                //1: statistics mid-rehash (see test_map_rehash.cpp)
+    for (int i=0; i<test_keys; ++i)
+      m.put(i*7919,i);
+    ics::HashStatistics s = m.statistics();
+    ASSERT_TRUE(consistent(s,test_keys));
+    ASSERT_FALSE(s.counted);
+    ASSERT_EQ(0,s.hits);
+    ASSERT_EQ(0,s.resizes);
+    ASSERT_EQ(0,s.shared_codes);
+    ASSERT_LT(s.collision_score,1.5);
+  }
+
+  SetTypeInt set;
+  for (int i=0; i<test_keys; ++i)
+    set.insert(i);
+  ASSERT_TRUE(consistent(set.statistics(),test_keys));
+
+  MapTypeInt empty;
+  ics::HashStatistics s = empty.statistics();
+  ASSERT_TRUE(consistent(s,0));
+  ASSERT_EQ(0.0,s.collision_score);
+  MapTypeInt moved(std::move(empty));
+  ASSERT_TRUE(consistent(empty.statistics(),0));      //no bins
+}
+
+
+TEST_F(HashStatisticsTest, counted_lookups) {
+  CountedMapTypeConstant m;
+  for (int i=0; i<chain_keys; ++i)
+    m.put(i,i);
+  ics::HashStatistics s = m.statistics();
+  ASSERT_TRUE(s.counted);
+  ASSERT_EQ(chain_keys,s.max_chain);
+  ASSERT_EQ(chain_keys-1,s.shared_codes);
+  ASSERT_GT(s.collision_score,10.0);
+  ASSERT_EQ(7,s.resizes);                             //1 bin doubled to 128
+  ASSERT_GT(s.resize_seconds,0.0);
+
+  m.reset_statistics();
+  for (int i=0; i<chain_keys; ++i)                    //keys are added at the front of their chain
+    ASSERT_TRUE(m.has_key(i));
+  ASSERT_FALSE(m.has_key(-1));
+  s = m.statistics();
+  ASSERT_EQ(chain_keys,s.hits);
+  ASSERT_EQ(chain_keys*(chain_keys+1)/2,s.hit_probes);
+  ASSERT_EQ((chain_keys+1)/2.0,s.average_hit_probes());
+  ASSERT_EQ(1,s.misses);
+  ASSERT_EQ(chain_keys,s.average_miss_probes());
+  ASSERT_EQ(0,s.resizes);
+
+  CountedSetTypeConstant set;
+  for (int i=0; i<chain_keys; ++i)
+    set.insert(i);
+  set.reset_statistics();
+  ASSERT_FALSE(set.contains(-1));
+  s = set.statistics();
+  ASSERT_TRUE(consistent(s,chain_keys));
+  ASSERT_EQ(chain_keys,s.average_miss_probes());
+
+  std::ostringstream out;
+  out << s.str();
+  ASSERT_NE(std::string::npos,out.str().find("misses=1"));
+}
+
+
+TEST_F(HashStatisticsTest, bad_hash_functions) {
+  //Edges among test nodes: a product is the same for (a,b) and (b,a), and is even 3/4 of the time
+  ics::HashMap<Edge,int,hash_edge_product> product;
+  ics::HashMap<Edge,int,hash_edge_combine> combine;
+  for (int i=0; i<test_keys; ++i) {
+    Edge e("node-" + std::to_string(i%50),"node-" + std::to_string(i/50));
+    product.put(e,i);
+    combine.put(e,i);
+  }
+  ics::HashStatistics s_product = product.statistics(), s_combine = combine.statistics();
+  std::cout << "  hash_edge_product: " << s_product.str() << std::endl;
+  std::cout << "  hash_edge_combine: " << s_combine.str() << std::endl;
+  ASSERT_EQ(20*19/2,s_product.shared_codes);          //(a,b) and (b,a) both added for a != b < 20
+  ASSERT_EQ(0,s_combine.shared_codes);
+  ASSERT_GT(s_product.collision_score,s_combine.collision_score);
+  ASSERT_GT(s_product.max_chain,s_combine.max_chain);
+
+  //Every ordering of 3 words: a sum is the same for all 6 orderings
+  ics::HashSet<WordQueue,hash_word_sum>     sum;
+  ics::HashSet<WordQueue,hash_word_ordered> ordered;
+  std::vector<std::string> words = {"a","b","c","d","e","f","g","h","i","j"};
+  for (const std::string& w1 : words)
+    for (const std::string& w2 : words)
+      for (const std::string& w3 : words) {
+        WordQueue wq;
+        wq.enqueue(w1);
+        wq.enqueue(w2);
+        wq.enqueue(w3);
+        sum.insert(wq);
+        ordered.insert(wq);
+      }
+  ics::HashStatistics s_sum = sum.statistics(), s_ordered = ordered.statistics();
+  std::cout << "  hash_word_sum:     " << s_sum.str() << std::endl;
+  std::cout << "  hash_word_ordered: " << s_ordered.str() << std::endl;
+  ASSERT_EQ(1000-220,s_sum.shared_codes);            //220 multisets of 3 of 10 words
+  ASSERT_EQ(0,s_ordered.shared_codes);
+  ASSERT_GT(s_sum.collision_score,2*s_ordered.collision_score);
+}
+
+
+//has_key on every key of a map without and with counting
+TEST_F(HashStatisticsTest, speed_counting) {
+  MapTypeInt m;
+  CountedMapTypeInt c;
+  ics::Stopwatch s_put, s_put_counted, s_get, s_get_counted;
+  s_put.start();
+  for (int i=0; i<speed_keys; ++i)
+    m.put(i,i);
+  s_put.stop();
+  s_put_counted.start();
+  for (int i=0; i<speed_keys; ++i)
+    c.put(i,i);
+  s_put_counted.stop();
+
+  long found = 0, found_counted = 0;
+  s_get.start();
+  for (int g=0; g<speed_gets; ++g)
+    for (int i=0; i<speed_keys; ++i)
+      found += m.has_key(i);
+  s_get.stop();
+  s_get_counted.start();
+  for (int g=0; g<speed_gets; ++g)
+    for (int i=0; i<speed_keys; ++i)
+      found_counted += c.has_key(i);
+  s_get_counted.stop();
+  ASSERT_EQ(found,found_counted);
+
+  ics::HashStatistics s = c.statistics();
+  std::cout << "speed_counting (" << speed_keys << " keys, seconds)" << std::endl;
+  std::cout << "  NoHashCounters: put = " << s_put.read()         << "   has_key = " << s_get.read() << std::endl;
+  std::cout << "  HashCounters:   put = " << s_put_counted.read() << "   has_key = " << s_get_counted.read() << std::endl;
+  std::cout << "  " << s.str() << std::endl;
+  ASSERT_EQ(long(speed_gets)*speed_keys,s.hits);
+}
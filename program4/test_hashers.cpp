@@ -0,0 +1,191 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>                 // std::next_permutation
+#include <bitset>
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "array_queue.hpp"
+#include "pair.hpp"
+#include "hash_map.hpp"
+#include "hash_set.hpp"
+#include "hashers.hpp"
+
+typedef ics::ArrayQueue<std::string>        WordQueue;
+typedef ics::pair<std::string,std::string>  Edge;
+
+//static: every test_*.cpp is linked into the same executable
+//The functions users wrote before hashers.hpp: HashGraph's old hash_pair_str and wordgenerator's hashfunct
+static std::size_t std_hash_string (const std::string& s)  {std::hash<std::string> str_hash; return str_hash(s);}
+static std::size_t old_hash_edge   (const Edge& e)         {return std_hash_string(e.first) * std_hash_string(e.second);}
+static std::size_t old_hash_words  (const WordQueue& wq) {
+  std::size_t answer = 0;
+  for (const std::string& w : wq)
+    answer += std_hash_string(w);
+  return answer;
+}
+
+typedef ics::HashSet<Edge,old_hash_edge>                                            EdgeSetOld;
+typedef ics::HashSet<Edge,ics::hash_pair<ics::hash_string,ics::hash_string,std::string,std::string>> EdgeSetNew;
+typedef ics::HashSet<WordQueue,old_hash_words>                                      WordSetOld;
+typedef ics::HashSet<WordQueue,ics::hash_string_queue>                              WordSetNew;
+
+static const int node_names   = 300;       //edge_collisions (node_names^2 edges)
+static const int speed_count  = 1000000;   //speed_hashers (strings hashed per length)
+static const int speed_edges  = 700;       //speed_hashers (speed_edges^2 edges)
+
+
+class HashersTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+static std::string node (int i) {return "node-" + std::to_string(i);}
+
+
+
+//Every length branch of hash_bytes: 0, 1-3, 4-16, 17-48, and the 3-lane loop
+TEST_F(HashersTest, views_match_strings) {
+  std::string s;
+  for (int length=0; length<200; ++length) {
+    ASSERT_EQ(ics::hash_string(s),ics::hash_string_view(std::string_view(s)));
+    ASSERT_EQ(ics::hash_string(s),ics::hash_bytes(s.data(),s.size()));
+    s += char('a' + length%26);
+  }
+}
+
+
+//Prefixes of a string of one repeated byte all differ (the length is hashed), and flipping any one
+//  bit of a key flips about half (32) of its hash's bits
+TEST_F(HashersTest, lengths_and_avalanche) {
+  std::string a(200,'a');
+  std::vector<std::uint64_t> codes;
+  for (int length=0; length<=200; ++length)
+    codes.push_back(ics::hash_string_view(std::string_view(a.data(),length)));
+  std::sort(codes.begin(),codes.end());
+  ASSERT_TRUE(std::adjacent_find(codes.begin(),codes.end()) == codes.end());
+
+  for (int length : {3,8,13,40,100}) {
+    std::string key(length,'x');
+    std::uint64_t original = ics::hash_string(key);
+    long flipped = 0, trials = 0;
+    for (int byte=0; byte<length; ++byte)
+      for (int bit=0; bit<8; ++bit, ++trials) {
+        std::string changed = key;
+        changed[byte] ^= char(1 << bit);
+        flipped += std::bitset<64>(original ^ ics::hash_string(changed)).count();
+      }
+    double average = double(flipped)/trials;
+    ASSERT_GT(average,28.0) << length;
+    ASSERT_LT(average,36.0) << length;
+  }
+}
+
+
+TEST_F(HashersTest, combine_is_ordered) {
+  Edge ab("a","b"), ba("b","a");
+  ASSERT_EQ(old_hash_edge(ab),old_hash_edge(ba));         //the old product is symmetric
+  auto edge_hash = ics::hash_pair<ics::hash_string,ics::hash_string,std::string,std::string>;
+  ASSERT_NE(edge_hash(ab),edge_hash(ba));
+  ASSERT_NE(ics::hash_combine(0,1),ics::hash_combine(0,2));  //0 does not absorb (as it does for *)
+  ASSERT_NE(ics::hash_combine(1,0),ics::hash_combine(2,0));
+  ASSERT_NE(ics::hash_integer(1),ics::hash_integer(-1));
+
+  WordQueue abc, cba;
+  for (std::string w : {"a","b","c"})
+    abc.enqueue(w);
+  for (std::string w : {"c","b","a"})
+    cba.enqueue(w);
+  ASSERT_EQ(old_hash_words(abc),old_hash_words(cba));
+  ASSERT_NE(ics::hash_string_queue(abc),ics::hash_string_queue(cba));
+}
+
+
+//Every ordered pair of nodes: the product hashes (a,b) and (b,a) alike
+TEST_F(HashersTest, edge_collisions) {
+  EdgeSetOld old_edges;
+  EdgeSetNew new_edges;
+  for (int a=0; a<node_names; ++a)
+    for (int b=0; b<node_names; ++b) {
+      old_edges.insert(Edge(node(a),node(b)));
+      new_edges.insert(Edge(node(a),node(b)));
+    }
+  ics::HashStatistics old_s = old_edges.statistics(), new_s = new_edges.statistics();
+  ASSERT_GE(old_s.shared_codes,node_names*(node_names-1)/2);
+  ASSERT_EQ(0,new_s.shared_codes);
+  ASSERT_LT(new_s.collision_score,1.2) << new_s.str();
+  std::cout << "  edges: old shared_codes = " << old_s.shared_codes << ", collision_score = " << old_s.collision_score
+            << "; new shared_codes = " << new_s.shared_codes << ", collision_score = " << new_s.collision_score << std::endl;
+}
+
+
+//Every ordering of the same words: their sum hashes them all alike
+TEST_F(HashersTest, word_queue_collisions) {
+  WordSetOld old_queues;
+  WordSetNew new_queues;
+  std::vector<std::string> words = {"a","cat","mat","on","sat","the"};
+  int queues = 0;
+  do {
+    WordQueue wq;
+    for (const std::string& w : words)
+      wq.enqueue(w);
+    old_queues.insert(wq);
+    new_queues.insert(wq);
+    ++queues;
+  } while (std::next_permutation(words.begin(),words.end()));
+
+  ASSERT_EQ(queues,new_queues.size());
+  ics::HashStatistics old_s = old_queues.statistics(), new_s = new_queues.statistics();
+  ASSERT_EQ(queues-1,old_s.shared_codes);
+  ASSERT_EQ(0,new_s.shared_codes);
+}
+
+
+TEST_F(HashersTest, speed_hashers) {
+  std::cout << "speed_hashers (" << speed_count << " strings per length; MB/s: std::hash / hash_string)" << std::endl;
+  for (int length : {8,64,1024}) {
+    std::string key(length,'k');
+    std::uint64_t sums[2] = {0,0};
+    double seconds[2];
+    for (int which=0; which<2; ++which) {
+      ics::Stopwatch s;
+      s.start();
+      for (int i=0; i<speed_count; ++i) {
+        key[i%length] = char(i);            //a different key each time: no hoisting
+        sums[which] += which == 0 ? std_hash_string(key) : ics::hash_string(key);
+      }
+      s.stop();
+      seconds[which] = s.read();
+    }
+    ASSERT_NE(0u,sums[0]);
+    ASSERT_NE(0u,sums[1]);
+    double mb = double(length)*speed_count/1e6;
+    std::cout << "  length " << length << " = " << mb/seconds[0] << " / " << mb/seconds[1] << std::endl;
+  }
+
+  std::vector<Edge> edges;
+  for (int a=0; a<speed_edges; ++a)
+    for (int b=0; b<speed_edges; ++b)
+      edges.push_back(Edge(node(a),node(b)));
+  ics::Stopwatch old_time, new_time;
+  EdgeSetOld old_edges;
+  EdgeSetNew new_edges;
+  old_time.start();
+  for (const Edge& e : edges)
+    old_edges.insert(e);
+  for (const Edge& e : edges)
+    ASSERT_TRUE(old_edges.contains(e));
+  old_time.stop();
+  new_time.start();
+  for (const Edge& e : edges)
+    new_edges.insert(e);
+  for (const Edge& e : edges)
+    ASSERT_TRUE(new_edges.contains(e));
+  new_time.stop();
+  ASSERT_EQ(old_edges.size(),new_edges.size());
+  std::cout << "  edge set insert+contains seconds = " << old_time.read() << " / " << new_time.read()
+            << " (" << new_edges.size() << " edges)" << std::endl;
+}
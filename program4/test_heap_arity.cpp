@@ -0,0 +1,142 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>                 // std::sort
+#include "ics46goody.hpp"
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "heap_priority_queue.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static const int test_size  = 10000;    //same_order
+static const int speed_size = 1000000;  //speed_arity (values enqueued)
+
+
+class HeapArityTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+//A priority (key) padded to Bytes bytes in all
+template<int Bytes>
+class Payload {
+  public:
+    Payload(std::int64_t key = 0) : key(key) {}
+    bool operator == (const Payload& rhs) const {return key == rhs.key;}
+    std::int64_t key;
+    char         pad[Bytes-sizeof(std::int64_t)];
+};
+
+template<int Bytes>
+std::ostream& operator << (std::ostream& outs, const Payload<Bytes>& p) {return outs << p.key;}
+
+
+template<class T>
+static bool arity_gt (const T& a, const T& b) {return a.key > b.key;}
+
+template<>
+bool arity_gt<std::int64_t> (const std::int64_t& a, const std::int64_t& b) {return a > b;}
+
+
+static std::int64_t key_of (std::int64_t k) {return k;}
+
+template<int Bytes>
+static std::int64_t key_of (const Payload<Bytes>& p) {return p.key;}
+
+
+template<class T, int Arity>
+using ArityPQ = ics::HeapPriorityQueue<T,arity_gt<T>,ics::CheckedIteration,Arity>;
+
+
+
+TEST_F(HeapArityTest, same_order) {
+  std::vector<std::int64_t> values;
+  for (int i=0; i<test_size; ++i)
+    values.push_back(ics::rand_range(0,test_size));
+  ArityPQ<std::int64_t,2> q2;
+  ArityPQ<std::int64_t,4> q4(values);   //heapify
+  ArityPQ<std::int64_t,8> q8;
+  ArityPQ<std::int64_t,3> q3;
+  for (std::int64_t v : values) {
+    q2.enqueue(v);
+    q8.enqueue(v);
+    q3.enqueue(v);
+  }
+  std::sort(values.begin(),values.end(),[] (std::int64_t a, std::int64_t b) {return a > b;});
+
+  std::vector<std::int64_t> iterated;  //The Iterator's frontier takes all Arity children
+  for (std::int64_t v : q8)
+    iterated.push_back(v);
+  ASSERT_EQ(values,iterated);
+
+  for (std::int64_t v : values) {
+    ASSERT_EQ(v,q2.dequeue());
+    ASSERT_EQ(v,q4.dequeue());
+    ASSERT_EQ(v,q8.dequeue());
+    ASSERT_EQ(v,q3.dequeue());
+  }
+  ASSERT_TRUE(q8.empty());
+}
+
+
+//pq[1] (the root's first child) starts a cache line, so each group of 8 8-byte children shares one
+TEST_F(HeapArityTest, cache_line_aligned) {
+  ArityPQ<std::int64_t,8> q;
+  for (int i=0; i<100; ++i) {
+    q.enqueue(i);
+    ASSERT_EQ(0u,reinterpret_cast<std::uintptr_t>(&q.peek()+1) % 64);
+  }
+  ArityPQ<Payload<40>,4> odd;           //40 does not divide 64: no offset, but still aligned
+  for (int i=0; i<100; ++i) {
+    odd.enqueue(Payload<40>(i));
+    ASSERT_EQ(0u,reinterpret_cast<std::uintptr_t>(&odd.peek()) % 64);
+  }
+  ASSERT_EQ(99,odd.dequeue().key);
+}
+
+
+//Seconds for speed_size enqueues of random keys, then dequeues: all of them (dequeue-heavy) or a
+//  tenth of them (enqueue-heavy)
+template<class T, int Arity>
+static void time_arity(const std::vector<std::int64_t>& keys, int dequeues, double& seconds, std::int64_t& checksum) {
+  ArityPQ<T,Arity> q;
+  ics::Stopwatch time;
+  time.start();
+  for (std::int64_t k : keys)
+    q.enqueue(T(k));
+  for (int i=0; i<dequeues; ++i)
+    checksum += key_of(q.dequeue());
+  time.stop();
+  seconds = time.read();
+}
+
+
+template<class T>
+static void sweep_arity(const char* label, const std::vector<std::int64_t>& keys) {
+  for (int dequeues : {speed_size/10, speed_size}) {
+    double s2, s4, s8;
+    std::int64_t c2 = 0, c4 = 0, c8 = 0;
+    time_arity<T,2>(keys,dequeues,s2,c2);
+    time_arity<T,4>(keys,dequeues,s4,c4);
+    time_arity<T,8>(keys,dequeues,s8,c8);
+    ASSERT_EQ(c2,c4);
+    ASSERT_EQ(c2,c8);
+    std::cout << "  " << label << (dequeues == speed_size ? " dequeue-heavy: " : " enqueue-heavy: ")
+              << s2 << " / " << s4 << " / " << s8 << std::endl;
+  }
+}
+
+
+TEST_F(HeapArityTest, speed_arity) {
+  std::vector<std::int64_t> keys;
+  for (int i=0; i<speed_size; ++i)
+    keys.push_back(ics::rand_range(1,speed_size));
+  std::cout << "speed_arity (" << speed_size << " enqueues, then " << speed_size/10 << " or " << speed_size
+            << " dequeues; Arity 2 / 4 / 8, seconds)" << std::endl;
+  sweep_arity<std::int64_t>("  8-byte T",keys);
+  sweep_arity<Payload<32>> (" 32-byte T",keys);
+  sweep_arity<Payload<128>>("128-byte T",keys);
+}
@@ -0,0 +1,148 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <algorithm>                 // std::sort, std::max_element
+#include "ics46goody.hpp"
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "heap_priority_queue.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static const int test_size  = 5000;      //enqueue_all_batches, merge_steals_buffer
+static const int speed_size = 10000000;  //speed_bulk_load, speed_merge (values loaded)
+
+
+class HeapBulkTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+static bool bulk_gt (const std::int64_t& a, const std::int64_t& b) {return a > b;}
+static bool bulk_lt (const std::int64_t& a, const std::int64_t& b) {return a < b;}
+typedef ics::HeapPriorityQueue<std::int64_t,bulk_gt> BulkPQ;
+
+
+//Dequeues everything, checking it against values sorted highest first
+static void expect_dequeues(BulkPQ& q, std::vector<std::int64_t> values) {
+  std::sort(values.begin(),values.end(),[] (std::int64_t a, std::int64_t b) {return a > b;});
+  ASSERT_EQ(std::int64_t(values.size()),q.size());
+  for (std::int64_t v : values)
+    ASSERT_EQ(v,q.dequeue());
+  ASSERT_TRUE(q.empty());
+}
+
+
+static std::vector<std::int64_t> bulk_values(int n, int high) {
+  std::vector<std::int64_t> values;
+  for (int i=0; i<n; ++i)
+    values.push_back(ics::rand_range(0,high));
+  return values;
+}
+
+
+
+//Batches smaller than the heap percolate each value up; larger ones heapify
+TEST_F(HeapBulkTest, enqueue_all_batches) {
+  for (int batch : {0, 1, 10, test_size, 3*test_size}) {
+    std::vector<std::int64_t> values = bulk_values(test_size,test_size), more = bulk_values(batch,test_size);
+    BulkPQ q(values);
+    ASSERT_EQ(batch,q.enqueue_all(more));
+    values.insert(values.end(),more.begin(),more.end());
+    expect_dequeues(q,values);
+  }
+
+  BulkPQ q;
+  std::vector<std::int64_t> ascending;  //Worst case for percolate_up
+  for (int i=0; i<test_size; ++i)
+    ascending.push_back(i);
+  ASSERT_EQ(test_size,q.enqueue_all(ascending));
+  ASSERT_EQ(test_size-1,q.peek());
+  expect_dequeues(q,ascending);
+}
+
+
+//Enqueueing a queue into itself adds one copy of each value it had (not the copies being appended)
+TEST_F(HeapBulkTest, enqueue_all_self) {
+  std::vector<std::int64_t> values = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  BulkPQ q(values);
+  ASSERT_EQ(10,q.enqueue_all(q));
+  values.insert(values.end(),values.begin(),values.end());
+  expect_dequeues(q,values);
+
+  BulkPQ empty;
+  ASSERT_EQ(0,empty.enqueue_all(empty));
+  ASSERT_TRUE(empty.empty());
+}
+
+
+TEST_F(HeapBulkTest, merge_steals_buffer) {
+  std::vector<std::int64_t> small = bulk_values(10,test_size), large = bulk_values(test_size,test_size);
+  BulkPQ q(small), other(2*test_size);  //other has room for both
+  other.enqueue_all(large);
+  std::int64_t* other_array = &other.peek();
+  ASSERT_EQ(test_size,q.merge(std::move(other)));
+  ASSERT_EQ(other_array,&q.peek());     //Kept other's (larger) array: no reallocation
+  ASSERT_TRUE(other.empty());
+  ASSERT_EQ(0,other.merge(std::move(other)));
+  other.enqueue(test_size+1);           //other is still usable
+  ASSERT_EQ(1,q.merge(std::move(other)));
+  ASSERT_EQ(test_size+1,q.peek());
+  ASSERT_EQ(0,q.merge(std::move(q)));
+
+  std::vector<std::int64_t> all = small;
+  all.insert(all.end(),large.begin(),large.end());
+  all.push_back(test_size+1);
+  expect_dequeues(q,all);
+
+  ics::HeapPriorityQueue<std::int64_t> max_q(small,bulk_gt), min_q(large,bulk_lt);
+  max_q.merge(std::move(min_q));        //Different gts: min_q's array, reordered by max_q's gt
+  ASSERT_EQ(*std::max_element(all.begin(),all.end()-1),max_q.peek());
+  ASSERT_EQ(std::int64_t(all.size()-1),max_q.size());
+}
+
+
+//Seconds to load speed_size random (or ascending) values into an empty heap, or a small batch into
+//  a large heap: by enqueue (one percolate_up each) and by enqueue_all
+TEST_F(HeapBulkTest, speed_bulk_load) {
+  std::vector<std::int64_t> random = bulk_values(speed_size,speed_size), ascending, batch = bulk_values(speed_size/100,speed_size);
+  for (int i=0; i<speed_size; ++i)
+    ascending.push_back(i);
+
+  std::cout << "speed_bulk_load (" << speed_size << " values; enqueue each / enqueue_all, seconds)" << std::endl;
+  for (const std::vector<std::int64_t>* values : {&random, &ascending, &batch}) {
+    BulkPQ one(values == &batch ? random : std::vector<std::int64_t>()), all(one);
+    ics::Stopwatch one_time, all_time;
+    one_time.start();
+    for (std::int64_t v : *values)
+      one.enqueue(v);
+    one_time.stop();
+    all_time.start();
+    all.enqueue_all(*values);
+    all_time.stop();
+    ASSERT_EQ(one.size(),all.size());
+    ASSERT_EQ(one.peek(),all.peek());
+    std::cout << (values == &random ? "  random:            " : values == &ascending ? "  ascending:         " : "  1% batch into heap: ")
+              << one_time.read() << " / " << all_time.read() << std::endl;
+  }
+}
+
+
+//Seconds to combine two heaps of speed_size/2 values: by dequeueing one into the other, and by merge
+TEST_F(HeapBulkTest, speed_merge) {
+  std::vector<std::int64_t> a = bulk_values(speed_size/2,speed_size), b = bulk_values(speed_size/2,speed_size);
+  BulkPQ drain_into(a), drained(b), merge_into(a), merged(b);
+  ics::Stopwatch drain_time, merge_time;
+  drain_time.start();
+  while (!drained.empty())
+    drain_into.enqueue(drained.dequeue());
+  drain_time.stop();
+  merge_time.start();
+  merge_into.merge(std::move(merged));
+  merge_time.stop();
+  ASSERT_EQ(drain_into.size(),merge_into.size());
+  ASSERT_EQ(drain_into.peek(),merge_into.peek());
+  std::cout << "speed_merge (two heaps of " << speed_size/2 << " values; drain by dequeue / merge, seconds)" << std::endl;
+  std::cout << "  " << drain_time.read() << " / " << merge_time.read() << std::endl;
+}
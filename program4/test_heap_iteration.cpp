@@ -0,0 +1,177 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>                 // std::sort, std::is_sorted
+#include "ics46goody.hpp"
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "heap_priority_queue.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static bool heap_iteration_gt (const int& a, const int& b) {return a > b;}
+typedef ics::HeapPriorityQueue<int,heap_iteration_gt> HeapType;
+
+static const int test_size  = 1000;     //priority_order, erase_while_iterating
+static const int speed_size = 1000000;  //speed_top_k (values in the queue)
+static const int speed_laps = 100;      //speed_top_k (iterations over the top speed_k values)
+static const int speed_k    = 10;       //speed_top_k
+
+
+class HeapIterationTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+static std::vector<int> random_values(int n) {
+  std::vector<int> values;
+  for (int i=0; i<n; ++i)
+    values.push_back(ics::rand_range(0,n/4));    //Many duplicates
+  return values;
+}
+
+
+
+TEST_F(HeapIterationTest, priority_order) {
+  std::vector<int> values = random_values(test_size);
+  HeapType q(values);
+  std::sort(values.begin(),values.end(),[] (int a, int b) {return a > b;});
+
+  std::vector<int> visited;
+  for (int v : q)
+    visited.push_back(v);
+  ASSERT_EQ(values,visited);
+  ASSERT_EQ(test_size,q.size());       //Iterating does not change the queue
+
+  int k = 0;                           //Stopping early: only the top values are visited
+  for (HeapType::Iterator i = q.begin(); k<10; ++i, ++k)
+    ASSERT_EQ(values[k],*i);
+
+  HeapType empty;
+  ASSERT_EQ(empty.end(),empty.begin());
+  ASSERT_THROW(*empty.begin(),ics::IteratorPositionIllegal);
+}
+
+
+TEST_F(HeapIterationTest, unordered) {
+  std::vector<int> values = random_values(test_size);
+  HeapType q(values);
+  std::vector<int> visited;
+  for (HeapType::UnorderedIterator i = q.unordered_begin(); i != q.unordered_end(); ++i)
+    visited.push_back(*i);
+  std::sort(values.begin(),values.end());
+  std::sort(visited.begin(),visited.end());
+  ASSERT_EQ(values,visited);
+
+  HeapType::UnorderedIterator i = q.unordered_begin();
+  q.enqueue(0);
+  ASSERT_THROW(*i,ics::ConcurrentModificationError);
+  ASSERT_THROW(*q.unordered_end(),ics::IteratorPositionIllegal);
+}
+
+
+//Erasing repairs the Iterator's frontier in place; it still visits every value in priority order,
+//  and the queue loses exactly the erased values
+TEST_F(HeapIterationTest, erase_while_iterating) {
+  std::vector<int> values = random_values(test_size);
+  HeapType q(values);
+  std::sort(values.begin(),values.end(),[] (int a, int b) {return a > b;});
+
+  std::vector<int> visited, kept;
+  for (HeapType::Iterator i = q.begin(); i != q.end(); ++i) {
+    visited.push_back(*i);
+    if (*i % 3 == 0) {
+      ASSERT_EQ(visited.back(),i.erase());
+      ASSERT_THROW(i.erase(),ics::CannotEraseError);
+      ASSERT_THROW(*i,ics::IteratorPositionIllegal);
+    } else
+      kept.push_back(visited.back());
+  }
+  ASSERT_EQ(values,visited);
+  ASSERT_EQ(std::int64_t(kept.size()),q.size());
+  for (int v : kept)
+    ASSERT_EQ(v,q.dequeue());
+
+  HeapType r({3,1,2});
+  HeapType::Iterator i = r.begin(), j = r.begin();
+  i.erase();
+  ASSERT_THROW(*j,ics::ConcurrentModificationError);
+}
+
+
+//A priority (key) with an identity (id) that == ignores, like an entry compared by its key
+class Tagged {
+  public:
+    Tagged(int key = 0, int id = 0) : key(key), id(id) {}
+    bool operator == (const Tagged& rhs) const {return key == rhs.key;}
+    bool operator != (const Tagged& rhs) const {return key != rhs.key;}
+    int key, id;
+};
+
+static bool tagged_gt (const Tagged& a, const Tagged& b) {return a.key > b.key;}
+
+
+//erase removes the cursor's value by its index, not the first value == to it: with many equal keys,
+//  exactly the erased ids leave the queue (for several arities, erasing about half the values)
+template<int Arity>
+static void erase_tagged() {
+  ics::HeapPriorityQueue<Tagged,tagged_gt,ics::CheckedIteration,Arity> q;
+  for (int id=0; id<test_size; ++id)
+    q.enqueue(Tagged(ics::rand_range(0,10),id));
+
+  std::vector<int> kept_ids, visited_keys;
+  for (auto i = q.begin(); i != q.end(); ++i) {
+    visited_keys.push_back(i->key);
+    if (ics::rand_range(0,1) == 0)
+      ASSERT_EQ(visited_keys.back(),i.erase().key);
+    else
+      kept_ids.push_back(i->id);
+  }
+  ASSERT_EQ(test_size,int(visited_keys.size()));
+  ASSERT_TRUE(std::is_sorted(visited_keys.begin(),visited_keys.end(),[] (int a, int b) {return a > b;}));
+
+  std::vector<int> dequeued_ids;
+  while (!q.empty())
+    dequeued_ids.push_back(q.dequeue().id);
+  std::sort(kept_ids.begin(),kept_ids.end());
+  std::sort(dequeued_ids.begin(),dequeued_ids.end());
+  ASSERT_EQ(kept_ids,dequeued_ids);
+}
+
+
+TEST_F(HeapIterationTest, erase_by_index) {
+  erase_tagged<2>();
+  erase_tagged<3>();
+  erase_tagged<4>();
+}
+
+
+//The top speed_k values of a large queue: copying the queue and dequeueing from the copy (what the
+//  Iterator used to do) vs. the frontier Iterator, which copies nothing
+TEST_F(HeapIterationTest, speed_top_k) {
+  HeapType q(random_values(speed_size));
+  long copy_sum = 0, frontier_sum = 0;
+  ics::Stopwatch copy_time, frontier_time;
+
+  copy_time.start();
+  for (int lap=0; lap<speed_laps; ++lap) {
+    HeapType copy(q);
+    for (int k=0; k<speed_k; ++k)
+      copy_sum += copy.dequeue();
+  }
+  copy_time.stop();
+
+  frontier_time.start();
+  for (int lap=0; lap<speed_laps; ++lap) {
+    HeapType::Iterator i = q.begin();
+    for (int k=0; k<speed_k; ++k, ++i)
+      frontier_sum += *i;
+  }
+  frontier_time.stop();
+
+  ASSERT_EQ(copy_sum,frontier_sum);
+  std::cout << "speed_top_k (top " << speed_k << " of " << speed_size << " values; " << speed_laps
+            << " laps; copy+dequeue / Iterator, seconds)" << std::endl;
+  std::cout << "  " << copy_time.read() << " / " << frontier_time.read() << std::endl;
+}
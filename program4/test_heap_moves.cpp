@@ -0,0 +1,190 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>                 // std::max, std::swap
+#include "ics46goody.hpp"
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "heap_priority_queue.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static const int test_size   = 1000;    //live_objects, moves_not_copies
+static const int speed_size  = 200000;  //speed_heavy_values (values enqueued, then dequeued)
+static const int heavy_words = 8;       //strings in each Heavy value
+
+
+class HeapMovesTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+//A priority with heap-allocated contents, like wordgenerator's CorpusEntry (pair<WordQueue,FollowSet>):
+//  copying one copies all its strings; moving one moves a few pointers. Counts its constructions.
+class Heavy {
+  public:
+    static long copies, moves, live;
+
+    Heavy(int key = 0) : key(key), words(heavy_words,"a word longer than the small string buffer " + std::to_string(key))
+    {++live;}
+    Heavy(const Heavy& h) : key(h.key), words(h.words) {++copies; ++live;}
+    Heavy(Heavy&& h) noexcept : key(h.key), words(std::move(h.words)) {++moves; ++live;}
+    ~Heavy() {--live;}
+    Heavy& operator = (const Heavy& h) {key = h.key; words = h.words; ++copies; return *this;}
+    Heavy& operator = (Heavy&& h) noexcept {key = h.key; words = std::move(h.words); ++moves; return *this;}
+    bool operator == (const Heavy& rhs) const {return key == rhs.key;}
+    bool operator != (const Heavy& rhs) const {return key != rhs.key;}
+
+    static void reset() {copies = moves = 0;}
+
+    int                      key;
+    std::vector<std::string> words;
+};
+long Heavy::copies = 0, Heavy::moves = 0, Heavy::live = 0;
+
+static std::ostream& operator << (std::ostream& outs, const Heavy& h) {return outs << h.key;}
+static bool heavy_gt (const Heavy& a, const Heavy& b) {return a.key > b.key;}
+
+
+//No default constructor: the heap's array holds only the values enqueued
+class NoDefault {
+  public:
+    explicit NoDefault(int key) : key(key) {}
+    bool operator == (const NoDefault& rhs) const {return key == rhs.key;}
+    int key;
+};
+static bool no_default_gt (const NoDefault& a, const NoDefault& b) {return a.key > b.key;}
+
+
+//HeapPriorityQueue as it was: new T[length] (every slot default-constructed), growth by move
+//  assignment into a new T[] array, and std::swap at each level of percolate_up/percolate_down
+template<class T, bool (*gt)(const T& a, const T& b)>
+class SwapHeap {
+  public:
+    ~SwapHeap() {delete[] pq;}
+    bool empty() const {return used == 0;}
+    void enqueue(T&& element) {
+      if (used == length) {
+        T* old_pq = pq;
+        length = std::max(std::int64_t(1),2*length);
+        pq = new T[length];
+        for (std::int64_t i=0; i<used; ++i)
+          pq[i] = std::move(old_pq[i]);
+        delete[] old_pq;
+      }
+      pq[used++] = std::move(element);
+      for (std::int64_t i=used-1; i != 0 && gt(pq[i],pq[(i-1)/2]); i = (i-1)/2)
+        std::swap(pq[(i-1)/2],pq[i]);
+    }
+    T dequeue() {
+      T to_return = std::move(pq[0]);
+      if (--used != 0)
+        pq[0] = std::move(pq[used]);
+      for (std::int64_t i=0, l=1; l < used; l = 2*i+1) {
+        std::int64_t max_child = (l+1 >= used || gt(pq[l],pq[l+1]) ? l : l+1);
+        if (gt(pq[i],pq[max_child]))
+          break;
+        std::swap(pq[i],pq[max_child]);
+        i = max_child;
+      }
+      return to_return;
+    }
+  private:
+    T*           pq     = new T[0];
+    std::int64_t length = 0;
+    std::int64_t used   = 0;
+};
+
+
+
+TEST_F(HeapMovesTest, live_objects) {
+  long before = Heavy::live;
+  {
+    ics::HeapPriorityQueue<Heavy,heavy_gt> q(100);   //Room for 100: none constructed
+    ASSERT_EQ(before,Heavy::live);
+    for (int i=0; i<test_size; ++i)
+      q.enqueue(Heavy(ics::rand_range(0,test_size)));
+    ASSERT_EQ(before+test_size,Heavy::live);
+    for (int i=0; i<test_size/2; ++i)
+      q.dequeue();
+    ASSERT_EQ(before+test_size/2,Heavy::live);
+
+    ics::HeapPriorityQueue<Heavy,heavy_gt> copy(q);
+    ASSERT_EQ(before+test_size,Heavy::live);
+    copy.clear();
+    ASSERT_EQ(before+test_size/2,Heavy::live);
+    copy = q;
+    ASSERT_EQ(q,copy);
+    ASSERT_EQ(before+test_size,Heavy::live);
+    for (ics::HeapPriorityQueue<Heavy,heavy_gt>::Iterator i = copy.begin(); i != copy.end(); ++i)
+      if (i->key % 2 == 0)
+        i.erase();
+    ASSERT_EQ(before+test_size/2+copy.size(),Heavy::live);
+  }
+  ASSERT_EQ(before,Heavy::live);
+}
+
+
+TEST_F(HeapMovesTest, no_default_constructor) {
+  ics::HeapPriorityQueue<NoDefault,no_default_gt> q({NoDefault(3),NoDefault(1),NoDefault(4)});
+  q.enqueue(NoDefault(5));
+  q.emplace(2);
+  ASSERT_EQ(5,q.dequeue().key);
+  ASSERT_EQ(4,q.dequeue().key);
+  ASSERT_EQ(3,q.dequeue().key);
+  ASSERT_EQ(2,q.size());
+}
+
+
+//Enqueueing and dequeueing rvalues never copies a value, and a hole-based percolate moves each value
+//  at most once per level: fewer moves than 3 per level (std::swap)
+TEST_F(HeapMovesTest, moves_not_copies) {
+  ics::HeapPriorityQueue<Heavy,heavy_gt> q;
+  std::vector<Heavy> values;
+  for (int i=0; i<test_size; ++i)
+    values.push_back(Heavy(ics::rand_range(0,test_size)));
+  Heavy::reset();
+  for (Heavy& h : values)
+    q.enqueue(std::move(h));
+  while (!q.empty())
+    q.dequeue();
+  ASSERT_EQ(0,Heavy::copies);
+  std::cout << "  " << double(Heavy::moves)/test_size << " moves per value enqueued and dequeued" << std::endl;
+}
+
+
+TEST_F(HeapMovesTest, speed_heavy_values) {
+  std::vector<int> keys;
+  for (int i=0; i<speed_size; ++i)
+    keys.push_back(ics::rand_range(0,speed_size));
+
+  long swap_sum = 0, hole_sum = 0, swap_moves, hole_moves;
+  ics::Stopwatch swap_time, hole_time;
+  {
+    SwapHeap<Heavy,heavy_gt> q;
+    Heavy::reset();
+    swap_time.start();
+    for (int k : keys)
+      q.enqueue(Heavy(k));
+    while (!q.empty())
+      swap_sum += q.dequeue().key;
+    swap_time.stop();
+    swap_moves = Heavy::moves;
+  }
+  {
+    ics::HeapPriorityQueue<Heavy,heavy_gt> q;
+    Heavy::reset();
+    hole_time.start();
+    for (int k : keys)
+      q.enqueue(Heavy(k));
+    while (!q.empty())
+      hole_sum += q.dequeue().key;
+    hole_time.stop();
+    hole_moves = Heavy::moves;
+  }
+  ASSERT_EQ(swap_sum,hole_sum);
+  std::cout << "speed_heavy_values (" << speed_size << " Heavy values enqueued, then dequeued; std::swap / hole)" << std::endl;
+  std::cout << "  moves   = " << swap_moves << " / " << hole_moves << std::endl;
+  std::cout << "  seconds = " << swap_time.read() << " / " << hole_time.read() << std::endl;
+}
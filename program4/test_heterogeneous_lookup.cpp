@@ -0,0 +1,213 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdlib>                   // std::malloc, std::aligned_alloc, std::free
+#include <cstddef>                   // std::max_align_t
+#include <new>
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "hash_map.hpp"
+#include "hash_set.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+//std::hash<std::string_view> equals std::hash<std::string> on the same characters
+static int hash_string (const std::string& s)    {std::hash<std::string> str_hash; return str_hash(s);}
+static int hash_view   (const std::string_view& s) {std::hash<std::string_view> view_hash; return view_hash(s);}
+
+typedef ics::HashMap<std::string,int,hash_string>                                      MapTypeStr;
+typedef ics::HashMap<std::string,int,hash_string,ics::HeapNodeAllocator,ics::CacheHash> CacheMapTypeStr;
+typedef ics::HashSet<std::string,hash_string>                                          SetTypeStr;
+
+static const int probe_keys  = 1000;     //map_probe/set_probe/no_allocations (keys in the container)
+static const int speed_words = 1000000;  //speed_probe (words of text probed)
+
+
+//Counts every allocation in the executable, so no_allocations can check that probes make none.
+//  Every replaceable operator new (array, aligned and nothrow forms too) counts and allocates with
+//  malloc/aligned_alloc, and every operator delete frees with free: each pair matches.
+//  They are kept out of line (GCC otherwise inlines a delete into a new-expression's cleanup and
+//  warns that free does not match operator new).
+static long allocations = 0;
+
+#if defined(__GNUC__) || defined(__clang__)
+#define COUNTED_NOINLINE __attribute__((noinline))
+#else
+#define COUNTED_NOINLINE
+#endif
+
+static void* counted_allocate (std::size_t n, std::size_t alignment = alignof(std::max_align_t)) noexcept {
+  ++allocations;
+  n = (n == 0 ? 1 : n);
+  if (alignment <= alignof(std::max_align_t))
+    return std::malloc(n);
+  return std::aligned_alloc(alignment,(n+alignment-1)/alignment*alignment);  //A multiple of alignment
+}
+
+static void* counted_or_throw (std::size_t n, std::size_t alignment = alignof(std::max_align_t)) {
+  if (void* p = counted_allocate(n,alignment))
+    return p;
+  throw std::bad_alloc();
+}
+
+COUNTED_NOINLINE void* operator new   (std::size_t n)                                 {return counted_or_throw(n);}
+COUNTED_NOINLINE void* operator new[] (std::size_t n)                                 {return counted_or_throw(n);}
+COUNTED_NOINLINE void* operator new   (std::size_t n, std::align_val_t a)             {return counted_or_throw(n,std::size_t(a));}
+COUNTED_NOINLINE void* operator new[] (std::size_t n, std::align_val_t a)             {return counted_or_throw(n,std::size_t(a));}
+COUNTED_NOINLINE void* operator new   (std::size_t n, const std::nothrow_t&) noexcept {return counted_allocate(n);}
+COUNTED_NOINLINE void* operator new[] (std::size_t n, const std::nothrow_t&) noexcept {return counted_allocate(n);}
+COUNTED_NOINLINE void* operator new   (std::size_t n, std::align_val_t a, const std::nothrow_t&) noexcept {return counted_allocate(n,std::size_t(a));}
+COUNTED_NOINLINE void* operator new[] (std::size_t n, std::align_val_t a, const std::nothrow_t&) noexcept {return counted_allocate(n,std::size_t(a));}
+
+COUNTED_NOINLINE void operator delete   (void* p) noexcept                                         {std::free(p);}
+COUNTED_NOINLINE void operator delete[] (void* p) noexcept                                         {std::free(p);}
+COUNTED_NOINLINE void operator delete   (void* p, std::size_t) noexcept                            {std::free(p);}
+COUNTED_NOINLINE void operator delete[] (void* p, std::size_t) noexcept                            {std::free(p);}
+COUNTED_NOINLINE void operator delete   (void* p, std::align_val_t) noexcept                       {std::free(p);}
+COUNTED_NOINLINE void operator delete[] (void* p, std::align_val_t) noexcept                       {std::free(p);}
+COUNTED_NOINLINE void operator delete   (void* p, std::size_t, std::align_val_t) noexcept          {std::free(p);}
+COUNTED_NOINLINE void operator delete[] (void* p, std::size_t, std::align_val_t) noexcept          {std::free(p);}
+COUNTED_NOINLINE void operator delete   (void* p, const std::nothrow_t&) noexcept                  {std::free(p);}
+COUNTED_NOINLINE void operator delete[] (void* p, const std::nothrow_t&) noexcept                  {std::free(p);}
+COUNTED_NOINLINE void operator delete   (void* p, std::align_val_t, const std::nothrow_t&) noexcept {std::free(p);}
+COUNTED_NOINLINE void operator delete[] (void* p, std::align_val_t, const std::nothrow_t&) noexcept {std::free(p);}
+
+
+class HeterogeneousLookupTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+//Long enough that building a std::string allocates (no short-string optimization)
+static std::string key (int i) {return "a-key-too-long-for-short-strings-" + std::to_string(i);}
+
+
+template<class Map>
+static ::testing::AssertionResult probes_match(int rehash_step) {
+  Map m;
+  m.set_rehash_step(rehash_step);
+  for (int i=0; i<probe_keys; i+=2)
+    m.put(key(i),i);
+  for (int i=0; i<probe_keys; ++i) {
+    std::string k = key(i);
+    std::string_view v = k;
+    if (m.has_key(v,hash_view) != m.has_key(k))
+      return ::testing::AssertionFailure() << "has_key " << k;
+    if (m.has_key(k) && m.get(v,hash_view) != m[k])
+      return ::testing::AssertionFailure() << "get " << k;
+  }
+  try {
+    m.get(std::string_view("missing"),hash_view);
+    return ::testing::AssertionFailure() << "get missing key";
+  } catch (ics::KeyError& e) {}
+
+  Map moved(std::move(m));
+  if (m.has_key(std::string_view("x"),hash_view) || !moved.has_key(std::string_view(key(0)),hash_view))
+    return ::testing::AssertionFailure() << "move";
+  return ::testing::AssertionSuccess();
+}
+
+
+
+TEST_F(HeterogeneousLookupTest, map_probe) {
+  ASSERT_TRUE(probes_match<MapTypeStr>(0));
+  ASSERT_TRUE(probes_match<MapTypeStr>(1));          //mid-rehash (see test_map_rehash.cpp)
+  ASSERT_TRUE(probes_match<CacheMapTypeStr>(0));
+  ASSERT_TRUE(probes_match<CacheMapTypeStr>(1));
+
+  MapTypeStr m;                                       //a probe of the KEY type itself
+  m.put("a",1);
+  ASSERT_TRUE(m.has_key(std::string("a"),hash_string));
+  ASSERT_EQ(1,m.get(std::string("a"),hash_string));
+}
+
+
+TEST_F(HeterogeneousLookupTest, set_probe) {
+  SetTypeStr s;
+  for (int i=0; i<probe_keys; i+=3)
+    s.insert(key(i));
+  for (int i=0; i<probe_keys; ++i) {
+    std::string k = key(i);
+    ASSERT_EQ(s.contains(k),s.contains(std::string_view(k),hash_view));
+  }
+  SetTypeStr moved(std::move(s));
+  ASSERT_FALSE(s.contains(std::string_view(key(0)),hash_view));
+  ASSERT_TRUE(moved.contains(std::string_view(key(0)),hash_view));
+}
+
+
+TEST_F(HeterogeneousLookupTest, no_allocations) {
+  MapTypeStr m;
+  SetTypeStr s;
+  for (int i=0; i<probe_keys; i+=2) {
+    m.put(key(i),i);
+    s.insert(key(i));
+  }
+  std::string text;
+  for (int i=0; i<probe_keys; ++i)
+    text += key(i);
+
+  std::vector<std::string_view> views;
+  for (int i=0, at=0; i<probe_keys; ++i) {
+    int length = key(i).size();
+    views.push_back(std::string_view(text).substr(at,length));
+    at += length;
+  }
+
+  int found = 0;
+  long before = allocations;
+  for (std::string_view v : views) {
+    found += m.has_key(v,hash_view) + s.contains(v,hash_view);
+    if (m.has_key(v,hash_view))
+      found += m.get(v,hash_view) >= 0;
+  }
+  ASSERT_EQ(0,allocations-before);
+  ASSERT_EQ(3*probe_keys/2,found);
+
+  before = allocations;
+  for (std::string_view v : views)
+    found += m.has_key(std::string(v));
+  ASSERT_EQ(probe_keys,allocations-before);           //the way to probe before: one string each
+}
+
+
+//Count the words of a text (as views into it) that are keys in a map: building a std::string
+//  from each word to probe, or probing with the view
+TEST_F(HeterogeneousLookupTest, speed_probe) {
+  MapTypeStr m;
+  for (int i=0; i<probe_keys; i+=2)
+    m.put(key(i),i);
+  std::string text;
+  for (int w=0; w<speed_words; ++w)
+    text += key(w*7 % probe_keys) + " ";
+
+  std::vector<std::string_view> views;
+  std::string_view rest = text;
+  for (std::string_view::size_type space; (space = rest.find(' ')) != std::string_view::npos; rest.remove_prefix(space+1))
+    views.push_back(rest.substr(0,space));
+  ASSERT_EQ(speed_words,int(views.size()));
+
+  int by_string = 0, by_view = 0;
+  ics::Stopwatch s_string, s_view;
+  long before = allocations;
+  s_string.start();
+  for (std::string_view v : views)
+    by_string += m.has_key(std::string(v));
+  s_string.stop();
+  long string_allocations = allocations-before;
+
+  before = allocations;
+  s_view.start();
+  for (std::string_view v : views)
+    by_view += m.has_key(v,hash_view);
+  s_view.stop();
+
+  std::cout << "speed_probe (" << speed_words << " words, seconds/allocations)" << std::endl;
+  std::cout << "  has_key(std::string(word))   = " << s_string.read() << "/" << string_allocations << std::endl;
+  std::cout << "  has_key(word,hash_view)      = " << s_view.read() << "/" << allocations-before << std::endl;
+  ASSERT_EQ(by_string,by_view);
+  ASSERT_EQ(speed_words/2,by_view);
+}
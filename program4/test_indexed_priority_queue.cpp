@@ -0,0 +1,139 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>                 // std::sort
+#include "ics46goody.hpp"
+#include "gtest/gtest.h"
+#include "indexed_priority_queue.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static bool indexed_gt (const int& a, const int& b) {return a > b;}
+typedef ics::IndexedHeapPriorityQueue<int,indexed_gt> IndexedPQ;
+
+static const int test_size = 2000;   //random_operations
+
+
+class IndexedPriorityQueueTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+
+TEST_F(IndexedPriorityQueueTest, enqueue_dequeue) {
+  IndexedPQ q;
+  ASSERT_TRUE(q.empty());
+  ASSERT_THROW(q.dequeue(),ics::EmptyError);
+  ASSERT_THROW(q.peek(),ics::EmptyError);
+  IndexedPQ::Handle h5 = q.enqueue(5), h1 = q.enqueue(1), h9 = q.enqueue(9);
+  ASSERT_EQ(3,q.size());
+  ASSERT_EQ(9,q.peek());
+  ASSERT_EQ(h9,q.peek_handle());
+  ASSERT_TRUE(q.contains(h5));
+  ASSERT_EQ(1,q.value(h1));
+  ASSERT_EQ(9,q.dequeue());
+  ASSERT_FALSE(q.contains(h9));
+  ASSERT_THROW(q.value(h9),ics::KeyError);
+
+  IndexedPQ::Handle h7 = q.enqueue(7);   //Reuses h9's slot, with a new generation
+  ASSERT_NE(h9,h7);
+  ASSERT_FALSE(q.contains(h9));
+  ASSERT_TRUE(q.contains(h7));
+  ASSERT_FALSE(q.contains(IndexedPQ::no_handle));
+
+  std::ostringstream printed;
+  printed << q;
+  ASSERT_EQ("indexed_priority_queue[7,5,1]:highest",printed.str());
+
+  q.clear();
+  ASSERT_TRUE(q.empty());
+  ASSERT_FALSE(q.contains(h5));
+  ASSERT_THROW(ics::IndexedHeapPriorityQueue<int>(),ics::TemplateFunctionError);
+}
+
+
+TEST_F(IndexedPriorityQueueTest, decrease_key_update_erase) {
+  IndexedPQ q;
+  std::vector<IndexedPQ::Handle> h;
+  for (int i=0; i<10; ++i)
+    h.push_back(q.enqueue(i));
+
+  q.decrease_key(h[2],20);             //Higher priority: now first
+  ASSERT_EQ(20,q.peek());
+  ASSERT_EQ(h[2],q.peek_handle());
+  ASSERT_THROW(q.decrease_key(h[3],-1),ics::IcsError);
+  ASSERT_EQ(3,q.value(h[3]));
+
+  q.update(h[2],-5);                   //Lower priority: now last
+  q.update(h[0],15);
+  ASSERT_EQ(15,q.peek());
+  ASSERT_EQ(7,q.erase(h[7]));
+  ASSERT_FALSE(q.contains(h[7]));
+  ASSERT_THROW(q.erase(h[7]),ics::KeyError);
+
+  std::vector<int> order;
+  while (!q.empty())
+    order.push_back(q.dequeue());
+  ASSERT_EQ((std::vector<int>{15,9,8,6,5,4,3,1,-5}),order);
+}
+
+
+TEST_F(IndexedPriorityQueueTest, copy_move) {
+  IndexedPQ q(indexed_gt);
+  IndexedPQ::Handle a = q.enqueue(1), b = q.enqueue(2);
+  IndexedPQ copy(q);
+  copy.update(a,10);                   //Handles are valid in the copy too
+  ASSERT_EQ(10,copy.peek());
+  ASSERT_EQ(2,q.peek());
+
+  IndexedPQ moved(std::move(copy));
+  ASSERT_TRUE(copy.empty());
+  ASSERT_EQ(10,moved.dequeue());
+  ASSERT_EQ(2,moved.value(b));
+  copy = moved;
+  ASSERT_EQ(1,copy.size());
+  copy = IndexedPQ(indexed_gt);
+  ASSERT_TRUE(copy.empty());
+}
+
+
+//Against a sorted std::vector model: every operation, on random handles
+TEST_F(IndexedPriorityQueueTest, random_operations) {
+  IndexedPQ q;
+  std::vector<IndexedPQ::Handle> handles;
+  std::vector<int>               values;   //values[i] is handles[i]'s value
+  for (int op=0; op<test_size; ++op) {
+    int choice = ics::rand_range(0,4);
+    if (choice <= 1 || handles.empty()) {
+      int v = ics::rand_range(0,1000);
+      handles.push_back(q.enqueue(v));
+      values.push_back(v);
+    } else {
+      int i = ics::rand_range(0,handles.size()-1);
+      if (choice == 2) {
+        values[i] += ics::rand_range(0,100);
+        q.decrease_key(handles[i],values[i]);
+      } else if (choice == 3) {
+        values[i] = ics::rand_range(0,1000);
+        q.update(handles[i],values[i]);
+      } else {
+        ASSERT_EQ(values[i],q.erase(handles[i]));
+        ASSERT_FALSE(q.contains(handles[i]));
+        handles.erase(handles.begin()+i);
+        values.erase(values.begin()+i);
+      }
+    }
+    ASSERT_EQ(std::int64_t(values.size()),q.size());
+    if (!values.empty()) {
+      ASSERT_EQ(*std::max_element(values.begin(),values.end()),q.peek());
+    }
+  }
+  for (std::size_t i=0; i<handles.size(); ++i)
+    ASSERT_EQ(values[i],q.value(handles[i]));
+
+  std::sort(values.begin(),values.end(),[] (int a, int b) {return a > b;});
+  for (int v : values)
+    ASSERT_EQ(v,q.dequeue());
+}
@@ -0,0 +1,170 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>                    // std::remove
+#include <cstdint>
+#include <climits>                   // INT_MIN, INT_MAX
+#include <type_traits>
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "hash_map.hpp"
+#include "hash_set.hpp"
+#include "heap_priority_queue.hpp"
+#include "mapped_hash_map.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static int         hash_int_min (const int& i)          {return i == 0 ? INT_MIN : i;}
+static std::size_t hash_int64   (const std::int64_t& i) {return i;}   //all 64 bits; keys differing only in their high 32 bits
+static bool        gt_char      (const char& a, const char& b) {return a > b;}
+
+typedef ics::HashMap<int,int,hash_int_min>                  MapTypeIntMin;
+typedef ics::HashSet<int,hash_int_min>                      SetTypeIntMin;
+typedef ics::HashMap<std::int64_t,int,hash_int64>           MapTypeInt64;
+typedef ics::HashSet<std::int64_t,hash_int64>               SetTypeInt64;
+typedef ics::MappedHashMap<std::int64_t,int,hash_int64>     MappedMapTypeInt64;
+typedef ics::HeapPriorityQueue<char,gt_char>                PriorityQueueTypeChar;
+
+static const char*        image_file  = "test_large_table.image"; //image_round_trip
+static const int          sparse_keys = 100000;                  //high_bits_spread/image_round_trip
+static const int          speed_keys  = 1000000;                 //speed_sparse_keys
+static const std::int64_t huge_size   = (std::int64_t(1) << 31) + 16;  //DISABLED_more_than_2_31_values (about 6GB)
+
+
+class LargeTableTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {std::remove(image_file);}
+};
+
+
+//Sparse 64-bit keys: the i-th differs from the others only in its high 32 bits
+static std::int64_t sparse_key (int i) {return std::int64_t(i) << 32;}
+
+
+static bool power_of_two (std::int64_t n) {return n > 0 && (n & (n-1)) == 0;}
+
+
+
+TEST_F(LargeTableTest, sizes_are_64_bit) {
+  static_assert(std::is_same<decltype(MapTypeInt64().size()),std::int64_t>::value,"HashMap::size");
+  static_assert(std::is_same<decltype(SetTypeInt64().size()),std::int64_t>::value,"HashSet::size");
+  static_assert(std::is_same<decltype(PriorityQueueTypeChar().size()),std::int64_t>::value,"HeapPriorityQueue::size");
+  static_assert(std::is_same<decltype(ics::HashStatistics().bins),std::int64_t>::value,"HashStatistics::bins");
+}
+
+
+//abs(INT_MIN) is INT_MIN: the old codes could be negative (a negative bin index)
+TEST_F(LargeTableTest, int_min_hash) {
+  MapTypeIntMin m;
+  SetTypeIntMin s;
+  for (int i=0; i<100; ++i) {
+    m.put(i,-i);
+    s.insert(i);
+  }
+  ASSERT_TRUE(m.has_key(0));
+  ASSERT_TRUE(s.contains(0));
+  ASSERT_EQ(0,m.erase(0));
+  ASSERT_EQ(1,s.erase(0));
+  ASSERT_FALSE(m.has_key(0));
+  ASSERT_FALSE(s.contains(0));
+  ASSERT_EQ(99,m.size());
+  ASSERT_EQ(99,s.size());
+}
+
+
+TEST_F(LargeTableTest, power_of_two_bins) {
+  ASSERT_EQ(1024,MapTypeInt64(1000).statistics().bins);
+  ASSERT_EQ(1024,SetTypeInt64(1000).statistics().bins);
+  ASSERT_EQ(1,MapTypeInt64(0).statistics().bins);
+  for (int step : {0,1}) {
+    MapTypeInt64 m;
+    m.set_rehash_step(step);              //1: checked mid-rehash too
+    SetTypeInt64 s;
+    for (int i=0; i<5000; ++i) {
+      m.put(sparse_key(i),i);
+      s.insert(sparse_key(i));
+      if (i%97 == 0) {
+        ASSERT_TRUE(power_of_two(s.statistics().bins));
+        ASSERT_EQ(i+1,m.statistics().used);
+      }
+    }
+    m.set_rehash_step(0);                 //statistics() counts old bins too while rehashing
+    ASSERT_TRUE(power_of_two(m.statistics().bins));
+  }
+}
+
+
+//With bin = code % bins, keys that differ only above bit 31 all went to one bin
+TEST_F(LargeTableTest, high_bits_spread) {
+  MapTypeInt64 m;
+  SetTypeInt64 s;
+  for (int i=0; i<sparse_keys; ++i) {
+    m.put(sparse_key(i),i);
+    s.insert(sparse_key(i));
+  }
+  ASSERT_EQ(sparse_keys,m.size());
+  for (int i=0; i<sparse_keys; ++i) {
+    ASSERT_EQ(i,m[sparse_key(i)]);
+    ASSERT_TRUE(s.contains(sparse_key(i)));
+    ASSERT_FALSE(s.contains(sparse_key(i)+1));
+  }
+
+  ics::HashStatistics ms = m.statistics(), ss = s.statistics();
+  ASSERT_EQ(0,ms.shared_codes);
+  ASSERT_LT(ms.collision_score,1.5) << ms.str();
+  ASSERT_LT(ss.collision_score,1.5) << ss.str();
+  ASSERT_LT(ms.max_chain,16) << ms.str();
+}
+
+
+//Images store all 64 bits of each code (image_version 2)
+TEST_F(LargeTableTest, image_round_trip) {
+  MapTypeInt64 m;
+  for (int i=0; i<sparse_keys; ++i)
+    m.put(sparse_key(i),i);
+  {
+    std::ofstream out(image_file,std::ios::binary);
+    m.write_image(out);
+  }
+
+  MappedMapTypeInt64 mapped(image_file);
+  ASSERT_EQ(m.size(),mapped.size());
+  for (int i=0; i<sparse_keys; ++i) {
+    ASSERT_TRUE(mapped.has_key(sparse_key(i)));
+    ASSERT_EQ(i,mapped[sparse_key(i)]);
+    ASSERT_FALSE(mapped.has_key(sparse_key(i)+1));
+  }
+}
+
+
+//A real container of more than 2^31 values: a heap of chars needs about 6GB while growing.
+//Run it with --gtest_also_run_disabled_tests
+TEST_F(LargeTableTest, DISABLED_more_than_2_31_values) {
+  PriorityQueueTypeChar q;
+  for (std::int64_t i=0; i<huge_size; ++i)
+    q.enqueue(char(i%128));
+  ASSERT_EQ(huge_size,q.size());
+  ASSERT_GT(q.size(),std::int64_t(INT_MAX));
+  for (int i=0; i<16; ++i)
+    ASSERT_EQ(127,q.dequeue());
+  ASSERT_EQ(huge_size-16,q.size());
+}
+
+
+TEST_F(LargeTableTest, speed_sparse_keys) {
+  ics::Stopwatch s;
+  s.start();
+  MapTypeInt64 m;
+  for (int i=0; i<speed_keys; ++i)
+    m.put(sparse_key(i),i);
+  long sum = 0;
+  for (int i=0; i<speed_keys; ++i)
+    sum += m.has_key(sparse_key(i));
+  s.stop();
+  ASSERT_EQ(speed_keys,sum);
+
+  ics::HashStatistics stats = m.statistics();
+  std::cout << "speed_sparse_keys (" << speed_keys << " keys differing only in their high 32 bits)" << std::endl;
+  std::cout << "  put+has_key seconds = " << s.read() << std::endl;
+  std::cout << "  bins = " << stats.bins << ", max_chain = " << stats.max_chain
+            << ", collision_score = " << stats.collision_score << std::endl;
+}
@@ -0,0 +1,215 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>                 // std::random_shuffle, std::sort
+#include "ics46goody.hpp"
+#include "gtest/gtest.h"
+#include "hash_map.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static int hash_int (const int& s) {std::hash<int> str_hash; return str_hash(s);}
+
+typedef ics::HashMap<int,int,hash_int> MapTypeInt;
+
+static const int test_size  = 10000;    //large_scale
+static const int speed_size = 1<<20;    //speed_put_latency (puts timed individually)
+static const int speed_step = 4;        //speed_put_latency (old bins moved per put)
+
+
+class MapRehashTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+//Put keys 0..size-1 into a map moving one old bin per operation; with load_threshold 1 and
+//  bins doubling at powers of 2, the last resize (at size 2^k+1) is still moving bins when size
+//  is a bit more than a power of 2
+static void load_migrating(MapTypeInt& m, int size) {
+  m.set_rehash_step(1);
+  for (int i=0; i<size; ++i)
+    m.put(i,10*i);
+}
+
+
+static ::testing::AssertionResult holds(const MapTypeInt& m, const std::map<int,int>& ref) {
+  if (m.size() != int(ref.size()))
+    return ::testing::AssertionFailure() << "size " << m.size() << " != " << ref.size();
+  for (const std::pair<const int,int>& e : ref)
+    if (!m.has_key(e.first) || m[e.first] != e.second)
+      return ::testing::AssertionFailure() << "key " << e.first;
+  std::map<int,int> seen;
+  for (const ics::pair<int,int>& e : m)
+    if (!seen.insert(std::make_pair(e.first,e.second)).second)
+      return ::testing::AssertionFailure() << "iterated twice " << e.first;
+  if (seen != ref)
+    return ::testing::AssertionFailure() << "iteration differs";
+  return ::testing::AssertionSuccess();
+}
+
+
+
+TEST_F(MapRehashTest, lookup_while_migrating) {
+  MapTypeInt m;
+  std::map<int,int> ref;
+  load_migrating(m,1030);
+  for (int i=0; i<1030; ++i)
+    ref[i] = 10*i;
+  ASSERT_TRUE(holds(m,ref));
+  ASSERT_NE(std::string::npos,m.str().find("migrated="));  //really mid-rehash
+
+  ASSERT_EQ(50,m.erase(5));
+  ref.erase(5);
+  ASSERT_EQ(10290,m.put(1029,7));
+  ref[1029] = 7;
+  m[2000] = 3;
+  ref[2000] = 3;
+  ASSERT_TRUE(holds(m,ref));
+  ASSERT_TRUE(m.has_value(7));
+  ASSERT_FALSE(m.has_value(-1));
+}
+
+
+TEST_F(MapRehashTest, copy_assign_clear_while_migrating) {
+  MapTypeInt m;
+  load_migrating(m,1030);
+  MapTypeInt copy(m), assigned;
+  assigned = m;
+  ASSERT_EQ(m,copy);
+  ASSERT_EQ(m,assigned);
+  ASSERT_EQ(copy,m);
+
+  std::ostringstream one_out;
+  MapTypeInt one;
+  load_migrating(one,3);      //bins 1 -> 2 -> 4: 3 keys are mid-rehash
+  one.erase(0);
+  one.erase(1);
+  one_out << one;
+  ASSERT_EQ("map[2->20]",one_out.str());
+
+  m.clear();
+  ASSERT_TRUE(m.empty());
+  ASSERT_FALSE(m.has_key(1));
+  ASSERT_EQ(1030,copy.size());
+}
+
+
+TEST_F(MapRehashTest, step_back_to_zero_finishes) {
+  MapTypeInt m;
+  load_migrating(m,1030);
+  MapTypeInt::Iterator it = m.begin();
+  m.set_rehash_step(0);
+  ASSERT_EQ(std::string::npos,m.str().find("migrated="));
+  ASSERT_THROW(++it,ics::ConcurrentModificationError);
+}
+
+
+TEST_F(MapRehashTest, iterator_while_migrating) {
+  MapTypeInt m;
+  load_migrating(m,1030);
+
+  //A put that moves bins changes mod_count like any other put
+  MapTypeInt::Iterator it = m.begin();
+  m.put(0,0);
+  ASSERT_THROW(*it,ics::ConcurrentModificationError);
+
+  //Iterator::erase moves no bins, so erasing everything visits each key once
+  int count = 0;
+  for (MapTypeInt::Iterator i = m.begin(); i != m.end(); ++i) {
+    int k = i->first;
+    ASSERT_EQ(k,i.erase().first);
+    ASSERT_FALSE(m.has_key(k));
+    ++count;
+  }
+  ASSERT_EQ(1030,count);
+  ASSERT_TRUE(m.empty());
+}
+
+
+TEST_F(MapRehashTest, large_scale) {
+  MapTypeInt lm;
+  lm.set_rehash_step(1);
+  std::map<int,int> ref;
+
+  std::vector<int> values;
+  for (int i=0; i<test_size; ++i)
+    values.push_back(i);
+  std::random_shuffle(values.begin(),values.end());
+
+  for (int test=1; test<=3; ++test) {
+    int inserted = 0;
+    int erased   = 0;
+    while (erased != test_size) {
+      int to_insert = ics::rand_range(0,test_size-inserted);
+      for (int i=0; i <to_insert; ++i) {
+        ASSERT_EQ(inserted,lm.put(values[inserted],inserted));
+        ref[values[inserted]] = inserted;
+        ++inserted;
+      }
+      ASSERT_TRUE(holds(lm,ref));
+
+      int to_erase = ics::rand_range(0,inserted-erased);
+      for (int i=0; i <to_erase; ++i) {
+        ASSERT_EQ(erased,lm.erase(values[erased]));
+        ref.erase(values[erased]);
+        ++erased;
+      }
+      ASSERT_TRUE(holds(lm,ref));
+    }
+  }
+  ASSERT_TRUE(lm.empty());
+}
+
+
+//Times each of speed_size puts individually; prints a log2 histogram of put latencies
+//  and the p50/p99/p99.9/max latency; returns the max (ns)
+static long long put_latencies(const char* name, int step, const std::vector<int>& keys, int& checksum) {
+  typedef std::chrono::steady_clock Clock;
+  std::vector<long long> ns;
+  ns.reserve(keys.size());
+
+  MapTypeInt m;
+  m.set_rehash_step(step);
+  for (int k : keys) {
+    Clock::time_point start = Clock::now();
+    m.put(k,k);
+    ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now()-start).count());
+  }
+  checksum += m.size();
+
+  std::vector<int> histogram(40,0);   //histogram[b]: puts taking [2^b,2^(b+1)) ns
+  for (long long t : ns) {
+    int b = 0;
+    while (b < 39 && (2LL<<b) <= t)
+      ++b;
+    ++histogram[b];
+  }
+  std::sort(ns.begin(),ns.end());
+  long long worst = ns.back();
+
+  std::cout << "  " << name << ": p50 = " << ns[ns.size()/2] << "ns, p99 = " << ns[ns.size()*99/100]
+            << "ns, p99.9 = " << ns[ns.size()*999/1000] << "ns, max = " << worst << "ns" << std::endl;
+  for (int b=0; b<40; ++b)
+    if (histogram[b] != 0)
+      std::cout << "    [" << (1LL<<b) << "ns," << (2LL<<b) << "ns): " << histogram[b] << std::endl;
+  return worst;
+}
+
+
+TEST_F(MapRehashTest, speed_put_latency) {
+  std::vector<int> keys;
+  for (int i=0; i<speed_size; ++i)
+    keys.push_back(i);
+  std::random_shuffle(keys.begin(),keys.end());
+
+  int checksum = 0;
+  std::cout << "speed_put_latency (" << speed_size << " puts, each timed)" << std::endl;
+  long long all_at_once = put_latencies("rehash all at once  ",0,keys,checksum);
+  long long incremental = put_latencies("rehash 4 bins per op",speed_step,keys,checksum);
+  ASSERT_EQ(2*speed_size,checksum);
+  //The last all-at-once resize moves speed_size/2 nodes in one put
+  ASSERT_LT(incremental,all_at_once);
+}
@@ -0,0 +1,215 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>                    // std::remove
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "hash_map.hpp"
+#include "hash_set.hpp"
+#include "mapped_hash_map.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static int hash_int    (const int& i)         {std::hash<int> int_hash; return int_hash(i);}
+static int hash_string (const std::string& s) {std::hash<std::string> str_hash; return str_hash(s);}
+
+typedef ics::HashMap<std::string,int,hash_string>                                      MapTypeStr;
+typedef ics::HashMap<std::string,int,hash_string,ics::HeapNodeAllocator,ics::CacheHash> CacheMapTypeStr;
+typedef ics::HashMap<int,std::string,hash_int>                                         MapTypeIntStr;
+typedef ics::HashSet<std::string,hash_string>                                          SetTypeStr;
+typedef ics::MappedHashMap<std::string,int,hash_string>                                MappedMapTypeStr;
+typedef ics::MappedHashMap<int,std::string,hash_int>                                   MappedMapTypeIntStr;
+typedef ics::MappedHashSet<std::string,hash_string>                                    MappedSetTypeStr;
+
+static const char* image_file = "test_mapped_map.image";  //every test writes (then removes) this file
+static const int   test_keys  = 1000;                     //round trip tests
+static const int   speed_keys = 1000000;                  //speed_cold_start
+static const int   speed_gets = 1000;                     //speed_cold_start (lookups after starting)
+
+
+class MappedMapTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {std::remove(image_file);}
+};
+
+
+template<class Container>
+static void write_image_file(const Container& c) {
+  std::ofstream out(image_file,std::ios::binary);
+  c.write_image(out);
+}
+
+
+static std::string word (int i) {return "word-" + std::to_string(i);}
+
+
+//Check that the mapped image of m has exactly m's entries (and none of the keys -1..-n)
+template<class Map>
+static ::testing::AssertionResult image_matches(const Map& m, int n) {
+  write_image_file(m);
+  MappedMapTypeStr mapped(image_file);
+  if (mapped.size() != m.size() || mapped.empty() != m.empty())
+    return ::testing::AssertionFailure() << "size " << mapped.size();
+  for (int i=0; i<n; ++i) {
+    if (mapped.has_key(word(i)) != m.has_key(word(i)) || mapped.has_key(word(-1-i)))
+      return ::testing::AssertionFailure() << "has_key " << word(i);
+    if (m.has_key(word(i)) && mapped[word(i)] != m[word(i)])
+      return ::testing::AssertionFailure() << "[] " << word(i);
+  }
+
+  int count = 0;
+  for (const MappedMapTypeStr::Entry& e : mapped)
+    if (++count, !m.has_key(std::string(e.first)) || m[std::string(e.first)] != e.second)
+      return ::testing::AssertionFailure() << "iterated " << e.first;
+  if (count != m.size())
+    return ::testing::AssertionFailure() << "iterated " << count;
+  return ::testing::AssertionSuccess();
+}
+
+
+
+TEST_F(MappedMapTest, map_round_trip) {
+  for (int step : {0,1}) {
+    MapTypeStr m;
+    CacheMapTypeStr c;
+    m.set_rehash_step(step);                  //1: written mid-rehash (see test_map_rehash.cpp)
+    c.set_rehash_step(step);
+    for (int i=0; i<test_keys; i+=2) {
+      m.put(word(i),i);
+      c.put(word(i),-i);
+    }
+    ASSERT_TRUE(image_matches(m,test_keys));
+    ASSERT_TRUE(image_matches(c,test_keys));
+  }
+
+  MapTypeStr m;
+  ASSERT_TRUE(image_matches(m,10));           //empty
+  m.put("a",1);
+  ASSERT_TRUE(image_matches(m,10));
+  MapTypeStr moved(std::move(m));
+  ASSERT_TRUE(image_matches(m,10));           //no bins
+
+  write_image_file(moved);
+  MappedMapTypeStr mapped(image_file);
+  ASSERT_THROW(mapped["b"],ics::KeyError);
+  ASSERT_THROW(*mapped.end(),ics::IteratorPositionIllegal);
+  std::ostringstream out;
+  out << mapped;
+  ASSERT_EQ("map[a->1]",out.str());
+}
+
+
+TEST_F(MappedMapTest, string_values) {
+  MapTypeIntStr m;
+  for (int i=0; i<test_keys; ++i)
+    m.put(i,word(i));
+  write_image_file(m);
+
+  MappedMapTypeIntStr mapped(image_file);
+  ASSERT_EQ(test_keys,mapped.size());
+  for (int i=0; i<test_keys; ++i)
+    ASSERT_EQ(word(i),mapped[i]);             //a std::string_view into the image
+  ASSERT_FALSE(mapped.has_key(-1));
+  int count = 0;
+  for (auto i = mapped.begin(); i != mapped.end(); ++i, ++count)
+    ASSERT_EQ(word(i->first),i->second);
+  ASSERT_EQ(test_keys,count);
+}
+
+
+TEST_F(MappedMapTest, set_round_trip) {
+  SetTypeStr s;
+  for (int i=0; i<test_keys; i+=3)
+    s.insert(word(i));
+  write_image_file(s);
+
+  MappedSetTypeStr mapped(image_file);
+  ASSERT_EQ(s.size(),mapped.size());
+  for (int i=0; i<test_keys; ++i)
+    ASSERT_EQ(s.contains(word(i)),mapped.contains(word(i)));
+  int count = 0;
+  for (std::string_view e : mapped) {
+    ++count;
+    ASSERT_TRUE(s.contains(std::string(e)));
+  }
+  ASSERT_EQ(s.size(),count);
+}
+
+
+TEST_F(MappedMapTest, rejects_other_files) {
+  ASSERT_THROW(MappedMapTypeStr{"no-such-file.image"},ics::IcsError);
+
+  SetTypeStr s({"a","b"});
+  write_image_file(s);
+  ASSERT_THROW(MappedMapTypeStr{image_file},ics::IcsError);     //a set's image
+  ASSERT_NO_THROW(MappedSetTypeStr{image_file});
+
+  MapTypeStr m({{"a",1},{"b",2}});
+  write_image_file(m);
+  ASSERT_THROW(MappedMapTypeIntStr{image_file},ics::IcsError);  //other key/value types
+  ASSERT_THROW(MappedSetTypeStr{image_file},ics::IcsError);
+
+  std::ostringstream image;
+  m.write_image(image);
+  std::string bytes = image.str();
+  {
+    std::ofstream out(image_file,std::ios::binary);
+    out << bytes.substr(0,bytes.size()-1);                      //truncated
+  }
+  ASSERT_THROW(MappedMapTypeStr{image_file},ics::IcsError);
+  {
+    std::ofstream out(image_file,std::ios::binary);
+    out << "map[a->1,b->2]";                                    //not an image
+  }
+  ASSERT_THROW(MappedMapTypeStr{image_file},ics::IcsError);
+}
+
+
+//Starting a program that needs a big map: rebuilding it through put_all (even from entries already
+//  in memory) versus mapping its image; both then look up speed_gets keys
+TEST_F(MappedMapTest, speed_cold_start) {
+  std::vector<ics::pair<std::string,int>> entries;
+  for (int i=0; i<speed_keys; ++i)
+    entries.push_back(ics::pair<std::string,int>(word(i),i));
+  {
+    MapTypeStr m;
+    m.put_all(entries);
+    write_image_file(m);
+  }
+
+  long rebuilt_sum = 0, mapped_sum = 0;
+  ics::Stopwatch s_rebuild, s_map, s_iterate;
+  s_rebuild.start();
+  {
+    MapTypeStr m;
+    m.put_all(entries);
+    for (int i=0; i<speed_gets; ++i)
+      rebuilt_sum += m[word(i*997 % speed_keys)];
+  }
+  s_rebuild.stop();
+
+  s_map.start();
+  {
+    MappedMapTypeStr mapped(image_file);
+    for (int i=0; i<speed_gets; ++i)
+      mapped_sum += mapped[word(i*997 % speed_keys)];
+  }
+  s_map.stop();
+  ASSERT_EQ(rebuilt_sum,mapped_sum);
+
+  MappedMapTypeStr mapped(image_file);
+  long count = 0;
+  s_iterate.start();
+  for (const MappedMapTypeStr::Entry& e : mapped)
+    count += e.second;
+  s_iterate.stop();
+  ASSERT_EQ(long(speed_keys)*(speed_keys-1)/2,count);
+
+  std::ifstream image(image_file,std::ios::binary | std::ios::ate);
+  std::cout << "speed_cold_start (" << speed_keys << " keys, " << speed_gets << " lookups, seconds; image "
+            << image.tellg() << " bytes)" << std::endl;
+  std::cout << "  HashMap put_all       = " << s_rebuild.read() << std::endl;
+  std::cout << "  MappedHashMap         = " << s_map.read() << "   (iterating every entry: " << s_iterate.read() << ")" << std::endl;
+}
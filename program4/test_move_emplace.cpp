@@ -0,0 +1,284 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "node_allocator.hpp"
+#include "hash_map.hpp"
+#include "hash_set.hpp"
+#include "heap_priority_queue.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static int hash_string (const std::string& s) {std::hash<std::string> str_hash; return str_hash(s);}
+
+static const int speed_size   = 100000;     //speed_local_info (nodes in the map)
+static const int speed_degree = 4;        //speed_local_info (names in each of a node's sets)
+
+
+class MoveEmplaceTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+//Like HashGraph's LocalInfo (a node's in/out node and edge sets), but counting how often it is copied
+struct Info {
+  typedef ics::HashSet<std::string,hash_string> NameSet;
+  static int copies;
+
+  int     priority = 0;
+  NameSet out_nodes, in_nodes, out_edges, in_edges;
+
+  Info () {}
+  explicit Info (int p) : priority(p) {}
+  Info (const Info& i) : priority(i.priority), out_nodes(i.out_nodes), in_nodes(i.in_nodes), out_edges(i.out_edges), in_edges(i.in_edges)
+  {++copies;}
+  Info (Info&& i) noexcept = default;
+  Info& operator = (const Info& i) {
+    priority = i.priority; out_nodes = i.out_nodes; in_nodes = i.in_nodes; out_edges = i.out_edges; in_edges = i.in_edges;
+    ++copies;
+    return *this;
+  }
+  Info& operator = (Info&& i) noexcept = default;
+  bool operator == (const Info& rhs) const {return priority == rhs.priority && out_nodes == rhs.out_nodes && in_edges == rhs.in_edges;}
+};
+int Info::copies = 0;
+
+std::ostream& operator << (std::ostream& outs, const Info& i) {return outs << "Info(" << i.priority << ")";}
+
+static bool info_gt (const Info& a, const Info& b) {return a.priority > b.priority;}
+
+typedef ics::HashMap<std::string,Info,hash_string>                         InfoMap;
+typedef ics::HashMap<std::string,Info,hash_string,ics::PoolNodeAllocator<>> PoolInfoMap;
+typedef ics::HashSet<std::string,hash_string>                              SetTypeStr;
+typedef ics::HeapPriorityQueue<Info,info_gt>                               InfoPQ;
+
+
+static Info filled (int p) {
+  Info i(p);
+  for (int d=0; d<speed_degree; ++d) {
+    i.out_nodes.insert(std::to_string(p+d));
+    i.in_nodes.insert(std::to_string(p-d));
+  }
+  return i;
+}
+
+
+
+TEST_F(MoveEmplaceTest, noexcept_moves) {
+  ASSERT_TRUE(std::is_nothrow_move_constructible<InfoMap>::value);
+  ASSERT_TRUE(std::is_nothrow_move_assignable<InfoMap>::value);
+  ASSERT_TRUE(std::is_nothrow_move_constructible<PoolInfoMap>::value);
+  ASSERT_TRUE(std::is_nothrow_move_assignable<PoolInfoMap>::value);
+  ASSERT_TRUE(std::is_nothrow_move_constructible<SetTypeStr>::value);
+  ASSERT_TRUE(std::is_nothrow_move_assignable<SetTypeStr>::value);
+  ASSERT_TRUE(std::is_nothrow_move_constructible<InfoPQ>::value);
+  ASSERT_TRUE(std::is_nothrow_move_assignable<InfoPQ>::value);
+}
+
+
+TEST_F(MoveEmplaceTest, map_mutators_move) {
+  InfoMap m;
+  Info::copies = 0;
+
+  ASSERT_EQ(1,m.try_emplace(std::string("a"),1));
+  ASSERT_EQ(0,m.try_emplace(std::string("a"),2));   //already there: nothing built
+  std::string b = "b";
+  ASSERT_EQ(1,m.try_emplace(b,2));                  //key copied, value built in place
+  ASSERT_EQ("b",b);
+  m[std::string("c")].priority = 3;
+  InfoMap::Entry d("d",Info(4));
+  Info::copies = 0;                                 //(pair's constructor copies)
+  ASSERT_EQ(1,m.emplace(std::move(d)));
+  ASSERT_EQ(0,m.emplace(InfoMap::Entry("d",Info())));
+  Info::copies = 0;
+
+  ASSERT_EQ(1,m.put(std::string("a"),filled(10)).priority);   //existing key: old value swapped out
+  ASSERT_EQ(0,Info::copies);
+  ASSERT_EQ(5,m.put(std::string("e"),Info(5)).priority);      //new key: returning the value copies it
+  ASSERT_EQ(1,Info::copies);
+
+  Info::copies = 0;
+  ASSERT_EQ(2,m.erase("b").priority);
+  for (InfoMap::Iterator i = m.begin(); i != m.end(); ++i)
+    if (i->first == "c") {
+      ASSERT_EQ(3,i.erase().second.priority);
+    }
+  ASSERT_EQ(0,Info::copies);
+
+  ASSERT_EQ(3,m.size());
+  ASSERT_EQ(filled(10),m["a"]);
+  ASSERT_EQ(4,m["d"].priority);
+  ASSERT_EQ(5,m["e"].priority);
+}
+
+
+//Moves a map with and without a rehash in progress, and with a pooled NodeAllocator
+template<class Map>
+::testing::AssertionResult moves_keep(int size, int rehash_step) {
+  Map m;
+  m.set_rehash_step(rehash_step);
+  for (int i=0; i<size; ++i)
+    m.try_emplace(std::to_string(i),i);
+  Info::copies = 0;
+
+  typename Map::Iterator it = m.begin();
+  Map moved(std::move(m));
+  if (m.size() != 0 || !m.empty() || m.has_key("0") || moved.size() != size)
+    return ::testing::AssertionFailure() << "move constructor";
+  try {
+    ++it;
+    return ::testing::AssertionFailure() << "iterator survived move";
+  } catch (ics::ConcurrentModificationError& e) {}
+
+  Map assigned;
+  assigned.try_emplace("x",-1);
+  assigned = std::move(moved);
+  assigned = std::move(assigned);
+  moved = std::move(m);                 //moving a moved-from map
+  if (!moved.empty() || assigned.size() != size || assigned.has_key("x"))
+    return ::testing::AssertionFailure() << "move assignment";
+  for (int i=0; i<size; ++i)
+    if (!assigned.has_key(std::to_string(i)) || assigned[std::to_string(i)].priority != i)
+      return ::testing::AssertionFailure() << "lost key " << i;
+  if (Info::copies != 0)
+    return ::testing::AssertionFailure() << Info::copies << " copies";
+
+  //Moved-from maps are usable: their next insertion allocates a bin
+  for (int i=0; i<size; ++i)
+    m.put(std::to_string(i),Info(-i));
+  Map copy(moved);
+  copy[std::string("y")].priority = 1;
+  if (m.size() != size || m["1"].priority != -1 || copy.size() != 1 || !(Map(moved) == moved))
+    return ::testing::AssertionFailure() << "reuse after move";
+  return ::testing::AssertionSuccess();
+}
+
+
+TEST_F(MoveEmplaceTest, map_move_construct_assign) {
+  ASSERT_TRUE(moves_keep<InfoMap>(1000,0));
+  ASSERT_TRUE(moves_keep<InfoMap>(1030,1));   //mid-rehash (see test_map_rehash.cpp)
+  ASSERT_TRUE(moves_keep<PoolInfoMap>(1000,0));
+  ASSERT_TRUE(moves_keep<PoolInfoMap>(1030,1));
+}
+
+
+TEST_F(MoveEmplaceTest, set_insert_emplace_move) {
+  SetTypeStr s;
+  std::string a(100,'a');
+  ASSERT_EQ(1,s.insert(std::move(a)));
+  ASSERT_EQ(1,s.emplace(3,'b'));
+  ASSERT_EQ(0,s.emplace(3,'b'));
+  ASSERT_EQ(0,s.insert(std::string(100,'a')));
+  ASSERT_TRUE(s.contains("bbb") && s.contains(std::string(100,'a')));
+
+  SetTypeStr moved(std::move(s));
+  ASSERT_TRUE(s.empty());
+  ASSERT_FALSE(s.contains("bbb"));
+  ASSERT_EQ(0,s.erase("bbb"));
+  ASSERT_EQ(2,moved.size());
+  SetTypeStr assigned({"x"});
+  assigned = std::move(moved);
+  ASSERT_EQ(SetTypeStr({"bbb",std::string(100,'a')}),assigned);
+
+  for (int i=0; i<100; ++i)
+    ASSERT_EQ(1,s.insert(std::to_string(i)));
+  ASSERT_EQ(100,s.size());
+  ASSERT_EQ(100,SetTypeStr(s).size());
+  ASSERT_EQ(0,SetTypeStr(moved).size());
+}
+
+
+TEST_F(MoveEmplaceTest, priority_queue_enqueue_emplace_move) {
+  InfoPQ pq;
+  Info::copies = 0;
+  for (int i=0; i<100; ++i)
+    if (i%2 == 0)
+      pq.enqueue(filled(i));
+    else
+      pq.emplace(i);
+  ASSERT_EQ(0,Info::copies);
+
+  InfoPQ moved(std::move(pq));
+  ASSERT_TRUE(pq.empty());
+  InfoPQ assigned;
+  assigned.emplace(1000);
+  assigned = std::move(moved);
+  ASSERT_EQ(0,Info::copies);
+  ASSERT_EQ(100,assigned.size());
+
+  for (int i=99; i>=0; --i) {
+    Info top = assigned.dequeue();
+    ASSERT_EQ(i,top.priority);
+    ASSERT_EQ(i%2 == 0 ? speed_degree : 0,top.out_nodes.size());
+  }
+  ASSERT_EQ(0,Info::copies);
+
+  pq.enqueue(Info(7));                        //moved-from queues are usable
+  ASSERT_EQ(7,pq.peek().priority);
+}
+
+
+//Build a map of speed_size names to Infos (each with speed_degree names in two sets), then copy
+//  or move it as a whole; returns the seconds taken and counts Info copies
+template<class Build>
+static double build_map(Build build, InfoMap& m, int& copies) {
+  Info::copies = 0;
+  ics::Stopwatch s;
+  s.start();
+  for (int i=0; i<speed_size; ++i)
+    build(m,i);
+  s.stop();
+  copies = Info::copies;
+  return s.read();
+}
+
+
+//Key by key: HashMap::operator == calls has_value for each key (O(N^2) at speed_size)
+static bool same(const InfoMap& a, const InfoMap& b) {
+  if (a.size() != b.size())
+    return false;
+  for (const InfoMap::Entry& e : a)
+    if (!b.has_key(e.first) || !(b[e.first] == e.second))
+      return false;
+  return true;
+}
+
+
+TEST_F(MoveEmplaceTest, speed_local_info) {
+  int copies;
+  InfoMap by_copy, by_move, by_emplace;
+  std::cout << "speed_local_info (" << speed_size << " nodes, seconds/Info copies)" << std::endl;
+
+  double t = build_map([] (InfoMap& m, int i) {std::string name = std::to_string(i); Info info = filled(i); m.put(name,info);},by_copy,copies);
+  std::cout << "  put(const KEY&,const T&) = " << t << "/" << copies << std::endl;
+  ASSERT_EQ(2*speed_size,copies);                      //into the node, and returned
+
+  t = build_map([] (InfoMap& m, int i) {m.put(std::to_string(i),filled(i));},by_move,copies);
+  std::cout << "  put(KEY&&,T&&)           = " << t << "/" << copies << std::endl;
+  ASSERT_EQ(speed_size,copies);                        //only the returned value
+
+  t = build_map([] (InfoMap& m, int i) {m.try_emplace(std::to_string(i),filled(i));},by_emplace,copies);
+  std::cout << "  try_emplace(KEY&&,T&&)   = " << t << "/" << copies << std::endl;
+  ASSERT_EQ(0,copies);
+  ASSERT_TRUE(same(by_copy,by_emplace));
+
+  Info::copies = 0;
+  ics::Stopwatch s_copy, s_move;
+  s_copy.start();
+  InfoMap copied(by_copy);
+  s_copy.stop();
+  copies = Info::copies;
+  std::cout << "  copy constructor         = " << s_copy.read() << "/" << copies << std::endl;
+  ASSERT_LE(speed_size,copies);                        //and the trailers' (default) Infos
+  s_move.start();
+  InfoMap moved(std::move(by_move));
+  s_move.stop();
+  std::cout << "  move constructor         = " << s_move.read() << "/" << Info::copies-copies << std::endl;
+  ASSERT_EQ(copies,Info::copies);
+  ASSERT_TRUE(by_move.empty());
+  ASSERT_TRUE(same(copied,moved));
+}
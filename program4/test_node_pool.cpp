@@ -0,0 +1,176 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>                 // std::random_shuffle
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "node_allocator.hpp"
+#include "hash_map.hpp"
+#include "hash_set.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static int hash_string (const std::string& s) {std::hash<std::string> str_hash; return str_hash(s);}
+static int hash_int    (const int& s)         {std::hash<int> str_hash; return str_hash(s);}
+
+typedef ics::PoolNodeAllocator<>                                       Pooled;
+typedef ics::HashMap<int,int,hash_int,Pooled>                          PoolMapTypeInt;
+typedef ics::HashSet<std::string,hash_string,Pooled>                   PoolSetTypeStr;
+
+static const int speed_live  = 100000;   //speed_churn (entries live at any time)
+static const int speed_churn = 2000000;  //speed_churn (erase+insert pairs)
+
+
+class NodePoolTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+//Counts live instances, to check that Pools construct and destruct what they hand out
+struct Tracked {
+  static int live;
+  std::string s;
+  Tracked(std::string v = "") : s(v) {++live;}
+  Tracked(const Tracked& t) : s(t.s) {++live;}
+  ~Tracked() {--live;}
+};
+int Tracked::live = 0;
+
+
+
+TEST_F(NodePoolTest, pool_recycles) {
+  {
+    ics::PoolNodeAllocator<4>::Pool<Tracked> p;
+    Tracked* a = p.create("a");
+    Tracked* b = p.create("b");
+    ASSERT_EQ(2,Tracked::live);
+    ASSERT_EQ("b",b->s);
+    p.destroy(a);
+    ASSERT_EQ(1,Tracked::live);
+    ASSERT_EQ(a,p.create("c"));    //freelist before the rest of the slab
+
+    std::vector<Tracked*> many;
+    for (int i=0; i<100; ++i)      //past several 4-node slabs
+      many.push_back(p.create(std::to_string(i)));
+    p.reserve(1000);               //one slab; what was left of the last one is freelisted
+    for (int i=0; i<100; ++i) {
+      ASSERT_EQ(std::to_string(i),many[i]->s);
+      p.destroy(many[i]);
+    }
+    p.destroy(b);
+    p.destroy(a);
+    ASSERT_EQ(0,Tracked::live);
+  }
+
+  ics::HeapNodeAllocator::Pool<Tracked> h;
+  Tracked* t = h.create("x");
+  ASSERT_EQ(1,Tracked::live);
+  h.destroy(t);
+  ASSERT_EQ(0,Tracked::live);
+}
+
+
+TEST_F(NodePoolTest, map_operations) {
+  PoolMapTypeInt m;
+  for (int i=0; i<1000; ++i)
+    ASSERT_EQ(i,m.put(i,i));
+  for (int i=0; i<1000; i+=2)
+    ASSERT_EQ(i,m.erase(i));
+  for (int i=1000; i<1500; ++i)    //reuses the erased nodes
+    m[i] = i;
+  ASSERT_EQ(1000,m.size());
+  for (int i=0; i<1500; ++i)
+    ASSERT_EQ(i%2 == 1 || i >= 1000, m.has_key(i));
+
+  PoolMapTypeInt copy(m), assigned;
+  assigned = m;
+  ASSERT_EQ(m,copy);
+  ASSERT_EQ(m,assigned);
+
+  int count = 0;
+  for (PoolMapTypeInt::Iterator it = m.begin(); it != m.end(); ++it, ++count)
+    it.erase();
+  ASSERT_EQ(1000,count);
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(1000,copy.size());
+
+  copy.clear();
+  copy.set_rehash_step(1);
+  for (int i=0; i<5000; ++i)
+    copy.put(i,-i);
+  for (int i=0; i<5000; ++i)
+    ASSERT_EQ(-i,copy[i]);
+}
+
+
+TEST_F(NodePoolTest, set_operations) {
+  PoolSetTypeStr s({"a","b","c"}), t;
+  ASSERT_EQ(0,s.insert("a"));
+  ASSERT_EQ(1,s.insert("d"));
+  ASSERT_EQ(1,s.erase("b"));
+  ASSERT_EQ(1,s.insert("b"));
+  t = s;
+  ASSERT_EQ(s,t);
+  ASSERT_EQ(2,t.retain_all(PoolSetTypeStr({"a","b"})));
+  ASSERT_EQ(2,t.size());
+  ASSERT_TRUE(t.contains("a") && t.contains("b"));
+
+  std::ostringstream out;
+  PoolSetTypeStr one({"x"});
+  out << one;
+  ASSERT_EQ("set[x]",out.str());
+
+  for (PoolSetTypeStr::Iterator it = s.begin(); it != s.end(); ++it)
+    it.erase();
+  ASSERT_TRUE(s.empty());
+  s.clear();
+  ASSERT_EQ(1,s.insert("z"));
+}
+
+
+//Keep speed_live entries in the container, each step erasing the oldest and inserting a new one
+template<class C>
+double churn(const std::vector<int>& keys, int& checksum) {
+  C c;
+  int oldest = 0;
+  for (int i=0; i<speed_live; ++i)
+    checksum += c.insert(keys[i]);
+
+  ics::Stopwatch s;
+  s.start();
+  for (int i=0; i<speed_churn; ++i) {
+    checksum += c.erase(keys[oldest]);
+    oldest = (oldest+1) % keys.size();
+    checksum += c.insert(keys[(oldest+speed_live-1) % keys.size()]);
+  }
+  s.stop();
+  checksum -= c.size();
+  return s.read();
+}
+
+
+//Adapt HashMap to the insert/erase interface used by churn
+template<class Alloc>
+class ChurnMap : public ics::HashMap<int,int,hash_int,Alloc> {
+  public:
+    int insert (int k) {this->put(k,k); return 1;}
+    int erase  (int k) {return ics::HashMap<int,int,hash_int,Alloc>::erase(k) == k;}
+};
+
+
+TEST_F(NodePoolTest, speed_churn) {
+  std::vector<int> keys;
+  for (int i=0; i<2*speed_live; ++i)
+    keys.push_back(i);
+  std::random_shuffle(keys.begin(),keys.end());
+
+  int checksum = 0;
+  std::cout << "speed_churn (" << speed_live << " live, " << speed_churn << " erase+insert pairs, seconds)" << std::endl;
+  std::cout << "  HashMap new/delete = " << churn<ChurnMap<ics::HeapNodeAllocator>>(keys,checksum) << std::endl;
+  std::cout << "  HashMap pooled     = " << churn<ChurnMap<Pooled>>(keys,checksum) << std::endl;
+  std::cout << "  HashSet new/delete = " << churn<ics::HashSet<int,hash_int>>(keys,checksum) << std::endl;
+  std::cout << "  HashSet pooled     = " << churn<ics::HashSet<int,hash_int,Pooled>>(keys,checksum) << std::endl;
+  ASSERT_EQ(4*2*speed_churn,checksum);
+}
@@ -0,0 +1,313 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>                 // std::random_shuffle
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "array_queue.hpp"
+#include "hash_map.hpp"
+#include "persistent_hash_map.hpp"
+#include "hashers.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static int hash_persistent_bad (const int& s) {return s % 7;}  //Many keys share each code on purpose
+
+typedef ics::pair<std::string,int>                                      EntryType;
+typedef ics::PersistentHashMap<std::string,int,ics::hash_string>        PersistentMapTypeStr;
+typedef ics::PersistentHashMap<int,int,ics::hash_integer<int>>          PersistentMapTypeInt;
+typedef ics::PersistentHashMap<int,int,hash_persistent_bad>             PersistentMapTypeBad;
+typedef ics::HashMap<int,int,ics::hash_integer<int>>                    ChainMapTypeInt;
+
+static const int test_size      = 10000;    //versions, large_scale
+static const int reader_threads = 4;        //snapshot_readers
+static const int speed_size     = 1000000;  //speed_snapshot_update (entries in each map)
+static const int speed_updates  = 100000;   //speed_snapshot_update (puts after the snapshot)
+
+
+class PersistentMapTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+static PersistentMapTypeStr load(PersistentMapTypeStr m, std::string keys, std::vector<int> values) {
+  for (unsigned i=0; i<keys.size(); ++i)
+    m = m.put(std::string(1,keys[i]),values[i]);
+  return m;
+}
+
+
+static ::testing::AssertionResult mapsto(const PersistentMapTypeStr& m, std::string keys, std::vector<int> values) {
+  for (unsigned i=0; i<keys.size(); ++i)
+    if (!m.has_key(std::string(1,keys[i])) || m[std::string(1,keys[i])] != values[i])
+      return ::testing::AssertionFailure() << "key " << keys[i];
+  return ::testing::AssertionSuccess();
+}
+
+
+
+TEST_F(PersistentMapTest, empty) {
+  PersistentMapTypeStr m;
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(0,m.size());
+  ASSERT_FALSE(m.has_key("a"));
+  ASSERT_FALSE(m.has_value(1));
+  ASSERT_TRUE(m.begin() == m.end());
+  ASSERT_THROW(m.erase("a"),ics::KeyError);
+}
+
+
+TEST_F(PersistentMapTest, put_erase_index) {
+  PersistentMapTypeStr empty;
+  PersistentMapTypeStr m = load(empty,"abcdefgh",{1,2,3,4,5,6,7,8});
+  ASSERT_TRUE(empty.empty());
+  ASSERT_EQ(8,m.size());
+  ASSERT_TRUE(mapsto(m,"abcdefgh",{1,2,3,4,5,6,7,8}));
+
+  PersistentMapTypeStr changed = m.put("d",40);
+  ASSERT_EQ(8,changed.size());
+  ASSERT_EQ(40,changed["d"]);
+  ASSERT_EQ(4,m["d"]);
+  ASSERT_TRUE(changed.has_value(40));
+  ASSERT_FALSE(m.has_value(40));
+
+  PersistentMapTypeStr smaller = changed.erase("a");
+  ASSERT_EQ(7,smaller.size());
+  ASSERT_FALSE(smaller.has_key("a"));
+  ASSERT_TRUE(changed.has_key("a"));
+  ASSERT_THROW(smaller.erase("a"),ics::KeyError);
+  ASSERT_THROW(smaller["a"],ics::KeyError);
+  ASSERT_TRUE(smaller.clear().empty());
+  ASSERT_EQ(7,smaller.size());
+}
+
+
+//Every version made along the way still holds exactly the keys it held when it was made
+TEST_F(PersistentMapTest, versions) {
+  std::vector<PersistentMapTypeInt> versions(1);
+  for (int i=0; i<test_size; ++i)
+    versions.push_back(versions.back().put(i,i));
+  for (int i=0; i<test_size; i+=2)
+    versions.push_back(versions.back().erase(i));
+
+  for (int v=0; v<=test_size; v+=test_size/10) {
+    ASSERT_EQ(v,versions[v].size());
+    for (int i=0; i<test_size; ++i)
+      ASSERT_EQ(i < v,versions[v].has_key(i));
+  }
+  const PersistentMapTypeInt& last = versions.back();
+  ASSERT_EQ(test_size/2,last.size());
+  for (int i=0; i<test_size; ++i)
+    ASSERT_EQ(i%2 == 1,last.has_key(i));
+}
+
+
+//Only 7 distinct codes: keys share leaves at the bottom of the trie; erasing them empties and
+//  collapses those leaves
+TEST_F(PersistentMapTest, shared_codes) {
+  PersistentMapTypeBad m;
+  for (int i=0; i<300; ++i)
+    m = m.put(i,i);
+  ASSERT_EQ(300,m.size());
+  for (int i=0; i<300; ++i)
+    ASSERT_EQ(i,m[i]);
+  ASSERT_FALSE(m.has_key(300));
+  m = m.put(7,70);
+  ASSERT_EQ(300,m.size());
+  ASSERT_EQ(70,m[7]);
+
+  PersistentMapTypeBad half = m;
+  for (int i=0; i<300; i+=2)
+    half = half.erase(i);
+  ASSERT_EQ(150,half.size());
+  for (int i=0; i<300; ++i)
+    ASSERT_EQ(i%2 == 1,half.has_key(i));
+  for (int i=1; i<300; i+=2)
+    half = half.erase(i);
+  ASSERT_TRUE(half.empty());
+  ASSERT_EQ(300,m.size());
+}
+
+
+TEST_F(PersistentMapTest, operator_rel) {
+  PersistentMapTypeStr m1 = load(PersistentMapTypeStr(),"abcdefgh",{1,2,3,4,5,6,7,8});
+  PersistentMapTypeStr m2 = load(PersistentMapTypeStr(),"hgfedcba",{8,7,6,5,4,3,2,1});
+  ASSERT_TRUE(m1 == m2);
+  ASSERT_FALSE(m1 != m2);
+  ASSERT_TRUE(m1 == m1.snapshot());
+  m2 = m2.put("a",0);
+  ASSERT_TRUE(m1 != m2);
+  m2 = m2.erase("a");
+  ASSERT_FALSE(m1 == m2);
+}
+
+
+TEST_F(PersistentMapTest, constructors) {
+  PersistentMapTypeStr m = load(PersistentMapTypeStr(),"abcdefgh",{1,2,3,4,5,6,7,8});
+
+  PersistentMapTypeStr copy(m);
+  ASSERT_EQ(m,copy);
+  PersistentMapTypeStr il({EntryType("a",1),EntryType("b",2)});
+  ASSERT_TRUE(mapsto(il,"ab",{1,2}));
+  ics::ArrayQueue<EntryType> q;
+  for (EntryType e : m)
+    q.enqueue(e);
+  PersistentMapTypeStr iterable(q);
+  ASSERT_EQ(m,iterable);
+  ASSERT_EQ(m,il.put_all(q));
+  ASSERT_EQ(2,il.size());
+
+  PersistentMapTypeStr moved(std::move(copy));
+  ASSERT_EQ(m,moved);
+  ASSERT_TRUE(copy.empty());
+  copy = copy.put("z",26);
+  ASSERT_TRUE(mapsto(copy,"z",{26}));
+
+  moved = std::move(copy);                 //The moved-from map is empty: size agrees with iteration
+  ASSERT_TRUE(mapsto(moved,"z",{26}));
+  ASSERT_EQ(1,moved.size());
+  ASSERT_EQ(0,copy.size());
+  ASSERT_TRUE(copy.begin() == copy.end());
+  copy = copy.put("y",25);
+  ASSERT_TRUE(mapsto(copy,"y",{25}));
+  ASSERT_EQ(1,copy.size());
+
+  std::ostringstream out;
+  out << il;
+  ASSERT_TRUE(out.str() == "map[a->1,b->2]" || out.str() == "map[b->2,a->1]");
+}
+
+
+//An iterator keeps iterating over the version it began on after the variable is assigned
+TEST_F(PersistentMapTest, iterator) {
+  PersistentMapTypeBad m;
+  for (int i=0; i<300; ++i)
+    m = m.put(i,i);
+  PersistentMapTypeBad::Iterator it = m.begin();
+  PersistentMapTypeBad::Iterator end = m.end();
+  m = m.clear();
+
+  std::vector<bool> seen(300,false);
+  int count = 0;
+  for (; it != end; it++) {
+    ASSERT_FALSE(seen[it->first]);
+    seen[it->first] = true;
+    ASSERT_EQ(it->first,(*it).second);
+    ++count;
+  }
+  ASSERT_EQ(300,count);
+  ASSERT_THROW(*it,ics::IteratorPositionIllegal);
+  ASSERT_THROW(it == m.end(),ics::ComparingDifferentIteratorsError);
+}
+
+
+TEST_F(PersistentMapTest, large_scale) {
+  PersistentMapTypeInt lm;
+  ChainMapTypeInt      check;
+
+  std::vector<int> values;
+  for (int i=0; i<test_size; ++i)
+    values.push_back(i);
+  std::random_shuffle(values.begin(),values.end());
+
+  for (int i=0; i<test_size; ++i) {
+    lm = lm.put(values[i],i);
+    check.put(values[i],i);
+  }
+  for (int i=0; i<test_size; i+=3) {
+    lm = lm.erase(values[i]);
+    check.erase(values[i]);
+  }
+  ASSERT_EQ(check.size(),lm.size());
+  int count = 0;
+  for (const auto& kv : lm) {
+    ASSERT_EQ(check[kv.first],kv.second);
+    ++count;
+  }
+  ASSERT_EQ(check.size(),count);
+}
+
+
+//Readers check snapshots in their own threads while the writer makes (and drops) newer versions
+TEST_F(PersistentMapTest, snapshot_readers) {
+  PersistentMapTypeInt m;
+  for (int i=0; i<test_size; ++i)
+    m = m.put(i,i);
+
+  std::atomic<int> failures(0);
+  std::vector<std::thread> readers;
+  for (int t=0; t<reader_threads; ++t) {
+    PersistentMapTypeInt snapshot = m;
+    readers.push_back(std::thread([snapshot,&failures] {
+      for (int lap=0; lap<5; ++lap) {
+        long sum = 0;
+        for (const auto& kv : snapshot)
+          sum += kv.second;
+        if (snapshot.size() != test_size || sum != long(test_size)*(test_size-1)/2)
+          ++failures;
+      }
+    }));
+  }
+  for (int i=0; i<test_size; ++i)
+    m = m.put(i,-i).erase(i);
+  for (std::thread& r : readers)
+    r.join();
+
+  ASSERT_EQ(0,failures.load());
+  ASSERT_TRUE(m.empty());
+}
+
+
+//A snapshot (copy) of a HashMap copies every node; of a PersistentHashMap, it is one reference.
+//  Updates afterwards: HashMap's put changes the map in place (its copy is already separate);
+//  PersistentHashMap's put copies O(log32 N) nodes on the path to the key
+TEST_F(PersistentMapTest, speed_snapshot_update) {
+  std::vector<int> keys;
+  for (int i=0; i<speed_size; ++i)
+    keys.push_back(i);
+  std::random_shuffle(keys.begin(),keys.end());
+
+  ChainMapTypeInt      hm;
+  PersistentMapTypeInt pm;
+  ics::Stopwatch hm_build, pm_build;
+  hm_build.start();
+  for (int k : keys)
+    hm.put(k,k);
+  hm_build.stop();
+  pm_build.start();
+  for (int k : keys)
+    pm = pm.put(k,k);
+  pm_build.stop();
+
+  ics::Stopwatch hm_snap, pm_snap, hm_update, pm_update;
+  hm_snap.start();
+  ChainMapTypeInt hm_snapshot(hm);
+  hm_snap.stop();
+  pm_snap.start();
+  PersistentMapTypeInt pm_snapshot(pm);
+  pm_snap.stop();
+
+  hm_update.start();
+  for (int i=0; i<speed_updates; ++i)
+    hm.put(keys[i],-1);
+  hm_update.stop();
+  pm_update.start();
+  for (int i=0; i<speed_updates; ++i)
+    pm = pm.put(keys[i],-1);
+  pm_update.stop();
+
+  for (int i=0; i<speed_updates; i+=97) {
+    ASSERT_EQ(keys[i],hm_snapshot[keys[i]]);
+    ASSERT_EQ(keys[i],pm_snapshot[keys[i]]);
+    ASSERT_EQ(-1,pm[keys[i]]);
+  }
+  ASSERT_EQ(hm.size(),pm.size());
+  std::cout << "speed_snapshot_update (" << speed_size << " int entries; seconds: HashMap / PersistentHashMap)" << std::endl;
+  std::cout << "  build    = " << hm_build.read()  << " / " << pm_build.read() << std::endl;
+  std::cout << "  snapshot = " << hm_snap.read()   << " / " << pm_snap.read()  << std::endl;
+  std::cout << "  " << speed_updates << " updates = " << hm_update.read() << " / " << pm_update.read() << std::endl;
+}
@@ -0,0 +1,178 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>                 // std::random_shuffle
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "hash_map.hpp"
+#include "hash_set.hpp"
+#include "hashers.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+typedef ics::HashMap<int,int,ics::hash_integer<int>,ics::HeapNodeAllocator,ics::RecomputeHash,ics::HashCounters> MapTypeCounted;
+typedef ics::HashSet<int,ics::hash_integer<int>,ics::HeapNodeAllocator,ics::HashCounters>                          SetTypeCounted;
+
+static const int test_size  = 100000;   //shrink_threshold
+static const int speed_size = 1000000;  //speed_iterate_after_erase (keys put, then all but speed_kept erased)
+static const int speed_kept = 1000;     //speed_iterate_after_erase
+static const int speed_laps = 100;      //speed_iterate_after_erase (iterations over the survivors)
+
+
+class ReserveShrinkTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+
+TEST_F(ReserveShrinkTest, reserve) {
+  MapTypeCounted m;
+  SetTypeCounted s(0.5);
+  m.reserve(1000);
+  s.reserve(1000);
+  ASSERT_EQ(1024,m.statistics().bins);
+  ASSERT_EQ(2048,s.statistics().bins);
+  m.reset_statistics();
+  s.reset_statistics();
+  for (int i=0; i<1000; ++i) {
+    m.put(i,i);
+    s.insert(i);
+  }
+  ASSERT_EQ(0,m.statistics().resizes);
+  ASSERT_EQ(0,s.statistics().resizes);
+
+  m.reserve(10);                      //never shrinks
+  s.reserve(10);
+  ASSERT_EQ(1024,m.statistics().bins);
+  ASSERT_EQ(2048,s.statistics().bins);
+}
+
+
+TEST_F(ReserveShrinkTest, rehash_and_shrink_to_fit) {
+  MapTypeCounted m;
+  SetTypeCounted s;
+  for (int i=0; i<1000; ++i) {
+    m.put(i,-i);
+    s.insert(i);
+  }
+  m.rehash(5000);
+  s.rehash(5000);
+  ASSERT_EQ(8192,m.statistics().bins);
+  ASSERT_EQ(8192,s.statistics().bins);
+
+  m.rehash(1);                        //still enough bins for every key
+  s.rehash(1);
+  ASSERT_EQ(1024,m.statistics().bins);
+  ASSERT_EQ(1024,s.statistics().bins);
+
+  for (int i=10; i<1000; ++i) {
+    m.erase(i);
+    s.erase(i);
+  }
+  ASSERT_EQ(1024,m.statistics().bins); //no shrink threshold: erase never shrinks
+  m.shrink_to_fit();
+  s.shrink_to_fit();
+  ASSERT_EQ(16,m.statistics().bins);
+  ASSERT_EQ(16,s.statistics().bins);
+  for (int i=0; i<1000; ++i) {
+    ASSERT_EQ(i < 10,m.has_key(i));
+    ASSERT_EQ(i < 10,s.contains(i));
+  }
+  ASSERT_EQ(-9,m[9]);
+
+  ics::HashMap<int,int,ics::hash_integer<int>> migrating;  //shrink_to_fit mid incremental rehash
+  migrating.set_rehash_step(1);
+  for (int i=0; i<1030; ++i)
+    migrating.put(i,i);
+  auto i = migrating.begin();
+  migrating.shrink_to_fit();          //already 2048 bins, but the rehash is finished: nodes moved
+  ASSERT_EQ(2048,migrating.statistics().bins);
+  ASSERT_THROW(*i,ics::ConcurrentModificationError);
+  for (int i=0; i<1030; ++i)
+    ASSERT_EQ(i,migrating[i]);
+}
+
+
+TEST_F(ReserveShrinkTest, shrink_threshold) {
+  MapTypeCounted m;
+  SetTypeCounted s;
+  m.set_shrink_threshold(0.125);
+  s.set_shrink_threshold(0.125);
+  for (int i=0; i<test_size; ++i) {
+    m.put(i,i);
+    s.insert(i);
+  }
+  for (int i=0; i<test_size-100; ++i) {
+    m.erase(i);
+    s.erase(i);
+    if (i%997 == 0) {
+      ASSERT_GE(m.size(),m.statistics().bins/8);
+    }
+  }
+  ASSERT_LE(m.statistics().bins,1024);
+  ASSERT_LE(s.statistics().bins,1024);
+  for (int i=test_size-100; i<test_size; ++i) {
+    ASSERT_EQ(i,m[i]);
+    ASSERT_TRUE(s.contains(i));
+  }
+
+  m.clear();
+  s.clear();
+  ASSERT_EQ(1,m.statistics().bins);
+  ASSERT_EQ(1,s.statistics().bins);
+}
+
+
+//low_water is clamped to load_threshold/4: putting and erasing one key at a size just past a
+//  resize does not resize on every call
+TEST_F(ReserveShrinkTest, no_thrashing) {
+  MapTypeCounted m;
+  m.set_shrink_threshold(0.9);
+  for (int i=0; i<1025; ++i)
+    m.put(i,i);
+  m.reset_statistics();
+  for (int i=0; i<1000; ++i) {
+    m.erase(1024);
+    m.put(1024,1024);
+  }
+  ASSERT_EQ(0,m.statistics().resizes);
+}
+
+
+//Iterating over speed_kept keys left in the bins of speed_size: without shrinking, each ++
+//  walks past about speed_size/speed_kept empty bins
+TEST_F(ReserveShrinkTest, speed_iterate_after_erase) {
+  std::vector<int> keys;
+  for (int i=0; i<speed_size; ++i)
+    keys.push_back(i);
+  std::random_shuffle(keys.begin(),keys.end());
+
+  std::cout << "speed_iterate_after_erase (" << speed_size << " keys put, all but " << speed_kept
+            << " erased; " << speed_laps << " iterations, seconds)" << std::endl;
+  long checksum = 0;
+  for (int how=0; how<3; ++how) {
+    ics::HashMap<int,int,ics::hash_integer<int>> m;
+    if (how == 2)
+      m.set_shrink_threshold(0.125);
+    for (int k : keys)
+      m.put(k,k);
+    ics::Stopwatch erase_time, iterate_time;
+    erase_time.start();
+    for (int i=speed_kept; i<speed_size; ++i)
+      m.erase(keys[i]);
+    if (how == 1)
+      m.shrink_to_fit();
+    erase_time.stop();
+
+    iterate_time.start();
+    for (int lap=0; lap<speed_laps; ++lap)
+      for (const auto& kv : m)
+        checksum += kv.second;
+    iterate_time.stop();
+    ASSERT_EQ(speed_kept,m.size());
+    std::cout << "  " << (how == 0 ? "no shrink    " : how == 1 ? "shrink_to_fit" : "threshold 1/8")
+              << ": erase = " << erase_time.read() << ", iterate = " << iterate_time.read()
+              << " (bins = " << m.statistics().bins << ")" << std::endl;
+  }
+  ASSERT_NE(0,checksum);
+}
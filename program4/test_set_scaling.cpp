@@ -0,0 +1,74 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>                 // std::random_shuffle
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "hash_set.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static int hash_int (const int& s) {std::hash<int> str_hash; return str_hash(s);}
+
+typedef ics::HashSet<int,hash_int> SetTypeInt;
+
+//Each set size is 10x the previous one; every size holds total_elements (split among
+//  total_elements/size sets) so the memory footprint, and therefore the cache behavior, is the same
+static const int    scaling_sizes[] = {100, 1000, 10000, 100000};
+static const int    total_elements  = 100000;
+static const int    lookups         = 1000000;  //contains calls timed at each size (half hits, half misses)
+static const int    repeats         = 3;        //best of repeats is reported, to filter scheduler noise
+static const double max_slowdown    = 3.0;      //allowed (largest size)/(smallest size) time per contains;
+                                                //  a set that scans every bin is ~1000x slower here
+
+
+class SetScalingTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+//Returns the best time (seconds) over repeats for lookups contains calls, spread round robin
+//  over total_elements/size sets of size elements each
+static double time_contains(int size, int& checksum) {
+  int sets = total_elements/size;
+  std::vector<int> in;
+  for (int i=0; i<total_elements; ++i)
+    in.push_back(2*i);
+  std::random_shuffle(in.begin(),in.end());
+
+  std::vector<SetTypeInt> s(sets);
+  for (int i=0; i<total_elements; ++i)
+    s[i % sets].insert(in[i]);
+
+  double best = 0.;
+  for (int r=0; r<repeats; ++r) {
+    ics::Stopwatch sw;
+    sw.start();
+    for (int i=0; i<lookups; i+=2) {
+      int j = (i/2) % total_elements;
+      checksum += s[j % sets].contains(in[j]);     //hit
+      checksum += s[j % sets].contains(in[j]+1);   //miss (odd values are never inserted)
+    }
+    sw.stop();
+    if (r == 0 || sw.read() < best)
+      best = sw.read();
+  }
+  return best;
+}
+
+
+TEST_F(SetScalingTest, contains_independent_of_size) {
+  int checksum = 0;
+  std::cout << "contains_independent_of_size (" << lookups << " contains at each size, best of " << repeats << ")" << std::endl;
+  double smallest = 0.;
+  for (int size : scaling_sizes) {
+    double t = time_contains(size,checksum);
+    if (size == scaling_sizes[0])
+      smallest = t;
+    std::cout << "  size = " << size << ": " << t << " seconds, " << 1e9*t/lookups
+              << " ns/contains, slowdown = " << t/smallest << std::endl;
+    //Checked at each size, so a regression fails at the first 10x step instead of grinding on
+    ASSERT_LT(t/smallest,max_slowdown) << "HashSet::contains is no longer independent of the set's size";
+  }
+  ASSERT_EQ(repeats*(lookups/2)*int(sizeof(scaling_sizes)/sizeof(int)),checksum);
+}
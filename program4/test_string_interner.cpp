@@ -0,0 +1,110 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "gtest/gtest.h"
+#include "string_interner.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static const int test_size = 100000;  //many_names
+
+
+class StringInternerTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+static std::string interner_name (int i) {return "name-" + std::to_string(i) + "-of-many";}
+
+
+
+TEST_F(StringInternerTest, intern_find_name) {
+  ics::StringInterner si;
+  ASSERT_TRUE(si.empty());
+  ASSERT_EQ(ics::StringInterner::no_symbol,si.find("a"));
+  ASSERT_EQ(0u,si.intern("a"));
+  ASSERT_EQ(1u,si.intern("bc"));
+  ASSERT_EQ(0u,si.intern(std::string("a")));
+  ASSERT_EQ(2u,si.intern(""));
+  ASSERT_EQ(3,si.size());
+  ASSERT_TRUE(si.has("bc"));
+  ASSERT_FALSE(si.has("b"));
+  ASSERT_EQ(1u,si.find("bc"));
+  ASSERT_EQ("bc",si.name(1));
+  ASSERT_EQ("",si.name(2));
+  ASSERT_THROW(si.name(3),ics::KeyError);
+
+  si.clear();
+  ASSERT_TRUE(si.empty());
+  ASSERT_FALSE(si.has("a"));
+  ASSERT_EQ(0u,si.intern("bc"));
+}
+
+
+//The arena never moves a name: views taken early stay valid as chunks (and the table) are added
+TEST_F(StringInternerTest, many_names) {
+  ics::StringInterner si(256);
+  std::string_view first = si.name(si.intern(interner_name(0)));
+  for (int i=0; i<test_size; ++i)
+    ASSERT_EQ(ics::Symbol(i),si.intern(interner_name(i)));
+  for (int i=0; i<test_size; ++i) {
+    ASSERT_EQ(ics::Symbol(i),si.find(interner_name(i)));
+    ASSERT_EQ(interner_name(i),si.name(i));
+  }
+  ASSERT_EQ(interner_name(0),first);
+  ASSERT_EQ(first.data(),si.name(0).data());
+  ASSERT_FALSE(si.has(interner_name(test_size)));
+
+  std::string big(1000,'b');           //Longer than a chunk: a chunk of its own
+  ics::Symbol b = si.intern(big);
+  ics::Symbol after = si.intern("after");
+  ASSERT_EQ(big,si.name(b));
+  ASSERT_EQ("after",si.name(after));
+  ASSERT_EQ(interner_name(test_size-1),si.name(test_size-1));
+}
+
+
+TEST_F(StringInternerTest, copy_move) {
+  ics::StringInterner si(8);
+  for (std::string n : {"x","longer than eight","y"})
+    si.intern(n);
+  ics::StringInterner copy(si);
+  ASSERT_EQ(3,copy.size());
+  for (ics::Symbol s=0; s<3; ++s) {
+    ASSERT_EQ(si.name(s),copy.name(s));
+    ASSERT_NE(si.name(s).data(),copy.name(s).data());   //Its own arena
+  }
+
+  ics::StringInterner moved(std::move(copy));
+  ASSERT_TRUE(copy.empty());
+  ASSERT_EQ(2u,moved.find("y"));
+  copy = moved;
+  ASSERT_EQ(1u,copy.find("longer than eight"));
+  copy = ics::StringInterner();
+  ASSERT_TRUE(copy.empty());
+}
+
+
+//Interned keys: a SymbolMap/SymbolEdgeMap compares and hashes keys as integers
+TEST_F(StringInternerTest, symbol_containers) {
+  ics::StringInterner         si;
+  ics::SymbolMap<int>         degree;
+  ics::SymbolEdgeMap<int>     distance;
+  ics::SymbolSet              seen;
+  const char* routes[][2] = {{"Irvine","Boston"},{"Boston","Chicago"},{"Irvine","Chicago"},{"Chicago","Irvine"}};
+  for (auto& r : routes) {
+    ics::Symbol from = si.intern(r[0]), to = si.intern(r[1]);
+    ++degree[from];
+    distance[ics::SymbolEdge(from,to)] = int(si.name(from).size() + si.name(to).size());
+    seen.insert(from);
+    seen.insert(to);
+  }
+  ASSERT_EQ(3,si.size());
+  ASSERT_EQ(3,seen.size());
+  ASSERT_EQ(2,degree[si.find("Irvine")]);
+  ASSERT_EQ(13,distance[ics::SymbolEdge(si.find("Chicago"),si.find("Irvine"))]);
+  ASSERT_FALSE(distance.has_key(ics::SymbolEdge(si.find("Boston"),si.find("Irvine"))));
+  ASSERT_NE(ics::hash_symbol_edge(ics::SymbolEdge(1,2)),ics::hash_symbol_edge(ics::SymbolEdge(2,1)));
+}
@@ -0,0 +1,301 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>                 // std::random_shuffle
+#include <cstdint>
+#include "ics46goody.hpp"
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "array_queue.hpp"           // must leave in for use in iterator_erase
+#include "hash_set.hpp"
+#include "swiss_hash_set.hpp"
+#include "hashers.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+static int hash_string (const std::string& s) {std::hash<std::string> str_hash; return str_hash(s);}
+static int hash_int    (const int& s)         {std::hash<int> str_hash; return str_hash(s);}
+static int hash_bad    (const int& s)         {return s % 3;}  //Everything in a few groups on purpose
+static std::uint64_t hash_int64 (const std::int64_t& i) {return i;}  //all 64 bits; elements differing only in their high 32 bits
+
+typedef ics::SwissHashSet<std::string,hash_string> SwissSetTypeStr;
+typedef ics::SwissHashSet<int,hash_int>            SwissSetTypeInt;
+
+static const int test_size  = 10000;   //hashers_64_bit, large_scale
+static const int speed_size = 1000000; //speed_* (elements in each set)
+
+
+class SwissSetTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+static void load(SwissSetTypeStr& s, std::string elements) {
+  for (char c : elements)
+    s.insert(std::string(1,c));
+}
+
+
+static ::testing::AssertionResult has_all(const SwissSetTypeStr& s, std::string elements) {
+  for (char c : elements)
+    if (!s.contains(std::string(1,c)))
+      return ::testing::AssertionFailure() << "element " << c;
+  return ::testing::AssertionSuccess();
+}
+
+
+
+TEST_F(SwissSetTest, empty) {
+  SwissSetTypeStr s;
+  ASSERT_TRUE(s.empty());
+  ASSERT_EQ(0,s.size());
+  ASSERT_FALSE(s.contains("a"));
+}
+
+
+TEST_F(SwissSetTest, insert_erase) {
+  SwissSetTypeStr s;
+  ASSERT_EQ(1,s.insert("d"));
+  ASSERT_EQ(1,s.insert("a"));
+  ASSERT_EQ(0,s.insert("d"));
+  ASSERT_EQ(2,s.size());
+  ASSERT_TRUE(has_all(s,"da"));
+  ASSERT_FALSE(s.contains("x"));
+
+  ASSERT_EQ(1,s.erase("d"));
+  ASSERT_EQ(0,s.erase("d"));
+  ASSERT_EQ(1,s.size());
+  ASSERT_FALSE(s.contains("d"));
+
+  load(s,"abcdefghijklmnopqrstuvwxyz");
+  ASSERT_EQ(26,s.size());
+  ASSERT_TRUE(has_all(s,"abcdefghijklmnopqrstuvwxyz"));
+  s.clear();
+  ASSERT_TRUE(s.empty());
+  ASSERT_FALSE(s.contains("a"));
+}
+
+
+TEST_F(SwissSetTest, collisions) {
+  //Few distinct hash values: groups fill up, so erase must leave DELETED tags
+  ics::SwissHashSet<int,hash_bad> s;
+  for (int i=0; i<500; ++i)
+    ASSERT_EQ(1,s.insert(i));
+  for (int i=0; i<500; i+=2)
+    ASSERT_EQ(1,s.erase(i));
+  for (int i=0; i<500; ++i)
+    ASSERT_EQ(i%2 == 1, s.contains(i));
+  for (int i=0; i<500; i+=2)
+    ASSERT_EQ(1,s.insert(i));
+  ASSERT_EQ(500,s.size());
+}
+
+
+TEST_F(SwissSetTest, bulk) {
+  SwissSetTypeStr s, t;
+  load(s,"abcde");
+  load(t,"cdefg");
+  ASSERT_TRUE(s.contains_all(SwissSetTypeStr({"a","e"})));
+  ASSERT_FALSE(s.contains_all(t));
+
+  ASSERT_EQ(2,s.insert_all(t));
+  ASSERT_EQ(7,s.size());
+  ASSERT_EQ(2,s.erase_all(SwissSetTypeStr({"a","b","z"})));
+  ASSERT_EQ(1,s.retain_all(SwissSetTypeStr({"c","d","e","f"})));
+  ASSERT_TRUE(has_all(s,"cdef"));
+  ASSERT_EQ(4,s.size());
+}
+
+
+TEST_F(SwissSetTest, operator_rel) {
+  SwissSetTypeStr s1, s2, s3;
+  load(s1,"abc");
+  load(s2,"cba");
+  load(s3,"abcd");
+  ASSERT_EQ(s1,s2);
+  ASSERT_NE(s1,s3);
+  ASSERT_TRUE(s1 <= s2);
+  ASSERT_FALSE(s1 < s2);
+  ASSERT_TRUE(s1 < s3);
+  ASSERT_TRUE(s3 > s1);
+  ASSERT_TRUE(s3 >= s1);
+  ASSERT_FALSE(s3 <= s1);
+
+  SwissSetTypeStr s4(s3), s5;
+  s5 = s3;
+  ASSERT_EQ(s3,s4);
+  ASSERT_EQ(s3,s5);
+
+  std::ostringstream out;
+  SwissSetTypeStr s6({"a"});
+  out << s6;
+  ASSERT_EQ("set[a]",out.str());
+}
+
+
+TEST_F(SwissSetTest, constructors) {
+  ics::ArrayQueue<std::string> q;
+  q.enqueue("a");
+  q.enqueue("b");
+  SwissSetTypeStr s1(q), s2({"b","a"}), s3(s1,0.5), s4(1000);
+  ASSERT_EQ(s1,s2);
+  ASSERT_EQ(s1,s3);
+  ASSERT_TRUE(s4.empty());
+
+  ics::SwissHashSet<std::string> none(0.875, hash_string);
+  none.insert("x");
+  ASSERT_TRUE(none.contains("x"));
+  ASSERT_THROW((ics::SwissHashSet<std::string>()),ics::TemplateFunctionError);
+}
+
+
+TEST_F(SwissSetTest, iterator) {
+  SwissSetTypeStr s, s_iter;
+  load(s,"fcijbdegah");
+  for (const std::string& x : s)
+    s_iter.insert(x);
+  ASSERT_EQ(s,s_iter);
+
+  ics::ArrayQueue<std::string> erased;
+  SwissSetTypeStr::Iterator it(s.begin());
+  erased.enqueue(it.erase());
+  ASSERT_THROW(it.erase(),ics::CannotEraseError);
+  ASSERT_THROW(*it,ics::IteratorPositionIllegal);
+  ++it;
+  ++it;
+  erased.enqueue(it.erase());
+  ASSERT_EQ(8,s.size());
+  for (const std::string& x : erased)
+    ASSERT_FALSE(s.contains(x));
+
+  for (SwissSetTypeStr::Iterator i(s.begin()); i != s.end(); i++) {
+    std::string x = *i;
+    ASSERT_EQ(x,i.erase());
+  }
+  ASSERT_TRUE(s.empty());
+
+  SwissSetTypeStr::Iterator j(s_iter.begin());
+  s_iter.erase("a");
+  ASSERT_THROW(++j,ics::ConcurrentModificationError);
+  ASSERT_THROW(*j,ics::ConcurrentModificationError);
+}
+
+
+//64-bit hashers (hashers.hpp) instantiate SwissHashSet as they do HashSet, so either can be swapped in
+TEST_F(SwissSetTest, hashers_64_bit) {
+  ics::SwissHashSet<std::string,ics::hash_string> s;
+  ics::HashSet<std::string,ics::hash_string>      chained;
+  for (int i=0; i<test_size; ++i) {
+    s.insert(std::to_string(i));
+    chained.insert(std::to_string(i));
+  }
+  ASSERT_EQ(chained.size(),s.size());
+  for (const std::string& e : chained)
+    ASSERT_TRUE(s.contains(e));
+
+  ics::SwissHashSet<std::int64_t,hash_int64> high;
+  for (int i=0; i<test_size; ++i)
+    high.insert(std::int64_t(i) << 32);
+  for (int i=0; i<test_size; i+=2)
+    ASSERT_EQ(1,high.erase(std::int64_t(i) << 32));
+  ASSERT_EQ(test_size/2,high.size());
+  for (int i=0; i<test_size; ++i)
+    ASSERT_EQ(i%2 == 1,high.contains(std::int64_t(i) << 32));
+
+  ics::SwissHashSet<std::string,ics::undefinedhash<std::string,std::uint64_t>> none(0.875,ics::hash_string);
+  none.insert("x");
+  ASSERT_TRUE(none.contains("x"));
+}
+
+
+TEST_F(SwissSetTest, large_scale) {
+  SwissSetTypeInt ls;
+
+  std::vector<int> values;
+  for (int i=0; i<test_size; ++i)
+    values.push_back(i);
+  std::random_shuffle(values.begin(),values.end());
+
+  for (int test=1; test<=5; ++test) {
+    int inserted = 0;
+    int erased   = 0;
+    while (erased != test_size) {
+      int to_insert = ics::rand_range(0,test_size-inserted);
+      for (int i=0; i <to_insert; ++i) {
+        ASSERT_EQ(1,ls.insert(values[inserted]));
+        ASSERT_TRUE(ls.contains(values[inserted]));
+        ++inserted;
+      }
+
+      int to_erase = ics::rand_range(0,inserted-erased);
+      for (int i=0; i <to_erase; ++i) {
+        ASSERT_EQ(1,ls.erase(values[erased]));
+        ASSERT_FALSE(ls.contains(values[erased]));
+        ++erased;
+      }
+    }
+  }
+  ASSERT_TRUE(ls.empty());
+}
+
+
+//Time speed_size inserts, then speed_size hit and speed_size miss contains
+template<class SetType, class E>
+void time_set(const char* name, const std::vector<E>& in, const std::vector<E>& out, int& checksum) {
+  ics::Stopwatch s_insert, s_hit, s_miss;
+  SetType s;
+
+  s_insert.start();
+  for (const E& e : in)
+    s.insert(e);
+  s_insert.stop();
+
+  s_hit.start();
+  for (const E& e : in)
+    checksum += s.contains(e);
+  s_hit.stop();
+
+  s_miss.start();
+  for (const E& e : out)
+    checksum += s.contains(e);
+  s_miss.stop();
+
+  std::cout << "  " << name << ": insert = " << s_insert.read() << ", hit contains = " << s_hit.read()
+            << ", miss contains = " << s_miss.read() << std::endl;
+}
+
+
+TEST_F(SwissSetTest, speed_int) {
+  std::vector<int> in, out;
+  for (int i=0; i<speed_size; ++i) {
+    in.push_back(2*i);
+    out.push_back(2*i+1);
+  }
+  std::random_shuffle(in.begin(),in.end());
+
+  int checksum = 0;
+  std::cout << "speed_int (" << speed_size << " int elements, seconds)" << std::endl;
+  time_set<ics::HashSet<int,hash_int>>     ("HashSet     ",in,out,checksum);
+  time_set<ics::SwissHashSet<int,hash_int>>("SwissHashSet",in,out,checksum);
+  ASSERT_EQ(2*speed_size,checksum);
+}
+
+
+TEST_F(SwissSetTest, speed_string) {
+  std::vector<std::string> in, out;
+  for (int i=0; i<speed_size; ++i) {
+    std::ostringstream w;
+    w << "word" << i << "-of-the-corpus";
+    in.push_back(w.str());
+    out.push_back(w.str()+"?");
+  }
+  std::random_shuffle(in.begin(),in.end());
+
+  int checksum = 0;
+  std::cout << "speed_string (" << speed_size << " string elements, seconds)" << std::endl;
+  time_set<ics::HashSet<std::string,hash_string>>     ("HashSet     ",in,out,checksum);
+  time_set<ics::SwissHashSet<std::string,hash_string>>("SwissHashSet",in,out,checksum);
+  ASSERT_EQ(2*speed_size,checksum);
+}
@@ -0,0 +1,174 @@
+#include <iostream>
+#include <string>
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "hash_map.hpp"
+#include "hash_set.hpp"
+#include "heap_priority_queue.hpp"
+#include "hashers.hpp"
+
+//static: every test_*.cpp is linked into the same executable
+typedef ics::HashMap<int,int,ics::hash_integer<int>>                                                       CheckedMap;
+typedef ics::HashMap<int,int,ics::hash_integer<int>,ics::HeapNodeAllocator,ics::RecomputeHash,
+                     ics::NoHashCounters,ics::UncheckedIteration>                                         UncheckedMap;
+typedef ics::HashSet<int,ics::hash_integer<int>>                                                           CheckedSet;
+typedef ics::HashSet<int,ics::hash_integer<int>,ics::HeapNodeAllocator,ics::NoHashCounters,ics::UncheckedIteration> UncheckedSet;
+
+static const int test_size  = 10000;     //for_each_visits_all
+static const int speed_size = 10000000;  //speed_scan (entries in the map)
+static const int speed_laps = 5;         //speed_scan (scans of the map)
+
+
+class UncheckedIterationTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+static bool iteration_gt (const int& a, const int& b) {return a > b;}
+
+
+
+TEST_F(UncheckedIterationTest, for_each_visits_all) {
+  CheckedMap   m;
+  UncheckedMap um;
+  CheckedSet   s;
+  UncheckedSet us;
+  ics::HeapPriorityQueue<int,iteration_gt>                          pq;
+  ics::HeapPriorityQueue<int,iteration_gt,ics::UncheckedIteration> upq;
+  long expected = 0;
+  for (int i=0; i<test_size; ++i) {
+    m.put(i,2*i);
+    um.put(i,2*i);
+    s.insert(i);
+    us.insert(i);
+    pq.enqueue(i);
+    upq.enqueue(i);
+    expected += i;
+  }
+
+  long keys = 0, values = 0, ukeys = 0, uvalues = 0;
+  int count = 0;
+  m.for_each ([&] (const CheckedMap::Entry& e)   {keys += e.first; values += e.second; ++count;});
+  um.for_each([&] (const UncheckedMap::Entry& e) {ukeys += e.first; uvalues += e.second;});
+  ASSERT_EQ(test_size,count);
+  ASSERT_EQ(expected,keys);
+  ASSERT_EQ(2*expected,values);
+  ASSERT_EQ(expected,ukeys);
+  ASSERT_EQ(2*expected,uvalues);
+
+  long set_sum = 0, uset_sum = 0, pq_sum = 0, upq_sum = 0;
+  s.for_each  ([&] (const int& i) {set_sum += i;});
+  us.for_each ([&] (const int& i) {uset_sum += i;});
+  pq.for_each ([&] (const int& i) {pq_sum += i;});
+  upq.for_each([&] (const int& i) {upq_sum += i;});
+  ASSERT_EQ(expected,set_sum);
+  ASSERT_EQ(expected,uset_sum);
+  ASSERT_EQ(expected,pq_sum);
+  ASSERT_EQ(expected,upq_sum);
+
+  long iterated = 0;                   //Unchecked iterators visit the same entries
+  for (const auto& kv : um)
+    iterated += kv.first;
+  ASSERT_EQ(expected,iterated);
+
+  CheckedMap empty;
+  empty.for_each([&] (const CheckedMap::Entry&) {++count;});
+  ASSERT_EQ(test_size,count);
+}
+
+
+TEST_F(UncheckedIterationTest, checked_concurrent_modification) {
+  CheckedMap m;
+  CheckedSet s;
+  ics::HeapPriorityQueue<int,iteration_gt> pq;
+  for (int i=0; i<10; ++i) {
+    m.put(i,i);
+    s.insert(i);
+    pq.enqueue(i);
+  }
+  ASSERT_THROW(m.for_each ([&] (const CheckedMap::Entry& e) {m.put(e.first,0);}),ics::ConcurrentModificationError);
+  ASSERT_THROW(s.for_each ([&] (const int& i) {s.erase(i);}),ics::ConcurrentModificationError);
+  ASSERT_THROW(pq.for_each([&] (const int& i) {pq.enqueue(i);}),ics::ConcurrentModificationError);
+
+  auto i = m.begin();
+  m.put(i->first,-1);
+  ASSERT_THROW(*i,ics::ConcurrentModificationError);
+}
+
+
+//An unchecked iterator is not invalidated by a modification that moves no entries (here, updating a
+//  value); the caller is responsible for not using one after a modification that does
+TEST_F(UncheckedIterationTest, unchecked_no_concurrent_modification) {
+  UncheckedMap m;
+  ics::HeapPriorityQueue<int,iteration_gt,ics::UncheckedIteration> pq;
+  for (int i=0; i<10; ++i) {
+    m.put(i,i);
+    pq.enqueue(i);
+  }
+  auto i = m.begin();
+  int key = i->first;
+  m.put(key,-1);
+  ASSERT_EQ(key,(*i).first);
+  ASSERT_EQ(-1,i->second);
+  ++i;
+  ASSERT_NE(m.end(),i);
+
+  int visited = 0;
+  m.for_each([&] (const UncheckedMap::Entry& e) {m.put(e.first,e.second+1); ++visited;});
+  ASSERT_EQ(10,visited);
+  ASSERT_EQ(0,m[key]);
+
+  auto p = pq.begin();
+  pq.enqueue(100);                     //room in the array: the heap is not reallocated
+  ASSERT_NO_THROW(*p);
+}
+
+
+//Full-table scans: checked iterator, unchecked iterator, for_each. Each map is built, scanned and
+//  destroyed in turn so only one 10M-entry map is alive at a time
+template<class Map, class Scan>
+static void scan_map(const char* label, Scan scan, long expected) {
+  Map m;
+  m.reserve(speed_size);
+  for (int i=0; i<speed_size; ++i)
+    m.put(i,i);
+
+  long checksum = 0;
+  ics::Stopwatch scan_time;
+  scan_time.start();
+  for (int lap=0; lap<speed_laps; ++lap)
+    checksum += scan(m);
+  scan_time.stop();
+  ASSERT_EQ(speed_laps*expected,checksum);
+  std::cout << "  " << label << ": " << scan_time.read() << std::endl;
+}
+
+
+TEST_F(UncheckedIterationTest, speed_scan) {
+  long expected = long(speed_size)*(speed_size-1)/2;
+  std::cout << "speed_scan (" << speed_size << " entries; " << speed_laps << " scans, seconds)" << std::endl;
+  scan_map<CheckedMap>("checked iterator  ", [] (const CheckedMap& m) {
+    long sum = 0;
+    for (const auto& kv : m)
+      sum += kv.second;
+    return sum;
+  }, expected);
+  scan_map<UncheckedMap>("unchecked iterator", [] (const UncheckedMap& m) {
+    long sum = 0;
+    for (const auto& kv : m)
+      sum += kv.second;
+    return sum;
+  }, expected);
+  scan_map<CheckedMap>("checked for_each  ", [] (const CheckedMap& m) {
+    long sum = 0;
+    m.for_each([&] (const CheckedMap::Entry& e) {sum += e.second;});
+    return sum;
+  }, expected);
+  scan_map<UncheckedMap>("unchecked for_each", [] (const UncheckedMap& m) {
+    long sum = 0;
+    m.for_each([&] (const UncheckedMap::Entry& e) {sum += e.second;});
+    return sum;
+  }, expected);
+}
@@ -13,17 +13,17 @@
 //#include "array_map.hpp"
 //#include "hash_map.hpp"
 //#include "hash_set.hpp"
+//#include "hashers.hpp"                   //ics::hash_string, ics::hash_string_queue
 //
-//int hash_string (const std::string& s){std::hash<std::string> str_hash; return str_hash(s);}
 //
 //typedef ics::ArrayQueue<std::string>         WordQueue;
 //typedef ics::ArraySet<std::string>           FollowSet;
-////typedef ics::HashSet<std::string, hash_string> FollowSet;
+////typedef ics::HashSet<std::string, ics::hash_string> FollowSet;
 //typedef ics::pair<WordQueue,FollowSet>       CorpusEntry;
 //typedef ics::HeapPriorityQueue<CorpusEntry> CorpusPQ;
 ////typedef ics::ArrayPriorityQueue<CorpusEntry> CorpusPQ;
 ////typedef ics::ArrayMap<WordQueue,FollowSet>   Corpus;
-//typedef ics::HashMap<WordQueue, FollowSet> Corpus;
+//typedef ics::HashMap<WordQueue, FollowSet, ics::hash_string_queue> Corpus;
 //
 //
 //
@@ -68,18 +68,8 @@
 ////  Corpus (Map) of each sequence (Queue) of os (Order-Statistic) words
 ////  associated with the Set of all words that follow them somewhere in the
 ////  file.
-//int hashfunct(const WordQueue& wq)
-//{
-//    std::hash<std::string> str_hash;
-//    int answer = 0;
-//    for(auto w : wq)
-//        answer += str_hash(w);
-//    return answer;
-//}
-//
 //Corpus read_corpus(int os, std::ifstream &file) {
-//    //std::hash<std::string> hashfunc;
-//  Corpus corpus(1,hashfunct);
+//  Corpus corpus;
 //  WordQueue word_queue;
 //
 //  std::string line;
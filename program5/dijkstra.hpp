@@ -10,6 +10,7 @@
 #include "array_queue.hpp"
 #include "array_stack.hpp"
 #include "heap_priority_queue.hpp"
+#include "indexed_priority_queue.hpp"
 #include "hash_graph.hpp"
 
 
@@ -38,48 +39,55 @@ class Info {
   };
 
 
-  bool gt_info(const Info &a, const Info &b) { return a.cost < b.cost; }
+  inline bool gt_info(const Info &a, const Info &b) { return a.cost < b.cost; }
 
   typedef ics::HashGraph<int> DistGraph;
   typedef ics::HeapPriorityQueue<Info, gt_info> CostPQ;
+  typedef ics::IndexedHeapPriorityQueue<Info, gt_info> CostIPQ;
   typedef ics::HashMap<std::string, Info, DistGraph::hash_str> CostMap;
+  typedef ics::HashMap<std::string, CostIPQ::Handle, DistGraph::hash_str> HandleMap;
   typedef ics::pair<std::string, Info> CostMapEntry;
 
 
 //Return the final_map as specified in the lecture-node description of
 //  extended Dijkstra algorithm
-  CostMap extended_dijkstra(const DistGraph &g, std::string start_node) {
-        CostMap info_map;
+//Every node's Info is enqueued once; a cheaper path to a node lowers its cost in place
+//  (decrease_key through its handle), so no stale Infos are enqueued or dequeued
+//If start_node is not in g, throw a GraphError exception (as g.out_nodes(start_node) does)
+  inline CostMap extended_dijkstra(const DistGraph &g, std::string start_node) {
+        if(!g.has_node(start_node))
+            throw GraphError("HashGraph::node not in graph");
         CostMap answer_map;
+        CostIPQ info_pq;
+        HandleMap handles;                               //Nodes not yet in answer_map: their Infos' handles
         for(auto val : g.all_nodes())
-            info_map.put(val.first, Info(val.first));
-        Info snode;
-        snode.node = start_node;
-        snode.cost = 0;
-        info_map.put(snode.node, snode);
-        CostPQ info_pq;
-        for(auto val : info_map)
-            info_pq.enqueue(val.second);
-        while(info_map.size())
+        {
+            Info info(val.first);
+            if(val.first == start_node)
+                info.cost = 0;
+            handles.put(val.first, info_pq.enqueue(info));
+        }
+        while(!info_pq.empty())
         {
             auto val = info_pq.dequeue();
             if(val.cost == std::numeric_limits<int>::max())
                 break;
-            if(answer_map.has_key(val.node))
-                continue;
-            answer_map.put(val.node,info_map.erase(val.node));
-            for(auto d : g.out_nodes(val.node))
+            handles.erase(val.node);
+            for(const std::string& d : g.out_nodes(val.node))    //edge_value probes by view: no strings built
             {
-                Info dnfo = info_map[d];
-                if(dnfo.cost > g.edge_value(val.node, d) + val.cost)
+                if(!handles.has_key(d))
+                    continue;
+                int cost = g.edge_value(val.node, d) + val.cost;
+                CostIPQ::Handle h = handles[d];
+                if(info_pq.value(h).cost > cost)
                 {
                     Info temp (d);
-                    temp.cost = g.edge_value(val.node, d) + val.cost;
+                    temp.cost = cost;
                     temp.from = val.node;
-                    info_map.put(d,temp);
-                    info_pq.enqueue(temp);
+                    info_pq.decrease_key(h, temp);
                 }
             }
+            answer_map.put(val.node, val);
         }
         return answer_map;
 
@@ -88,7 +96,7 @@ class Info {
 
 //Return a queue whose front is the start node (implicit in answer_map) and whose
 //  rear is the end node
-  ArrayQueue <std::string> recover_path(const CostMap &answer_map, std::string end_node) {
+  inline ArrayQueue <std::string> recover_path(const CostMap &answer_map, std::string end_node) {
         ArrayStack<std::string> answerstack;
         ArrayQueue<std::string> path;
         answerstack.push(end_node);
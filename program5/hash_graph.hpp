@@ -3,15 +3,18 @@
 #define HASH_GRAPH_HPP_
 
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <initializer_list>
+#include <cstdint>
 #include "ics_exceptions.hpp"
 #include "pair.hpp"
 #include "heap_priority_queue.hpp"
 #include "hash_set.hpp"
 #include "hash_map.hpp"
+#include "hashers.hpp"
 
 
 namespace ics {
@@ -26,19 +29,35 @@ namespace ics {
   public:
     //Typedefs
     typedef std::string                NodeName;
+    typedef std::string_view           NodeView;  //Queries take names as views: no NodeName is built
     typedef pair<NodeName, NodeName>   Edge;
     typedef pair<NodeName, LocalInfo>  NodeLocalEntry;
 
+    //Probes edge_values (and EdgeSets) for the Edge with these names, without building one
+    struct EdgeView {
+      NodeView first, second;
+      friend bool operator == (const EdgeView& v, const Edge& e) {return v.first == e.first && v.second == e.second;}
+      friend std::ostream& operator << (std::ostream& outs, const EdgeView& v) {return outs << v.first << "->" << v.second;}
+    };
+
     //Static methods for hashing (in the maps) and for printing in alphabetic
     //  order the nodes in a graph (see << for HashGraph<T>)
-    static int hash_str(const NodeName& s) {
-      std::hash<std::string> str_hash;
-      return str_hash(s);
+    //The hashers in hashers.hpp hash a view as the name it probes for; an edge combines its
+    //  nodes' hashes in order, so (a,b) and (b,a) hash differently
+    static std::uint64_t hash_view(const NodeView& s) {
+      return hash_string_view(s);
+    }
+
+    static std::uint64_t hash_edge_view(const EdgeView& s) {
+      return hash_combine(hash_string_view(s.first), hash_string_view(s.second));
     }
 
-    static int hash_pair_str(const Edge& s) {
-      std::hash<std::string> str_hash;
-      return str_hash(s.first) * str_hash(s.second);
+    static std::uint64_t hash_str(const NodeName& s) {
+      return hash_string(s);
+    }
+
+    static std::uint64_t hash_pair_str(const Edge& s) {
+      return hash_edge_view(EdgeView{s.first,s.second});
     }
 
     static bool LocalInfo_gt(const NodeLocalEntry& a, const NodeLocalEntry& b)
@@ -60,22 +79,22 @@ namespace ics {
     HashGraph(const HashGraph<T>& g);
 
     //Queries
-    bool empty      ()                                     const;
-    int  node_count ()                                     const;
-    int  edge_count ()                                     const;
-    bool has_node  (std::string node_name)                 const;
-    bool has_edge  (NodeName origin, NodeName destination) const;
-    T    edge_value(NodeName origin, NodeName destination) const;
-    int  in_degree (NodeName node_name)                    const;
-    int  out_degree(NodeName node_name)                    const;
-    int  degree    (NodeName node_name)                    const;
+    bool         empty      ()                                     const;
+    std::int64_t node_count ()                                     const;
+    std::int64_t edge_count ()                                     const;
+    bool         has_node  (NodeView node_name)                    const;
+    bool         has_edge  (NodeView origin, NodeView destination) const;
+    T            edge_value(NodeView origin, NodeView destination) const;
+    std::int64_t in_degree (NodeView node_name)                    const;
+    std::int64_t out_degree(NodeView node_name)                    const;
+    std::int64_t degree    (NodeView node_name)                    const;
 
     const NodeMap& all_nodes()                   const;
     const EdgeMap& all_edges()                   const;
-    const NodeSet& out_nodes(NodeName node_name) const;
-    const NodeSet& in_nodes (NodeName node_name) const;
-    const EdgeSet& out_edges(NodeName node_name) const;
-    const EdgeSet& in_edges (NodeName node_name) const;
+    const NodeSet& out_nodes(NodeView node_name) const;
+    const NodeSet& in_nodes (NodeView node_name) const;
+    const EdgeSet& out_edges(NodeView node_name) const;
+    const EdgeSet& in_edges (NodeView node_name) const;
 
     //Commands
     void add_node   (NodeName node_name);
@@ -192,28 +211,28 @@ bool HashGraph<T>::empty() const {
 
 //Returns the number of nodes in a graph
 template<class T>
-int HashGraph<T>::node_count() const {
+std::int64_t HashGraph<T>::node_count() const {
       return this->node_values.size();
 }
 
 
 //Returns the number of edges in a graph
 template<class T>
-int HashGraph<T>::edge_count() const {
+std::int64_t HashGraph<T>::edge_count() const {
       return this->edge_values.size();
 }
 
 
 //Returns whether or not node_name is in the graph
 template<class T>
-bool HashGraph<T>::has_node(NodeName node_name) const {
-      return this->node_values.has_key(node_name);
+bool HashGraph<T>::has_node(NodeView node_name) const {
+      return this->node_values.has_key(node_name, hash_view);
 }
 
 //Returns whether or not the edge is in the graph
 template<class T>
-bool HashGraph<T>::has_edge(NodeName origin, NodeName destination) const {
-      return this->edge_values.has_key(Edge(origin,destination));
+bool HashGraph<T>::has_edge(NodeView origin, NodeView destination) const {
+      return this->edge_values.has_key(EdgeView{origin,destination}, hash_edge_view);
 
 }
 
@@ -221,11 +240,10 @@ bool HashGraph<T>::has_edge(NodeName origin, NodeName destination) const {
 //Returns the value of the edge in the graph; if the edge is not in the graph,
 //  throw a GraphError exception with appropriate descriptive text
 template<class T>
-T HashGraph<T>::edge_value(NodeName origin, NodeName destination) const {
+T HashGraph<T>::edge_value(NodeView origin, NodeView destination) const {
       if(!this->has_edge(origin, destination))
         throw GraphError("HashGraph::edge not in graph");
-      Edge orgdest (origin, destination);
-      return this->edge_values[orgdest];
+      return this->edge_values.get(EdgeView{origin,destination}, hash_edge_view);
 
 }
 
@@ -233,10 +251,10 @@ T HashGraph<T>::edge_value(NodeName origin, NodeName destination) const {
 //Returns the in-degree of node_name; if that node is not in the graph,
 //  throw a GraphError exception with appropriate descriptive text
 template<class T>
-int HashGraph<T>::in_degree(NodeName node_name) const {
+std::int64_t HashGraph<T>::in_degree(NodeView node_name) const {
       if(!this->has_node(node_name))
         throw GraphError("HashGraph::node not in graph");
-      LocalInfo li = this->node_values[node_name];
+      const LocalInfo& li = this->node_values.get(node_name, hash_view);
       return li.in_nodes.size();
 }
 
@@ -244,10 +262,10 @@ int HashGraph<T>::in_degree(NodeName node_name) const {
 //Returns the out-degree of node_name; if that node is not in the graph,
 //  throw a GraphError exception with appropriate descriptive text
 template<class T>
-int HashGraph<T>::out_degree(NodeName node_name) const {
+std::int64_t HashGraph<T>::out_degree(NodeView node_name) const {
       if(!this->has_node(node_name))
         throw GraphError("HashGraph::node not in graph");
-      LocalInfo li = this->node_values[node_name];
+      const LocalInfo& li = this->node_values.get(node_name, hash_view);
       return li.out_nodes.size();
 }
 
@@ -255,7 +273,7 @@ int HashGraph<T>::out_degree(NodeName node_name) const {
 //Returns the degree of node_name; if that node is not in the graph,
 //  throw a GraphError exception with appropriate descriptive text.
 template<class T>
-int HashGraph<T>::degree(NodeName node_name) const {
+std::int64_t HashGraph<T>::degree(NodeView node_name) const {
       if(!this->has_node(node_name))
         throw GraphError("HashGraph::node not in graph");
       return this->in_degree(node_name) + this->out_degree(node_name);
@@ -282,10 +300,10 @@ auto HashGraph<T>::all_edges () const -> const EdgeMap& {
 //  if that node is not in the graph, throw a GraphError exception with
 //  appropriate  descriptive text
 template<class T>
-auto HashGraph<T>::out_nodes(NodeName node_name) const -> const NodeSet& {
+auto HashGraph<T>::out_nodes(NodeView node_name) const -> const NodeSet& {
       if(!this->has_node(node_name))
         throw GraphError("HashGraph::node not in graph");
-      return this->node_values[node_name].out_nodes;
+      return this->node_values.get(node_name, hash_view).out_nodes;
 }
 
 
@@ -294,10 +312,10 @@ auto HashGraph<T>::out_nodes(NodeName node_name) const -> const NodeSet& {
 //  if that node is not in the graph, throw a GraphError exception with
 //  appropriate descriptive text
 template<class T>
-auto HashGraph<T>::in_nodes(NodeName node_name) const -> const NodeSet& {
+auto HashGraph<T>::in_nodes(NodeView node_name) const -> const NodeSet& {
       if(!this->has_node(node_name))
         throw GraphError("HashGraph::node not in graph");
-      return this->node_values[node_name].in_nodes;
+      return this->node_values.get(node_name, hash_view).in_nodes;
 }
 
 
@@ -306,10 +324,10 @@ auto HashGraph<T>::in_nodes(NodeName node_name) const -> const NodeSet& {
 //  if that node is not in the graph, throw a GraphError exception with
 //  appropriate descriptive text
 template<class T>
-auto HashGraph<T>::out_edges(NodeName node_name) const -> const EdgeSet& {
+auto HashGraph<T>::out_edges(NodeView node_name) const -> const EdgeSet& {
       if(!this->has_node(node_name))
         throw GraphError("HashGraph::node not in graph");
-      return this->node_values[node_name].out_edges;
+      return this->node_values.get(node_name, hash_view).out_edges;
 }
 
 
@@ -318,10 +336,10 @@ auto HashGraph<T>::out_edges(NodeName node_name) const -> const EdgeSet& {
 //  if that node is not in the graph, throw a GraphError exception with
 //  appropriate descriptive text
 template<class T>
-auto HashGraph<T>::in_edges(NodeName node_name) const -> const EdgeSet& {
+auto HashGraph<T>::in_edges(NodeView node_name) const -> const EdgeSet& {
       if(!this->has_node(node_name))
         throw GraphError("HashGraph::node not in graph");
-      return this->node_values[node_name].in_edges;
+      return this->node_values.get(node_name, hash_view).in_edges;
 }
 
 
@@ -333,10 +351,7 @@ auto HashGraph<T>::in_edges(NodeName node_name) const -> const EdgeSet& {
 //Ensure that its associated LocalInfo has a from_graph refers to this graph.
 template<class T>
 void HashGraph<T>::add_node (NodeName node_name) {
-      if(has_node(node_name))
-        return;
-      LocalInfo li (this);
-      this->node_values.put(node_name,li);
+      this->node_values.try_emplace(std::move(node_name),this);   //LocalInfo(this) built in its node: no copies
 }
 
 
@@ -0,0 +1,157 @@
+#ifndef HASH_IMAGE_HPP_
+#define HASH_IMAGE_HPP_
+
+#include <string>
+#include <string_view>
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include "hash_code.hpp"
+
+
+namespace ics {
+
+
+//Binary images of HashMap/HashSet contents (written by their write_image), which MappedHashMap/
+//  MappedHashSet (mapped_hash_map.hpp) use in place, without rebuilding a table.
+//An image is one block of bytes; every position in it is an offset from its start, so it can
+//  be mapped at any address:
+//    ImageHeader
+//    uint64_t bin_start[bins+1]  bin b's entries are entry[bin_start[b] .. bin_start[b+1]-1]
+//    entries                     each entry_size bytes: uint64_t code (a HashCode), then the
+//                                key's field and (for a map) the value's field
+//    strings                     the characters of every std::string field
+//bins is a power of 2 and a key's bin is bin_index(code,bits) (see hash_code.hpp) for its code
+//  (to_hash_code(hash(key))), so an image must be read with the hash function that wrote it.
+struct ImageHeader {
+  char     magic[8];          //image_magic
+  uint32_t version;           //image_version
+  uint32_t is_map;            //1 for a HashMap's image, 0 for a HashSet's
+  uint32_t key_tag;           //ImageField<KEY>::tag
+  uint32_t value_tag;         //ImageField<T>::tag (0 for a HashSet's)
+  uint64_t bins;
+  uint64_t used;
+  uint64_t entry_size;
+  uint64_t bins_offset;
+  uint64_t entries_offset;
+  uint64_t strings_offset;
+  uint64_t image_size;
+};
+
+static const char     image_magic[8] = {'I','C','S','H','I','M','G','\0'};
+static const uint32_t image_version  = 2;          //1: uint32_t codes, bin code % bins
+
+
+//How a key or value is stored in an entry, and what a mapped image returns for it (View).
+//A trivially copyable X is stored as its bytes (rounded up to a multiple of 8); View is X.
+//A std::string is stored as the offset/length of its characters in strings; View is a
+//  std::string_view of them (no copying). Other types cannot be imaged.
+template<class X, bool trivial = std::is_trivially_copyable<X>::value>
+class ImageField;
+
+template<class X>
+class ImageField<X,true> {
+  public:
+    typedef X View;
+    static const uint32_t tag  = sizeof(X);
+    static const uint64_t size = (sizeof(X)+7)/8*8;
+
+    static void write (char* field, const X& x, std::string& strings) {std::memcpy(field,&x,sizeof(X));}
+    static View read  (const char* image, const ImageHeader& h, const char* field) {
+      X x;
+      std::memcpy(&x,field,sizeof(X));
+      return x;
+    }
+};
+
+template<>
+class ImageField<std::string,false> {
+  public:
+    typedef std::string_view View;
+    static const uint32_t tag  = 0xFFFFFFFF;
+    static const uint64_t size = 2*sizeof(uint64_t);
+
+    static void write (char* field, const std::string& s, std::string& strings) {
+      uint64_t offset_length[2] = {strings.size(), s.size()};
+      std::memcpy(field,offset_length,size);
+      strings += s;
+    }
+    static View read (const char* image, const ImageHeader& h, const char* field) {
+      uint64_t offset_length[2];
+      std::memcpy(offset_length,field,size);
+      return View(image + h.strings_offset + offset_length[0], offset_length[1]);
+    }
+};
+
+
+//Collects a container's entries (add) then writes their image (write); for a HashSet, T is
+//  ignored and every value is nullptr
+template<class KEY, class T>
+class HashImageWriter {
+  public:
+    explicit HashImageWriter (bool is_map) : is_map(is_map) {}
+
+    void add   (HashCode code, const KEY& key, const T* value) {added.push_back(Added{code,&key,value});}
+    void write (std::ostream& out, std::int64_t bins) const;   //bins is rounded up to a power of 2
+
+  private:
+    struct Added {
+      HashCode   code;
+      const KEY* key;
+      const T*   value;
+    };
+
+    bool               is_map;
+    std::vector<Added> added;
+};
+
+
+template<class KEY, class T>
+void HashImageWriter<KEY,T>::write (std::ostream& out, std::int64_t bins) const {
+  ImageHeader h;
+  std::memcpy(h.magic,image_magic,sizeof(h.magic));
+  h.version        = image_version;
+  h.is_map         = is_map;
+  h.key_tag        = ImageField<KEY>::tag;
+  h.value_tag      = is_map ? ImageField<T>::tag : 0;
+  int bits         = bin_bits(bins);
+  h.bins           = uint64_t(1) << bits;
+  h.used           = added.size();
+  h.entry_size     = 8 + ImageField<KEY>::size + (is_map ? ImageField<T>::size : 0);
+  h.bins_offset    = (sizeof(ImageHeader)+7)/8*8;
+  h.entries_offset = h.bins_offset + (h.bins+1)*sizeof(uint64_t);
+  h.strings_offset = h.entries_offset + h.used*h.entry_size;
+
+  //Counting sort of the entries into their bins
+  std::vector<uint64_t> bin_start(h.bins+1,0);
+  for (const Added& a : added)
+    ++bin_start[bin_index(a.code,bits)+1];
+  for (uint64_t b=0; b<h.bins; ++b)
+    bin_start[b+1] += bin_start[b];
+
+  std::vector<uint64_t> next(bin_start.begin(),bin_start.end()-1);
+  std::vector<char>     entries(h.used*h.entry_size,0);
+  std::string           strings;
+  for (const Added& a : added) {
+    char* e = &entries[next[bin_index(a.code,bits)]++ * h.entry_size];
+    std::memcpy(e,&a.code,sizeof(a.code));
+    ImageField<KEY>::write(e+8,*a.key,strings);
+    if (is_map)
+      ImageField<T>::write(e+8+ImageField<KEY>::size,*a.value,strings);
+  }
+  h.image_size = h.strings_offset + strings.size();
+
+  static const char padding[8] = {0};
+  out.write(reinterpret_cast<const char*>(&h),sizeof(h));
+  out.write(padding,h.bins_offset-sizeof(h));
+  out.write(reinterpret_cast<const char*>(bin_start.data()),bin_start.size()*sizeof(uint64_t));
+  out.write(entries.data(),entries.size());
+  out.write(strings.data(),strings.size());
+}
+
+
+}
+
+#endif /* HASH_IMAGE_HPP_ */
@@ -4,8 +4,15 @@
 #include <string>
 #include <iostream>
 #include <initializer_list>
+#include <utility>              //std::move, std::forward, std::swap
 #include "ics_exceptions.hpp"
 #include "pair.hpp"
+#include "node_allocator.hpp"
+#include "hash_image.hpp"
+#include "hash_statistics.hpp"
+#include "hash_code.hpp"
+#include "template_function.hpp"
+#include "iteration_policy.hpp"
 
 
 namespace ics {
@@ -13,61 +20,159 @@ namespace ics {
 
 #ifndef undefinedhashdefined
 #define undefinedhashdefined
-template<class T>
-int undefinedhash (const T& a) {return 0;}
+template<class T, class R = int>
+R undefinedhash (const T& a) {return 0;}
 #endif /* undefinedhashdefined */
 
+#ifndef ICS_PREFETCH
+#if defined(__GNUC__) || defined(__clang__)
+#define ICS_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define ICS_PREFETCH(address)
+#endif
+#endif /* ICS_PREFETCH */
+
+//Hash code policies for HashMap: each list node derives from one.
+//RecomputeHash stores nothing (a node is no bigger): a key's hash code is recomputed, calling
+//  hash(key), whenever it is needed, including for every key moved in a resize.
+//CacheHash stores each key's hash code in its node when it is added: resizes never call hash,
+//  and lookups compare hash codes before calling KEY's operator ==.
+class RecomputeHash {
+  public:
+    template<class KEY, class Hash>
+    HashCode code      (const KEY& key, const Hash& hash) const {return to_hash_code(hash(key));}
+    void     set_code  (HashCode c)                             {}
+    bool     may_match (HashCode c)                       const {return true;}
+};
+
+class CacheHash {
+  public:
+    template<class KEY, class Hash>
+    HashCode code      (const KEY& key, const Hash& hash) const {return hash_code;}
+    void     set_code  (HashCode c)                             {hash_code = c;}
+    bool     may_match (HashCode c)                       const {return hash_code == c;}
+
+  private:
+    HashCode hash_code = 0;
+};
+
+
 //Instantiate the templated class supplying thash(a): produces a hash value for a.
 //If thash is defaulted to undefinedhash in the template, then a constructor must supply chash.
 //If both thash and chash are supplied, then they must be the same (by ==) function.
 //If neither is supplied, or both are supplied but different, TemplateFunctionError is raised.
 //The (unique) non-undefinedhash value supplied by thash/chash is stored in the instance variable hash.
-template<class KEY,class T, int (*thash)(const KEY& a) = undefinedhash<KEY>> class HashMap {
+//A thash is called directly (see template_function.hpp), so it can be inlined; thash can also be
+//  functor<F> for a stateless functor class F (e.g., HashMap<int,int,functor<IntHash>>).
+//thash may return an int or a 64-bit value; sizes and bins are 64-bit, so a map can hold more
+//  than 2^31 entries. There are always 2^bits bins (see hash_code.hpp).
+//NodeAllocator (see node_allocator.hpp) allocates the list nodes: PoolNodeAllocator<> recycles erased
+//  nodes from slabs instead of calling new/delete for each one.
+//HashCache (RecomputeHash or CacheHash, above) decides whether nodes store their keys' hash codes.
+//Counters (NoHashCounters or HashCounters, see hash_statistics.hpp) decides whether statistics()
+//  reports lookup probes and resizes too; with NoHashCounters the counting compiles to nothing.
+//Iteration (CheckedIteration or UncheckedIteration, see iteration_policy.hpp) decides whether
+//  Iterators and for_each check for concurrent modification.
+template<class KEY,class T, auto thash = undefinedhash<KEY>, class NodeAllocator = HeapNodeAllocator, class HashCache = RecomputeHash, class Counters = NoHashCounters, class Iteration = CheckedIteration> class HashMap {
   public:
     typedef ics::pair<KEY,T>   Entry;
-    typedef int (*hashfunc) (const KEY& a);
+    typedef decltype(thash) hashfunc;  //int or 64-bit hash values: see hash_code.hpp
 
     //Destructor/Constructors
     ~HashMap ();
 
-    HashMap          (double the_load_threshold = 1.0, int (*chash)(const KEY& a) = undefinedhash<KEY>);
-    explicit HashMap (int initial_bins, double the_load_threshold = 1.0, int (*chash)(const KEY& k) = undefinedhash<KEY>);
-    HashMap          (const HashMap<KEY,T,thash>& to_copy, double the_load_threshold = 1.0, int (*chash)(const KEY& a) = undefinedhash<KEY>);
-    explicit HashMap (const std::initializer_list<Entry>& il, double the_load_threshold = 1.0, int (*chash)(const KEY& a) = undefinedhash<KEY>);
+    HashMap          (double the_load_threshold = 1.0, hashfunc chash = undefinedhash<KEY>);
+    explicit HashMap (int initial_bins, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<KEY>);
+    HashMap          (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& to_copy, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<KEY>);
+    HashMap          (HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>&& to_move) noexcept;  //to_move is left with no bins (allocated when next needed)
+    explicit HashMap (const std::initializer_list<Entry>& il, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<KEY>);
 
     //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
     template <class Iterable>
-    explicit HashMap (const Iterable& i, double the_load_threshold = 1.0, int (*chash)(const KEY& a) = undefinedhash<KEY>);
+    explicit HashMap (const Iterable& i, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<KEY>);
 
 
     //Queries
     bool empty      () const;
-    int  size       () const;
+    std::int64_t size () const;
     bool has_key    (const KEY& key) const;
     bool has_value  (const T& value) const;
     std::string str () const; //supplies useful debugging information; contrast to operator <<
+    HashStatistics statistics () const; //chain lengths, collisions, (with HashCounters) probes/resizes
+
+    //Heterogeneous lookup: probe is any type comparable (probe == key) to KEY, with phash(probe) ==
+    //  hash(key) when they are equal (e.g., std::string_view probing std::string keys: nothing is built)
+    template<class Probe, class Code> bool     has_key (const Probe& probe, Code (*phash)(const Probe& p)) const;
+    template<class Probe, class Code> const T& get     (const Probe& probe, Code (*phash)(const Probe& p)) const; //KeyError if absent
+
+    //Batched lookup of keys[0..n-1]: hashes a batch of keys and prefetches their bins before
+    //  searching any list, so the cache misses of independent probes overlap; both return # found
+    std::int64_t contains_many (const KEY* keys, std::int64_t n, bool* found)      const;  //found[i]  = has_key(keys[i])
+    std::int64_t get_many      (const KEY* keys, std::int64_t n, const T** values) const;  //values[i] = &(*this)[keys[i]] or nullptr
+
+    //Write an image of the map (see hash_image.hpp) that MappedHashMap (mapped_hash_map.hpp) can
+    //  search in place; KEY and T must each be std::string or trivially copyable
+    void write_image (std::ostream& out) const;
 
 
     //Commands
     T    put   (const KEY& key, const T& value);
+    T    put   (KEY&& key, T&& value);    //moves key/value in; copies value only when returning it for a new key
     T    erase (const KEY& key);
     void clear ();
 
+    //If key is not in the map, add it with the value T(args...) constructed in its node and return 1;
+    //  otherwise return 0 (leaving args untouched). Unlike put, no T is copied or returned.
+    template<class... Args>
+    int try_emplace (const KEY& key, Args&&... args);
+    template<class... Args>
+    int try_emplace (KEY&& key, Args&&... args);
+
+    //Construct Entry(args...) in a node and add it, returning 1, unless its key is already in the map: return 0
+    template<class... Args>
+    int emplace (Args&&... args);
+
+    //0 (the default): a resize rehashes every bin at once. Otherwise a resize allocates the new bins
+    //  and each later put/erase/operator[] insertion moves bins_per_op old bins into them, so no single
+    //  call pays for the whole O(N) rehash. bins_per_op >= 1/load_threshold ensures each resize
+    //  completes before the next starts (else the next one finishes it at once).
+    void set_rehash_step (int bins_per_op);
+
+    //Sizing: bins are always a power of 2. reserve(n) grows the bins (never shrinks them) so n keys are
+    //  within load_threshold: put_all of n keys after reserve(n) never resizes. rehash(at_least_bins)
+    //  resizes, up or down, to at least at_least_bins bins and at least enough bins for size() keys;
+    //  shrink_to_fit() is rehash(0). Each relinks every node at once (finishing any incremental rehash).
+    void reserve       (std::int64_t n);
+    void rehash        (std::int64_t at_least_bins);
+    void shrink_to_fit ();
+
+    //0 (the default): the bins never shrink on their own. Otherwise erase(key) calls shrink_to_fit once
+    //  size()/bins falls below low_water, and clear() shrinks to 1 bin, so iteration and clear stop
+    //  walking the empty bins left by mass erases. low_water is clamped to at most load_threshold/4, so
+    //  a map that just shrank (or grew) is not resized again by the next few put/erase calls.
+    //Iterator::erase never shrinks (it would move the nodes being iterated over): call shrink_to_fit after.
+    void set_shrink_threshold (double low_water);
+
+    //Restart the counts that statistics() reports (with HashCounters)
+    void reset_statistics ();
+
     //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
     template <class Iterable>
-    int put_all(const Iterable& i);
+    std::int64_t put_all(const Iterable& i);
 
 
     //Operators
 
     T&       operator [] (const KEY&);
+    T&       operator [] (KEY&&);
     const T& operator [] (const KEY&) const;
-    HashMap<KEY,T,thash>& operator = (const HashMap<KEY,T,thash>& rhs);
-    bool operator == (const HashMap<KEY,T,thash>& rhs) const;
-    bool operator != (const HashMap<KEY,T,thash>& rhs) const;
+    HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& operator = (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& rhs);
+    HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& operator = (HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>&& rhs) noexcept;  //Takes rhs's hash/load_threshold too
+    bool operator == (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& rhs) const;
+    bool operator != (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& rhs) const;
 
-    template<class KEY2,class T2, int (*hash2)(const KEY2& a)>
-    friend std::ostream& operator << (std::ostream& outs, const HashMap<KEY2,T2,hash2>& m);
+    template<class KEY2,class T2, auto hash2, class NodeAllocator2, class HashCache2, class Counters2, class Iteration2>
+    friend std::ostream& operator << (std::ostream& outs, const HashMap<KEY2,T2,hash2,NodeAllocator2,HashCache2,Counters2,Iteration2>& m);
 
 
 
@@ -77,29 +182,29 @@ template<class KEY,class T, int (*thash)(const KEY& a) = undefinedhash<KEY>> cla
   public:
     class Iterator {
       public:
-         typedef pair<int,LN*> Cursor;
+         typedef pair<std::int64_t,LN*> Cursor;
 
         //Private constructor called in begin/end, which are friends of HashMap<T>
         ~Iterator();
         Entry       erase();
         std::string str  () const;
-        HashMap<KEY,T,thash>::Iterator& operator ++ ();
-        HashMap<KEY,T,thash>::Iterator  operator ++ (int);
-        bool operator == (const HashMap<KEY,T,thash>::Iterator& rhs) const;
-        bool operator != (const HashMap<KEY,T,thash>::Iterator& rhs) const;
+        HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& operator ++ ();
+        HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator  operator ++ (int);
+        bool operator == (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& rhs) const;
+        bool operator != (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& rhs) const;
         Entry& operator *  () const;
         Entry* operator -> () const;
-        friend std::ostream& operator << (std::ostream& outs, const HashMap<KEY,T,thash>::Iterator& i) {
+        friend std::ostream& operator << (std::ostream& outs, const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& i) {
           outs << i.str(); //Use the same meaning as the debugging .str() method
           return outs;
         }
-        friend Iterator HashMap<KEY,T,thash>::begin () const;
-        friend Iterator HashMap<KEY,T,thash>::end   () const;
+        friend Iterator HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::begin () const;
+        friend Iterator HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::end   () const;
 
       private:
         //If can_erase is false, current indexes the "next" value (must ++ to reach it)
         Cursor                current; //Bin Index and Cursor; stop: LN* == nullptr
-        HashMap<KEY,T,thash>* ref_map;
+        HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>* ref_map;
         int                   expected_mod_count;
         bool                  can_erase = true;
 
@@ -107,41 +212,81 @@ template<class KEY,class T, int (*thash)(const KEY& a) = undefinedhash<KEY>> cla
         void advance_cursors();
 
         //Called in friends begin/end
-        Iterator(HashMap<KEY,T,thash>* iterate_over, bool from_begin);
+        Iterator(HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>* iterate_over, bool from_begin);
     };
 
 
     Iterator begin () const;
     Iterator end   () const;
 
+    //Internal iteration: visit(entry) for each entry (as a const Entry&), walking the bins without an Iterator;
+    //  visit must not change the map. With CheckedIteration, mod_count is compared after each visit (before
+    //  moving on), so ConcurrentModificationError is thrown after the visit that changed the map has run;
+    //  with UncheckedIteration the comparison compiles to nothing and such a change is undefined.
+    template<class Visitor>
+    void for_each (Visitor visit) const;
+
 
   private:
-    class LN {
+    class LN : public HashCache {
     public:
-      LN ()                         : next(nullptr){}
-      LN (const LN& ln)             : value(ln.value), next(ln.next){}
-      LN (Entry v, LN* n = nullptr) : value(v), next(n){}
+      LN ()                                : next(nullptr){}
+      LN (const LN& ln)                    : HashCache(ln), value(ln.value), next(ln.next){}
+      LN (const LN& ln, LN* n)             : HashCache(ln), value(ln.value), next(n){}
+      LN (const Entry& v, LN* n = nullptr) : value(v), next(n){}
+      LN (Entry&& v, LN* n = nullptr)      : value(std::move(v)), next(n){}
+      LN (KEY&& k, T&& v, LN* n)           : next(n) {value.first = std::move(k); value.second = std::move(v);} //pair has no moving 2-argument constructor
+
+      //Erasing this node's entry: take n's entry/code/next instead (then n can be deallocated)
+      void take (LN* n) {HashCache::operator = (*n); value = std::move(n->value); next = n->next;}
 
       Entry value;
       LN*   next;
   };
 
-  int (*hash)(const KEY& k);  //Hashing function used (from template or constructor)
+  TemplateFunction<hashfunc,thash,undefinedhash<KEY>> hash;  //Hashing function used (from template or constructor)
   LN** map      = nullptr;    //Pointer to array of pointers: each bin stores a list with a trailer node
   double load_threshold;      //used/bins <= load_threshold
-  int bins      = 1;          //# bins in array (should start at 1 so hash_compress doesn't % 0)
-  int used      = 0;          //Cache for number of key->value pairs in the hash table
+  std::int64_t bins = 1;      //# bins in array: 2^bits (0 only once moved from)
+  int          bits = 0;
+  std::int64_t used = 0;      //Cache for number of key->value pairs in the hash table
   int mod_count = 0;          //For sensing concurrent modification
+  typename NodeAllocator::template Pool<LN> nodes; //Allocates every LN (trailers too); see node_allocator.hpp
+  Counters counters;          //Not copied or moved: counts the operations on this map
 
+  //Incremental rehashing: while old_map != nullptr, old bin b < migrated has been moved into
+  //  map[2b] and map[2b+1] (bins == 2*old_bins); old bins >= migrated still hold their
+  //  keys (and receive new keys that hash to them) and the map bins they feed are not yet allocated
+  LN**         old_map     = nullptr; //Bins being emptied into map during an incremental rehash
+  std::int64_t old_bins    = 0;       //# bins in old_map (2^(bits-1))
+  std::int64_t migrated    = 0;       //old_map[0..migrated-1] are moved into map
+  int          rehash_step = 0;       //old bins moved per mutating operation; 0 means all at once
+  double       shrink_threshold = 0;  //erase shrinks the bins when used/bins < shrink_threshold; 0 means never
+  static constexpr std::int64_t scan_ahead = 8;//bins prefetched ahead while scanning past empty bins
 
-  //Helper methods
-  int   hash_compress        (const KEY& key)          const;  //hash function ranged to [0,bins-1]
-  LN*   find_key             (const KEY& key)          const;  //Returns reference to key's node or nullptr
-  LN*   copy_list            (LN*   l)                 const;  //Copy the keys/values in a bin (order irrelevant)
-  LN**  copy_hash_table      (LN** ht, int bins)       const;  //Copy the bins/keys/values in ht tree (order in bins irrelevant)
 
-  void  ensure_load_threshold(int new_used);                   //Reallocate if load_factor > load_threshold
-  void  delete_hash_table    (LN**& ht, int bins);             //Deallocate all LN in ht (and the ht itself; ht == nullptr)
+  //Helper methods
+  HashCode     hash_code            (const KEY& key)          const;  //hash function as a HashCode: the code nodes store
+  LN*&         bin_of               (HashCode code)           const;  //The list a key with hash_code code belongs in: in map or (while rehashing) old_map
+  std::int64_t all_bins             ()                        const;  //# bins in map plus, while rehashing, old_map
+  LN*          bin_list             (std::int64_t b)          const;  //b-th list over map then old_map; nullptr if not in use
+  LN*          find_key             (const KEY& key)          const;  //Returns reference to key's node or nullptr
+  template<class Probe>
+  LN*          find_key             (const Probe& key, HashCode code) const; //Same, given key's hash_code (or a Probe and its code)
+  LN*          add_node             (KEY&& key, T&& value, HashCode code); //Add key (not in the map; hash_code code) with value; returns its node
+  LN*          copy_list            (LN*   l);                        //Copy the keys/values in a bin (order irrelevant)
+  LN**         copy_hash_table      (LN** ht, std::int64_t bins);     //Copy the bins/keys/values in ht tree (order in bins irrelevant)
+  void         allocate_bins        (std::int64_t at_least);          //map = 2^bits >= at_least bins, each with a trailer
+
+  void         ensure_load_threshold(std::int64_t new_used);          //Reallocate if load_factor > load_threshold
+  void         migrate_bins         (std::int64_t count);             //Move up to count old_map bins into map
+  void         finish_rehash        ();                               //Move all remaining old_map bins into map
+  void         delete_hash_table    (LN**& ht, std::int64_t bins);    //Deallocate all LN in ht (and the ht itself; ht == nullptr)
+  void         delete_all_bins      ();                               //Deallocate map and old_map (mid-rehash too), allocating nothing
+  std::int64_t bins_for             (std::int64_t n)          const;  //# bins holding n keys within load_threshold
+  void         resize_bins          (std::int64_t at_least);          //Relink every node into 2^bits >= at_least bins at once
+  template<class Resolve>
+  std::int64_t probe_many           (const KEY* keys, std::int64_t n, Resolve resolve) const; //For contains/get_many: resolve(i,find_key(keys[i]))
 };
 
 
@@ -153,95 +298,101 @@ template<class KEY,class T, int (*thash)(const KEY& a) = undefinedhash<KEY>> cla
 
 //Destructor/Constructors
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::~HashMap() {
-  delete_hash_table(map,bins);
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::~HashMap() {
+  delete_all_bins();
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::HashMap(double the_load_threshold, int (*chash)(const KEY& k))
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::HashMap(double the_load_threshold, hashfunc chash)
 : hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold) {
   if (hash == (hashfunc)undefinedhash<KEY>)
     throw TemplateFunctionError("HashMap::default constructor: neither specified");
   if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
     throw TemplateFunctionError("HashMap::default constructor: both specified and different");
 
-  map = new LN*[bins];
-  for (int b=0; b<bins; ++b)
-    map[b] = new LN();         //Put a trailer node in bin
+  allocate_bins(1);
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::HashMap(int initial_bins, double the_load_threshold, int (*chash)(const KEY& k))
-: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), bins(initial_bins), load_threshold(the_load_threshold) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::HashMap(int initial_bins, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold) {
   if (hash == (hashfunc)undefinedhash<KEY>)
     throw TemplateFunctionError("HashMap::length constructor: neither specified");
   if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
     throw TemplateFunctionError("HashMap::length constructor: both specified and different");
 
-  if (bins < 1)
-    bins = 1;
-  map = new LN*[bins];
-  for (int b=0; b<bins; ++b)
-    map[b] = new LN();         //Put a trailer node in bin
+  allocate_bins(initial_bins);
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::HashMap(const HashMap<KEY,T,thash>& to_copy, double the_load_threshold, int (*chash)(const KEY& a))
-: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold), bins(to_copy.bins) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::HashMap(const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& to_copy, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold) {
   if (hash == (hashfunc)undefinedhash<KEY>)
     hash = to_copy.hash;//throw TemplateFunctionError("HashMap::copy constructor: neither specified");
   if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
     throw TemplateFunctionError("HashMap::copy constructor: both specified and different");
 
-  if (hash == to_copy.hash && (double)to_copy.size()/to_copy.bins <= the_load_threshold) {
+  rehash_step      = to_copy.rehash_step;
+  shrink_threshold = to_copy.shrink_threshold;
+  if (hash == to_copy.hash && to_copy.old_map == nullptr && (double)to_copy.size()/to_copy.bins <= the_load_threshold) {
+    bins = to_copy.bins;
+    bits = to_copy.bits;
     used = to_copy.used;
     map  = copy_hash_table(to_copy.map,to_copy.bins);
   }else {
-    bins = std::max(1,int(to_copy.size()/load_threshold));
-    map = new LN*[bins];
-    for (int b=0; b<bins; ++b)
-      map[b] = new LN();         //Put a trailer node in bin
-
-    for (int b=0; b<to_copy.bins; ++b)
-      for (LN* c = to_copy.map[b]; c->next!=nullptr; c=c->next)
+    allocate_bins(std::int64_t(to_copy.size()/load_threshold));
+    for (std::int64_t b=0; b<to_copy.all_bins(); ++b)
+      for (LN* c = to_copy.bin_list(b); c!=nullptr && c->next!=nullptr; c=c->next)
         put(c->value.first,c->value.second);
   }
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::HashMap(const std::initializer_list<Entry>& il, double the_load_threshold, int (*chash)(const KEY& k))
-: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold), bins(std::max(1,int(il.size()/the_load_threshold))) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::HashMap(HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>&& to_move) noexcept
+: hash(to_move.hash), map(to_move.map), load_threshold(to_move.load_threshold), bins(to_move.bins), bits(to_move.bits), used(to_move.used),
+  nodes(std::move(to_move.nodes)), old_map(to_move.old_map), old_bins(to_move.old_bins), migrated(to_move.migrated), rehash_step(to_move.rehash_step),
+  shrink_threshold(to_move.shrink_threshold) {
+  to_move.map      = nullptr;
+  to_move.bins     = 0;
+  to_move.bits     = 0;
+  to_move.used     = 0;
+  to_move.old_map  = nullptr;
+  to_move.old_bins = 0;
+  to_move.migrated = 0;
+  ++to_move.mod_count;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::HashMap(const std::initializer_list<Entry>& il, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold) {
   if (hash == (hashfunc)undefinedhash<KEY>)
     throw TemplateFunctionError("HashMap::initializer_list constructor: neither specified");
   if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
     throw TemplateFunctionError("HashMap::initializer_list constructor: both specified and different");
 
-  map = new LN*[bins];
-  for (int b=0; b<bins; ++b)
-    map[b] = new LN();
+  allocate_bins(std::int64_t(il.size()/the_load_threshold));
 
   for (const Entry& m_entry : il)
     put(m_entry.first,m_entry.second);
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
 template <class Iterable>
-HashMap<KEY,T,thash>::HashMap(const Iterable& i, double the_load_threshold, int (*chash)(const KEY& k))
-: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold), bins(std::max(1,int(i.size()/the_load_threshold))) {
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::HashMap(const Iterable& i, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<KEY> ? thash : chash), load_threshold(the_load_threshold) {
   if (hash == (hashfunc)undefinedhash<KEY>)
     throw TemplateFunctionError("HashMap::Iterable constructor: neither specified");
   if (thash != (hashfunc)undefinedhash<KEY> && chash != (hashfunc)undefinedhash<KEY> && thash != chash)
     throw TemplateFunctionError("HashMap::Iterable constructor: both specified and different");
 
-  map = new LN*[bins];
-  for (int b=0; b<bins; ++b)
-    map[b] = new LN();
+  allocate_bins(std::int64_t(i.size()/the_load_threshold));
 
   for (const Entry& m_entry : i)
     put(m_entry.first,m_entry.second);
@@ -252,28 +403,70 @@ HashMap<KEY,T,thash>::HashMap(const Iterable& i, double the_load_threshold, int
 //
 //Queries
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::empty() const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::empty() const {
   return used == 0;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-int HashMap<KEY,T,thash>::size() const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::size() const {
   return used;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::has_key (const KEY& key) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::has_key (const KEY& key) const {
   return find_key(key) != nullptr;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::has_value (const T& value) const {
-  for (int b=0; b<bins; ++b)
-    for (LN* c = map[b]; c->next!=nullptr; c=c->next)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class Probe, class Code>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::has_key (const Probe& probe, Code (*phash)(const Probe& p)) const {
+  return find_key(probe,to_hash_code(phash(probe))) != nullptr;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class Probe, class Code>
+const T& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::get (const Probe& probe, Code (*phash)(const Probe& p)) const {
+  LN* c = find_key(probe,to_hash_code(phash(probe)));
+  if (c != nullptr)
+    return c->value.second;
+
+  std::ostringstream answer;
+  answer << "HashMap::get: key(" << probe << ") not in Map";
+  throw KeyError(answer.str());
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::contains_many (const KEY* keys, std::int64_t n, bool* found) const {
+  return probe_many(keys,n,[found] (std::int64_t i, LN* c) {found[i] = c != nullptr;});
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::get_many (const KEY* keys, std::int64_t n, const T** values) const {
+  return probe_many(keys,n,[values] (std::int64_t i, LN* c) {values[i] = c == nullptr ? nullptr : &c->value.second;});
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::write_image (std::ostream& out) const {
+  HashImageWriter<KEY,T> image(true);
+  for (std::int64_t b=0; b<all_bins(); ++b)
+    for (LN* c = bin_list(b); c!=nullptr && c->next!=nullptr; c=c->next)
+      image.add(c->code(c->value.first,hash),c->value.first,&c->value.second);
+  image.write(out,bins);
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::has_value (const T& value) const {
+  for (std::int64_t b=0; b<all_bins(); ++b)
+    for (LN* c = bin_list(b); c!=nullptr && c->next!=nullptr; c=c->next)
       if (value == c->value.second)
         return true;
 
@@ -281,32 +474,64 @@ bool HashMap<KEY,T,thash>::has_value (const T& value) const {
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-std::string HashMap<KEY,T,thash>::str() const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::string HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::str() const {
   std::ostringstream answer;
   answer << "HashMap[";
   if (bins != 0) {
     answer << std::endl;
-    for (int b=0; b<bins; ++b) {
-      answer << "  bin[" << b << "] = ";
-      for (LN* c = map[b]; c->next!=nullptr; c=c->next)
+    for (std::int64_t b=0; b<all_bins(); ++b) {
+      if (b < bins)
+        answer << "  bin[" << b << "] = ";
+      else
+        answer << "  old bin[" << b-bins << "] = ";
+      LN* c = bin_list(b);
+      if (c == nullptr) {
+        answer << (b < bins ? "(unallocated)" : "(migrated)") << std::endl;
+        continue;
+      }
+      for (; c->next!=nullptr; c=c->next)
         answer << c->value.first << "->" << c->value.second << " -> " ;
       answer << "TRAILER" << std::endl;
     }
   }
-  answer  << "](load_threshold=" << load_threshold << ",bins=" << bins << ",used=" <<used <<",mod_count=" << mod_count << ")";
+  answer  << "](load_threshold=" << load_threshold << ",bins=" << bins << ",used=" <<used <<",mod_count=" << mod_count;
+  if (old_map != nullptr)
+    answer << ",old_bins=" << old_bins << ",migrated=" << migrated;
+  answer  << ")";
   return answer.str();
 }
 
 
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashStatistics HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::statistics () const {
+  HashStatistics answer;
+  std::vector<HashCode> codes;
+  codes.reserve(used);
+  for (std::int64_t b=0; b<all_bins(); ++b) {
+    LN* c = bin_list(b);
+    if (c == nullptr)
+      continue;
+    int length = 0;
+    for (; c->next!=nullptr; c=c->next, ++length)
+      codes.push_back(c->code(c->value.first,hash));
+    answer.count_chain(length);
+  }
+  answer.count_codes(codes);
+  counters.report(answer);
+  return answer;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 //Commands
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-T HashMap<KEY,T,thash>::put(const KEY& key, const T& value) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+T HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::put(const KEY& key, const T& value) {
   T to_return;
-  LN* c = find_key(key);
+  HashCode code = hash_code(key);
+  LN* c = find_key(key,code);
   if (c != nullptr) {
     to_return = c->value.second;
     c->value.second = value;
@@ -314,56 +539,79 @@ T HashMap<KEY,T,thash>::put(const KEY& key, const T& value) {
     to_return = value;
     ensure_load_threshold(used+1);
     ++used;
-    int bin = hash_compress(key);                  //bins may have changed in ensure_load_threshold!
-    map[bin] = new LN(Entry(key,value),map[bin]);  //easy to put at front: bin LNs unordered
+    LN*& bin = bin_of(code);                       //bins may have changed in ensure_load_threshold!
+    bin = nodes.create(Entry(key,value),bin);            //easy to put at front: bin LNs unordered
+    bin->set_code(code);
   }
 
+  migrate_bins(rehash_step);                       //after c is used: migration relinks nodes
   ++mod_count;
   return to_return;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-T HashMap<KEY,T,thash>::erase(const KEY& key) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+T HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::put(KEY&& key, T&& value) {
+  HashCode code = hash_code(key);
+  LN* c = find_key(key,code);
+  if (c != nullptr) {
+    std::swap(c->value.second,value);              //value now holds the old value, to return
+    migrate_bins(rehash_step);
+    ++mod_count;
+  }else
+    add_node(std::move(key),T(value),code);
+
+  return std::move(value);
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+T HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::erase(const KEY& key) {
   LN* c = find_key(key);
   if (c == nullptr) {
     std::ostringstream answer;
     answer << "HashMap::erase: key(" << key << ") not in Map";
     throw KeyError(answer.str());
   }
-  T to_return = c->value.second;
+  T to_return = std::move(c->value.second);
   LN* to_delete = c->next;
-  *c = *(c->next);
-  delete to_delete;
+  c->take(to_delete);
+  nodes.destroy(to_delete);
 
+  migrate_bins(rehash_step);
   --used;
   ++mod_count;
+  if (used < shrink_threshold*bins)
+    shrink_to_fit();
   return to_return;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-void HashMap<KEY,T,thash>::clear() {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::clear() {
+  finish_rehash();
   //Leave Trailers in bins
-  for (int b=0; b<bins; ++b) {
+  for (std::int64_t b=0; b<bins; ++b) {
     LN* c=map[b];
     for (; c->next!=nullptr; /*See body*/) {
       LN* to_delete = c;
       c = c->next;
-      delete to_delete;
+      nodes.destroy(to_delete);
     }
     map[b] = c;
   }
 
   used = 0;
   ++mod_count;
+  if (shrink_threshold > 0)
+    shrink_to_fit();
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
 template<class Iterable>
-int HashMap<KEY,T,thash>::put_all(const Iterable& i) {
-  int count = 0;
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::put_all(const Iterable& i) {
+  std::int64_t count = 0;
   for (const Entry& m_entry : i) {
     ++count;
     put(m_entry.first, m_entry.second);
@@ -373,28 +621,129 @@ int HashMap<KEY,T,thash>::put_all(const Iterable& i) {
 }
 
 
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class... Args>
+int HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::try_emplace(const KEY& key, Args&&... args) {
+  HashCode code = hash_code(key);
+  if (find_key(key,code) != nullptr)
+    return 0;
+
+  add_node(KEY(key),T(std::forward<Args>(args)...),code);
+  return 1;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class... Args>
+int HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::try_emplace(KEY&& key, Args&&... args) {
+  HashCode code = hash_code(key);
+  if (find_key(key,code) != nullptr)
+    return 0;
+
+  add_node(std::move(key),T(std::forward<Args>(args)...),code);
+  return 1;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class... Args>
+int HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::emplace(Args&&... args) {
+  LN* n = nodes.create(Entry(std::forward<Args>(args)...));
+  HashCode code = hash_code(n->value.first);
+  if (find_key(n->value.first,code) != nullptr) {
+    nodes.destroy(n);
+    return 0;
+  }
+
+  n->set_code(code);
+  ensure_load_threshold(used+1);
+  ++used;
+  LN*& bin = bin_of(code);                        //bins may have changed in ensure_load_threshold!
+  n->next = bin;
+  bin = n;
+  migrate_bins(rehash_step);
+  ++mod_count;
+  return 1;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::reset_statistics () {
+  counters.reset();
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::set_rehash_step(int bins_per_op) {
+  rehash_step = std::max(0,bins_per_op);
+  if (rehash_step == 0 && old_map != nullptr) {
+    finish_rehash();
+    ++mod_count;        //nodes moved between bins
+  }
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::reserve(std::int64_t n) {
+  if (bins_for(n) > bins)
+    resize_bins(bins_for(n));
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::rehash(std::int64_t at_least_bins) {
+  resize_bins(std::max(at_least_bins,bins_for(used)));
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::shrink_to_fit() {
+  rehash(0);
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::set_shrink_threshold(double low_water) {
+  shrink_threshold = std::min(std::max(0.,low_water),load_threshold/4);
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 //Operators
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-T& HashMap<KEY,T,thash>::operator [] (const KEY& key) {
-  LN* c = find_key(key);
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+T& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator [] (const KEY& key) {
+  HashCode code = hash_code(key);
+  LN* c = find_key(key,code);
   if (c != nullptr)
     return c->value.second;
 
   ensure_load_threshold(used+1);
+  migrate_bins(rehash_step);                   //a hit (above) must not migrate: it does not change mod_count
   ++used;
   ++mod_count;
-  int bin = hash_compress(key);                //bins may have changed in ensure_load_threshold!
+  LN*& bin = bin_of(code);                     //bins may have changed in ensure_load_threshold!
+
+  bin = nodes.create(Entry(key,T()),bin);            //easy to put at front: bin LNs unordered
+  bin->set_code(code);
+  return bin->value.second;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+T& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator [] (KEY&& key) {
+  HashCode code = hash_code(key);
+  LN* c = find_key(key,code);
+  if (c != nullptr)
+    return c->value.second;
 
-  map[bin] = new LN(Entry(key,T()),map[bin]);  //easy to put at front: bin LNs unordered
-  return map[bin]->value.second;
+  return add_node(std::move(key),T(),code)->value.second;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-const T& HashMap<KEY,T,thash>::operator [] (const KEY& key) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+const T& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator [] (const KEY& key) const {
   LN* c = find_key(key);
   if (c != nullptr)
     return c->value.second;
@@ -405,20 +754,22 @@ const T& HashMap<KEY,T,thash>::operator [] (const KEY& key) const {
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>& HashMap<KEY,T,thash>::operator = (const HashMap<KEY,T,thash>& rhs) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator = (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& rhs) {
   if (this == &rhs)
     return *this;
 
-  if (hash == rhs.hash && (double)rhs.size()/rhs.bins <= load_threshold) {
+  finish_rehash();
+  if (hash == rhs.hash && rhs.old_map == nullptr && (double)rhs.size()/rhs.bins <= load_threshold) {
     delete_hash_table(map,bins);
     map  = copy_hash_table(rhs.map,rhs.bins);
     bins = rhs.bins;
+    bits = rhs.bits;
     used = rhs.used;
   }else{
     clear();
-    for (int b=0; b<rhs.bins; ++b)
-      for (LN* c = rhs.map[b]; c->next!=nullptr; c=c->next)
+    for (std::int64_t b=0; b<rhs.all_bins(); ++b)
+      for (LN* c = rhs.bin_list(b); c!=nullptr && c->next!=nullptr; c=c->next)
         put(c->value.first,c->value.second);
   }
   ++mod_count;
@@ -426,15 +777,47 @@ HashMap<KEY,T,thash>& HashMap<KEY,T,thash>::operator = (const HashMap<KEY,T,thas
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::operator == (const HashMap<KEY,T,thash>& rhs) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator = (HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>&& rhs) noexcept {
+  if (this == &rhs)
+    return *this;
+
+  delete_all_bins();
+  nodes          = std::move(rhs.nodes);     //every node of this was just destroyed
+  hash           = rhs.hash;
+  map            = rhs.map;
+  load_threshold = rhs.load_threshold;
+  bins           = rhs.bins;
+  bits           = rhs.bits;
+  used           = rhs.used;
+  old_map        = rhs.old_map;
+  old_bins       = rhs.old_bins;
+  migrated       = rhs.migrated;
+  rehash_step    = rhs.rehash_step;
+  shrink_threshold = rhs.shrink_threshold;
+
+  rhs.map      = nullptr;
+  rhs.bins     = 0;
+  rhs.bits     = 0;
+  rhs.used     = 0;
+  rhs.old_map  = nullptr;
+  rhs.old_bins = 0;
+  rhs.migrated = 0;
+  ++rhs.mod_count;
+  ++mod_count;
+  return *this;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator == (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& rhs) const {
   if (this == &rhs)
     return true;
   if (used != rhs.size())
     return false;
 
-  for (int b=0; b<bins; ++b)
-    for (LN* c=map[b]; c->next!=nullptr; c=c->next) {
+  for (std::int64_t b=0; b<all_bins(); ++b)
+    for (LN* c=bin_list(b); c!=nullptr && c->next!=nullptr; c=c->next) {
       // Uses ! and ==, so != on T need not be defined
       LN* rhs_pair = rhs.find_key(c->value.first);
       if (rhs_pair == nullptr || !(c->value.second == rhs_pair->value.second))
@@ -448,19 +831,19 @@ bool HashMap<KEY,T,thash>::operator == (const HashMap<KEY,T,thash>& rhs) const {
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::operator != (const HashMap<KEY,T,thash>& rhs) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::operator != (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& rhs) const {
   return !(*this == rhs);
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-std::ostream& operator << (std::ostream& outs, const HashMap<KEY,T,thash>& m) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::ostream& operator << (std::ostream& outs, const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>& m) {
   outs << "map[";
 
-  int printed = 0;
-  for (int b=0; b<m.bins; ++b)
-    for (typename HashMap<KEY,T,thash>::LN* c = m.map[b]; c->next!=nullptr; c = c->next)
+  std::int64_t printed = 0;
+  for (std::int64_t b=0; b<m.all_bins(); ++b)
+    for (typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN* c = m.bin_list(b); c!=nullptr && c->next!=nullptr; c = c->next)
       outs << (printed++ == 0? "" : ",") << c->value.first << "->" << c->value.second;
 
   outs << "]";
@@ -472,15 +855,32 @@ std::ostream& operator << (std::ostream& outs, const HashMap<KEY,T,thash>& m) {
 //
 //Iterator constructors
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-auto HashMap<KEY,T,thash>::begin () const -> HashMap<KEY,T,thash>::Iterator {
-  return Iterator(const_cast<HashMap<KEY,T,thash>*>(this),true);
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+auto HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::begin () const -> HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator {
+  return Iterator(const_cast<HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>*>(this),true);
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-auto HashMap<KEY,T,thash>::end () const -> HashMap<KEY,T,thash>::Iterator {
-  return Iterator(const_cast<HashMap<KEY,T,thash>*>(this),false);
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+auto HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::end () const -> HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator {
+  return Iterator(const_cast<HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>*>(this),false);
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class Visitor>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::for_each (Visitor visit) const {
+  int expected_mod_count = mod_count;
+  std::int64_t all = all_bins();
+  for (std::int64_t b = 0; b < all; ++b) {
+    if (!old_map && b + scan_ahead < all)
+      ICS_PREFETCH(map[b + scan_ahead]);
+    for (LN* p = bin_list(b); p != nullptr && p->next != nullptr; p = p->next) {
+      visit(const_cast<const Entry&>(p->value));
+      if (Iteration::modified(expected_mod_count,mod_count))
+        throw ConcurrentModificationError("HashMap::for_each");
+    }
+  }
 }
 
 
@@ -488,25 +888,79 @@ auto HashMap<KEY,T,thash>::end () const -> HashMap<KEY,T,thash>::Iterator {
 //
 //Private helper methods
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-int HashMap<KEY,T,thash>::hash_compress (const KEY& key) const {
-  return abs(hash(key)) % bins;
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashCode HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::hash_code (const KEY& key) const {
+  return to_hash_code(hash(key));
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN*& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::bin_of (HashCode code) const {
+  if (old_map != nullptr) {
+    std::int64_t b = bin_index(code,bits-1);
+    if (b >= migrated)
+      return old_map[b];
+  }
+  return map[bin_index(code,bits)];
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::all_bins () const {
+  return old_map == nullptr ? bins : bins+old_bins;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN* HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::bin_list (std::int64_t b) const {
+  if (old_map == nullptr)
+    return map[b];
+  if (b < bins)
+    return b/2 < migrated ? map[b] : nullptr;
+  return b-bins >= migrated ? old_map[b-bins] : nullptr;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-typename HashMap<KEY,T,thash>::LN* HashMap<KEY,T,thash>::find_key (const KEY& key) const {
-  int bin = hash_compress(key);
-  for (LN* c = map[bin]; c->next!=nullptr; c=c->next)
-    if (key == c->value.first)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN* HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::find_key (const KEY& key) const {
+  return find_key(key,hash_code(key));
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class Probe>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN* HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::find_key (const Probe& key, HashCode code) const {
+  if (bins == 0)
+    return nullptr;
+  int probes = 0;
+  for (LN* c = bin_of(code); c->next!=nullptr; c=c->next) {
+    ++probes;
+    if (c->may_match(code) && key == c->value.first) { //CacheHash: compare codes first
+      counters.lookup(true,probes);
       return c;
+    }
+  }
 
+  counters.lookup(false,probes);
   return nullptr;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-typename HashMap<KEY,T,thash>::LN* HashMap<KEY,T,thash>::copy_list (LN* l) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN* HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::add_node (KEY&& key, T&& value, HashCode code) {
+  ensure_load_threshold(used+1);
+  ++used;
+  LN*& bin = bin_of(code);                         //bins may have changed in ensure_load_threshold!
+  LN*  n   = bin = nodes.create(std::move(key),std::move(value),bin);
+  n->set_code(code);
+  migrate_bins(rehash_step);                       //relinks n (and may deallocate the array bin is in)
+  ++mod_count;
+  return n;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN* HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::copy_list (LN* l) {
   //  //Recursive
   //  if (l == nullptr)
   //    return nullptr;
@@ -515,68 +969,196 @@ typename HashMap<KEY,T,thash>::LN* HashMap<KEY,T,thash>::copy_list (LN* l) const
 
   //Iterative: order in bin makes no difference, but Trailer must be at end
   if (l->next == nullptr)
-    return new LN();
+    return nodes.create();
 
-   LN* answer = new LN(l->value, new LN());
+   LN* answer = nodes.create(*l, nodes.create());
    for (LN* c = l->next; c->next != nullptr; c = c->next)
-     answer = new LN(c->value,answer);
+     answer = nodes.create(*c,answer);
 
   return answer;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-typename HashMap<KEY,T,thash>::LN** HashMap<KEY,T,thash>::copy_hash_table (LN** ht, int bins) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+typename HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::LN** HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::copy_hash_table (LN** ht, std::int64_t bins) {
   LN** answer = new LN*[bins];
-  for (int b=0; b<bins; ++b)
+  for (std::int64_t b=0; b<bins; ++b)
      answer[b] = copy_list(ht[b]);
   return answer;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-void HashMap<KEY,T,thash>::ensure_load_threshold(int new_used) {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::allocate_bins (std::int64_t at_least) {
+  bits = bin_bits(at_least);
+  bins = std::int64_t(1) << bits;
+  map = new LN*[bins];
+  nodes.reserve(bins);
+  for (std::int64_t b=0; b<bins; ++b)
+    map[b] = nodes.create();         //Put a trailer node in bin
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::ensure_load_threshold(std::int64_t new_used) {
+  if (bins == 0)        //moved from: start again with one bin
+    allocate_bins(1);
   if (double(new_used)/double(bins) <= load_threshold)
     return;
 
-  LN** old_map  = map;
-  int  old_bins = bins;
+  counters.resized();
+  typename Counters::Timer timing(counters);
+  finish_rehash();      //the previous resize is still moving bins
+
+  old_map  = map;
+  old_bins = bins;
+  migrated = 0;
 
   bins = 2*old_bins;
-  map = new LN*[bins];
+  ++bits;
+  map = new LN*[bins];  //trailers allocated as each old bin is moved into map
+
+  if (rehash_step == 0) {
+    nodes.reserve(bins);
+    finish_rehash();
+  }
+}
+
 
-  for (int b=0; b<bins; ++b)
-    map[b] = new LN();  //allocate trailers in new maps
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::migrate_bins(std::int64_t count) {
+  if (old_map == nullptr || count <= 0)
+    return;
 
-  for (int b=0; b<old_bins; ++b) {
+  typename Counters::Timer timing(counters);
+  for (; old_map != nullptr && count > 0; --count) {
+    //Keys in old bin b go to map[2b] or map[2b+1]
+    std::int64_t b = migrated++;
     LN* c = old_map[b];
+    map[2*b]   = nodes.create();
+    map[2*b+1] = nodes.create();
     for (; c->next!=nullptr; /*See body*/) {
-      int bin = hash_compress(c->value.first);
+      std::int64_t bin = bin_index(c->code(c->value.first,hash),bits);  //CacheHash: hash is not called
       LN* to_move = c;
       c = c->next;
       to_move->next = map[bin];
       map[bin] = to_move;
     }
-    delete c;           //deallocate trailers in old_map
+    nodes.destroy(c);           //deallocate trailer in old_map
+
+    if (migrated == old_bins) {
+      delete [] old_map;
+      old_map  = nullptr;
+      old_bins = 0;
+      migrated = 0;
+    }
+  }
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::finish_rehash() {
+  if (old_map != nullptr)
+    migrate_bins(old_bins-migrated);
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::bins_for(std::int64_t n) const {
+  std::int64_t b = std::int64_t(n/load_threshold);
+  return b*load_threshold < n ? b+1 : b;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::resize_bins(std::int64_t at_least) {
+  if (bins == 0) {      //moved from: nothing to relink
+    allocate_bins(at_least);
+    return;
   }
+  if (old_map != nullptr) {
+    finish_rehash();
+    ++mod_count;        //nodes moved between bins, even if no resize follows
+  }
+  if (bins == std::int64_t(1) << bin_bits(at_least))
+    return;
 
-  delete [] old_map;
+  counters.resized();
+  typename Counters::Timer timing(counters);
+  LN**         previous  = map;
+  std::int64_t old_count = bins;
+  allocate_bins(at_least);
+  //Relink each old node at the front of its new bin, as migrate_bins does
+  for (std::int64_t b=0; b<old_count; ++b) {
+    LN* c = previous[b];
+    for (; c->next!=nullptr; /*See body*/) {
+      std::int64_t bin = bin_index(c->code(c->value.first,hash),bits);  //CacheHash: hash is not called
+      LN* to_move = c;
+      c = c->next;
+      to_move->next = map[bin];
+      map[bin] = to_move;
+    }
+    nodes.destroy(c);           //deallocate old trailer
+  }
+  delete [] previous;
+  ++mod_count;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-void HashMap<KEY,T,thash>::delete_hash_table (LN**& ht, int bins) {
-  for (int b=0; b<bins; ++b)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::delete_hash_table (LN**& ht, std::int64_t bins) {
+  for (std::int64_t b=0; b<bins; ++b)
     for (LN* c=ht[b]; c!=nullptr; /*See body*/) {
       LN* to_delete = c;
       c = c->next;
-      delete to_delete;
+      nodes.destroy(to_delete);
   }
   delete[] ht;
   ht = nullptr;
 }
 
 
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::delete_all_bins () {
+  for (std::int64_t b=0; b<all_bins(); ++b)
+    for (LN* c=bin_list(b); c!=nullptr; /*See body*/) {
+      LN* to_delete = c;
+      c = c->next;
+      nodes.destroy(to_delete);
+    }
+  delete[] map;
+  delete[] old_map;
+  map     = nullptr;
+  old_map = nullptr;
+}
+
+
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+template<class Resolve>
+std::int64_t HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::probe_many (const KEY* keys, std::int64_t n, Resolve resolve) const {
+  const int batch = 16;                               //probes in flight at once
+  HashCode codes[batch];
+  std::int64_t found = 0;
+  for (std::int64_t first=0; first<n; first+=batch) {
+    int count = n-first < batch ? int(n-first) : batch;
+    for (int i=0; i<count; ++i)
+      codes[i] = hash_code(keys[first+i]);
+    if (bins != 0) {
+      for (int i=0; i<count; ++i)                     //the bins' pointers...
+        ICS_PREFETCH(&bin_of(codes[i]));
+      for (int i=0; i<count; ++i)                     //...then the lists' first nodes
+        ICS_PREFETCH(bin_of(codes[i]));
+    }
+    for (int i=0; i<count; ++i) {
+      LN* c = find_key(keys[first+i],codes[i]);
+      found += c != nullptr;
+      resolve(first+i,c);
+    }
+  }
+  return found;
+}
+
+
 
 
 
@@ -585,18 +1167,22 @@ void HashMap<KEY,T,thash>::delete_hash_table (LN**& ht, int bins) {
 //
 //Iterator class definitions
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-void HashMap<KEY,T,thash>::Iterator::advance_cursors(){
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+void HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::advance_cursors(){
   if (current.second != nullptr && current.second->next != nullptr && current.second->next->next != nullptr) {
     current.second = current.second->next;
     return;
   }else
-    for (int b=current.first+1; b<ref_map->bins; ++b)
-      if (ref_map->map[b]->next != nullptr) {
+    for (std::int64_t b=current.first+1, all=ref_map->all_bins(); b<all; ++b) {
+      if (ref_map->old_map == nullptr && b+scan_ahead < all)
+        ICS_PREFETCH(ref_map->map[b+scan_ahead]);   //The trailer of a bin ahead: each empty bin costs a miss
+      LN* l = ref_map->bin_list(b);
+      if (l != nullptr && l->next != nullptr) {
         current.first  = b;
-        current.second = ref_map->map[b];
+        current.second = l;
         return;
       }
+    }
 
   //Not found
   current.first  = -1;
@@ -604,8 +1190,8 @@ void HashMap<KEY,T,thash>::Iterator::advance_cursors(){
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::Iterator::Iterator(HashMap<KEY,T,thash>* iterate_over, bool from_begin)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::Iterator(HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>* iterate_over, bool from_begin)
 : ref_map(iterate_over), expected_mod_count(ref_map->mod_count) {
   current = Cursor(-1,nullptr);
   if (from_begin)
@@ -613,14 +1199,14 @@ HashMap<KEY,T,thash>::Iterator::Iterator(HashMap<KEY,T,thash>* iterate_over, boo
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-HashMap<KEY,T,thash>::Iterator::~Iterator()
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::~Iterator()
 {}
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-auto HashMap<KEY,T,thash>::Iterator::erase() -> Entry {
-  if (expected_mod_count != ref_map->mod_count)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+auto HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::erase() -> Entry {
+  if (Iteration::modified(expected_mod_count,ref_map->mod_count))
     throw ConcurrentModificationError("HashMap::Iterator::erase");
   if (!can_erase)
     throw CannotEraseError("HashMap::Iterator::erase Iterator cursor already erased");
@@ -628,29 +1214,29 @@ auto HashMap<KEY,T,thash>::Iterator::erase() -> Entry {
     throw CannotEraseError("HashMap::Iterator::erase Iterator cursor beyond data structure");
 
   can_erase = false;
-  Entry to_return = current.second->value;
+  Entry to_return = std::move(current.second->value);
   LN* to_delete = current.second->next;
-  *current.second = *(current.second->next);
+  current.second->take(to_delete);
 
   --ref_map->used;
   ++ref_map->mod_count;
   expected_mod_count = ref_map->mod_count;
-  delete to_delete;
+  ref_map->nodes.destroy(to_delete);
 
   return to_return;
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-std::string HashMap<KEY,T,thash>::Iterator::str() const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+std::string HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::str() const {
   std::ostringstream answer;
   answer << ref_map->str() << "(current=" << current.first << "/" << current.second << ",expected_mod_count=" << expected_mod_count << ",can_erase=" << can_erase << ")";
   return answer.str();
 }
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-auto  HashMap<KEY,T,thash>::Iterator::operator ++ () -> HashMap<KEY,T,thash>::Iterator& {
-  if (expected_mod_count != ref_map->mod_count)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+auto  HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::operator ++ () -> HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& {
+  if (Iteration::modified(expected_mod_count,ref_map->mod_count))
     throw ConcurrentModificationError("HashMap::Iterator::operator ++");
 
   if (current.second == nullptr)
@@ -664,9 +1250,9 @@ auto  HashMap<KEY,T,thash>::Iterator::operator ++ () -> HashMap<KEY,T,thash>::It
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-auto  HashMap<KEY,T,thash>::Iterator::operator ++ (int) -> HashMap<KEY,T,thash>::Iterator {
-  if (expected_mod_count != ref_map->mod_count)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+auto  HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::operator ++ (int) -> HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator {
+  if (Iteration::modified(expected_mod_count,ref_map->mod_count))
     throw ConcurrentModificationError("HashMap::Iterator::operator ++(int)");
 
   if (current.second == nullptr)
@@ -681,12 +1267,12 @@ auto  HashMap<KEY,T,thash>::Iterator::operator ++ (int) -> HashMap<KEY,T,thash>:
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::Iterator::operator == (const HashMap<KEY,T,thash>::Iterator& rhs) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::operator == (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& rhs) const {
   const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
   if (rhsASI == 0)
     throw IteratorTypeError("HashMap::Iterator::operator ==");
-  if (expected_mod_count != ref_map->mod_count)
+  if (Iteration::modified(expected_mod_count,ref_map->mod_count))
     throw ConcurrentModificationError("HashMap::Iterator::operator ==");
   if (ref_map != rhsASI->ref_map)
     throw ComparingDifferentIteratorsError("HashMap::Iterator::operator ==");
@@ -695,12 +1281,12 @@ bool HashMap<KEY,T,thash>::Iterator::operator == (const HashMap<KEY,T,thash>::It
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-bool HashMap<KEY,T,thash>::Iterator::operator != (const HashMap<KEY,T,thash>::Iterator& rhs) const {
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+bool HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::operator != (const HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator& rhs) const {
   const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
   if (rhsASI == 0)
     throw IteratorTypeError("HashMap::Iterator::operator !=");
-  if (expected_mod_count != ref_map->mod_count)
+  if (Iteration::modified(expected_mod_count,ref_map->mod_count))
     throw ConcurrentModificationError("HashMap::Iterator::operator !=");
   if (ref_map != rhsASI->ref_map)
     throw ComparingDifferentIteratorsError("HashMap::Iterator::operator !=");
@@ -709,10 +1295,9 @@ bool HashMap<KEY,T,thash>::Iterator::operator != (const HashMap<KEY,T,thash>::It
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-pair<KEY,T>& HashMap<KEY,T,thash>::Iterator::operator *() const {
-  if (expected_mod_count !=
-      ref_map->mod_count)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+pair<KEY,T>& HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::operator *() const {
+  if (Iteration::modified(expected_mod_count,ref_map->mod_count))
     throw ConcurrentModificationError("HashMap::Iterator::operator *");
   if (!can_erase || current.second == nullptr)
     throw IteratorPositionIllegal("HashMap::Iterator::operator * Iterator illegal");
@@ -721,10 +1306,9 @@ pair<KEY,T>& HashMap<KEY,T,thash>::Iterator::operator *() const {
 }
 
 
-template<class KEY,class T, int (*thash)(const KEY& a)>
-pair<KEY,T>* HashMap<KEY,T,thash>::Iterator::operator ->() const {
-  if (expected_mod_count !=
-      ref_map->mod_count)
+template<class KEY,class T, auto thash, class NodeAllocator, class HashCache, class Counters, class Iteration>
+pair<KEY,T>* HashMap<KEY,T,thash,NodeAllocator,HashCache,Counters,Iteration>::Iterator::operator ->() const {
+  if (Iteration::modified(expected_mod_count,ref_map->mod_count))
     throw ConcurrentModificationError("HashMap::Iterator::operator *");
   if (!can_erase || current.second == nullptr)
     throw IteratorPositionIllegal("HashMap::Iterator::operator -> Iterator illegal");
@@ -5,8 +5,15 @@
 #include <iostream>
 #include <sstream>
 #include <initializer_list>
+#include <utility>              //std::move, std::forward
 #include "ics_exceptions.hpp"
 #include "pair.hpp"
+#include "node_allocator.hpp"
+#include "hash_image.hpp"
+#include "hash_statistics.hpp"
+#include "hash_code.hpp"
+#include "template_function.hpp"
+#include "iteration_policy.hpp"
 
 
 namespace ics {
@@ -14,37 +21,69 @@ namespace ics {
 
 #ifndef undefinedhashdefined
 #define undefinedhashdefined
-template<class T>
-int undefinedhash (const T& a) {return 0;}
+template<class T, class R = int>
+R undefinedhash (const T& a) {return 0;}
 #endif /* undefinedhashdefined */
 
+#ifndef ICS_PREFETCH
+#if defined(__GNUC__) || defined(__clang__)
+#define ICS_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define ICS_PREFETCH(address)
+#endif
+#endif /* ICS_PREFETCH */
+
 //Instantiate the templated class supplying thash(a): produces a hash value for a.
 //If thash is defaulted to undefinedhash in the template, then a constructor must supply chash.
 //If both thash and chash are supplied, then they must be the same (by ==) function.
 //If neither is supplied, or both are supplied but different, TemplateFunctionError is raised.
 //The (unique) non-undefinedhash value supplied by thash/chash is stored in the instance variable hash.
-template<class T, int (*thash)(const T& a) = undefinedhash<T>> class HashSet {
+//A thash is called directly (see template_function.hpp), so it can be inlined; thash can also be
+//  functor<F> for a stateless functor class F (e.g., HashSet<int,functor<IntHash>>).
+//thash may return an int or a 64-bit value; sizes and bins are 64-bit, so a set can hold more
+//  than 2^31 elements. There are always 2^bits bins (see hash_code.hpp).
+//NodeAllocator (see node_allocator.hpp) allocates the list nodes: PoolNodeAllocator<> recycles erased
+//  nodes from slabs instead of calling new/delete for each one.
+//Counters (NoHashCounters or HashCounters, see hash_statistics.hpp) decides whether statistics()
+//  reports lookup probes and resizes too; with NoHashCounters the counting compiles to nothing.
+//Iteration (CheckedIteration or UncheckedIteration, see iteration_policy.hpp) decides whether
+//  Iterators and for_each check for concurrent modification.
+template<class T, auto thash = undefinedhash<T>, class NodeAllocator = HeapNodeAllocator, class Counters = NoHashCounters, class Iteration = CheckedIteration> class HashSet {
   public:
-    typedef int (*hashfunc) (const T& a);
+    typedef decltype(thash) hashfunc;  //int or 64-bit hash values: see hash_code.hpp
 
     //Destructor/Constructors
     ~HashSet ();
 
-    HashSet (double the_load_threshold = 1.0, int (*chash)(const T& a) = undefinedhash<T>);
-    explicit HashSet (int initial_bins, double the_load_threshold = 1.0, int (*chash)(const T& k) = undefinedhash<T>);
-    HashSet (const HashSet<T,thash>& to_copy, double the_load_threshold = 1.0, int (*chash)(const T& a) = undefinedhash<T>);
-    explicit HashSet (const std::initializer_list<T>& il, double the_load_threshold = 1.0, int (*chash)(const T& a) = undefinedhash<T>);
+    HashSet (double the_load_threshold = 1.0, hashfunc chash = undefinedhash<T>);
+    explicit HashSet (int initial_bins, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<T>);
+    HashSet (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& to_copy, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<T>);
+    HashSet (HashSet<T,thash,NodeAllocator,Counters,Iteration>&& to_move) noexcept;  //to_move is left with no bins (allocated when next needed)
+    explicit HashSet (const std::initializer_list<T>& il, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<T>);
 
     //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
     template <class Iterable>
-    explicit HashSet (const Iterable& i, double the_load_threshold = 1.0, int (*chash)(const T& a) = undefinedhash<T>);
+    explicit HashSet (const Iterable& i, double the_load_threshold = 1.0, hashfunc chash = undefinedhash<T>);
 
 
     //Queries
     bool empty      () const;
-    int  size       () const;
+    std::int64_t size () const;
     bool contains   (const T& element) const;
     std::string str () const; //supplies useful debugging information; contrast to operator <<
+    HashStatistics statistics () const; //chain lengths, collisions, (with HashCounters) probes/resizes
+
+    //Heterogeneous lookup: probe is any type comparable (probe == element) to T, with phash(probe) ==
+    //  hash(element) when they are equal (e.g., std::string_view probing std::string elements)
+    template<class Probe, class Code> bool contains (const Probe& probe, Code (*phash)(const Probe& p)) const;
+
+    //Batched contains of elements[0..n-1] (found[i] = contains(elements[i])): hashes a batch of
+    //  elements and prefetches their bins before searching any list; returns # found
+    std::int64_t contains_many (const T* elements, std::int64_t n, bool* found) const;
+
+    //Write an image of the set (see hash_image.hpp) that MappedHashSet (mapped_hash_map.hpp) can
+    //  search in place; T must be std::string or trivially copyable
+    void write_image (std::ostream& out) const;
 
     //Iterable class must support "for-each" loop: .begin()/.end() and prefix ++ on returned result
     template <class Iterable>
@@ -53,32 +92,55 @@ template<class T, int (*thash)(const T& a) = undefinedhash<T>> class HashSet {
 
     //Commands
     int  insert (const T& element);
+    int  insert (T&& element);
     int  erase  (const T& element);
     void clear  ();
 
+    //Restart the counts that statistics() reports (with HashCounters)
+    void reset_statistics ();
+
+    //Sizing: bins are always a power of 2. reserve(n) grows the bins (never shrinks them) so n elements
+    //  are within load_threshold: insert_all of n elements after reserve(n) never resizes.
+    //  rehash(at_least_bins) resizes, up or down, to at least at_least_bins bins and at least enough
+    //  bins for size() elements; shrink_to_fit() is rehash(0).
+    void reserve       (std::int64_t n);
+    void rehash        (std::int64_t at_least_bins);
+    void shrink_to_fit ();
+
+    //0 (the default): the bins never shrink on their own. Otherwise erase(element) calls shrink_to_fit
+    //  once size()/bins falls below low_water, and clear() shrinks to 1 bin. low_water is clamped to at
+    //  most load_threshold/4, so a set that just shrank (or grew) is not resized again right away.
+    //Iterator::erase never shrinks (it would move the nodes being iterated over): call shrink_to_fit after.
+    void set_shrink_threshold (double low_water);
+
+    //Construct T(args...) in a node and add it, returning 1, unless it is already in the set: return 0
+    template<class... Args>
+    int emplace (Args&&... args);
+
     //Iterable class must support "for" loop: .begin()/.end() and prefix ++ on returned result
 
     template <class Iterable>
-    int insert_all(const Iterable& i);
+    std::int64_t insert_all(const Iterable& i);
 
     template <class Iterable>
-    int erase_all(const Iterable& i);
+    std::int64_t erase_all(const Iterable& i);
 
     template<class Iterable>
-    int retain_all(const Iterable& i);
+    std::int64_t retain_all(const Iterable& i);
 
 
     //Operators
-    HashSet<T,thash>& operator = (const HashSet<T,thash>& rhs);
-    bool operator == (const HashSet<T,thash>& rhs) const;
-    bool operator != (const HashSet<T,thash>& rhs) const;
-    bool operator <= (const HashSet<T,thash>& rhs) const;
-    bool operator <  (const HashSet<T,thash>& rhs) const;
-    bool operator >= (const HashSet<T,thash>& rhs) const;
-    bool operator >  (const HashSet<T,thash>& rhs) const;
+    HashSet<T,thash,NodeAllocator,Counters,Iteration>& operator = (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs);
+    HashSet<T,thash,NodeAllocator,Counters,Iteration>& operator = (HashSet<T,thash,NodeAllocator,Counters,Iteration>&& rhs) noexcept;  //Takes rhs's hash/load_threshold too
+    bool operator == (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const;
+    bool operator != (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const;
+    bool operator <= (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const;
+    bool operator <  (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const;
+    bool operator >= (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const;
+    bool operator >  (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const;
 
-    template<class T2, int (*hash2)(const T2& a)>
-    friend std::ostream& operator << (std::ostream& outs, const HashSet<T2,hash2>& s);
+    template<class T2, auto hash2, class NodeAllocator2, class Counters2, class Iteration2>
+    friend std::ostream& operator << (std::ostream& outs, const HashSet<T2,hash2,NodeAllocator2,Counters2,Iteration2>& s);
 
 
 
@@ -88,29 +150,29 @@ template<class T, int (*thash)(const T& a) = undefinedhash<T>> class HashSet {
   public:
     class Iterator {
       public:
-        typedef pair<int,LN*> Cursor;
+        typedef pair<std::int64_t,LN*> Cursor;
 
-        //Private constructor called in begin/end, which are friends of HashSet<T,thash>
+        //Private constructor called in begin/end, which are friends of HashSet<T,thash,NodeAllocator,Counters,Iteration>
         ~Iterator();
         T           erase();
         std::string str  () const;
-        HashSet<T,thash>::Iterator& operator ++ ();
-        HashSet<T,thash>::Iterator  operator ++ (int);
-        bool operator == (const HashSet<T,thash>::Iterator& rhs) const;
-        bool operator != (const HashSet<T,thash>::Iterator& rhs) const;
+        HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& operator ++ ();
+        HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator  operator ++ (int);
+        bool operator == (const HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& rhs) const;
+        bool operator != (const HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& rhs) const;
         T& operator *  () const;
         T* operator -> () const;
-        friend std::ostream& operator << (std::ostream& outs, const HashSet<T,thash>::Iterator& i) {
+        friend std::ostream& operator << (std::ostream& outs, const HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& i) {
           outs << i.str(); //Use the same meaning as the debugging .str() method
           return outs;
         }
-        friend Iterator HashSet<T,thash>::begin () const;
-        friend Iterator HashSet<T,thash>::end   () const;
+        friend Iterator HashSet<T,thash,NodeAllocator,Counters,Iteration>::begin () const;
+        friend Iterator HashSet<T,thash,NodeAllocator,Counters,Iteration>::end   () const;
 
       private:
         //If can_erase is false, current indexes the "next" value (must ++ to reach it)
         Cursor              current; //Bin Index and Cursor; stop: LN* == nullptr
-        HashSet<T,thash>*   ref_set;
+        HashSet<T,thash,NodeAllocator,Counters,Iteration>*   ref_set;
         int                 expected_mod_count;
         bool                can_erase = true;
 
@@ -118,43 +180,61 @@ template<class T, int (*thash)(const T& a) = undefinedhash<T>> class HashSet {
         void advance_cursors();
 
         //Called in friends begin/end
-        Iterator(HashSet<T,thash>* iterate_over, bool from_begin);
+        Iterator(HashSet<T,thash,NodeAllocator,Counters,Iteration>* iterate_over, bool from_begin);
     };
 
 
     Iterator begin () const;
     Iterator end   () const;
 
+    //Internal iteration: visit(element) for each element (as a const T&), walking the bins without an Iterator;
+    //  visit must not change the set. With CheckedIteration, mod_count is compared after each visit (before
+    //  moving on), so ConcurrentModificationError is thrown after the visit that changed the set has run;
+    //  with UncheckedIteration the comparison compiles to nothing and such a change is undefined.
+    template<class Visitor>
+    void for_each (Visitor visit) const;
+
 
   private:
     class LN {
       public:
         LN ()                      {}
         LN (const LN& ln)          : value(ln.value), next(ln.next){}
-        LN (T v,  LN* n = nullptr) : value(v), next(n){}
+        LN (const T& v, LN* n = nullptr) : value(v), next(n){}
+        LN (T&& v, LN* n = nullptr)      : value(std::move(v)), next(n){}
 
         T   value;
         LN* next   = nullptr;
     };
 
 public:
-  int (*hash)(const T& k);   //Hashing function used (from template or constructor)
+  TemplateFunction<hashfunc,thash,undefinedhash<T>> hash;  //Hashing function used (from template or constructor)
 private:
   LN** set      = nullptr;   //Pointer to array of pointers: each bin stores a list with a trailer node
   double load_threshold;     //used/bins <= load_threshold
-  int bins      = 1;         //# bins in array (should start at 1 so hash_compress doesn't % 0)
-  int used      = 0;         //Cache for number of key->value pairs in the hash table
+  std::int64_t bins = 1;     //# bins in array: 2^bits (0 only once moved from)
+  int          bits = 0;
+  std::int64_t used = 0;     //Cache for number of key->value pairs in the hash table
   int mod_count = 0;         //For sensing concurrent modification
+  typename NodeAllocator::template Pool<LN> nodes; //Allocates every LN (trailers too); see node_allocator.hpp
+  Counters counters;         //Not copied or moved: counts the operations on this set
+  double shrink_threshold = 0; //erase shrinks the bins when used/bins < shrink_threshold; 0 means never
+  static constexpr std::int64_t scan_ahead = 8;//bins prefetched ahead while scanning past empty bins
 
 
   //Helper methods
-  int   hash_compress        (const T& key)              const;  //hash function ranged to [0,bins-1]
-  LN*   find_element         (const T& element)          const;  //Returns reference to element's node or nullptr
-  LN*   copy_list            (LN*   l)                   const;  //Copy the elements in a bin (order irrelevant)
-  LN**  copy_hash_table      (LN** ht, int bins)         const;  //Copy the bins/keys/values in ht tree (order in bins irrelevant)
-
-  void  ensure_load_threshold(int new_used);                     //Reallocate if load_threshold > load_threshold
-  void  delete_hash_table    (LN**& ht, int bins);               //Deallocate all LN in ht (and the ht itself; ht == nullptr)
+  std::int64_t hash_compress        (const T& key)              const;  //hash function ranged to [0,bins-1]
+  LN*          find_element         (const T& element)          const;  //Returns reference to element's node or nullptr
+  template<class Probe>
+  LN*          find_element         (const Probe& element, HashCode code) const; //Same, given to_hash_code(hash(element)) (or a Probe and its code)
+  LN*          copy_list            (LN*   l);                          //Copy the elements in a bin (order irrelevant)
+  LN**         copy_hash_table      (LN** ht, std::int64_t bins);       //Copy the bins/keys/values in ht tree (order in bins irrelevant)
+  void         allocate_bins        (std::int64_t at_least);            //set = 2^bits >= at_least bins, each with a trailer
+
+  void         ensure_load_threshold(std::int64_t new_used);            //Reallocate if load_threshold > load_threshold
+  void         delete_hash_table    (LN**& ht, std::int64_t bins);      //Deallocate all LN in ht (and the ht itself; ht == nullptr)
+  std::int64_t bins_for             (std::int64_t n)            const;  //# bins holding n elements within load_threshold
+  void         resize_bins          (std::int64_t at_least);            //Relink every node into 2^bits >= at_least bins
 };
 
 
@@ -167,95 +247,96 @@ private:
 //
 //Destructor/Constructors
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::~HashSet() {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::~HashSet() {
   delete_hash_table(set,bins);
 }
 
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::HashSet(double the_load_threshold, int (*chash)(const T& element))
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::HashSet(double the_load_threshold, hashfunc chash)
 : hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(the_load_threshold) {
   if (hash == (hashfunc)undefinedhash<T>)
     throw TemplateFunctionError("HashSet::default constructor: neither specified");
   if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
     throw TemplateFunctionError("HashSet::default constructor: both specified and different");
 
-  set = new LN*[bins];
-  for (int b=0; b<bins; ++b)
-    set[b] = new LN();
+  allocate_bins(1);
 }
 
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::HashSet(int initial_bins, double the_load_threshold, int (*chash)(const T& element))
-: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), bins(initial_bins), load_threshold(the_load_threshold) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::HashSet(int initial_bins, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(the_load_threshold) {
   if (hash == (hashfunc)undefinedhash<T>)
     throw TemplateFunctionError("HashSet::length constructor: neither specified");
   if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
     throw TemplateFunctionError("HashSet::length constructor: both specified and different");
 
-  if (bins < 1)
-    bins = 1;
-  set = new LN*[bins];
-  for (int b=0; b<bins; ++b)
-    set[b] = new LN();
+  allocate_bins(initial_bins);
 }
 
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::HashSet(const HashSet<T,thash>& to_copy, double the_load_threshold, int (*chash)(const T& element))
-: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(the_load_threshold), bins(to_copy.bins) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::HashSet(const HashSet<T,thash,NodeAllocator,Counters,Iteration>& to_copy, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(the_load_threshold) {
   if (hash == (hashfunc)undefinedhash<T>)
     hash = to_copy.hash;//throw TemplateFunctionError("HashSet::copy constructor: neither specified");
   if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
     throw TemplateFunctionError("HashSet::copy constructor: both specified and different");
 
+  shrink_threshold = to_copy.shrink_threshold;
   if (hash == to_copy.hash && (double)to_copy.size()/to_copy.bins <= the_load_threshold) {
+    bins = to_copy.bins;
+    bits = to_copy.bits;
     used = to_copy.used;
     set  = copy_hash_table(to_copy.set,to_copy.bins);
   }else {
-    bins = std::max(1,int(to_copy.size()/load_threshold));
-    set = new LN*[bins];
-    for (int b=0; b<bins; ++b)
-      set[b] = new LN();         //Put a trailer node in bin
-
-    for (int b=0; b<to_copy.bins; ++b)
+    allocate_bins(std::int64_t(to_copy.size()/load_threshold));
+    for (std::int64_t b=0; b<to_copy.bins; ++b)
       for (LN* c = to_copy.set[b]; c->next!=nullptr; c=c->next)
         insert(c->value);
   }
 }
 
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::HashSet(const std::initializer_list<T>& il, double the_load_threshold, int (*chash)(const T& element))
-: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(the_load_threshold), bins(std::max(1,int(il.size()/the_load_threshold))) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::HashSet(HashSet<T,thash,NodeAllocator,Counters,Iteration>&& to_move) noexcept
+: hash(to_move.hash), set(to_move.set), load_threshold(to_move.load_threshold), bins(to_move.bins), bits(to_move.bits), used(to_move.used),
+  nodes(std::move(to_move.nodes)), shrink_threshold(to_move.shrink_threshold) {
+  to_move.set  = nullptr;
+  to_move.bins = 0;
+  to_move.bits = 0;
+  to_move.used = 0;
+  ++to_move.mod_count;
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::HashSet(const std::initializer_list<T>& il, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(the_load_threshold) {
   if (hash == (hashfunc)undefinedhash<T>)
     throw TemplateFunctionError("HashSet::initializer_list constructor: neither specified");
   if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
     throw TemplateFunctionError("HashSet::initializer_list constructor: both specified and different");
 
-  set = new LN*[bins];
-  for (int b=0; b<bins; ++b)
-    set[b] = new LN();
+  allocate_bins(std::int64_t(il.size()/the_load_threshold));
 
   for (const T& v : il)
     insert(v);
 }
 
 
-template<class T, int (*thash)(const T& a)>
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
 template<class Iterable>
-HashSet<T,thash>::HashSet(const Iterable& i, double the_load_threshold, int (*chash)(const T& a))
-: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(the_load_threshold), bins(std::max(1,int(i.size()/the_load_threshold))) {
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::HashSet(const Iterable& i, double the_load_threshold, hashfunc chash)
+: hash(thash != (hashfunc)undefinedhash<T> ? thash : chash), load_threshold(the_load_threshold) {
   if (hash == (hashfunc)undefinedhash<T>)
     throw TemplateFunctionError("HashSet::Iterable constructor: neither specified");
   if (thash != (hashfunc)undefinedhash<T> && chash != (hashfunc)undefinedhash<T> && thash != chash)
     throw TemplateFunctionError("HashSet::Iterable constructor: both specified and different");
 
-  set = new LN*[bins];
-  for (int b=0; b<bins; ++b)
-    set[b] = new LN();
+  allocate_bins(std::int64_t(i.size()/the_load_threshold));
 
   for (const T& v : i)
     insert(v);
@@ -266,31 +347,72 @@ HashSet<T,thash>::HashSet(const Iterable& i, double the_load_threshold, int (*ch
 //
 //Queries
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::empty() const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::empty() const {
   return used == 0;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-int HashSet<T,thash>::size() const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::size() const {
   return used;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::contains (const T& element) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::contains (const T& element) const {
   return find_element(element) != nullptr;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-std::string HashSet<T,thash>::str() const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+template<class Probe, class Code>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::contains (const Probe& probe, Code (*phash)(const Probe& p)) const {
+  return find_element(probe,to_hash_code(phash(probe))) != nullptr;
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::contains_many (const T* elements, std::int64_t n, bool* found) const {
+  const int batch = 16;                               //probes in flight at once
+  HashCode codes[batch];
+  std::int64_t answer = 0;
+  for (std::int64_t first=0; first<n; first+=batch) {
+    int count = n-first < batch ? int(n-first) : batch;
+    for (int i=0; i<count; ++i)
+      codes[i] = to_hash_code(hash(elements[first+i]));
+    if (bins != 0) {
+      for (int i=0; i<count; ++i)                     //the bins' pointers...
+        ICS_PREFETCH(&set[bin_index(codes[i],bits)]);
+      for (int i=0; i<count; ++i)                     //...then the lists' first nodes
+        ICS_PREFETCH(set[bin_index(codes[i],bits)]);
+    }
+    for (int i=0; i<count; ++i) {
+      found[first+i] = find_element(elements[first+i],codes[i]) != nullptr;
+      answer += found[first+i];
+    }
+  }
+  return answer;
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::write_image (std::ostream& out) const {
+  HashImageWriter<T,T> image(false);
+  for (std::int64_t b=0; b<bins; ++b)
+    for (LN* c = set[b]; c->next!=nullptr; c=c->next)
+      image.add(to_hash_code(hash(c->value)),c->value,nullptr);
+  image.write(out,bins);
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::string HashSet<T,thash,NodeAllocator,Counters,Iteration>::str() const {
   std::ostringstream answer;
   answer << "HashSet[";
   if (bins != 0) {
     answer << std::endl;
-    for (int b=0; b<bins; ++b) {
+    for (std::int64_t b=0; b<bins; ++b) {
       answer << "bin[" << b << "] = ";
       for (LN* c = set[b]; c->next!=nullptr; c=c->next)
         answer << c->value << " -> " ;
@@ -303,9 +425,26 @@ std::string HashSet<T,thash>::str() const {
 }
 
 
-template<class T, int (*thash)(const T& a)>
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashStatistics HashSet<T,thash,NodeAllocator,Counters,Iteration>::statistics () const {
+  HashStatistics answer;
+  std::vector<HashCode> codes;
+  codes.reserve(used);
+  for (std::int64_t b=0; b<bins; ++b) {
+    int length = 0;
+    for (LN* c = set[b]; c->next!=nullptr; c=c->next, ++length)
+      codes.push_back(to_hash_code(hash(c->value)));
+    answer.count_chain(length);
+  }
+  answer.count_codes(codes);
+  counters.report(answer);
+  return answer;
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
 template <class Iterable>
-bool HashSet<T,thash>::contains_all(const Iterable& i) const {
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::contains_all(const Iterable& i) const {
   for (const T& v : i)
     if (!contains(v))
       return false;
@@ -318,8 +457,8 @@ bool HashSet<T,thash>::contains_all(const Iterable& i) const {
 //
 //Commands
 
-template<class T, int (*thash)(const T& a)>
-int HashSet<T,thash>::insert(const T& element) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+int HashSet<T,thash,NodeAllocator,Counters,Iteration>::insert(const T& element) {
   LN* c = find_element(element);
   if (c != nullptr)
       return 0;
@@ -328,48 +467,119 @@ int HashSet<T,thash>::insert(const T& element) {
 
   ++used;
   ++mod_count;
-  int bin = hash_compress(element);     //bins may have changed in ensure_load_threshold!
-  set[bin] = new LN(element,set[bin]);  //easy to put at front: bin LNs unordered
+  std::int64_t bin = hash_compress(element);     //bins may have changed in ensure_load_threshold!
+  set[bin] = nodes.create(element,set[bin]);  //easy to put at front: bin LNs unordered
   return 1;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-int HashSet<T,thash>::erase(const T& element) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+int HashSet<T,thash,NodeAllocator,Counters,Iteration>::insert(T&& element) {
+  if (find_element(element) != nullptr)
+    return 0;
+
+  ensure_load_threshold(used+1);
+
+  ++used;
+  ++mod_count;
+  std::int64_t bin = hash_compress(element);     //bins may have changed in ensure_load_threshold!
+  set[bin] = nodes.create(std::move(element),set[bin]);
+  return 1;
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+template<class... Args>
+int HashSet<T,thash,NodeAllocator,Counters,Iteration>::emplace(Args&&... args) {
+  LN* n = nodes.create(T(std::forward<Args>(args)...));
+  if (find_element(n->value) != nullptr) {
+    nodes.destroy(n);
+    return 0;
+  }
+
+  ensure_load_threshold(used+1);
+
+  ++used;
+  ++mod_count;
+  std::int64_t bin = hash_compress(n->value);    //bins may have changed in ensure_load_threshold!
+  n->next = set[bin];
+  set[bin] = n;
+  return 1;
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+int HashSet<T,thash,NodeAllocator,Counters,Iteration>::erase(const T& element) {
   LN* c = find_element(element);
   if (c == nullptr)
     return 0;
 
   LN* to_delete = c->next;
-  *c = *(c->next);
-  delete to_delete;
+  c->value = std::move(to_delete->value);
+  c->next  = to_delete->next;
+  nodes.destroy(to_delete);
   --used;
   ++mod_count;
+  if (used < shrink_threshold*bins)
+    shrink_to_fit();
   return 1;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-void HashSet<T,thash>::clear() {
-  for (int b=0; b<bins; ++b) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::clear() {
+  for (std::int64_t b=0; b<bins; ++b) {
     LN* l=set[b];
     for (; l->next!=nullptr; /*See body*/) {
       LN* to_delete = l;
       l = l->next;
-      delete to_delete;
+      nodes.destroy(to_delete);
     }
     set[b] = l;
   }
 
   used = 0;
   ++mod_count;
+  if (shrink_threshold > 0)
+    shrink_to_fit();
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::reset_statistics () {
+  counters.reset();
 }
 
 
-template<class T, int (*thash)(const T& a)>
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::reserve(std::int64_t n) {
+  if (bins_for(n) > bins)
+    resize_bins(bins_for(n));
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::rehash(std::int64_t at_least_bins) {
+  resize_bins(std::max(at_least_bins,bins_for(used)));
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::shrink_to_fit() {
+  rehash(0);
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::set_shrink_threshold(double low_water) {
+  shrink_threshold = std::min(std::max(0.,low_water),load_threshold/4);
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
 template<class Iterable>
-int HashSet<T,thash>::insert_all(const Iterable& i) {
-  int count = 0;
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::insert_all(const Iterable& i) {
+  std::int64_t count = 0;
   for (const T& v : i)
     count += insert(v);
 
@@ -377,30 +587,31 @@ int HashSet<T,thash>::insert_all(const Iterable& i) {
 }
 
 
-template<class T, int (*thash)(const T& a)>
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
 template<class Iterable>
-int HashSet<T,thash>::erase_all(const Iterable& i) {
-  int count = 0;
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::erase_all(const Iterable& i) {
+  std::int64_t count = 0;
   for (const T& v : i)
     count += erase(v);
   return count;
 }
 
 
-template<class T, int (*thash)(const T& a)>
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
 template<class Iterable>
-int HashSet<T,thash>::retain_all(const Iterable& i) {
-  HashSet<T,thash> s(i);
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::retain_all(const Iterable& i) {
+  HashSet<T,thash,NodeAllocator,Counters,Iteration> s(i);
 
-  int count = 0;
-  for (int b=0; b<bins; ++b)
+  std::int64_t count = 0;
+  for (std::int64_t b=0; b<bins; ++b)
     for (LN* c=set[b]; c->next!=nullptr; /*See body*/) {
       if (s.contains(c->value))
         c = c-> next;
       else{
         LN* to_delete = c->next;
-        *c = *(c->next);
-        delete to_delete;
+        c->value = std::move(to_delete->value);
+        c->next  = to_delete->next;
+        nodes.destroy(to_delete);
         ++count;
       }
     }
@@ -414,8 +625,8 @@ int HashSet<T,thash>::retain_all(const Iterable& i) {
 //
 //Operators
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>& HashSet<T,thash>::operator = (const HashSet<T,thash>& rhs) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>& HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator = (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) {
   if (this == &rhs)
     return *this;
 
@@ -423,10 +634,11 @@ HashSet<T,thash>& HashSet<T,thash>::operator = (const HashSet<T,thash>& rhs) {
     delete_hash_table(set,bins);
     set  = copy_hash_table(rhs.set,rhs.bins);
     bins = rhs.bins;
+    bits = rhs.bits;
     used = rhs.used;
   }else{
     clear();
-    for (int b=0; b<rhs.bins; ++b)
+    for (std::int64_t b=0; b<rhs.bins; ++b)
       for (LN* c = rhs.set[b]; c->next!=nullptr; c=c->next)
         insert(c->value);
   }
@@ -436,14 +648,39 @@ HashSet<T,thash>& HashSet<T,thash>::operator = (const HashSet<T,thash>& rhs) {
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::operator == (const HashSet<T,thash>& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>& HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator = (HashSet<T,thash,NodeAllocator,Counters,Iteration>&& rhs) noexcept {
+  if (this == &rhs)
+    return *this;
+
+  delete_hash_table(set,bins);
+  nodes          = std::move(rhs.nodes);     //every node of this was just destroyed
+  hash           = rhs.hash;
+  set            = rhs.set;
+  load_threshold = rhs.load_threshold;
+  bins           = rhs.bins;
+  bits           = rhs.bits;
+  used           = rhs.used;
+  shrink_threshold = rhs.shrink_threshold;
+
+  rhs.set  = nullptr;
+  rhs.bins = 0;
+  rhs.bits = 0;
+  rhs.used = 0;
+  ++rhs.mod_count;
+  ++mod_count;
+  return *this;
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator == (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const {
   if (this == &rhs)
     return true;
   if (used != rhs.size())
     return false;
 
-  for (int b=0; b<bins; ++b)
+  for (std::int64_t b=0; b<bins; ++b)
     for (LN* c=set[b]; c->next!=nullptr; c=c->next)
        if (!rhs.contains(c->value))
          return false;
@@ -452,20 +689,20 @@ bool HashSet<T,thash>::operator == (const HashSet<T,thash>& rhs) const {
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::operator != (const HashSet<T,thash>& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator != (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const {
   return !(*this == rhs);
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::operator <= (const HashSet<T,thash>& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator <= (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const {
   if (this == &rhs)
     return true;
   if (used > rhs.size())
     return false;
 
-  for (int b=0; b<bins; ++b)
+  for (std::int64_t b=0; b<bins; ++b)
     for (LN* c=set[b]; c->next!=nullptr; c=c->next)
       if (!rhs.contains(c->value))
         return false;
@@ -473,14 +710,14 @@ bool HashSet<T,thash>::operator <= (const HashSet<T,thash>& rhs) const {
   return true;
 }
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::operator < (const HashSet<T,thash>& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator < (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const {
   if (this == &rhs)
     return false;
   if (used >= rhs.size())
     return false;
 
-  for (int b=0; b<bins; ++b)
+  for (std::int64_t b=0; b<bins; ++b)
     for (LN* c=set[b]; c->next!=nullptr; c=c->next)
       if (!rhs.contains(c->value))
         return false;
@@ -489,25 +726,25 @@ bool HashSet<T,thash>::operator < (const HashSet<T,thash>& rhs) const {
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::operator >= (const HashSet<T,thash>& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator >= (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const {
   return rhs <= *this;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::operator > (const HashSet<T,thash>& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::operator > (const HashSet<T,thash,NodeAllocator,Counters,Iteration>& rhs) const {
   return rhs < *this;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-std::ostream& operator << (std::ostream& outs, const HashSet<T,thash>& s) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::ostream& operator << (std::ostream& outs, const HashSet<T,thash,NodeAllocator,Counters,Iteration>& s) {
   outs  << "set[";
 
-  int printed = 0;
-  for (int b=0; b<s.bins; ++b)
-    for (typename HashSet<T,thash>::LN* c = s.set[b]; c->next != nullptr; c = c->next)
+  std::int64_t printed = 0;
+  for (std::int64_t b=0; b<s.bins; ++b)
+    for (typename HashSet<T,thash,NodeAllocator,Counters,Iteration>::LN* c = s.set[b]; c->next != nullptr; c = c->next)
       outs << (printed++ == 0? "" : ",") << c->value;
 
   outs << "]";
@@ -519,15 +756,31 @@ std::ostream& operator << (std::ostream& outs, const HashSet<T,thash>& s) {
 //
 //Iterator constructors
 
-template<class T, int (*thash)(const T& a)>
-auto HashSet<T,thash>::begin () const -> HashSet<T,thash>::Iterator {
-  return Iterator(const_cast<HashSet<T,thash>*>(this),true);
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+auto HashSet<T,thash,NodeAllocator,Counters,Iteration>::begin () const -> HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator {
+  return Iterator(const_cast<HashSet<T,thash,NodeAllocator,Counters,Iteration>*>(this),true);
 }
 
 
-template<class T, int (*thash)(const T& a)>
-auto HashSet<T,thash>::end () const -> HashSet<T,thash>::Iterator {
-  return Iterator(const_cast<HashSet<T,thash>*>(this),false);
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+auto HashSet<T,thash,NodeAllocator,Counters,Iteration>::end () const -> HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator {
+  return Iterator(const_cast<HashSet<T,thash,NodeAllocator,Counters,Iteration>*>(this),false);
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+template<class Visitor>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::for_each (Visitor visit) const {
+  int expected_mod_count = mod_count;
+  for (std::int64_t b = 0; b < bins; ++b) {
+    if (b + scan_ahead < bins)
+      ICS_PREFETCH(set[b + scan_ahead]);
+    for (LN* p = set[b]; p->next != nullptr; p = p->next) {
+      visit(const_cast<const T&>(p->value));
+      if (Iteration::modified(expected_mod_count,mod_count))
+        throw ConcurrentModificationError("HashSet::for_each");
+    }
+  }
 }
 
 
@@ -535,24 +788,38 @@ auto HashSet<T,thash>::end () const -> HashSet<T,thash>::Iterator {
 //
 //Private helper methods
 
-template<class T, int (*thash)(const T& a)>
-int HashSet<T,thash>::hash_compress (const T& element) const {
-  return abs(hash(element)) % bins;
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::hash_compress (const T& element) const {
+  return bin_index(to_hash_code(hash(element)),bits);
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+typename HashSet<T,thash,NodeAllocator,Counters,Iteration>::LN* HashSet<T,thash,NodeAllocator,Counters,Iteration>::find_element (const T& element) const {
+  return find_element(element,to_hash_code(hash(element)));
 }
 
 
-template<class T, int (*thash)(const T& a)>
-typename HashSet<T,thash>::LN* HashSet<T,thash>::find_element (const T& element) const {
-  int bin = hash_compress(element);
-  for (LN* c = set[bin]; c->next!=nullptr; c=c->next)
-    if (element == c->value)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+template<class Probe>
+typename HashSet<T,thash,NodeAllocator,Counters,Iteration>::LN* HashSet<T,thash,NodeAllocator,Counters,Iteration>::find_element (const Probe& element, HashCode code) const {
+  if (bins == 0)
+    return nullptr;
+  int probes = 0;
+  for (LN* c = set[bin_index(code,bits)]; c->next!=nullptr; c=c->next) {
+    ++probes;
+    if (element == c->value) {
+      counters.lookup(true,probes);
       return c;
+    }
+  }
 
+  counters.lookup(false,probes);
   return nullptr;
 }
 
-template<class T, int (*thash)(const T& a)>
-typename HashSet<T,thash>::LN* HashSet<T,thash>::copy_list (LN* l) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+typename HashSet<T,thash,NodeAllocator,Counters,Iteration>::LN* HashSet<T,thash,NodeAllocator,Counters,Iteration>::copy_list (LN* l) {
 //    //Recursive
 //    if (l == nullptr)
 //      return nullptr;
@@ -561,61 +828,87 @@ typename HashSet<T,thash>::LN* HashSet<T,thash>::copy_list (LN* l) const {
 
   //Iterative: order in bin makes no difference, but Trailer must be at end
   if (l->next == nullptr)
-    return new LN();
+    return nodes.create();
 
-   LN* answer = new LN(l->value,new LN());
+   LN* answer = nodes.create(l->value,nodes.create());
    for (LN* c = l->next; c->next != nullptr; c = c->next)
-     answer = new LN(c->value,answer);
+     answer = nodes.create(c->value,answer);
 
   return answer;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-typename HashSet<T,thash>::LN** HashSet<T,thash>::copy_hash_table (LN** ht, int bins) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+typename HashSet<T,thash,NodeAllocator,Counters,Iteration>::LN** HashSet<T,thash,NodeAllocator,Counters,Iteration>::copy_hash_table (LN** ht, std::int64_t bins) {
   LN** answer = new LN*[bins];
-  for (int b=0; b<bins; ++b)
+  for (std::int64_t b=0; b<bins; ++b)
      answer[b] = copy_list(ht[b]);
   return answer;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-void HashSet<T,thash>::ensure_load_threshold(int new_used) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::allocate_bins (std::int64_t at_least) {
+  bits = bin_bits(at_least);
+  bins = std::int64_t(1) << bits;
+  set = new LN*[bins];
+  nodes.reserve(bins);
+  for (std::int64_t b=0; b<bins; ++b)
+    set[b] = nodes.create();
+}
+
+
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::ensure_load_threshold(std::int64_t new_used) {
   if (double(new_used)/double(bins) <= load_threshold)
     return;
 
-  LN** old_set  = set;
-  int  old_bins = bins;
+  resize_bins(2*bins);                  //bins is 0 once moved from
+}
 
-  bins = 2*old_bins;
-  set = new LN*[bins];
 
-  for (int b=0; b<bins; ++b)
-    set[b] = new LN();
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::int64_t HashSet<T,thash,NodeAllocator,Counters,Iteration>::bins_for(std::int64_t n) const {
+  std::int64_t b = std::int64_t(n/load_threshold);
+  return b*load_threshold < n ? b+1 : b;
+}
+
 
-  for (int b=0; b<old_bins; ++b) {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::resize_bins(std::int64_t at_least) {
+  if (bins != 0 && bins == std::int64_t(1) << bin_bits(at_least))
+    return;
+
+  counters.resized();
+  typename Counters::Timer timing(counters);
+  LN**         old_set  = set;
+  std::int64_t old_bins = bins;
+
+  allocate_bins(at_least);
+
+  for (std::int64_t b=0; b<old_bins; ++b) {
     LN* c = old_set[b];
     for (; c->next!=nullptr; /*See body*/) {
-      int bin = hash_compress(c->value);
+      std::int64_t bin = hash_compress(c->value);
       LN* to_move = c;
       c = c->next;
       to_move->next = set[bin];
       set[bin] = to_move;
     }
-    delete c;           //deallocate trailers in old_map
+    nodes.destroy(c);           //deallocate trailers in old_map
   }
   delete [] old_set;
+  ++mod_count;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-void HashSet<T,thash>::delete_hash_table (LN**& ht, int bins) {
-  for (int b=0; b<bins; ++b)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::delete_hash_table (LN**& ht, std::int64_t bins) {
+  for (std::int64_t b=0; b<bins; ++b)
     for (LN* c=ht[b]; c!=nullptr; /*See body*/) {
       LN* to_delete = c;
       c = c->next;
-      delete to_delete;
+      nodes.destroy(to_delete);
   }
   delete[] ht;
   ht = nullptr;
@@ -630,18 +923,21 @@ void HashSet<T,thash>::delete_hash_table (LN**& ht, int bins) {
 //
 //Iterator class definitions
 
-template<class T, int (*thash)(const T& a)>
-void HashSet<T,thash>::Iterator::advance_cursors() {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+void HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::advance_cursors() {
   if (current.second != nullptr && current.second->next != nullptr && current.second->next->next != nullptr) {
     current.second = current.second->next;
     return;
   }else
-    for (int b=current.first+1; b<ref_set->bins; ++b)
+    for (std::int64_t b=current.first+1; b<ref_set->bins; ++b) {
+      if (b+scan_ahead < ref_set->bins)
+        ICS_PREFETCH(ref_set->set[b+scan_ahead]);   //The trailer of a bin ahead: each empty bin costs a miss
       if (ref_set->set[b]->next != nullptr) {
         current.first  = b;
         current.second = ref_set->set[b];
         return;
       }
+    }
 
   //Not found
   current.first  = -1;
@@ -649,8 +945,8 @@ void HashSet<T,thash>::Iterator::advance_cursors() {
 }
 
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::Iterator::Iterator(HashSet<T,thash>* iterate_over, bool from_begin)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::Iterator(HashSet<T,thash,NodeAllocator,Counters,Iteration>* iterate_over, bool from_begin)
 : ref_set(iterate_over), expected_mod_count(ref_set->mod_count) {
   current = Cursor(-1,nullptr);
   if (from_begin)
@@ -658,14 +954,14 @@ HashSet<T,thash>::Iterator::Iterator(HashSet<T,thash>* iterate_over, bool from_b
 }
 
 
-template<class T, int (*thash)(const T& a)>
-HashSet<T,thash>::Iterator::~Iterator()
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::~Iterator()
 {}
 
 
-template<class T, int (*thash)(const T& a)>
-T HashSet<T,thash>::Iterator::erase() {
-  if (expected_mod_count != ref_set->mod_count)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+T HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::erase() {
+  if (Iteration::modified(expected_mod_count,ref_set->mod_count))
     throw ConcurrentModificationError("HashSet::Iterator::erase");
   if (!can_erase)
     throw CannotEraseError("HashSet::Iterator::erase Iterator cursor already erased");
@@ -673,30 +969,31 @@ T HashSet<T,thash>::Iterator::erase() {
     throw CannotEraseError("HashSet::Iterator::erase Iterator cursor beyond data structure");
 
   can_erase = false;
-  T to_return = current.second->value;
+  T to_return = std::move(current.second->value);
   LN* to_delete = current.second->next;
 
-  *current.second = *(current.second->next);
+  current.second->value = std::move(to_delete->value);
+  current.second->next  = to_delete->next;
   --ref_set->used;
   ++ref_set->mod_count;
   expected_mod_count = ref_set->mod_count;
-  delete to_delete;
+  ref_set->nodes.destroy(to_delete);
 
   return to_return;
 }
 
 
-template<class T, int (*thash)(const T& a)>
-std::string HashSet<T,thash>::Iterator::str() const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+std::string HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::str() const {
   std::ostringstream answer;
   answer << ref_set->str() << "(current=" << current.first << "/" << current.second << ",expected_mod_count=" << expected_mod_count << ",can_erase=" << can_erase << ")";
   return answer.str();
 }
 
 
-template<class T, int (*thash)(const T& a)>
-auto  HashSet<T,thash>::Iterator::operator ++ () -> HashSet<T,thash>::Iterator& {
-  if (expected_mod_count != ref_set->mod_count)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+auto  HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::operator ++ () -> HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& {
+  if (Iteration::modified(expected_mod_count,ref_set->mod_count))
     throw ConcurrentModificationError("HashSet::Iterator::operator ++");
 
   if (current.second == nullptr)
@@ -710,9 +1007,9 @@ auto  HashSet<T,thash>::Iterator::operator ++ () -> HashSet<T,thash>::Iterator&
 }
 
 
-template<class T, int (*thash)(const T& a)>
-auto  HashSet<T,thash>::Iterator::operator ++ (int) -> HashSet<T,thash>::Iterator {
-  if (expected_mod_count != ref_set->mod_count)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+auto  HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::operator ++ (int) -> HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator {
+  if (Iteration::modified(expected_mod_count,ref_set->mod_count))
     throw ConcurrentModificationError("HashSet::Iterator::operator ++(int)");
 
   if (current.second == nullptr)
@@ -727,12 +1024,12 @@ auto  HashSet<T,thash>::Iterator::operator ++ (int) -> HashSet<T,thash>::Iterato
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::Iterator::operator == (const HashSet<T,thash>::Iterator& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::operator == (const HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& rhs) const {
   const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
   if (rhsASI == 0)
     throw IteratorTypeError("HashSet::Iterator::operator ==");
-  if (expected_mod_count != ref_set->mod_count)
+  if (Iteration::modified(expected_mod_count,ref_set->mod_count))
     throw ConcurrentModificationError("HashSet::Iterator::operator ==");
   if (ref_set != rhsASI->ref_set)
     throw ComparingDifferentIteratorsError("HashSet::Iterator::operator ==");
@@ -741,12 +1038,12 @@ bool HashSet<T,thash>::Iterator::operator == (const HashSet<T,thash>::Iterator&
 }
 
 
-template<class T, int (*thash)(const T& a)>
-bool HashSet<T,thash>::Iterator::operator != (const HashSet<T,thash>::Iterator& rhs) const {
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+bool HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::operator != (const HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator& rhs) const {
   const Iterator* rhsASI = dynamic_cast<const Iterator*>(&rhs);
   if (rhsASI == 0)
     throw IteratorTypeError("HashSet::Iterator::operator !=");
-  if (expected_mod_count != ref_set->mod_count)
+  if (Iteration::modified(expected_mod_count,ref_set->mod_count))
     throw ConcurrentModificationError("HashSet::Iterator::operator !=");
   if (ref_set != rhsASI->ref_set)
     throw ComparingDifferentIteratorsError("HashSet::Iterator::operator !=");
@@ -754,10 +1051,9 @@ bool HashSet<T,thash>::Iterator::operator != (const HashSet<T,thash>::Iterator&
   return this->current.second != rhsASI->current.second;
 }
 
-template<class T, int (*thash)(const T& a)>
-T& HashSet<T,thash>::Iterator::operator *() const {
-  if (expected_mod_count !=
-      ref_set->mod_count)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+T& HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::operator *() const {
+  if (Iteration::modified(expected_mod_count,ref_set->mod_count))
     throw ConcurrentModificationError("HashSet::Iterator::operator *");
   if (!can_erase || current.second == nullptr)
     throw IteratorPositionIllegal("HashSet::Iterator::operator * Iterator illegal");
@@ -765,10 +1061,9 @@ T& HashSet<T,thash>::Iterator::operator *() const {
   return current.second->value;
 }
 
-template<class T, int (*thash)(const T& a)>
-T* HashSet<T,thash>::Iterator::operator ->() const {
-  if (expected_mod_count !=
-      ref_set->mod_count)
+template<class T, auto thash, class NodeAllocator, class Counters, class Iteration>
+T* HashSet<T,thash,NodeAllocator,Counters,Iteration>::Iterator::operator ->() const {
+  if (Iteration::modified(expected_mod_count,ref_set->mod_count))
     throw ConcurrentModificationError("HashSet::Iterator::operator *");
   if (!can_erase || current.second == nullptr)
     throw IteratorPositionIllegal("HashSet::Iterator::operator * Iterator illegal");
@@ -0,0 +1,450 @@
+#ifndef INTERNED_GRAPH_HPP_
+#define INTERNED_GRAPH_HPP_
+
+#include <string>
+#include <string_view>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdint>
+#include "ics_exceptions.hpp"
+#include "ics46goody.hpp"       //ics::split
+#include "pair.hpp"
+#include "heap_priority_queue.hpp"
+#include "string_interner.hpp"
+
+
+namespace ics {
+
+
+//InternedHashGraph has HashGraph's queries and commands, but stores each node name once, in a
+//  StringInterner; all its maps and sets are keyed by the names' Symbols (see string_interner.hpp).
+//HashGraph stores a name in node_values, in the Edge key of edge_values for each of its edges, and
+//  again in the neighbor sets (out_nodes/in_nodes and out_edges/in_edges) of the nodes at both ends:
+//  here each of those is a 4-byte Symbol (an Edge is 8 bytes), hashed and compared as an integer.
+//Queries and commands take names (as views); all_nodes, out_nodes, ... return the Symbol-keyed
+//  maps and sets, whose Symbols name(...) turns back into names.
+//Removing a node does not remove its name from the interner: Symbols stay valid (and stable), and
+//  adding the node again reuses its Symbol. clear() empties the interner too.
+template<class T>
+class InternedHashGraph {
+  //Forward declaration: used in typedefs below
+  private:
+    class LocalInfo;
+
+  public:
+    //Typedefs
+    typedef std::string_view            NodeView;
+    typedef Symbol                      Node;
+    typedef SymbolEdge                  Edge;
+
+    typedef SymbolMap<LocalInfo>        NodeMap;
+    typedef SymbolEdgeMap<T>            EdgeMap;
+    typedef pair<Node, LocalInfo>       NodeMapEntry;
+    typedef pair<Edge, T>               EdgeMapEntry;
+
+    typedef SymbolSet                   NodeSet;
+    typedef SymbolEdgeSet               EdgeSet;
+
+    static bool name_gt(const NodeView& a, const NodeView& b)
+    {return a < b;}
+
+
+    //Destructor/Constructors
+    ~InternedHashGraph();
+    InternedHashGraph();
+    InternedHashGraph(const InternedHashGraph<T>& g);
+
+    //Queries
+    bool         empty      ()                                     const;
+    std::int64_t node_count ()                                     const;
+    std::int64_t edge_count ()                                     const;
+    bool         has_node  (NodeView node_name)                    const;
+    bool         has_edge  (NodeView origin, NodeView destination) const;
+    T            edge_value(NodeView origin, NodeView destination) const;
+    std::int64_t in_degree (NodeView node_name)                    const;
+    std::int64_t out_degree(NodeView node_name)                    const;
+    std::int64_t degree    (NodeView node_name)                    const;
+
+    const NodeMap& all_nodes()                   const;
+    const EdgeMap& all_edges()                   const;
+    const NodeSet& out_nodes(NodeView node_name) const;
+    const NodeSet& in_nodes (NodeView node_name) const;
+    const EdgeSet& out_edges(NodeView node_name) const;
+    const EdgeSet& in_edges (NodeView node_name) const;
+
+    //Names and Symbols
+    Node                  node (NodeView node_name) const;  //GraphError if node_name is not a node
+    NodeView              name (Node n)             const;  //KeyError if n was never a node's Symbol
+    const StringInterner& names()                   const;
+
+    //Commands
+    Node add_node   (NodeView node_name);                    //Returns node_name's Symbol
+    void add_edge   (NodeView origin, NodeView destination, T value);
+    void remove_node(NodeView node_name);
+    void remove_edge(NodeView origin, NodeView destination);
+    void clear      ();
+    void load       (std::ifstream& in_file,  std::string separator = ";");
+    void store      (std::ofstream& out_file, std::string separator = ";");
+
+    //Operators
+    InternedHashGraph<T>& operator = (const InternedHashGraph<T>& rhs);
+    bool operator == (const InternedHashGraph<T>& rhs) const;
+    bool operator != (const InternedHashGraph<T>& rhs) const;
+
+    template<class T2>
+    friend std::ostream& operator<<(std::ostream& outs, const InternedHashGraph<T2>& g);
+
+
+  private:
+    class LocalInfo {
+      public:
+        bool operator == (const LocalInfo& rhs) const {
+          //No need to check in_nodes and out_nodes: redundant information there
+          return in_edges == rhs.in_edges && out_edges == rhs.out_edges;
+        }
+        bool operator != (const LocalInfo& rhs) const {
+          return !(*this == rhs);
+        }
+        friend std::ostream& operator<<(std::ostream& outs, const LocalInfo& li) {
+          return outs << "LocalInfo[out_nodes = " << li.out_nodes << ", in_nodes = " << li.in_nodes << "]";
+        }
+
+        NodeSet out_nodes;
+        NodeSet in_nodes;
+        EdgeSet out_edges;
+        EdgeSet in_edges;
+    };
+
+    //InternedHashGraph<T> class instance variables
+    StringInterner node_names;
+    NodeMap        node_values;
+    EdgeMap        edge_values;
+
+    //Helper methods
+    Node             graph_node (NodeView node_name, const char* where) const; //GraphError if not a node
+    const LocalInfo& local_info (NodeView node_name, const char* where) const;
+};
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//InternedHashGraph: the class and related definitions
+
+//Destructor/Constructors
+
+template<class T>
+InternedHashGraph<T>::~InternedHashGraph ()
+{}
+
+
+template<class T>
+InternedHashGraph<T>::InternedHashGraph ()
+{}
+
+
+//The copied interner gives every name the same Symbol, so the maps and sets are copied as they are
+template<class T>
+InternedHashGraph<T>::InternedHashGraph (const InternedHashGraph<T>& g)
+: node_names(g.node_names), node_values(g.node_values), edge_values(g.edge_values)
+{}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Queries
+
+template<class T>
+bool InternedHashGraph<T>::empty() const {
+  return node_values.size() == 0;
+}
+
+
+template<class T>
+std::int64_t InternedHashGraph<T>::node_count() const {
+  return node_values.size();
+}
+
+
+template<class T>
+std::int64_t InternedHashGraph<T>::edge_count() const {
+  return edge_values.size();
+}
+
+
+template<class T>
+bool InternedHashGraph<T>::has_node(NodeView node_name) const {
+  Node n = node_names.find(node_name);
+  return n != StringInterner::no_symbol && node_values.has_key(n);
+}
+
+
+template<class T>
+bool InternedHashGraph<T>::has_edge(NodeView origin, NodeView destination) const {
+  Node o = node_names.find(origin), d = node_names.find(destination);
+  return o != StringInterner::no_symbol && d != StringInterner::no_symbol && edge_values.has_key(Edge(o,d));
+}
+
+
+template<class T>
+T InternedHashGraph<T>::edge_value(NodeView origin, NodeView destination) const {
+  if (!has_edge(origin, destination))
+    throw GraphError("InternedHashGraph::edge_value: edge not in graph");
+  return edge_values[Edge(node_names.find(origin),node_names.find(destination))];
+}
+
+
+template<class T>
+std::int64_t InternedHashGraph<T>::in_degree(NodeView node_name) const {
+  return local_info(node_name,"in_degree").in_nodes.size();
+}
+
+
+template<class T>
+std::int64_t InternedHashGraph<T>::out_degree(NodeView node_name) const {
+  return local_info(node_name,"out_degree").out_nodes.size();
+}
+
+
+template<class T>
+std::int64_t InternedHashGraph<T>::degree(NodeView node_name) const {
+  const LocalInfo& li = local_info(node_name,"degree");
+  return li.in_nodes.size() + li.out_nodes.size();
+}
+
+
+//The user should not mutate the returned maps and sets: call Graph commands instead
+template<class T>
+auto InternedHashGraph<T>::all_nodes () const -> const NodeMap& {
+  return node_values;
+}
+
+
+template<class T>
+auto InternedHashGraph<T>::all_edges () const -> const EdgeMap& {
+  return edge_values;
+}
+
+
+template<class T>
+auto InternedHashGraph<T>::out_nodes(NodeView node_name) const -> const NodeSet& {
+  return local_info(node_name,"out_nodes").out_nodes;
+}
+
+
+template<class T>
+auto InternedHashGraph<T>::in_nodes(NodeView node_name) const -> const NodeSet& {
+  return local_info(node_name,"in_nodes").in_nodes;
+}
+
+
+template<class T>
+auto InternedHashGraph<T>::out_edges(NodeView node_name) const -> const EdgeSet& {
+  return local_info(node_name,"out_edges").out_edges;
+}
+
+
+template<class T>
+auto InternedHashGraph<T>::in_edges(NodeView node_name) const -> const EdgeSet& {
+  return local_info(node_name,"in_edges").in_edges;
+}
+
+
+template<class T>
+auto InternedHashGraph<T>::node(NodeView node_name) const -> Node {
+  return graph_node(node_name,"node");
+}
+
+
+template<class T>
+auto InternedHashGraph<T>::name(Node n) const -> NodeView {
+  return node_names.name(n);
+}
+
+
+template<class T>
+const StringInterner& InternedHashGraph<T>::names() const {
+  return node_names;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Commands
+
+template<class T>
+auto InternedHashGraph<T>::add_node (NodeView node_name) -> Node {
+  Node n = node_names.intern(node_name);
+  node_values.try_emplace(n);
+  return n;
+}
+
+
+template<class T>
+void InternedHashGraph<T>::add_edge (NodeView origin, NodeView destination, T value) {
+  Node o = add_node(origin);
+  Node d = add_node(destination);
+  edge_values.put(Edge(o,d), value);
+  LocalInfo& oli = node_values[o];
+  oli.out_nodes.insert(d);
+  oli.out_edges.insert(Edge(o,d));
+  LocalInfo& dli = node_values[d];
+  dli.in_nodes.insert(o);
+  dli.in_edges.insert(Edge(o,d));
+}
+
+
+//If node_name is not in the graph, do nothing
+template<class T>
+void InternedHashGraph<T>::remove_node (NodeView node_name) {
+  if (!has_node(node_name))
+    return;
+  Node n = node_names.find(node_name);
+  NodeSet ins  = node_values[n].in_nodes;     //Copies: remove_edge changes the originals
+  NodeSet outs = node_values[n].out_nodes;
+  for (Node o : ins)
+    remove_edge(node_names.name(o), node_name);
+  for (Node d : outs)
+    remove_edge(node_name, node_names.name(d));
+  node_values.erase(n);
+}
+
+
+//If the edge is not in the graph, do nothing
+template<class T>
+void InternedHashGraph<T>::remove_edge (NodeView origin, NodeView destination) {
+  if (!has_edge(origin, destination))
+    return;
+  Node o = node_names.find(origin), d = node_names.find(destination);
+  edge_values.erase(Edge(o,d));
+  LocalInfo& oli = node_values[o];
+  oli.out_edges.erase(Edge(o,d));
+  oli.out_nodes.erase(d);
+  LocalInfo& dli = node_values[d];
+  dli.in_edges.erase(Edge(o,d));
+  dli.in_nodes.erase(o);
+}
+
+
+template<class T>
+void InternedHashGraph<T>::clear() {
+  edge_values.clear();
+  node_values.clear();
+  node_names.clear();
+}
+
+
+//The same file format as HashGraph::load: a node name per line, then origin/destination/value
+//  triples (separated by separator), one per line
+template<class T>
+void InternedHashGraph<T>::load (std::ifstream& in_file, std::string separator) {
+  std::string line;
+  while (getline(in_file,line)) {
+    std::vector<std::string> vline = ics::split(line, separator);
+    if (vline.size() == 1)
+      add_node(vline[0]);
+    else {
+      std::istringstream stream(vline[2]);
+      T value;
+      stream >> value;
+      add_edge(vline[0], vline[1], value);
+    }
+  }
+}
+
+
+template<class T>
+void InternedHashGraph<T>::store(std::ofstream& out_file, std::string separator) {
+  for (const NodeMapEntry& n : node_values)
+    out_file << node_names.name(n.first) << '\n';
+  for (const EdgeMapEntry& e : edge_values)
+    out_file << node_names.name(e.first.first) << separator << node_names.name(e.first.second) << separator << e.second << '\n';
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Operators
+
+template<class T>
+InternedHashGraph<T>& InternedHashGraph<T>::operator = (const InternedHashGraph<T>& rhs) {
+  if (this == &rhs)
+    return *this;
+  node_names  = rhs.node_names;
+  node_values = rhs.node_values;
+  edge_values = rhs.edge_values;
+  return *this;
+}
+
+
+//The same nodes (by name) with the same edges (and values); the graphs' Symbols may differ
+template<class T>
+bool InternedHashGraph<T>::operator == (const InternedHashGraph<T>& rhs) const {
+  if (this == &rhs)
+    return true;
+  if (node_count() != rhs.node_count() || edge_count() != rhs.edge_count())
+    return false;
+  for (const NodeMapEntry& n : node_values)
+    if (!rhs.has_node(node_names.name(n.first)))
+      return false;
+  for (const EdgeMapEntry& e : edge_values) {
+    NodeView o = node_names.name(e.first.first), d = node_names.name(e.first.second);
+    if (!rhs.has_edge(o,d) || !(e.second == rhs.edge_value(o,d)))
+      return false;
+  }
+  return true;
+}
+
+
+template<class T>
+bool InternedHashGraph<T>::operator != (const InternedHashGraph<T>& rhs) const {
+  return !(*this == rhs);
+}
+
+
+//Nodes in alphabetic order, each with its out edges (and their values)
+template<class T>
+std::ostream& operator<<(std::ostream& outs, const InternedHashGraph<T>& g) {
+  ics::HeapPriorityQueue<typename InternedHashGraph<T>::NodeView> hpq(g.name_gt);
+  for (const auto& n : g.node_values)
+    hpq.enqueue(g.node_names.name(n.first));
+
+  outs << "InternedHashGraph[\n";
+  while (!hpq.empty()) {
+    auto name = hpq.dequeue();
+    outs << name << " -> [";
+    int printed = 0;
+    for (const auto& e : g.out_edges(name))
+      outs << (printed++ == 0 ? "" : ",") << g.node_names.name(e.second) << "(" << g.edge_values[e] << ")";
+    outs << "]" << std::endl;
+  }
+  outs << "]";
+  return outs;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//Private helper methods
+
+template<class T>
+auto InternedHashGraph<T>::graph_node (NodeView node_name, const char* where) const -> Node {
+  Node n = node_names.find(node_name);
+  if (n == StringInterner::no_symbol || !node_values.has_key(n))
+    throw GraphError(std::string("InternedHashGraph::") + where + ": node not in graph");
+  return n;
+}
+
+
+template<class T>
+auto InternedHashGraph<T>::local_info (NodeView node_name, const char* where) const -> const LocalInfo& {
+  return node_values[graph_node(node_name,where)];
+}
+
+
+}
+
+#endif /* INTERNED_GRAPH_HPP_ */
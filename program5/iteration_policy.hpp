@@ -0,0 +1,34 @@
+#ifndef ITERATION_POLICY_HPP_
+#define ITERATION_POLICY_HPP_
+
+
+namespace ics {
+
+
+//The Iteration template argument of HashMap, HashSet, BSTMap and HeapPriorityQueue: whether their
+//  Iterators (and for_each) check for concurrent modification.
+//CheckedIteration (the default): each Iterator operation compares the container's mod_count to the
+//  one the Iterator expects, throwing ConcurrentModificationError if they differ.
+//UncheckedIteration: modified is a constant false, so those comparisons (and the throws) compile to
+//  nothing; for read-only bulk scans. As with std:: containers, using an Iterator after its container
+//  is changed (other than by that Iterator's erase) is then undefined. The position checks
+//  (IteratorPositionIllegal, CannotEraseError) remain.
+//for_each calls modified after each visit (not once per scan): with CheckedIteration, the visit that
+//  changed the container has run by the time ConcurrentModificationError is thrown.
+class CheckedIteration {
+  public:
+    static constexpr bool checked = true;
+    static bool modified (int expected_mod_count, int mod_count) {return expected_mod_count != mod_count;}
+};
+
+
+class UncheckedIteration {
+  public:
+    static constexpr bool checked = false;
+    static constexpr bool modified (int expected_mod_count, int mod_count) {return false;}
+};
+
+
+}
+
+#endif /* ITERATION_POLICY_HPP_ */
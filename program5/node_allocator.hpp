@@ -0,0 +1,200 @@
+#ifndef NODE_ALLOCATOR_HPP_
+#define NODE_ALLOCATOR_HPP_
+
+#include <new>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+
+
+namespace ics {
+
+
+//Node allocation policies for the linked-list containers (HashMap, HashSet).
+//A policy supplies a nested template Pool<N>, of which each container instance owns one
+//  (never copied: a copied container builds its nodes in its own Pool; a moved container takes
+//  its Pool along with its nodes, leaving an empty Pool behind). Pool<N> supports
+//    N*   create (args...) : a new N constructed from args
+//    void destroy(N* n)    : destruct/deallocate n (which create returned)
+//    void reserve(std::int64_t n) : hint that n creates are coming (e.g., the trailers for new bins)
+
+
+//Each node is allocated by new and deallocated by delete
+class HeapNodeAllocator {
+  public:
+    template<class N> class Pool {
+      public:
+        Pool () {}
+        Pool (const Pool& p)             = delete;
+        Pool (Pool&& p) noexcept         {}
+        Pool& operator = (const Pool& p) = delete;
+        Pool& operator = (Pool&& p) noexcept {return *this;}
+
+        template<class... Args>
+        N*   create  (Args&&... args) {return new N(std::forward<Args>(args)...);}
+        void destroy (N* n)           {delete n;}
+        void reserve (std::int64_t n) {}
+    };
+};
+
+
+//Nodes are carved from slabs holding (at least) slab_nodes nodes; destroy puts a node
+//  on a freelist, which create reuses before carving any more of a slab. Slabs are deallocated
+//  only when the Pool is (when its container is destructed), so memory stays at its high-water mark.
+//reserve(n) allocates one slab big enough for n nodes when the freelist plus the unused part of
+//  the current slab cannot supply them, so a container resize costs one allocation, not one per bin.
+template<int slab_nodes = 256>
+class PoolNodeAllocator {
+  public:
+    template<class N> class Pool {
+      public:
+        Pool () {}
+        Pool (const Pool& p)             = delete;
+        Pool (Pool&& p) noexcept;
+        Pool& operator = (const Pool& p) = delete;
+        Pool& operator = (Pool&& p) noexcept;    //Only when every node this Pool created is destroyed
+        ~Pool();
+
+        template<class... Args>
+        N*   create  (Args&&... args);
+        void destroy (N* n);
+        void reserve (std::int64_t n);
+
+      private:
+        //A free Slot links to the next free Slot; a used one holds an N.
+        //Slot 0 of each slab links to the previous slab (for deallocation).
+        union Slot {
+          Slot* next;
+          typename std::aligned_storage<sizeof(N),alignof(N)>::type node;
+        };
+
+        Slot* slabs      = nullptr;  //Most recent slab (its slot 0 links to the one before)
+        Slot* free_list  = nullptr;  //Destroyed nodes, most recent first
+        std::int64_t free_count = 0; //# of Slots in free_list
+        Slot* unused     = nullptr;  //Next never-used Slot in the current slab
+        Slot* unused_end = nullptr;  //One beyond the current slab's last Slot
+
+        void add_slab     (std::int64_t n); //Freelist what is left of the current slab; allocate a slab of n Slots
+        void delete_slabs ();        //Deallocate every slab (and so every node)
+    };
+};
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//PoolNodeAllocator::Pool definitions
+
+template<int slab_nodes>
+template<class N>
+PoolNodeAllocator<slab_nodes>::Pool<N>::Pool(Pool&& p) noexcept
+: slabs(p.slabs), free_list(p.free_list), free_count(p.free_count), unused(p.unused), unused_end(p.unused_end) {
+  p.slabs      = nullptr;
+  p.free_list  = nullptr;
+  p.free_count = 0;
+  p.unused     = nullptr;
+  p.unused_end = nullptr;
+}
+
+
+template<int slab_nodes>
+template<class N>
+auto PoolNodeAllocator<slab_nodes>::Pool<N>::operator = (Pool&& p) noexcept -> Pool& {
+  if (this == &p)
+    return *this;
+
+  delete_slabs();
+  slabs      = p.slabs;
+  free_list  = p.free_list;
+  free_count = p.free_count;
+  unused     = p.unused;
+  unused_end = p.unused_end;
+
+  p.slabs      = nullptr;
+  p.free_list  = nullptr;
+  p.free_count = 0;
+  p.unused     = nullptr;
+  p.unused_end = nullptr;
+  return *this;
+}
+
+
+template<int slab_nodes>
+template<class N>
+PoolNodeAllocator<slab_nodes>::Pool<N>::~Pool() {
+  delete_slabs();
+}
+
+
+template<int slab_nodes>
+template<class N>
+template<class... Args>
+N* PoolNodeAllocator<slab_nodes>::Pool<N>::create(Args&&... args) {
+  Slot* s;
+  if (free_list != nullptr) {
+    s = free_list;
+    free_list = free_list->next;
+    --free_count;
+  }else{
+    if (unused == unused_end)
+      add_slab(slab_nodes);
+    s = unused++;
+  }
+  return new (&s->node) N(std::forward<Args>(args)...);
+}
+
+
+template<int slab_nodes>
+template<class N>
+void PoolNodeAllocator<slab_nodes>::Pool<N>::destroy(N* n) {
+  n->~N();
+  Slot* s = reinterpret_cast<Slot*>(n);
+  s->next = free_list;
+  free_list = s;
+  ++free_count;
+}
+
+
+template<int slab_nodes>
+template<class N>
+void PoolNodeAllocator<slab_nodes>::Pool<N>::reserve(std::int64_t n) {
+  std::int64_t available = free_count + (unused_end-unused);
+  if (available < n)
+    add_slab(std::max(std::int64_t(slab_nodes), n-available));
+}
+
+
+template<int slab_nodes>
+template<class N>
+void PoolNodeAllocator<slab_nodes>::Pool<N>::add_slab(std::int64_t n) {
+  for (; unused != unused_end; ++unused) {
+    unused->next = free_list;
+    free_list = unused;
+    ++free_count;
+  }
+
+  Slot* slab = new Slot[n+1];
+  slab[0].next = slabs;
+  slabs        = slab;
+  unused       = slab+1;
+  unused_end   = slab+1+n;
+}
+
+
+template<int slab_nodes>
+template<class N>
+void PoolNodeAllocator<slab_nodes>::Pool<N>::delete_slabs() {
+  for (Slot* s = slabs; s != nullptr; /*See body*/) {
+    Slot* to_delete = s;
+    s = s->next;
+    delete[] to_delete;
+  }
+  slabs = nullptr;
+}
+
+
+}
+
+#endif /* NODE_ALLOCATOR_HPP_ */
@@ -0,0 +1,129 @@
+#include <iostream>
+#include <string>
+#include <limits>
+#include "ics46goody.hpp"
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "hash_graph.hpp"
+#include "dijkstra.hpp"
+
+static const int test_nodes  = 300;      //same_costs
+static const int test_edges  = 3000;     //same_costs
+static const int speed_nodes = 20000;    //speed_dijkstra
+static const int speed_edges = 400000;   //speed_dijkstra
+
+
+class DijkstraTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+//extended_dijkstra before decrease_key: a cheaper path to a node enqueues another Info for it, and
+//  dequeued Infos for nodes already in answer_map are skipped (lazy deletion)
+static ics::CostMap lazy_dijkstra(const ics::DistGraph& g, std::string start_node, long& dequeues) {
+  ics::CostMap info_map;
+  ics::CostMap answer_map;
+  for (auto val : g.all_nodes())
+    info_map.put(val.first, ics::Info(val.first));
+  ics::Info snode(start_node);
+  snode.cost = 0;
+  info_map.put(snode.node, snode);
+  ics::CostPQ info_pq;
+  for (auto val : info_map)
+    info_pq.enqueue(val.second);
+  while (info_map.size()) {
+    auto val = info_pq.dequeue();
+    ++dequeues;
+    if (val.cost == std::numeric_limits<int>::max())
+      break;
+    if (answer_map.has_key(val.node))
+      continue;
+    answer_map.put(val.node,info_map.erase(val.node));
+    for (const std::string& d : g.out_nodes(val.node)) {
+      int cost = g.edge_value(val.node, d) + val.cost;
+      if (info_map[d].cost > cost) {
+        ics::Info temp(d);
+        temp.cost = cost;
+        temp.from = val.node;
+        info_map.put(d,temp);
+        info_pq.enqueue(temp);
+      }
+    }
+  }
+  return answer_map;
+}
+
+
+static void random_graph(ics::DistGraph& g, int nodes, int edges) {
+  for (int n=0; n<nodes; ++n)
+    g.add_node("n" + std::to_string(n));
+  for (int e=0; e<edges; ++e)
+    g.add_edge("n" + std::to_string(ics::rand_range(0,nodes-1)), "n" + std::to_string(ics::rand_range(0,nodes-1)),
+               ics::rand_range(1,1000));
+}
+
+
+
+TEST_F(DijkstraTest, small_graph) {
+  ics::DistGraph g;
+  g.add_edge("a","b",7);
+  g.add_edge("a","c",2);
+  g.add_edge("c","b",3);
+  g.add_edge("b","d",1);
+  g.add_edge("c","d",9);
+  g.add_node("e");
+  ics::CostMap answer = ics::extended_dijkstra(g,"a");
+  ASSERT_EQ(4,answer.size());          //e is unreachable
+  ASSERT_FALSE(answer.has_key("e"));
+  ASSERT_EQ(0,answer["a"].cost);
+  ASSERT_EQ(5,answer["b"].cost);
+  ASSERT_EQ("c",answer["b"].from);
+  ASSERT_EQ(6,answer["d"].cost);
+
+  ics::ArrayQueue<std::string> path = ics::recover_path(answer,"d");
+  ASSERT_EQ(4,path.size());
+  ASSERT_EQ("a",path.dequeue());
+  ASSERT_EQ("c",path.dequeue());
+  ASSERT_EQ("b",path.dequeue());
+  ASSERT_EQ("d",path.dequeue());
+
+  ASSERT_THROW(ics::extended_dijkstra(g,"z"),ics::GraphError);   //start_node not in g
+}
+
+
+TEST_F(DijkstraTest, same_costs) {
+  ics::DistGraph g;
+  random_graph(g,test_nodes,test_edges);
+  long dequeues = 0;
+  for (int start=0; start<test_nodes; start+=37) {
+    std::string s = "n" + std::to_string(start);
+    ics::CostMap lazy = lazy_dijkstra(g,s,dequeues), indexed = ics::extended_dijkstra(g,s);
+    ASSERT_EQ(lazy.size(),indexed.size());
+    for (const auto& kv : lazy)
+      ASSERT_EQ(kv.second.cost,indexed[kv.first].cost);
+  }
+}
+
+
+TEST_F(DijkstraTest, speed_dijkstra) {
+  ics::DistGraph g;
+  random_graph(g,speed_nodes,speed_edges);
+  long dequeues = 0;
+  ics::Stopwatch lazy_time, indexed_time;
+
+  lazy_time.start();
+  ics::CostMap lazy = lazy_dijkstra(g,"n0",dequeues);
+  lazy_time.stop();
+  indexed_time.start();
+  ics::CostMap indexed = ics::extended_dijkstra(g,"n0");
+  indexed_time.stop();
+
+  ASSERT_EQ(lazy.size(),indexed.size());
+  for (const auto& kv : lazy)
+    ASSERT_EQ(kv.second.cost,indexed[kv.first].cost);
+  std::cout << "speed_dijkstra (" << speed_nodes << " nodes, " << speed_edges << " edges; lazy deletion / decrease_key)" << std::endl;
+  std::cout << "  dequeues = " << dequeues << " / " << g.node_count() << std::endl;
+  std::cout << "  seconds  = " << lazy_time.read() << " / " << indexed_time.read() << std::endl;
+}
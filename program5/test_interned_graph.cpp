@@ -0,0 +1,188 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>                    // std::remove
+#if defined(__linux__)
+#include <unistd.h>                  // sysconf
+#endif
+#include "ics46goody.hpp"
+#include "stopwatch.hpp"
+#include "gtest/gtest.h"
+#include "hash_graph.hpp"
+#include "interned_graph.hpp"
+
+typedef ics::HashGraph<int>         GraphType;
+typedef ics::InternedHashGraph<int> InternedGraphType;
+
+static const int flight_airports = 20000;    //speed_flight_graph_rss
+static const int flight_routes   = 500000;   //speed_flight_graph_rss
+
+
+class InternedGraphTest : public ::testing::Test {
+protected:
+    virtual void SetUp()    {}
+    virtual void TearDown() {}
+};
+
+
+template<class Graph>
+static void build_standard_graph(Graph& g) {
+  g.add_edge("a","b",12);
+  g.add_edge("a","c",13);
+  g.add_edge("b","d",24);
+  g.add_edge("c","d",34);
+  g.add_edge("a","d",14);
+  g.add_edge("d","a",41);
+  g.add_node("e");
+}
+
+
+//Resident set size (bytes) of this process; 0 where /proc is unavailable
+static long resident_bytes() {
+#if defined(__linux__)
+  std::ifstream statm("/proc/self/statm");
+  long pages = 0, resident = 0;
+  if (statm >> pages >> resident)
+    return resident * sysconf(_SC_PAGESIZE);
+#endif
+  return 0;
+}
+
+
+//Airport names as long as real ones ("Los Angeles International Airport (LAX)"): longer than
+//  std::string's small-string buffer, so every std::string copy of one is a heap block
+static std::string airport(int i) {
+  return "Regional Airport Number " + std::to_string(i) + " (A" + std::to_string(i) + ")";
+}
+
+
+
+TEST_F(InternedGraphTest, add_query) {
+  InternedGraphType g;
+  ASSERT_TRUE(g.empty());
+  build_standard_graph(g);
+  ASSERT_EQ(5,g.node_count());
+  ASSERT_EQ(6,g.edge_count());
+  ASSERT_TRUE(g.has_node("e"));
+  ASSERT_FALSE(g.has_node("f"));
+  ASSERT_TRUE(g.has_edge("d","a"));
+  ASSERT_FALSE(g.has_edge("b","a"));
+  ASSERT_FALSE(g.has_edge("a","f"));
+  ASSERT_EQ(14,g.edge_value("a","d"));
+  ASSERT_THROW(g.edge_value("a","e"),ics::GraphError);
+  ASSERT_EQ(3,g.out_degree("a"));
+  ASSERT_EQ(1,g.in_degree ("a"));
+  ASSERT_EQ(4,g.degree    ("a"));
+  ASSERT_EQ(0,g.degree    ("e"));
+  ASSERT_THROW(g.in_degree("f"),ics::GraphError);
+  ASSERT_THROW(g.node("f"),ics::GraphError);
+
+  ASSERT_TRUE(g.out_nodes("a").contains(g.node("c")));
+  ASSERT_TRUE(g.in_edges("d").contains(ics::SymbolEdge(g.node("b"),g.node("d"))));
+  ASSERT_EQ("b",g.name(g.node("b")));
+  ASSERT_EQ(5,g.names().size());
+}
+
+
+TEST_F(InternedGraphTest, remove) {
+  InternedGraphType g;
+  build_standard_graph(g);
+  InternedGraphType::Node d = g.node("d");
+  g.remove_edge("a","b");
+  ASSERT_FALSE(g.has_edge("a","b"));
+  ASSERT_EQ(2,g.out_degree("a"));
+  ASSERT_EQ(0,g.in_degree("b"));
+
+  g.remove_node("d");
+  ASSERT_FALSE(g.has_node("d"));
+  ASSERT_EQ(1,g.edge_count());
+  ASSERT_EQ(0,g.in_degree("a"));
+  ASSERT_EQ(0,g.out_degree("c"));
+  g.remove_node("d");                  //Not a node: nothing to do
+  ASSERT_EQ(d,g.add_node("d"));        //Its name (and Symbol) are still interned
+
+  g.clear();
+  ASSERT_TRUE(g.empty());
+  ASSERT_EQ(0,g.edge_count());
+  ASSERT_TRUE(g.names().empty());
+}
+
+
+TEST_F(InternedGraphTest, copy_equal_load_store) {
+  InternedGraphType g;
+  build_standard_graph(g);
+  InternedGraphType copy(g);
+  ASSERT_EQ(g,copy);
+  copy.remove_edge("a","c");
+  ASSERT_NE(g,copy);
+  copy = g;
+  ASSERT_EQ(g,copy);
+
+  InternedGraphType reversed;          //Same names, added in another order: other Symbols
+  reversed.add_node("e");
+  reversed.add_edge("d","a",41);
+  reversed.add_edge("a","d",14);
+  reversed.add_edge("c","d",34);
+  reversed.add_edge("b","d",24);
+  reversed.add_edge("a","c",13);
+  reversed.add_edge("a","b",12);
+  ASSERT_EQ(g,reversed);
+
+  std::ofstream out("interned_graph_test.txt");
+  g.store(out);
+  out.close();
+  std::ifstream in("interned_graph_test.txt");
+  InternedGraphType loaded;
+  loaded.load(in);
+  in.close();
+  std::remove("interned_graph_test.txt");
+  ASSERT_EQ(g,loaded);
+
+  std::ostringstream printed;
+  printed << g;
+  ASSERT_EQ(0u,printed.str().find("InternedHashGraph[\na -> ["));
+}
+
+
+//The same routes in a HashGraph and an InternedHashGraph (both kept alive, so memory freed while
+//  building one is not reused by the other): the growth of the resident set while building each
+TEST_F(InternedGraphTest, speed_flight_graph_rss) {
+  std::vector<std::string> names;
+  for (int i=0; i<flight_airports; ++i)
+    names.push_back(airport(i));
+  std::vector<int> from, to;
+  for (int r=0; r<flight_routes; ++r) {
+    from.push_back(ics::rand_range(0,flight_airports-1));
+    to.push_back(ics::rand_range(0,flight_airports-1));
+  }
+
+  ics::Stopwatch interned_time, string_time;
+  long start = resident_bytes();
+  InternedGraphType interned;
+  interned_time.start();
+  for (int r=0; r<flight_routes; ++r)
+    interned.add_edge(names[from[r]],names[to[r]],r);
+  interned_time.stop();
+  long after_interned = resident_bytes();
+
+  GraphType strings;
+  string_time.start();
+  for (int r=0; r<flight_routes; ++r)
+    strings.add_edge(names[from[r]],names[to[r]],r);
+  string_time.stop();
+  long after_strings = resident_bytes();
+
+  ASSERT_EQ(strings.node_count(),interned.node_count());
+  ASSERT_EQ(strings.edge_count(),interned.edge_count());
+  for (int r=0; r<flight_routes; r+=997)
+    ASSERT_EQ(strings.edge_value(names[from[r]],names[to[r]]),interned.edge_value(names[from[r]],names[to[r]]));
+
+  double string_mb = (after_strings-after_interned)/1e6, interned_mb = (after_interned-start)/1e6;
+  std::cout << "speed_flight_graph_rss (" << interned.node_count() << " airports, " << interned.edge_count()
+            << " routes; HashGraph / InternedHashGraph)" << std::endl;
+  std::cout << "  resident MB = " << string_mb << " / " << interned_mb << "  (interner: "
+            << interned.names().bytes()/1e6 << " MB)" << std::endl;
+  std::cout << "  build seconds = " << string_time.read() << " / " << interned_time.read() << std::endl;
+}